@@ -27,6 +27,7 @@
 #include <graphene/app/api_access.hpp>
 #include <graphene/app/application.hpp>
 #include <graphene/app/impacted.hpp>
+#include <graphene/account_history/account_history_plugin.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/get_config.hpp>
 #include <graphene/utilities/key_conversion.hpp>
@@ -406,13 +407,34 @@ namespace graphene { namespace app {
        if( start == operation_history_id_type() )
           start = node->operation_id;
 
+       // sequence number of the most recent operation which was moved out of memory
+       uint32_t spilled = 0;
        while(node && node->operation_id.instance.value > stop.instance.value && result.size() < limit)
        {
           if( node->operation_id.instance.value <= start.instance.value )
              result.push_back( node->operation_id(db) );
           if( node->next == account_transaction_history_id_type() )
              node = nullptr;
-          else node = &node->next(db);
+          else
+          {
+             const account_transaction_history_object* next = db.find( node->next );
+             if( next == nullptr )
+                spilled = node->sequence - 1;
+             node = next;
+          }
+       }
+
+       if( spilled > 0 && result.size() < limit )
+       {
+          auto plugin = _app.get_plugin<graphene::account_history::account_history_plugin>( "account_history" );
+          for( ; spilled > 0 && result.size() < limit; --spilled )
+          {
+             optional<operation_history_object> op = plugin->get_account_operation( account, spilled );
+             if( !op.valid() || op->id.instance() <= stop.instance.value )
+                break;
+             if( op->id.instance() <= start.instance.value )
+                result.push_back( *op );
+          }
        }
 
        return result;
@@ -430,17 +452,15 @@ namespace graphene { namespace app {
        if( start == 0 )
          start = account(db).statistics(db).total_ops;
        else start = min( account(db).statistics(db).total_ops, start );
-       const auto& hist_idx = db.get_index_type<account_transaction_history_index>();
-       const auto& by_seq_idx = hist_idx.indices().get<by_seq>();
-
-       auto itr = by_seq_idx.upper_bound( boost::make_tuple( account, start ) );
-       auto itr_stop = by_seq_idx.lower_bound( boost::make_tuple( account, stop ) );
-       --itr;
 
-       while ( itr != itr_stop && result.size() < limit )
+       // the plugin finds operations which were moved to disk as well as those in memory
+       auto plugin = _app.get_plugin<graphene::account_history::account_history_plugin>( "account_history" );
+       for( uint32_t seq = start; seq > stop && result.size() < limit; --seq )
        {
-          result.push_back( itr->operation_id(db) );
-          --itr;
+          optional<operation_history_object> op = plugin->get_account_operation( account, seq );
+          if( !op.valid() )
+             break;
+          result.push_back( *op );
        }
 
        return result;
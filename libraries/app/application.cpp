@@ -26,6 +26,7 @@
 #include <graphene/app/application.hpp>
 #include <graphene/app/plugin.hpp>
 
+#include <graphene/chain/exceptions.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <graphene/chain/protocol/types.hpp>
 #include <graphene/time/time.hpp>
@@ -310,6 +311,21 @@ namespace detail {
          }
          _chain_db->add_checkpoints( loaded_checkpoints );
 
+         if( _options->count("signature-recovery-threads") )
+            _chain_db->set_signature_recovery_threads( _options->at("signature-recovery-threads").as<uint32_t>() );
+         if( _options->count("signature-cache-size") )
+            _chain_db->set_signature_cache_size( _options->at("signature-cache-size").as<uint32_t>() );
+         if( _options->count("transaction-precheck-threads") )
+            _chain_db->set_transaction_precheck_threads( _options->at("transaction-precheck-threads").as<uint32_t>() );
+         if( _options->count("block-cache-size") )
+            _chain_db->set_block_cache_size( _options->at("block-cache-size").as<uint32_t>() );
+         if( _options->count("incremental-persistence") )
+            _chain_db->enable_incremental_persistence( _options->at("incremental-persistence").as<uint32_t>(),
+               uint64_t( _options->at("incremental-persistence-checkpoint-mb").as<uint32_t>() ) * 1024 * 1024 );
+         if( _options->count("replay-queue-depth") && _options->count("replay-hashing-threads") )
+            _chain_db->set_reindex_pipeline( _options->at("replay-queue-depth").as<uint32_t>(),
+                                             _options->at("replay-hashing-threads").as<uint32_t>() );
+
          if( _options->count("replay-blockchain") )
          {
             ilog("Replaying blockchain on user request.");
@@ -385,6 +401,9 @@ namespace detail {
             _chain_db->open(_data_dir / "blockchain", initial_state);
          }
 
+         if( _options->count("api-snapshot-threads") )
+            _chain_db->enable_state_snapshots( _options->at("api-snapshot-threads").as<uint32_t>() );
+
          if( _options->count("force-validate") )
          {
             ilog( "All transaction signatures will be validated" );
@@ -526,6 +545,20 @@ namespace detail {
             trx_count = 0;
          }
 
+         // already in a block or our pending state, most likely relayed to us by several peers
+         FC_ASSERT( !_chain_db->is_known_transaction( transaction_message.trx.id() ), "Duplicate transaction" );
+         try
+         {
+            _chain_db->precheck_transaction( transaction_message.trx );
+         }
+         catch( const graphene::chain::tx_malformed& e )
+         {
+            // tell the p2p code this one is the sender's fault.  Anything else, like an expiration that
+            // went out of bounds on the way, is passed on as it is and costs the sender nothing
+            FC_THROW_EXCEPTION( graphene::net::invalid_transaction_exception, "Transaction failed prechecks: ${e}",
+                                ("e", e.to_detail_string()) );
+         }
+
          _chain_db->push_transaction( transaction_message.trx );
       } FC_CAPTURE_AND_RETHROW( (transaction_message) ) }
 
@@ -912,6 +945,25 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("genesis-json", bpo::value<boost::filesystem::path>(), "File to read Genesis State from")
          ("dbg-init-key", bpo::value<string>(), "Block signing key to use for init witnesses, overrides genesis file")
          ("api-access", bpo::value<boost::filesystem::path>(), "JSON file specifying API permissions")
+         ("signature-recovery-threads", bpo::value<uint32_t>()->default_value(0),
+          "Number of worker threads used to recover transaction signature keys when validating blocks, 0 to disable")
+         ("signature-cache-size", bpo::value<uint32_t>()->default_value(100000),
+          "Number of recovered transaction signature keys remembered until their transactions expire, 0 to disable")
+         ("transaction-precheck-threads", bpo::value<uint32_t>()->default_value(2),
+          "Number of worker threads running the stateless checks on transactions received from the network, 0 to run them on the main thread")
+         ("block-cache-size", bpo::value<uint32_t>()->default_value(1024),
+          "Number of recently used decoded blocks kept in memory by the block database, 0 to disable")
+         ("incremental-persistence", bpo::value<uint32_t>()->implicit_value(16),
+          "Save only changed objects to a change log whenever a block becomes irreversible and on shutdown, merging the log after this many segments")
+         ("incremental-persistence-checkpoint-mb", bpo::value<uint32_t>()->default_value(1024),
+          "Size in MiB of the change log above which a full checkpoint replaces it, 0 never writes one while running")
+         ("replay-queue-depth", bpo::value<uint32_t>()->default_value(1000),
+          "Number of blocks read and hashed ahead of the block being applied while replaying the blockchain")
+         ("replay-hashing-threads", bpo::value<uint32_t>()->default_value(2),
+          "Number of threads computing block ids and merkle roots while replaying the blockchain")
+         ("api-snapshot-threads", bpo::value<uint32_t>()->default_value(0),
+          "Number of threads answering heavy database API queries from a copy of the chain state as of the last "
+          "applied block, which doubles the memory used by the chain state, 0 to answer them on the main thread")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
@@ -987,6 +1039,11 @@ std::shared_ptr<chain::database> application::chain_database() const
    return my->_chain_db;
 }
 
+const fc::path& application::data_dir()const
+{
+   return my->_data_dir;
+}
+
 void application::set_block_production(bool producing_blocks)
 {
    my->_is_block_producer = producing_blocks;
@@ -35,6 +35,7 @@
 #include <boost/multiprecision/cpp_int.hpp>
 
 #include <cctype>
+#include <deque>
 
 #include <cfenv>
 #include <iostream>
@@ -45,13 +46,77 @@ namespace graphene { namespace app {
 
 class database_api_impl;
 
+/**
+ *  Collects the changes of a database and hands them to every database_api_impl with a subscription.
+ *
+ *  All instances working on one database share a notifier, so each changed object is converted to a variant
+ *  once per batch no matter how many clients receive it. Changes are collected until the current task yields,
+ *  an object changed by a block and again by the pending transactions pushed back after it is sent once with
+ *  its latest state.
+ */
+class change_notifier : public std::enable_shared_from_this<change_notifier>
+{
+   public:
+      explicit change_notifier( graphene::chain::database& db );
+      ~change_notifier();
+
+      /** returns the notifier shared by all instances working on db, it only lives as long as they do */
+      static std::shared_ptr<change_notifier> get( graphene::chain::database& db );
+
+      void add_subscriber( const std::shared_ptr<database_api_impl>& api );
+
+   private:
+      /** the live notifier of each database, database_api instances are created on the thread which applies
+       *  blocks, like the signals they listen to */
+      static std::map< const graphene::chain::database*, std::weak_ptr<change_notifier> >& notifiers();
+
+      void on_objects_changed( const vector<object_id_type>& ids );
+      void on_objects_removed( const vector<const object*>& objs );
+      void on_applied_block();
+      void schedule_flush();
+      void flush();
+
+      graphene::chain::database&                                         _db;
+      vector< std::weak_ptr<database_api_impl> >                         _subscribers;
+      bool                                                               _flush_scheduled = false;
+
+      flat_set<object_id_type>                                           _changed;
+      /** the removed limit orders by market, they can no longer be looked up when the batch is sent */
+      map< pair<asset_id_type,asset_id_type>, vector<variant> >          _removed_orders;
+      vector<block_id_type>                                              _applied_blocks;
+      map< pair<asset_id_type,asset_id_type>, vector<pair<operation, operation_result>> > _market_ops;
+
+      boost::signals2::scoped_connection                                 _change_connection;
+      boost::signals2::scoped_connection                                 _removed_connection;
+      boost::signals2::scoped_connection                                 _applied_block_connection;
+};
+
+/** notifications queued for a client beyond this are dropped, starting with the oldest */
+static const size_t max_queued_notifications = 1000;
 
 class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 {
    public:
       database_api_impl( graphene::chain::database& db );
+      /** creates an instance which only answers queries from a copy of the chain state, without subscriptions */
+      explicit database_api_impl( const graphene::chain::database& snapshot );
       ~database_api_impl();
 
+      /**
+       *  Calls query with this instance, or with an instance reading the newest copy of the chain state on one of
+       *  the state snapshot threads if the database keeps such copies, so that heavy queries do not hold up blocks.
+       */
+      template<typename Query>
+      auto on_snapshot( const Query& query )const -> decltype( query( *this ) )
+      {
+         const graphene::chain::state_snapshots* snapshots = _db.get_state_snapshots();
+         if( snapshots == nullptr )
+            return query( *this );
+         return snapshots->async( [query]( const graphene::chain::database& snapshot ) {
+            return query( database_api_impl( snapshot ) );
+         }).wait();
+      }
+
       // Objects
       fc::variants get_objects(const vector<object_id_type>& ids)const;
 
@@ -72,6 +137,8 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       fc::variant_object get_config()const;
       chain_id_type get_chain_id()const;
       dynamic_global_property_object get_dynamic_global_properties()const;
+      pending_revalidation_stats get_pending_revalidation_stats()const;
+      signature_cache_stats get_signature_cache_stats()const;
 
       // Keys
       vector<vector<account_id_type>> get_key_references( vector<public_key_type> key )const;
@@ -79,6 +146,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       // Accounts
       vector<optional<account_object>> get_accounts(const vector<account_id_type>& account_ids)const;
       std::map<string,full_account> get_full_accounts( const vector<string>& names_or_ids, bool subscribe );
+      std::map<string,full_account> lookup_full_accounts( const vector<string>& names_or_ids )const;
       optional<account_object> get_account_by_name( string name )const;
       vector<account_id_type> get_account_references( account_id_type account_id )const;
       vector<optional<account_object>> lookup_account_names(const vector<string>& account_names)const;
@@ -108,9 +176,12 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       void subscribe_to_market(std::function<void(const variant&)> callback, asset_id_type a, asset_id_type b);
       void unsubscribe_from_market(asset_id_type a, asset_id_type b);
       market_ticker                      get_ticker( const string& base, const string& quote )const;
+      vector<market_ticker>              get_tickers( const vector<std::pair<string,string>>& markets )const;
       market_volume                      get_24_volume( const string& base, const string& quote )const;
       order_book                         get_order_book( const string& base, const string& quote, unsigned limit = 50 )const;
       vector<market_trade>               get_trade_history( const string& base, const string& quote, fc::time_point_sec start, fc::time_point_sec stop, unsigned limit = 100 )const;
+      /** returns the 24 hour statistics the market_history plugin keeps for the market, nullptr if it was never traded */
+      const graphene::market_history::market_ticker_object* find_market_ticker( asset_id_type a, asset_id_type b )const;
 
       // Witnesses
       vector<optional<witness_object>> get_witnesses(const vector<witness_id_type>& witness_ids)const;
@@ -166,24 +237,34 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
          return _subscribe_filter.contains( i );
       }
 
-      void broadcast_updates( const vector<variant>& updates );
-
-      /** called every time a block is applied to report the objects that were changed */
-      void on_objects_changed(const vector<object_id_type>& ids);
-      void on_objects_removed(const vector<const object*>& objs);
-      void on_applied_block();
+      /** registers this instance with the change notifier once it subscribes to anything */
+      void subscribe_to_changes();
+      /** queues a notification to the client, they are delivered in order by a single task */
+      void notify( const std::function<void(const fc::variant&)>& callback, const fc::variant& data );
+      void deliver_notifications();
+      subscription_queue_info get_subscription_queue_info()const;
 
       mutable fc::bloom_filter                               _subscribe_filter;
       std::function<void(const fc::variant&)> _subscribe_callback;
       std::function<void(const fc::variant&)> _pending_trx_callback;
       std::function<void(const fc::variant&)> _block_applied_callback;
 
-      boost::signals2::scoped_connection                                                                                           _change_connection;
-      boost::signals2::scoped_connection                                                                                           _removed_connection;
-      boost::signals2::scoped_connection                                                                                           _applied_block_connection;
+      struct notification
+      {
+         std::function<void(const fc::variant&)>  callback;
+         fc::variant                              data;
+      };
+      std::deque<notification>                                _notifications;
+      bool                                                    _delivering = false;
+      bool                                                    _subscribed_to_changes = false;
+      uint64_t                                                _delivered_notifications = 0;
+      uint64_t                                                _dropped_notifications = 0;
+
+      std::shared_ptr<change_notifier>                                                                                             _notifier;
       boost::signals2::scoped_connection                                                                                           _pending_trx_connection;
       map< pair<asset_id_type,asset_id_type>, std::function<void(const variant&)> >      _market_subscriptions;
       graphene::chain::database&                                                                                                            _db;
+      bool                                                                                                                                  _snapshot = false;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -197,25 +278,24 @@ database_api::database_api( graphene::chain::database& db )
 
 database_api::~database_api() {}
 
-database_api_impl::database_api_impl( graphene::chain::database& db ):_db(db)
+database_api_impl::database_api_impl( graphene::chain::database& db ):_notifier( change_notifier::get( db ) ),_db(db)
 {
    wlog("creating database api ${x}", ("x",int64_t(this)) );
-   _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids) {
-                                on_objects_changed(ids);
-                                });
-   _removed_connection = _db.removed_objects.connect([this](const vector<const object*>& objs) {
-                                on_objects_removed(objs);
-                                });
-   _applied_block_connection = _db.applied_block.connect([this](const signed_block&){ on_applied_block(); });
-
    _pending_trx_connection = _db.on_pending_transaction.connect([this](const signed_transaction& trx ){
                          if( _pending_trx_callback ) _pending_trx_callback( fc::variant(trx) );
                       });
 }
 
+database_api_impl::database_api_impl( const graphene::chain::database& snapshot )
+// only the const queries ever run on a snapshot
+:_db( const_cast<graphene::chain::database&>( snapshot ) ),_snapshot(true)
+{
+}
+
 database_api_impl::~database_api_impl()
 {
-   elog("freeing database api ${x}", ("x",int64_t(this)) );
+   if( !_snapshot )
+      elog("freeing database api ${x}", ("x",int64_t(this)) );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -273,6 +353,8 @@ void database_api_impl::set_subscribe_callback( std::function<void(const variant
 {
    edump((clear_filter));
    _subscribe_callback = cb;
+   if( cb )
+      subscribe_to_changes();
    if( clear_filter || !cb )
    {
       static fc::bloom_parameters param;
@@ -302,6 +384,8 @@ void database_api::set_block_applied_callback( std::function<void(const variant&
 void database_api_impl::set_block_applied_callback( std::function<void(const variant& block_id)> cb )
 {
    _block_applied_callback = cb;
+   if( cb )
+      subscribe_to_changes();
 }
 
 void database_api::cancel_all_subscriptions()
@@ -315,6 +399,20 @@ void database_api_impl::cancel_all_subscriptions()
    _market_subscriptions.clear();
 }
 
+subscription_queue_info database_api::get_subscription_queue_info()const
+{
+   return my->get_subscription_queue_info();
+}
+
+subscription_queue_info database_api_impl::get_subscription_queue_info()const
+{
+   subscription_queue_info result;
+   result.queued = _notifications.size();
+   result.delivered = _delivered_notifications;
+   result.dropped = _dropped_notifications;
+   return result;
+}
+
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
 // Blocks and transactions                                          //
@@ -422,6 +520,26 @@ dynamic_global_property_object database_api_impl::get_dynamic_global_properties(
    return _db.get(dynamic_global_property_id_type());
 }
 
+pending_revalidation_stats database_api::get_pending_revalidation_stats()const
+{
+   return my->get_pending_revalidation_stats();
+}
+
+pending_revalidation_stats database_api_impl::get_pending_revalidation_stats()const
+{
+   return _db.get_pending_revalidation_stats();
+}
+
+signature_cache_stats database_api::get_signature_cache_stats()const
+{
+   return my->get_signature_cache_stats();
+}
+
+signature_cache_stats database_api_impl::get_signature_cache_stats()const
+{
+   return _db.get_signature_cache_stats();
+}
+
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
 // Keys                                                             //
@@ -526,6 +644,23 @@ std::map<string,full_account> database_api::get_full_accounts( const vector<stri
 std::map<std::string, full_account> database_api_impl::get_full_accounts( const vector<std::string>& names_or_ids, bool subscribe)
 {
    idump((names_or_ids));
+   std::map<std::string, full_account> results = on_snapshot( [&names_or_ids]( const database_api_impl& impl ) {
+      return impl.lookup_full_accounts( names_or_ids );
+   });
+
+   if( subscribe )
+   {
+      for( const auto& item : results )
+      {
+         ilog( "subscribe to ${id}", ("id",item.second.account.name) );
+         subscribe_to_item( item.second.account.id );
+      }
+   }
+   return results;
+}
+
+std::map<std::string, full_account> database_api_impl::lookup_full_accounts( const vector<std::string>& names_or_ids )const
+{
    std::map<std::string, full_account> results;
 
    for (const std::string& account_name_or_id : names_or_ids)
@@ -543,12 +678,6 @@ std::map<std::string, full_account> database_api_impl::get_full_accounts( const
       if (account == nullptr)
          continue;
 
-      if( subscribe )
-      {
-         ilog( "subscribe to ${id}", ("id",account->name) );
-         subscribe_to_item( account->id );
-      }
-
       // fc::mutable_variant_object full_account;
       full_account acnt;
       acnt.account = *account;
@@ -585,8 +714,8 @@ std::map<std::string, full_account> database_api_impl::get_full_accounts( const
       auto balance_range = _db.get_index_type<account_balance_index>().indices().get<by_account_asset>().equal_range(boost::make_tuple(account->id));
       //vector<account_balance_object> balances;
       std::for_each(balance_range.first, balance_range.second,
-                    [&acnt](const account_balance_object& balance) {
-                       acnt.balances.emplace_back(balance);
+                    [&acnt](const account_balance_object* balance) {
+                       acnt.balances.emplace_back(*balance);
                     });
 
       // Add the account's vesting balances
@@ -667,7 +796,7 @@ vector<optional<account_object>> database_api_impl::lookup_account_names(const v
 
 map<string,account_id_type> database_api::lookup_accounts(const string& lower_bound_name, uint32_t limit)const
 {
-   return my->lookup_accounts( lower_bound_name, limit );
+   return my->on_snapshot( [&]( const database_api_impl& impl ) { return impl.lookup_accounts( lower_bound_name, limit ); } );
 }
 
 map<string,account_id_type> database_api_impl::lookup_accounts(const string& lower_bound_name, uint32_t limit)const
@@ -744,8 +873,8 @@ vector<asset> database_api_impl::get_account_balances(account_id_type acnt, cons
       // if the caller passes in an empty list of assets, return balances for all assets the account owns
       const account_balance_index& balance_index = _db.get_index_type<account_balance_index>();
       auto range = balance_index.indices().get<by_account_asset>().equal_range(boost::make_tuple(acnt));
-      for (const account_balance_object& balance : boost::make_iterator_range(range.first, range.second))
-         result.push_back(asset(balance.get_balance()));
+      for (const account_balance_object* balance : boost::make_iterator_range(range.first, range.second))
+         result.push_back(asset(balance->get_balance()));
    }
    else
    {
@@ -1014,6 +1143,7 @@ void database_api_impl::subscribe_to_market(std::function<void(const variant&)>
    if(a > b) std::swap(a,b);
    FC_ASSERT(a != b);
    _market_subscriptions[ std::make_pair(a,b) ] = callback;
+   subscribe_to_changes();
 }
 
 void database_api::unsubscribe_from_market(asset_id_type a, asset_id_type b)
@@ -1039,61 +1169,61 @@ market_ticker database_api_impl::get_ticker( const string& base, const string& q
    FC_ASSERT( assets[0], "Invalid base asset symbol: ${s}", ("s",base) );
    FC_ASSERT( assets[1], "Invalid quote asset symbol: ${s}", ("s",quote) );
 
-   auto base_id = assets[0]->id;
-   auto quote_id = assets[1]->id;
-
    market_ticker result;
 
    result.base = base;
    result.quote = quote;
+   result.latest = 0;
    result.base_volume = 0;
    result.quote_volume = 0;
    result.percent_change = 0;
    result.lowest_ask = 0;
    result.highest_bid = 0;
 
-   auto price_to_real = [&]( const share_type a, int p ) { return double( a.value ) / pow( 10, p ); };
-
    try {
-      if( base_id > quote_id ) std::swap(base_id, quote_id);
-
-      uint32_t day = 86400;
-      auto now = fc::time_point_sec( fc::time_point::now() );
-      auto orders = get_order_book( base, quote, 1 );
-      auto trades = get_trade_history( base, quote, now, fc::time_point_sec( now.sec_since_epoch() - day ), 100 );
-
-      result.latest = trades[0].price;
-
-      for ( market_trade t: trades )
+      const graphene::market_history::market_ticker_object* ticker = find_market_ticker( assets[0]->id, assets[1]->id );
+      if( ticker != nullptr )
       {
-         result.base_volume += t.value;
-         result.quote_volume += t.amount;
+         // the ticker stores the amounts of the asset with the lower id first
+         auto amount_to_real = [&]( share_type lower, share_type higher, const asset_object& a ) {
+            return double( ( a.id == ticker->base ? lower : higher ).value ) / pow( 10, a.precision );
+         };
+         auto price_to_real = [&]( share_type lower, share_type higher ) {
+            return amount_to_real( lower, higher, *assets[0] ) / amount_to_real( lower, higher, *assets[1] );
+         };
+
+         result.base_volume = amount_to_real( ticker->base_volume, ticker->quote_volume, *assets[0] );
+         result.quote_volume = amount_to_real( ticker->base_volume, ticker->quote_volume, *assets[1] );
+         result.latest = price_to_real( ticker->latest_base, ticker->latest_quote );
+         if( ticker->has_open() )
+            result.percent_change = ( ( result.latest / price_to_real( ticker->open_base, ticker->open_quote ) ) - 1 ) * 100;
       }
 
-      while (trades.size() == 100)
-      {
-         trades = get_trade_history( base, quote, trades[99].date, fc::time_point_sec( now.sec_since_epoch() - day ), 100 );
-
-         for ( market_trade t: trades )
-         {
-            result.base_volume += t.value;
-            result.quote_volume += t.amount;
-         }
-      }
-
-      trades = get_trade_history( base, quote, trades.back().date, fc::time_point_sec(), 1 );
-      result.percent_change = trades.size() > 0 ? ( ( result.latest / trades.back().price ) - 1 ) * 100 : 0;
-
-      //if (assets[0]->id == base_id)
-      {
+      auto orders = get_order_book( base, quote, 1 );
+      if( !orders.asks.empty() )
          result.lowest_ask = orders.asks[0].price;
+      if( !orders.bids.empty() )
          result.highest_bid = orders.bids[0].price;
-      }
 
       return result;
    } FC_CAPTURE_AND_RETHROW( (base)(quote) )
 }
 
+vector<market_ticker> database_api::get_tickers( const vector<std::pair<string,string>>& markets )const
+{
+   return my->get_tickers( markets );
+}
+
+vector<market_ticker> database_api_impl::get_tickers( const vector<std::pair<string,string>>& markets )const
+{
+   FC_ASSERT( markets.size() <= 100 );
+   vector<market_ticker> result;
+   result.reserve( markets.size() );
+   for( const auto& market : markets )
+      result.push_back( get_ticker( market.first, market.second ) );
+   return result;
+}
+
 market_volume database_api::get_24_volume( const string& base, const string& quote )const
 {
    return my->get_24_volume( base, quote );
@@ -1105,47 +1235,33 @@ market_volume database_api_impl::get_24_volume( const string& base, const string
    FC_ASSERT( assets[0], "Invalid base asset symbol: ${s}", ("s",base) );
    FC_ASSERT( assets[1], "Invalid quote asset symbol: ${s}", ("s",quote) );
 
-   auto base_id = assets[0]->id;
-   auto quote_id = assets[1]->id;
-
    market_volume result;
    result.base = base;
    result.quote = quote;
    result.base_volume = 0;
    result.quote_volume = 0;
 
-   try {
-      if( base_id > quote_id ) std::swap(base_id, quote_id);
-
-      uint32_t bucket_size = 86400;
-      auto now = fc::time_point_sec( fc::time_point::now() );
-
-      auto trades = get_trade_history( base, quote, now, fc::time_point_sec( now.sec_since_epoch() - bucket_size ), 100 );
-
-      for ( market_trade t: trades )
-      {
-         result.base_volume += t.value;
-         result.quote_volume += t.amount;
-      }
-
-      while (trades.size() == 100)
-      {
-         trades = get_trade_history( base, quote, trades[99].date, fc::time_point_sec( now.sec_since_epoch() - bucket_size ), 100 );
-
-         for ( market_trade t: trades )
-         {
-            result.base_volume += t.value;
-            result.quote_volume += t.amount;
-         }
-      }
+   const graphene::market_history::market_ticker_object* ticker = find_market_ticker( assets[0]->id, assets[1]->id );
+   if( ticker != nullptr )
+   {
+      const bool base_first = ticker->base == assets[0]->id;
+      result.base_volume = double( ( base_first ? ticker->base_volume : ticker->quote_volume ).value ) / pow( 10, assets[0]->precision );
+      result.quote_volume = double( ( base_first ? ticker->quote_volume : ticker->base_volume ).value ) / pow( 10, assets[1]->precision );
+   }
+   return result;
+}
 
-      return result;
-   } FC_CAPTURE_AND_RETHROW( (base)(quote) )
+const graphene::market_history::market_ticker_object* database_api_impl::find_market_ticker( asset_id_type a, asset_id_type b )const
+{
+   if( a > b ) std::swap( a, b );
+   const auto& ticker_idx = _db.get_index_type<graphene::market_history::market_ticker_index>().indices().get<graphene::market_history::by_market>();
+   auto itr = ticker_idx.find( boost::make_tuple( a, b ) );
+   return itr == ticker_idx.end() ? nullptr : &*itr;
 }
 
 order_book database_api::get_order_book( const string& base, const string& quote, unsigned limit )const
 {
-   return my->get_order_book( base, quote, limit);
+   return my->on_snapshot( [&]( const database_api_impl& impl ) { return impl.get_order_book( base, quote, limit ); } );
 }
 
 order_book database_api_impl::get_order_book( const string& base, const string& quote, unsigned limit )const
@@ -1750,166 +1866,233 @@ vector<blinded_balance_object> database_api_impl::get_blinded_balances( const fl
 //                                                                  //
 //////////////////////////////////////////////////////////////////////
 
-void database_api_impl::broadcast_updates( const vector<variant>& updates )
+void database_api_impl::subscribe_to_changes()
 {
-   if( updates.size() ) {
-      auto capture_this = shared_from_this();
-      fc::async([capture_this,updates](){
-          capture_this->_subscribe_callback( fc::variant(updates) );
-      });
-   }
+   if( _subscribed_to_changes || _snapshot )
+      return;
+   _subscribed_to_changes = true;
+   _notifier->add_subscriber( shared_from_this() );
 }
 
-void database_api_impl::on_objects_removed( const vector<const object*>& objs )
+void database_api_impl::notify( const std::function<void(const fc::variant&)>& callback, const fc::variant& data )
 {
-   /// we need to ensure the database_api is not deleted for the life of the async operation
-   if( _subscribe_callback )
+   _notifications.push_back( notification{ callback, data } );
+   if( _notifications.size() > max_queued_notifications )
    {
-      vector<variant>    updates;
-      updates.reserve(objs.size());
+      if( _dropped_notifications == 0 )
+         wlog( "database api ${x} is not keeping up with its notifications, dropping the oldest", ("x",int64_t(this)) );
+      _notifications.pop_front();
+      ++_dropped_notifications;
+   }
 
-      for( auto obj : objs )
-         updates.emplace_back( obj->id );
-      broadcast_updates( updates );
+   if( !_delivering )
+   {
+      _delivering = true;
+      /// we need to ensure the database_api is not deleted for the life of the async operation
+      auto capture_this = shared_from_this();
+      fc::async( [capture_this](){ capture_this->deliver_notifications(); } );
    }
+}
 
-   if( _market_subscriptions.size() )
+void database_api_impl::deliver_notifications()
+{
+   // a callback may yield while the connection sends, notifications queued meanwhile are delivered by this loop
+   while( !_notifications.empty() )
    {
-      map< pair<asset_id_type, asset_id_type>, vector<variant> > broadcast_queue;
-      for( const auto& obj : objs )
-      {
-         const limit_order_object* order = dynamic_cast<const limit_order_object*>(obj);
-         if( order )
-         {
-            auto sub = _market_subscriptions.find( order->get_market() );
-            if( sub != _market_subscriptions.end() )
-               broadcast_queue[order->get_market()].emplace_back( order->id );
-         }
-      }
-      if( broadcast_queue.size() )
-      {
-         auto capture_this = shared_from_this();
-         fc::async([capture_this,this,broadcast_queue](){
-             for( const auto& item : broadcast_queue )
-             {
-               auto sub = _market_subscriptions.find(item.first);
-               if( sub != _market_subscriptions.end() )
-                   sub->second( fc::variant(item.second ) );
-             }
-         });
+      notification next = std::move( _notifications.front() );
+      _notifications.pop_front();
+      try {
+         next.callback( next.data );
+      } catch( const fc::exception& e ) {
+         wlog( "notification to database api ${x} failed: ${e}", ("x",int64_t(this))("e",e.to_detail_string()) );
       }
+      ++_delivered_notifications;
    }
+   _delivering = false;
+}
+
+//////////////////////////////////////////////////////////////////////
+//                                                                  //
+// Change notifier                                                  //
+//                                                                  //
+//////////////////////////////////////////////////////////////////////
+
+change_notifier::change_notifier( graphene::chain::database& db ):_db(db)
+{
+   _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids) {
+                                on_objects_changed(ids);
+                                });
+   _removed_connection = _db.removed_objects.connect([this](const vector<const object*>& objs) {
+                                on_objects_removed(objs);
+                                });
+   _applied_block_connection = _db.applied_block.connect([this](const signed_block&){ on_applied_block(); });
 }
 
-void database_api_impl::on_objects_changed(const vector<object_id_type>& ids)
+change_notifier::~change_notifier()
 {
-   vector<variant>    updates;
-   map< pair<asset_id_type, asset_id_type>,  vector<variant> > market_broadcast_queue;
+   // the last database_api instance of the database went away
+   auto itr = notifiers().find( &_db );
+   if( itr != notifiers().end() && itr->second.expired() )
+      notifiers().erase( itr );
+}
 
-   for(auto id : ids)
-   {
-      const object* obj = nullptr;
-      if( _subscribe_callback )
-      {
-         obj = _db.find_object( id );
-         if( obj )
-         {
-            updates.emplace_back( obj->to_variant() );
-         }
-         else
-         {
-            updates.emplace_back(id); // send just the id to indicate removal
-         }
-      }
+std::map< const graphene::chain::database*, std::weak_ptr<change_notifier> >& change_notifier::notifiers()
+{
+   static std::map< const graphene::chain::database*, std::weak_ptr<change_notifier> > instance;
+   return instance;
+}
 
-      if( _market_subscriptions.size() )
-      {
-         if( !_subscribe_callback )
-            obj = _db.find_object( id );
-         if( obj )
-         {
-            const limit_order_object* order = dynamic_cast<const limit_order_object*>(obj);
-            if( order )
-            {
-               auto sub = _market_subscriptions.find( order->get_market() );
-               if( sub != _market_subscriptions.end() )
-                  market_broadcast_queue[order->get_market()].emplace_back( order->id );
-            }
-         }
-      }
+std::shared_ptr<change_notifier> change_notifier::get( graphene::chain::database& db )
+{
+   std::weak_ptr<change_notifier>& entry = notifiers()[&db];
+   std::shared_ptr<change_notifier> result = entry.lock();
+   if( !result )
+   {
+      result = std::make_shared<change_notifier>( db );
+      entry = result;
    }
+   return result;
+}
 
-   auto capture_this = shared_from_this();
+void change_notifier::add_subscriber( const std::shared_ptr<database_api_impl>& api )
+{
+   _subscribers.push_back( api );
+}
 
-   /// pushing the future back / popping the prior future if it is complete.
-   /// if a connection hangs then this could get backed up and result in
-   /// a failure to exit cleanly.
-   fc::async([capture_this,this,updates,market_broadcast_queue](){
-      if( _subscribe_callback ) _subscribe_callback( updates );
+void change_notifier::on_objects_changed( const vector<object_id_type>& ids )
+{
+   if( _subscribers.empty() )
+      return;
+   _changed.insert( ids.begin(), ids.end() );
+   schedule_flush();
+}
 
-      for( const auto& item : market_broadcast_queue )
-      {
-        auto sub = _market_subscriptions.find(item.first);
-        if( sub != _market_subscriptions.end() )
-            sub->second( fc::variant(item.second ) );
-      }
-   });
+void change_notifier::on_objects_removed( const vector<const object*>& objs )
+{
+   if( _subscribers.empty() )
+      return;
+   for( const object* obj : objs )
+   {
+      _changed.insert( obj->id );
+      const limit_order_object* order = dynamic_cast<const limit_order_object*>(obj);
+      if( order )
+         _removed_orders[order->get_market()].emplace_back( order->id );
+   }
+   schedule_flush();
 }
 
 /** note: this method cannot yield because it is called in the middle of
  * apply a block.
  */
-void database_api_impl::on_applied_block()
+void change_notifier::on_applied_block()
 {
-   if (_block_applied_callback)
+   if( _subscribers.empty() )
+      return;
+   _applied_blocks.push_back( _db.head_block_id() );
+
+   for( const optional< operation_history_object >& o_op : _db.get_applied_operations() )
    {
-      auto capture_this = shared_from_this();
-      block_id_type block_id = _db.head_block_id();
-      fc::async([this,capture_this,block_id](){
-         _block_applied_callback(fc::variant(block_id));
-      });
+      if( !o_op.valid() )
+         continue;
+      const operation_history_object& op = *o_op;
+      /* limit_order_create_operation and limit_order_cancel_operation are sent as changed orders */
+      if( op.op.which() == operation::tag<fill_order_operation>::value )
+         _market_ops[op.op.get<fill_order_operation>().get_market()].push_back( std::make_pair( op.op, op.result ) );
    }
+   schedule_flush();
+}
 
-   if(_market_subscriptions.size() == 0)
+void change_notifier::schedule_flush()
+{
+   if( _flush_scheduled )
       return;
+   _flush_scheduled = true;
+   auto capture_this = shared_from_this();
+   fc::async( [capture_this](){ capture_this->flush(); } );
+}
 
-   const auto& ops = _db.get_applied_operations();
-   map< std::pair<asset_id_type,asset_id_type>, vector<pair<operation, operation_result>> > subscribed_markets_ops;
-   for(const optional< operation_history_object >& o_op : ops)
+void change_notifier::flush()
+{
+   _flush_scheduled = false;
+   flat_set<object_id_type> changed = std::move( _changed );
+   auto removed_orders = std::move( _removed_orders );
+   vector<block_id_type> applied_blocks = std::move( _applied_blocks );
+   auto market_ops = std::move( _market_ops );
+   _changed.clear();
+   _removed_orders.clear();
+   _applied_blocks.clear();
+   _market_ops.clear();
+
+   vector< std::shared_ptr<database_api_impl> > subscribers;
+   bool objects_wanted = false;
+   bool markets_wanted = false;
+   for( auto itr = _subscribers.begin(); itr != _subscribers.end(); )
    {
-      if( !o_op.valid() )
+      std::shared_ptr<database_api_impl> api = itr->lock();
+      if( !api )
+      {
+         itr = _subscribers.erase( itr );
          continue;
-      const operation_history_object& op = *o_op;
+      }
+      objects_wanted |= bool( api->_subscribe_callback );
+      markets_wanted |= !api->_market_subscriptions.empty();
+      subscribers.push_back( std::move( api ) );
+      ++itr;
+   }
 
-      std::pair<asset_id_type,asset_id_type> market;
-      switch(op.op.which())
+   // each changed object is converted once and the variants are shared by all subscribers
+   vector<variant> updates;
+   map< pair<asset_id_type,asset_id_type>, vector<variant> > market_orders = std::move( removed_orders );
+   for( const object_id_type& id : changed )
+   {
+      const object* obj = ( objects_wanted || markets_wanted ) ? _db.find_object( id ) : nullptr;
+      if( objects_wanted )
       {
-         /*  This is sent via the object_changed callback
-         case operation::tag<limit_order_create_operation>::value:
-            market = op.op.get<limit_order_create_operation>().get_market();
-            break;
-         */
-         case operation::tag<fill_order_operation>::value:
-            market = op.op.get<fill_order_operation>().get_market();
-            break;
-            /*
-         case operation::tag<limit_order_cancel_operation>::value:
-         */
-         default: break;
+         if( obj )
+            updates.emplace_back( obj->to_variant() );
+         else
+            updates.emplace_back( id ); // send just the id to indicate removal
+      }
+      if( markets_wanted && obj )
+      {
+         const limit_order_object* order = dynamic_cast<const limit_order_object*>(obj);
+         if( order )
+            market_orders[order->get_market()].emplace_back( order->id );
       }
-      if(_market_subscriptions.count(market))
-         subscribed_markets_ops[market].push_back(std::make_pair(op.op, op.result));
    }
-   /// we need to ensure the database_api is not deleted for the life of the async operation
-   auto capture_this = shared_from_this();
-   fc::async([this,capture_this,subscribed_markets_ops](){
-      for(auto item : subscribed_markets_ops)
+   const fc::variant all_updates( updates );
+   map< pair<asset_id_type,asset_id_type>, fc::variant > market_order_variants;
+   for( auto& item : market_orders )
+      market_order_variants[item.first] = fc::variant( item.second );
+   map< pair<asset_id_type,asset_id_type>, fc::variant > market_op_variants;
+   if( markets_wanted )
+      for( auto& item : market_ops )
+         market_op_variants[item.first] = fc::variant( item.second );
+
+   for( const auto& api : subscribers )
+   {
+      // every subscriber receives every changed object, the subscribe filter does not narrow them down
+      if( api->_subscribe_callback && !updates.empty() )
+         api->notify( api->_subscribe_callback, all_updates );
+
+      for( const auto& item : market_order_variants )
       {
-         auto itr = _market_subscriptions.find(item.first);
-         if(itr != _market_subscriptions.end())
-            itr->second(fc::variant(item.second));
+         auto sub = api->_market_subscriptions.find( item.first );
+         if( sub != api->_market_subscriptions.end() )
+            api->notify( sub->second, item.second );
       }
-   });
+
+      if( api->_block_applied_callback )
+         for( const block_id_type& block_id : applied_blocks )
+            api->notify( api->_block_applied_callback, fc::variant( block_id ) );
+
+      for( const auto& item : market_op_variants )
+      {
+         auto sub = api->_market_subscriptions.find( item.first );
+         if( sub != api->_market_subscriptions.end() )
+            api->notify( sub->second, item.second );
+      }
+   }
 }
 
 } } // graphene::app
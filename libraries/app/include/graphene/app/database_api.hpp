@@ -106,6 +106,15 @@ struct market_trade
    double                     value;
 };
 
+struct subscription_queue_info
+{
+   /** notifications waiting to be sent to this client */
+   uint32_t                   queued = 0;
+   uint64_t                   delivered = 0;
+   /** notifications dropped because the client fell too far behind */
+   uint64_t                   dropped = 0;
+};
+
 /**
  * @brief The database_api class implements the RPC API for the chain database.
  *
@@ -145,6 +154,13 @@ class database_api
        * This unsubscribes from all subscribed markets and objects.
        */
       void cancel_all_subscriptions();
+      /**
+       * @brief Returns the state of the queue of notifications to this client
+       *
+       * Notifications are queued per client and sent in order. A client which falls more than 1000 notifications
+       * behind loses the oldest ones, and should fetch the objects it follows again with get_objects.
+       */
+      subscription_queue_info get_subscription_queue_info()const;
 
       /////////////////////////////
       // Blocks and transactions //
@@ -205,6 +221,18 @@ class database_api
        */
       dynamic_global_property_object get_dynamic_global_properties()const;
 
+      /**
+       * @brief Get how many pending transactions were applied again, checked again or dropped after the most recent
+       * block, and how long that took
+       */
+      pending_revalidation_stats get_pending_revalidation_stats()const;
+
+      /**
+       * @brief Get the number of transaction signatures whose keys were found in or missing from the signature key
+       * cache, and its current size
+       */
+      signature_cache_stats get_signature_cache_stats()const;
+
       //////////
       // Keys //
       //////////
@@ -380,10 +408,17 @@ class database_api
        * @brief Returns the ticker for the market assetA:assetB
        * @param a String name of the first asset
        * @param b String name of the second asset
-       * @return The market ticker for the past 24 hours.
+       * @return The market ticker for the 24 hours before the head block.
        */
       market_ticker get_ticker( const string& base, const string& quote )const;
 
+      /**
+       * @brief Returns the tickers of many markets at once
+       * @param markets Pairs of base and quote asset symbols, at most 100
+       * @return The market tickers for the past 24 hours, in the order of the markets
+       */
+      vector<market_ticker> get_tickers( const vector<std::pair<string,string>>& markets )const;
+
       /**
        * @brief Returns the 24 hour volume for the market assetA:assetB
        * @param a String name of the first asset
@@ -561,6 +596,7 @@ FC_REFLECT( graphene::app::order_book, (base)(quote)(bids)(asks) );
 FC_REFLECT( graphene::app::market_ticker, (base)(quote)(latest)(lowest_ask)(highest_bid)(percent_change)(base_volume)(quote_volume) );
 FC_REFLECT( graphene::app::market_volume, (base)(quote)(base_volume)(quote_volume) );
 FC_REFLECT( graphene::app::market_trade, (date)(price)(amount)(value) );
+FC_REFLECT( graphene::app::subscription_queue_info, (queued)(delivered)(dropped) );
 
 FC_API(graphene::app::database_api,
    // Objects
@@ -571,6 +607,7 @@ FC_API(graphene::app::database_api,
    (set_pending_transaction_callback)
    (set_block_applied_callback)
    (cancel_all_subscriptions)
+   (get_subscription_queue_info)
 
    // Blocks and transactions
    (get_block_header)
@@ -584,6 +621,8 @@ FC_API(graphene::app::database_api,
    (get_config)
    (get_chain_id)
    (get_dynamic_global_properties)
+   (get_pending_revalidation_stats)
+   (get_signature_cache_stats)
 
    // Keys
    (get_key_references)
@@ -621,6 +660,7 @@ FC_API(graphene::app::database_api,
    (subscribe_to_market)
    (unsubscribe_from_market)
    (get_ticker)
+   (get_tickers)
    (get_24_volume)
    (get_trade_history)
 
@@ -267,4 +267,49 @@ void account_referrer_index::object_modified( const object& after  )
 {
 }
 
+const object& account_balance_index::create( const std::function<void(object&)>& constructor )
+{
+   const auto& result = static_cast<const account_balance_object&>( slab_index::create( constructor ) );
+   if( !_indices.insert( &result ).second )
+   {
+      const object_id_type id = result.id;
+      slab_index::remove( result );
+      set_next_id( id );
+      FC_THROW( "Could not create object! Most likely a uniqueness constraint is violated." );
+   }
+   return result;
+}
+
+const object& account_balance_index::insert( object&& obj )
+{
+   const auto& result = static_cast<const account_balance_object&>( slab_index::insert( std::move(obj) ) );
+   if( !_indices.insert( &result ).second )
+   {
+      slab_index::remove( result );
+      FC_THROW( "Could not insert object, most likely a uniqueness constraint was violated" );
+   }
+   return result;
+}
+
+void account_balance_index::modify( const object& obj, const std::function<void(object&)>& m )
+{
+   const auto& balance = static_cast<const account_balance_object&>( obj );
+   auto& by_key = _indices.get<by_account_asset>();
+   auto itr = by_key.find( boost::make_tuple( balance.owner, balance.asset_type ) );
+   assert( itr != by_key.end() && *itr == &balance );
+   // the pointed to balance changes while modify() holds its node, which is then relinked
+   auto ok = by_key.modify( itr, [&]( const account_balance_object* ){ slab_index::modify( obj, m ); } );
+   FC_ASSERT( ok, "Could not modify object, most likely a index constraint was violated" );
+}
+
+void account_balance_index::remove( const object& obj )
+{
+   const auto& balance = static_cast<const account_balance_object&>( obj );
+   auto& by_key = _indices.get<by_account_asset>();
+   auto itr = by_key.find( boost::make_tuple( balance.owner, balance.asset_type ) );
+   assert( itr != by_key.end() && *itr == &balance );
+   by_key.erase( itr );
+   slab_index::remove( obj );
+}
+
 } } // graphene::chain
@@ -23,9 +23,12 @@
  */
 #include <graphene/chain/block_database.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
+#include <fc/interprocess/file_mapping.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/smart_ref_impl.hpp>
 
+#include <cstring>
+
 namespace graphene { namespace chain {
 
 struct index_entry
@@ -39,22 +42,55 @@ FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
 
 namespace graphene { namespace chain {
 
+/** the index file grows by at least this many entries at a time, so it is rarely remapped */
+static const uint64_t index_growth = 1024 * 64;
+
+struct block_database::index_mapping
+{
+   index_mapping( const fc::path& file, uint64_t entries )
+   :mapping( file.generic_string().c_str(), fc::read_write ),
+    region( mapping, fc::read_write, 0, entries * sizeof(index_entry) ),
+    capacity( entries ){}
+
+   index_entry* entries()const { return (index_entry*)region.get_address(); }
+
+   fc::file_mapping  mapping;
+   fc::mapped_region region;
+   uint64_t          capacity;
+};
+
+block_database::block_database()
+:_index_count(0),_blocks_size(0),_cache_hits(0),_cache_misses(0){}
+
+block_database::~block_database()
+{
+   if( is_open() )
+      close();
+}
+
 void block_database::open( const fc::path& dbdir )
 { try {
    fc::create_directories(dbdir);
-   _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
-   _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
-
-   if( !fc::exists( dbdir/"index" ) )
-   {
-     _block_num_to_pos.open( (dbdir/"index").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-   }
-   else
-   {
-     _block_num_to_pos.open( (dbdir/"index").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-   }
+   _index_file = dbdir/"index";
+
+   _blocks.open( dbdir/"blocks" );
+   _index_data.open( _index_file );
+
+   _blocks_size = _blocks.size();
+   const uint64_t entries_on_disk = _index_data.size() / sizeof(index_entry);
+   _index_count = 0;
+   _index.reset();
+   reserve_index( entries_on_disk );
+
+   // the tail of the index may be preallocated space left by an unclean shutdown, drop the never written entries
+   // and those whose block did not reach the blocks file before the crash
+   uint64_t count = entries_on_disk;
+   while( count > 0 && ( _index->entries()[count-1].block_id == block_id_type()
+                         || !in_blocks_file( _index->entries()[count-1] ) ) )
+      --count;
+   if( count < entries_on_disk )
+      wlog( "Dropping ${n} incomplete entries at the end of the block database index", ("n", entries_on_disk - count) );
+   _index_count = count;
 } FC_CAPTURE_AND_RETHROW( (dbdir) ) }
 
 bool block_database::is_open()const
@@ -64,14 +100,173 @@ bool block_database::is_open()const
 
 void block_database::close()
 {
-  _blocks.close();
-  _block_num_to_pos.close();
+   flush();
+   // unmap the index before it is truncated, the mapping must not reach past the end of the file
+   _index.reset();
+   // trim the preallocated tail so the index is exactly one entry per block number on disk
+   if( _index_data.is_open() )
+   {
+      try {
+         _index_data.resize( _index_count * sizeof(index_entry) );
+      } catch( const fc::exception& e ) {
+         elog( "Unable to trim block database index: ${e}", ("e", e.to_detail_string()) );
+      }
+      _index_data.close();
+   }
+   _blocks.close();
+   _index_count = 0;
+   _blocks_size = 0;
+
+   std::lock_guard<std::mutex> lock( _cache_mutex );
+   _cache.clear();
+   _cache_by_num.clear();
 }
 
 void block_database::flush()
 {
-  _blocks.flush();
-  _block_num_to_pos.flush();
+   auto index = std::atomic_load( &_index );
+   if( index )
+      index->region.flush();
+   if( _index_data.is_open() )
+      _index_data.sync();
+   if( _blocks.is_open() )
+      _blocks.sync();
+}
+
+void block_database::set_cache_size( size_t max_blocks )
+{
+   std::lock_guard<std::mutex> lock( _cache_mutex );
+   _cache_max_size = max_blocks;
+   while( _cache.size() > _cache_max_size )
+   {
+      _cache_by_num.erase( _cache.back().block_num );
+      _cache.pop_back();
+   }
+}
+
+optional<signed_block> block_database::cache_find( uint32_t block_num, const block_id_type* id, uint64_t& generation )const
+{
+   block_ptr found;
+   {
+      std::lock_guard<std::mutex> lock( _cache_mutex );
+      generation = _cache_generation;
+      auto itr = _cache_by_num.find( block_num );
+      if( itr != _cache_by_num.end() && ( id == nullptr || itr->second->id == *id ) )
+      {
+         _cache.splice( _cache.begin(), _cache, itr->second );
+         found = itr->second->block;
+      }
+   }
+   if( !found )
+   {
+      ++_cache_misses;
+      return optional<signed_block>();
+   }
+   ++_cache_hits;
+   return *found;
+}
+
+void block_database::cache_insert( uint32_t block_num, const block_id_type& id, block_ptr b, uint64_t generation )const
+{
+   std::lock_guard<std::mutex> lock( _cache_mutex );
+   if( _cache_max_size == 0 || generation != _cache_generation )
+      return;
+   auto itr = _cache_by_num.find( block_num );
+   if( itr != _cache_by_num.end() )
+   {
+      itr->second->id = id;
+      itr->second->block = std::move(b);
+      _cache.splice( _cache.begin(), _cache, itr->second );
+      return;
+   }
+   _cache.push_front( cached_block{ block_num, id, std::move(b) } );
+   _cache_by_num[block_num] = _cache.begin();
+   if( _cache.size() > _cache_max_size )
+   {
+      _cache_by_num.erase( _cache.back().block_num );
+      _cache.pop_back();
+   }
+}
+
+void block_database::cache_store( uint32_t block_num, const block_id_type& id, block_ptr b )
+{
+   uint64_t generation;
+   {
+      std::lock_guard<std::mutex> lock( _cache_mutex );
+      generation = ++_cache_generation;
+   }
+   cache_insert( block_num, id, std::move(b), generation );
+}
+
+void block_database::cache_erase( uint32_t block_num )
+{
+   std::lock_guard<std::mutex> lock( _cache_mutex );
+   ++_cache_generation;
+   auto itr = _cache_by_num.find( block_num );
+   if( itr == _cache_by_num.end() )
+      return;
+   _cache.erase( itr->second );
+   _cache_by_num.erase( itr );
+}
+
+void block_database::reserve_index( uint64_t entry_count )
+{
+   auto index = std::atomic_load( &_index );
+   if( index && index->capacity >= entry_count )
+      return;
+
+   uint64_t capacity = std::max( entry_count, (index ? index->capacity : 0) + index_growth );
+   if( _index_data.size() < capacity * sizeof(index_entry) )
+      _index_data.resize( capacity * sizeof(index_entry) );
+   std::atomic_store( &_index, std::make_shared<index_mapping>( _index_file, capacity ) );
+}
+
+void block_database::write_entry( uint32_t block_num, const index_entry& e )
+{
+   reserve_index( uint64_t(block_num) + 1 );
+   memcpy( &_index->entries()[block_num], &e, sizeof(e) );
+   if( _index_count.load() <= block_num )
+      _index_count = uint64_t(block_num) + 1;
+}
+
+bool block_database::in_blocks_file( const index_entry& e )const
+{
+   return e.block_pos <= _blocks_size.load() && e.block_size <= _blocks_size.load() - e.block_pos;
+}
+
+bool block_database::read_entry( uint32_t block_num, index_entry& e )const
+{
+   // load the count first, the mapping it was published after is guaranteed to cover it
+   const uint64_t count = _index_count.load();
+   if( block_num >= count )
+      return false;
+   auto index = std::atomic_load( &_index );
+   memcpy( &e, &index->entries()[block_num], sizeof(e) );
+   // an entry pointing past the blocks file was torn by a crash, treat its block as removed
+   if( !in_blocks_file( e ) )
+      e.block_size = 0;
+   return true;
+}
+
+optional<index_entry> block_database::last_entry()const
+{
+   const uint64_t count = _index_count.load();
+   auto index = std::atomic_load( &_index );
+   for( uint64_t num = count; num > 0; --num )
+   {
+      index_entry e;
+      memcpy( &e, &index->entries()[num-1], sizeof(e) );
+      if( e.block_size > 0 && in_blocks_file( e ) )
+         return e;
+   }
+   return optional<index_entry>();
+}
+
+signed_block block_database::read_block( const index_entry& e )const
+{
+   vector<char> data( e.block_size );
+   _blocks.read( data.data(), data.size(), e.block_pos );
+   return fc::raw::unpack<signed_block>(data);
 }
 
 void block_database::store( const block_id_type& _id, const signed_block& b )
@@ -83,33 +278,28 @@ void block_database::store( const block_id_type& _id, const signed_block& b )
       elog( "id argument of block_database::store() was not initialized for block ${id}", ("id", id) );
    }
    auto num = block_header::num_from_id(id);
-   _block_num_to_pos.seekp( sizeof( index_entry ) * num );
-   index_entry e;
-   _blocks.seekp( 0, _blocks.end );
    auto vec = fc::raw::pack( b );
-   e.block_pos  = _blocks.tellp();
+   index_entry e;
+   e.block_pos  = _blocks_size.load();
    e.block_size = vec.size();
    e.block_id   = id;
-   _blocks.write( vec.data(), vec.size() );
-   _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   _blocks.write( vec.data(), vec.size(), e.block_pos );
+   _blocks_size += vec.size();
+   write_entry( num, e );
+   cache_store( num, id, std::make_shared<signed_block>( b ) );
 }
 
 void block_database::remove( const block_id_type& id )
 { try {
    index_entry e;
-   auto index_pos = sizeof(e)*block_header::num_from_id(id);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !read_entry( block_header::num_from_id(id), e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    if( e.block_id == id )
    {
       e.block_size = 0;
-      _block_num_to_pos.seekp( sizeof(e)*block_header::num_from_id(id) );
-      _block_num_to_pos.write( (char*)&e, sizeof(e) );
+      write_entry( block_header::num_from_id(id), e );
+      cache_erase( block_header::num_from_id(id) );
    }
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
@@ -119,12 +309,8 @@ bool block_database::contains( const block_id_type& id )const
       return false;
 
    index_entry e;
-   auto index_pos = sizeof(e)*block_header::num_from_id(id);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !read_entry( block_header::num_from_id(id), e ) )
       return false;
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
 
    return e.block_id == id && e.block_size > 0;
 }
@@ -133,14 +319,9 @@ block_id_type block_database::fetch_block_id( uint32_t block_num )const
 {
    assert( block_num != 0 );
    index_entry e;
-   auto index_pos = sizeof(e)*block_num;
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= int64_t(index_pos) )
+   if( !read_entry( block_num, e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
    return e.block_id;
 }
@@ -149,24 +330,23 @@ optional<signed_block> block_database::fetch_optional( const block_id_type& id )
 {
    try
    {
+      const uint32_t block_num = block_header::num_from_id(id);
+      uint64_t generation;
+      auto cached = cache_find( block_num, &id, generation );
+      if( cached.valid() )
+         return cached;
+
       index_entry e;
-      auto index_pos = sizeof(e)*block_header::num_from_id(id);
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !read_entry( block_num, e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-      if( e.block_id != id ) return optional<signed_block>();
+      if( e.block_id != id || e.block_size == 0 ) return optional<signed_block>();
 
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      if (e.block_size)
-         _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      // an entry being rewritten concurrently may pair a new id with old data, the id check catches that
+      auto result = std::make_shared<signed_block>( read_block( e ) );
+      FC_ASSERT( result->id() == e.block_id );
+      cache_insert( block_num, e.block_id, result, generation );
+      return *result;
    }
    catch (const fc::exception&)
    {
@@ -181,21 +361,19 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
 {
    try
    {
+      uint64_t generation;
+      auto cached = cache_find( block_num, nullptr, generation );
+      if( cached.valid() )
+         return cached;
+
       index_entry e;
-      auto index_pos = sizeof(e)*block_num;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !read_entry( block_num, e ) || e.block_size == 0 )
          return {};
 
-      _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      auto result = std::make_shared<signed_block>( read_block( e ) );
+      FC_ASSERT( result->id() == e.block_id );
+      cache_insert( block_num, e.block_id, result, generation );
+      return *result;
    }
    catch (const fc::exception&)
    {
@@ -210,30 +388,10 @@ optional<signed_block> block_database::last()const
 {
    try
    {
-      index_entry e;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-
-      if( _block_num_to_pos.tellp() < sizeof(index_entry) )
+      optional<index_entry> e = last_entry();
+      if( !e.valid() )
          return optional<signed_block>();
-
-      _block_num_to_pos.seekg( -sizeof(index_entry), _block_num_to_pos.end );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      uint64_t pos = _block_num_to_pos.tellg();
-      while( e.block_size == 0 && pos > 0 )
-      {
-         pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      }
-
-      if( e.block_size == 0 )
-         return optional<signed_block>();
-
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
-      return result;
+      return read_block( *e );
    }
    catch (const fc::exception&)
    {
@@ -246,36 +404,10 @@ optional<signed_block> block_database::last()const
 
 optional<block_id_type> block_database::last_id()const
 {
-   try
-   {
-      index_entry e;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-
-      if( _block_num_to_pos.tellp() < sizeof(index_entry) )
-         return optional<block_id_type>();
-
-      _block_num_to_pos.seekg( -sizeof(index_entry), _block_num_to_pos.end );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      uint64_t pos = _block_num_to_pos.tellg();
-      while( e.block_size == 0 && pos > 0 )
-      {
-         pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      }
-
-      if( e.block_size == 0 )
-         return optional<block_id_type>();
-
-      return e.block_id;
-   }
-   catch (const fc::exception&)
-   {
-   }
-   catch (const std::exception&)
-   {
-   }
-   return optional<block_id_type>();
+   optional<index_entry> e = last_entry();
+   if( !e.valid() )
+      return optional<block_id_type>();
+   return e->block_id;
 }
 
 
@@ -37,7 +37,7 @@ asset database::get_balance(account_id_type owner, asset_id_type asset_id) const
    auto itr = index.find(boost::make_tuple(owner, asset_id));
    if( itr == index.end() )
       return asset(0, asset_id);
-   return itr->get_balance();
+   return (*itr)->get_balance();
 }
 
 asset database::get_balance(const account_object& owner, const asset_object& asset_obj) const
@@ -70,8 +70,8 @@ void database::adjust_balance(account_id_type account, asset delta )
       });
    } else {
       if( delta.amount < 0 )
-         FC_ASSERT( itr->get_balance() >= -delta, "Insufficient Balance: ${a}'s balance of ${b} is less than required ${r}", ("a",account(*this).name)("b",to_pretty_string(itr->get_balance()))("r",to_pretty_string(-delta)));
-      modify(*itr, [delta](account_balance_object& b) {
+         FC_ASSERT( (*itr)->get_balance() >= -delta, "Insufficient Balance: ${a}'s balance of ${b} is less than required ${r}", ("a",account(*this).name)("b",to_pretty_string((*itr)->get_balance()))("r",to_pretty_string(-delta)));
+      modify(**itr, [delta](account_balance_object& b) {
          b.adjust_balance(delta);
       });
    }
@@ -40,6 +40,20 @@
 
 namespace graphene { namespace chain {
 
+/// @return true if the two sets have an account in common
+static bool intersects( const flat_set<account_id_type>& a, const flat_set<account_id_type>& b )
+{
+   auto aitr = a.begin();
+   auto bitr = b.begin();
+   while( aitr != a.end() && bitr != b.end() )
+   {
+      if( *aitr < *bitr )      ++aitr;
+      else if( *bitr < *aitr ) ++bitr;
+      else return true;
+   }
+   return false;
+}
+
 bool database::is_known_block( const block_id_type& id )const
 {
    return _fork_db.is_known_block(id) || _block_id_to_block.contains(id);
@@ -113,18 +127,40 @@ std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of
 bool database::push_block(const signed_block& new_block, uint32_t skip)
 {
    //idump((new_block.block_num())(new_block.id())(new_block.timestamp)(new_block.previous));
+   // waiting for the recovery threads lets other tasks run on this thread, so it's done before
+   // the pending state is touched or an undo session is opened
+   if( !(skip & (skip_transaction_signatures | skip_authority_check)) )
+      precompute_signature_keys( new_block );
+
    bool result;
    detail::with_skip_flags( *this, skip, [&]()
    {
-      detail::without_pending_transactions( *this, std::move(_pending_tx),
+      detail::without_pending_transactions( *this, std::move(_pending_tx), std::move(_pending_tx_dependencies),
       [&]()
       {
          result = _push_block(new_block);
+         save_irreversible_state();
       });
    });
    return result;
 }
 
+void database::save_irreversible_state()
+{
+   // only the blocks are applied here, so no pending transaction ends up in the saved state
+   if( !incremental_persistence_enabled() )
+      return;
+   const uint32_t last_irreversible = get_dynamic_global_properties().last_irreversible_block_num;
+   if( last_irreversible <= _last_saved_irreversible_block )
+      return;
+   _last_saved_irreversible_block = last_irreversible;
+   try {
+      object_database::flush();
+   } catch( const fc::exception& e ) {
+      elog( "Unable to save the changed objects: ${e}", ("e", e.to_detail_string()) );
+   }
+}
+
 bool database::_push_block(const signed_block& new_block)
 { try {
    uint32_t skip = get_node_properties().skip_flags;
@@ -225,7 +261,8 @@ processed_transaction database::push_transaction( const signed_transaction& trx,
    return result;
 } FC_CAPTURE_AND_RETHROW( (trx) ) }
 
-processed_transaction database::_push_transaction( const signed_transaction& trx )
+processed_transaction database::_push_transaction( const signed_transaction& trx,
+                                                    const pending_transaction_dependencies* unchanged )
 {
    // If this is the first transaction pushed after applying a block, start a new undo session.
    // This allows us to quickly rewind to the clean state of the head block, in case a new block arrives.
@@ -238,9 +275,26 @@ processed_transaction database::_push_transaction( const signed_transaction& trx
    // apply the changes.
 
    auto temp_session = _undo_db.start_undo_session();
+   if( unchanged != nullptr )
+      _prevalidated_trx = &trx;
    auto processed_trx = _apply_transaction( trx );
    _pending_tx.push_back(processed_trx);
 
+   pending_transaction_dependencies dependencies;
+   if( unchanged != nullptr )
+   {
+      dependencies.authority_checked = unchanged->authority_checked;
+      dependencies.authorities_read = unchanged->authorities_read;
+   }
+   else
+   {
+      dependencies.authority_checked = _trx_authority_checked;
+      dependencies.authorities_read = std::move(_trx_authorities_read);
+   }
+   if( _undo_db.enabled() )
+      collect_changed_accounts( dependencies.accounts_written );
+   _pending_tx_dependencies.push_back( std::move(dependencies) );
+
    notify_changed_objects();
    // The transaction applied successfully. Merge its changes into the pending block session.
    temp_session.merge();
@@ -336,21 +390,34 @@ signed_block database::_generate_block(
    _pending_tx_session = _undo_db.start_undo_session();
 
    uint64_t postponed_tx_count = 0;
+   // accounts which were changed by a transaction that is now left out, or by blocks popped since the pending
+   // transactions were applied
+   flat_set<account_id_type> changed_accounts = _accounts_changed_since_pending;
    // pop pending state (reset to head block state)
-   for( const processed_transaction& tx : _pending_tx )
+   for( size_t i = 0; i < _pending_tx.size(); ++i )
    {
+      const processed_transaction& tx = _pending_tx[i];
+      const pending_transaction_dependencies* dependencies =
+         i < _pending_tx_dependencies.size() ? &_pending_tx_dependencies[i] : nullptr;
       size_t new_total_size = total_block_size + fc::raw::pack_size( tx );
 
       // postpone transaction if it would make block too big
       if( new_total_size >= maximum_block_size )
       {
          postponed_tx_count++;
+         if( dependencies != nullptr )
+            changed_accounts.insert( dependencies->accounts_written.begin(), dependencies->accounts_written.end() );
          continue;
       }
 
       try
       {
          auto temp_session = _undo_db.start_undo_session();
+         // the authority checks done when the transactions were pushed still hold unless an account they read
+         // has changed since
+         if( dependencies != nullptr && dependencies->authority_checked && !_all_accounts_changed_since_pending
+             && !intersects( dependencies->authorities_read, changed_accounts ) )
+            _prevalidated_trx = &tx;
          processed_transaction ptx = _apply_transaction( tx );
          temp_session.merge();
 
@@ -363,6 +430,8 @@ signed_block database::_generate_block(
       catch ( const fc::exception& e )
       {
          // Do nothing, transaction will not be re-applied
+         if( dependencies != nullptr )
+            changed_accounts.insert( dependencies->accounts_written.begin(), dependencies->accounts_written.end() );
          wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
          wlog( "The transaction was ${t}", ("t", tx) );
       }
@@ -413,18 +482,208 @@ void database::pop_block()
    _fork_db.pop_block();
    _block_id_to_block.remove( head_id );
    pop_undo();
+   _all_accounts_changed_since_pending = true;
 
    _popped_tx.insert( _popped_tx.begin(), head_block->transactions.begin(), head_block->transactions.end() );
 
 } FC_CAPTURE_AND_RETHROW() }
 
+void database::precompute_signature_keys( const signed_block& block )const
+{ try {
+   const size_t thread_count = _signature_recovery_threads.size();
+   const auto& trxs = block.transactions;
+   if( thread_count == 0 || trxs.empty() )
+      return;
+
+   const chain_id_type& chain_id = get_chain_id();
+   const size_t chunk_size = (trxs.size() + thread_count - 1) / thread_count;
+
+   vector< fc::future<void> > pending;
+   pending.reserve( thread_count );
+   for( size_t begin = 0, t = 0; begin < trxs.size(); begin += chunk_size, ++t )
+   {
+      const size_t end = std::min( trxs.size(), begin + chunk_size );
+      pending.push_back( _signature_recovery_threads[t]->async( [this,&trxs,&chain_id,begin,end]()
+      {
+         for( size_t i = begin; i < end; ++i )
+         {
+            try
+            {
+               _signature_key_cache.get_signature_keys( trxs[i], chain_id );
+            }
+            catch( const fc::exception& )
+            {
+               // leave the cache empty, verify_authority() will report the error on the main thread
+            }
+         }
+      }, "precompute_signature_keys" ) );
+   }
+   for( auto& f : pending )
+      f.wait();
+} FC_CAPTURE_AND_RETHROW( (block.block_num()) ) }
+
+void database::precheck_transaction( const signed_transaction& trx )const
+{ try {
+   // everything taken from the chain state is read here, on the calling thread
+   const chain_parameters& params = get_global_properties().parameters;
+   const uint32_t max_size = params.maximum_transaction_size;
+   const uint32_t max_time_until_expiration = params.maximum_time_until_expiration;
+   const bool check_expiration = head_block_num() > 0;
+   const fc::time_point_sec now = head_block_time();
+   const chain_id_type chain_id = get_chain_id();
+
+   auto check = [&]()
+   {
+      // the same bounds _apply_transaction() checks, against the head block time when we were called.
+      // These depend on when the transaction reached us, so they are reported as they are
+      if( check_expiration )
+      {
+         FC_ASSERT( trx.expiration <= now + max_time_until_expiration, "",
+                    ("trx.expiration",trx.expiration)("now",now)("max_til_exp",max_time_until_expiration) );
+         FC_ASSERT( now <= trx.expiration, "", ("now",now)("trx.exp",trx.expiration) );
+      }
+      // while these fail wherever and whenever the transaction is checked
+      try
+      {
+         const size_t size = fc::raw::pack_size( trx );
+         FC_ASSERT( size <= max_size, "Transaction is too large", ("size",size)("max",max_size) );
+         trx.validate();
+         _signature_key_cache.get_signature_keys( trx, chain_id );
+      }
+      catch( const fc::canceled_exception& )
+      {
+         throw;
+      }
+      catch( const fc::exception& e )
+      {
+         FC_THROW_EXCEPTION( tx_malformed, "${e}", ("e", e.to_detail_string()) );
+      }
+   };
+
+   if( _transaction_precheck_threads.empty() )
+      check();
+   else
+   {
+      fc::thread& thread = *_transaction_precheck_threads[_next_transaction_precheck_thread++ % _transaction_precheck_threads.size()];
+      thread.async( check, "precheck_transaction" ).wait();
+   }
+} FC_CAPTURE_AND_RETHROW( (trx.id()) ) }
+
 void database::clear_pending()
 { try {
    assert( (_pending_tx.size() == 0) || _pending_tx_session.valid() );
    _pending_tx.clear();
+   _pending_tx_dependencies.clear();
    _pending_tx_session.reset();
+   _accounts_changed_since_pending.clear();
+   _all_accounts_changed_since_pending = false;
 } FC_CAPTURE_AND_RETHROW() }
 
+void database::_restore_pending_transactions( vector<processed_transaction>&& pending,
+                                              vector<pending_transaction_dependencies>&& dependencies )
+{
+   const auto start = fc::time_point::now();
+   pending_revalidation_stats stats;
+   stats.block_num = head_block_num();
+
+   for( const auto& tx : _popped_tx )
+   {
+      try {
+         if( !is_known_transaction( tx.id() ) ) {
+            // since push_transaction() takes a signed_transaction,
+            // the operation_results field will be ignored.
+            _push_transaction( tx );
+         }
+      } catch ( const fc::exception&  ) {
+      }
+   }
+   _popped_tx.clear();
+
+   // accounts changed by the new blocks, or by pending transactions which are dropped
+   flat_set<account_id_type> changed = std::move( _accounts_changed_since_pending );
+   const bool all_changed = _all_accounts_changed_since_pending;
+   const auto now = head_block_time();
+   for( size_t i = 0; i < pending.size(); ++i )
+   {
+      const processed_transaction& tx = pending[i];
+      const pending_transaction_dependencies* previous = i < dependencies.size() ? &dependencies[i] : nullptr;
+      auto drop = [&]()
+      {
+         if( previous != nullptr )
+            changed.insert( previous->accounts_written.begin(), previous->accounts_written.end() );
+      };
+
+      if( tx.expiration < now )
+      {
+         ++stats.expired;
+         drop();
+         continue;
+      }
+      if( is_known_transaction( tx.id() ) )
+      {
+         // its changes are part of the new blocks now
+         ++stats.included;
+         continue;
+      }
+
+      const bool unchanged = previous != nullptr && previous->authority_checked && !all_changed
+                             && !intersects( previous->authorities_read, changed );
+      try
+      {
+         // since push_transaction() takes a signed_transaction,
+         // the operation_results field will be ignored.
+         _push_transaction( tx, unchanged ? previous : nullptr );
+         ++stats.reapplied;
+         if( !unchanged )
+            ++stats.rechecked;
+         // a transaction may write other accounts than before, e.g. create an account with a different id
+         if( previous != nullptr && previous->accounts_written != _pending_tx_dependencies.back().accounts_written )
+         {
+            drop();
+            const auto& written = _pending_tx_dependencies.back().accounts_written;
+            changed.insert( written.begin(), written.end() );
+         }
+      }
+      catch( const fc::exception& e )
+      {
+         ++stats.failed;
+         drop();
+         /*
+         wlog( "Pending transaction became invalid after switching to block ${b}  ${t}", ("b", head_block_id())("t",head_block_time()) );
+         wlog( "The invalid pending transaction caused exception ${e}", ("e", e.to_detail_string() ) );
+         */
+      }
+   }
+
+   // the transactions pushed from now on depend on the new pending state
+   _accounts_changed_since_pending.clear();
+   _all_accounts_changed_since_pending = false;
+
+   stats.microseconds = (fc::time_point::now() - start).count();
+   _pending_revalidation_stats = stats;
+}
+
+void database::collect_changed_accounts( flat_set<account_id_type>& accounts )const
+{
+   const auto& state = _undo_db.head();
+   auto add = [&]( object_id_type id )
+   {
+      if( id.is<account_id_type>() )
+         accounts.insert( account_id_type( id ) );
+   };
+   for( const auto& item : state.old_values ) add( item.first );
+   for( const auto& item : state.old_deltas ) add( item.first );
+   for( const auto& item : state.removed )    add( item.first );
+   for( const auto& id : state.new_ids )      add( id );
+}
+
+bool database::global_properties_changed()const
+{
+   const auto& state = _undo_db.head();
+   const object_id_type id = global_property_id_type();
+   return state.old_values.find( id ) != state.old_values.end() || state.old_deltas.find( id ) != state.old_deltas.end();
+}
+
 uint32_t database::push_applied_operation( const operation& op )
 {
    _applied_ops.emplace_back(op);
@@ -454,13 +713,18 @@ const vector<optional< operation_history_object > >& database::get_applied_opera
 //////////////////// private methods ////////////////////
 
 void database::apply_block( const signed_block& next_block, uint32_t skip )
+{
+   apply_block( next_block, next_block.id(), skip );
+}
+
+void database::apply_block( const signed_block& next_block, const block_id_type& next_block_id, uint32_t skip )
 {
    auto block_num = next_block.block_num();
    if( _checkpoints.size() && _checkpoints.rbegin()->second != block_id_type() )
    {
       auto itr = _checkpoints.find( block_num );
       if( itr != _checkpoints.end() )
-         FC_ASSERT( next_block.id() == itr->second, "Block did not match checkpoint", ("checkpoint",*itr)("block_id",next_block.id()) );
+         FC_ASSERT( next_block_id == itr->second, "Block did not match checkpoint", ("checkpoint",*itr)("block_id",next_block_id) );
 
       if( _checkpoints.rbegin()->first >= block_num )
          skip = ~0;// WE CAN SKIP ALMOST EVERYTHING
@@ -468,18 +732,18 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
 
    detail::with_skip_flags( *this, skip, [&]()
    {
-      _apply_block( next_block );
+      _apply_block( next_block, next_block_id );
    } );
    return;
 }
 
-void database::_apply_block( const signed_block& next_block )
+void database::_apply_block( const signed_block& next_block, const block_id_type& next_block_id )
 { try {
    uint32_t next_block_num = next_block.block_num();
    uint32_t skip = get_node_properties().skip_flags;
    _applied_ops.clear();
 
-   FC_ASSERT( (skip & skip_merkle_check) || next_block.transaction_merkle_root == next_block.calculate_merkle_root(), "", ("next_block.transaction_merkle_root",next_block.transaction_merkle_root)("calc",next_block.calculate_merkle_root())("next_block",next_block)("id",next_block.id()) );
+   FC_ASSERT( (skip & skip_merkle_check) || next_block.transaction_merkle_root == next_block.calculate_merkle_root(), "", ("next_block.transaction_merkle_root",next_block.transaction_merkle_root)("calc",next_block.calculate_merkle_root())("next_block",next_block)("id",next_block_id) );
 
    const witness_object& signing_witness = validate_block_header(skip, next_block);
    const auto& global_props = get_global_properties();
@@ -501,7 +765,7 @@ void database::_apply_block( const signed_block& next_block )
       ++_current_trx_in_block;
    }
 
-   update_global_dynamic_data(next_block);
+   update_global_dynamic_data(next_block, next_block_id);
    update_signing_witness(signing_witness, next_block);
    update_last_irreversible_block();
 
@@ -509,8 +773,10 @@ void database::_apply_block( const signed_block& next_block )
    if( maint_needed )
       perform_chain_maintenance(next_block, global_props);
 
-   create_block_summary(next_block);
+   create_block_summary(next_block, next_block_id);
    clear_expired_transactions();
+   _signature_key_cache.remove_expired( head_block_time() );
+   _signature_key_cache.set_expiration_limit( head_block_time() + get_global_properties().parameters.maximum_time_until_expiration );
    clear_expired_proposals();
    clear_expired_orders();
    update_expired_feeds();
@@ -530,6 +796,17 @@ void database::_apply_block( const signed_block& next_block )
    applied_block( next_block ); //emit
    _applied_ops.clear();
 
+   // remembered so that pending transactions whose authorities are not affected need not be checked again
+   if( _undo_db.enabled() )
+   {
+      collect_changed_accounts( _accounts_changed_since_pending );
+      // e.g. max_authority_depth, which decides what an authority check reads
+      if( global_properties_changed() )
+         _all_accounts_changed_since_pending = true;
+   }
+   else
+      _all_accounts_changed_since_pending = true;
+
    notify_changed_objects();
 } FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  }
 
@@ -538,8 +815,9 @@ void database::notify_changed_objects()
    if( _undo_db.enabled() )
    {
       const auto& head_undo = _undo_db.head();
-      vector<object_id_type> changed_ids;  changed_ids.reserve(head_undo.old_values.size());
+      vector<object_id_type> changed_ids;  changed_ids.reserve(head_undo.old_values.size() + head_undo.old_deltas.size());
       for( const auto& item : head_undo.old_values ) changed_ids.push_back(item.first);
+      for( const auto& item : head_undo.old_deltas ) changed_ids.push_back(item.first);
       for( const auto& item : head_undo.new_ids ) changed_ids.push_back(item);
       vector<const object*> removed;
       removed.reserve( head_undo.removed.size() );
@@ -565,24 +843,34 @@ processed_transaction database::apply_transaction(const signed_transaction& trx,
 processed_transaction database::_apply_transaction(const signed_transaction& trx)
 { try {
    uint32_t skip = get_node_properties().skip_flags;
+   const bool prevalidated = (_prevalidated_trx == &trx);
+   _prevalidated_trx = nullptr;
 
    if( true || !(skip&skip_validate) )   /* issue #505 explains why this skip_flag is disabled */
       trx.validate();
 
    auto& trx_idx = get_mutable_index_type<transaction_index>();
    const chain_id_type& chain_id = get_chain_id();
-   auto trx_id = trx.id();
-   FC_ASSERT( (skip & skip_transaction_dupe_check) ||
-              trx_idx.indices().get<by_trx_id>().find(trx_id) == trx_idx.indices().get<by_trx_id>().end() );
+   // the id is only needed for the dupe check, which is skipped while replaying
+   transaction_id_type trx_id;
+   if( !(skip & skip_transaction_dupe_check) )
+   {
+      trx_id = trx.id();
+      FC_ASSERT( trx_idx.indices().get<by_trx_id>().find(trx_id) == trx_idx.indices().get<by_trx_id>().end() );
+   }
    transaction_evaluation_state eval_state(this);
    const chain_parameters& chain_parameters = get_global_properties().parameters;
    eval_state._trx = &trx;
 
-   if( !(skip & (skip_transaction_signatures | skip_authority_check) ) )
+   _trx_authorities_read.clear();
+   _trx_authority_checked = false;
+   if( !prevalidated && !(skip & (skip_transaction_signatures | skip_authority_check) ) )
    {
-      auto get_active = [&]( account_id_type id ) { return &id(*this).active; };
-      auto get_owner  = [&]( account_id_type id ) { return &id(*this).owner;  };
-      trx.verify_authority( chain_id, get_active, get_owner, get_global_properties().parameters.max_authority_depth );
+      _trx_authority_checked = true;
+      auto get_active = [&]( account_id_type id ) { _trx_authorities_read.insert( id ); return &id(*this).active; };
+      auto get_owner  = [&]( account_id_type id ) { _trx_authorities_read.insert( id ); return &id(*this).owner;  };
+      verify_authority( trx.operations, _signature_key_cache.get_signature_keys( trx, chain_id ),
+                        get_active, get_owner, get_global_properties().parameters.max_authority_depth );
    }
 
    //Skip all manner of expiration and TaPoS checking if we're on block 1; It's impossible that the transaction is
@@ -628,7 +916,7 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    //Make sure the temp account has no non-zero balances
    const auto& index = get_index_type<account_balance_index>().indices().get<by_account_asset>();
    auto range = index.equal_range( boost::make_tuple( GRAPHENE_TEMP_ACCOUNT ) );
-   std::for_each(range.first, range.second, [](const account_balance_object& b) { FC_ASSERT(b.balance == 0); });
+   std::for_each(range.first, range.second, [](const account_balance_object* b) { FC_ASSERT(b->balance == 0); });
 
    return ptrx;
 } FC_CAPTURE_AND_RETHROW( (trx) ) }
@@ -673,11 +961,11 @@ const witness_object& database::validate_block_header( uint32_t skip, const sign
    return witness;
 }
 
-void database::create_block_summary(const signed_block& next_block)
+void database::create_block_summary(const signed_block& next_block, const block_id_type& next_block_id)
 {
    block_summary_id_type sid(next_block.block_num() & 0xffff );
    modify( sid(*this), [&](block_summary_object& p) {
-         p.block_id = next_block.id();
+         p.block_id = next_block_id;
    });
 }
 
@@ -173,7 +173,7 @@ void database::initialize_indexes()
    _undo_db.set_max_size( GRAPHENE_MIN_UNDO_HISTORY );
 
    //Protocol object indexes
-   add_index< primary_index<asset_index> >();
+   auto asset_idx = add_index< primary_index<asset_index> >();
    add_index< primary_index<force_settlement_index> >();
 
    auto acnt_index = add_index< primary_index<account_index> >();
@@ -182,25 +182,29 @@ void database::initialize_indexes()
 
    add_index< primary_index<committee_member_index> >();
    add_index< primary_index<witness_index> >();
-   add_index< primary_index<limit_order_index > >();
-   add_index< primary_index<call_order_index > >();
+   auto limit_index = add_index< primary_index<limit_order_index > >();
+   limit_index->add_secondary_index<limit_order_book_index>();
+   _limit_order_book = &limit_index->get_secondary_index<limit_order_book_index>();
+   auto call_index = add_index< primary_index<call_order_index > >();
+   call_index->add_secondary_index<call_order_margin_index>();
+   _call_order_margins = &call_index->get_secondary_index<call_order_margin_index>();
 
    auto prop_index = add_index< primary_index<proposal_index > >();
    prop_index->add_secondary_index<required_approval_index>();
 
    add_index< primary_index<withdraw_permission_index > >();
-   add_index< primary_index<vesting_balance_index> >();
+   auto vesting_index = add_index< primary_index<vesting_balance_index> >();
    add_index< primary_index<balance_index> >();
    add_index< primary_index<blinded_balance_index> >();
 
    //Implementation object indexes
    add_index< primary_index<transaction_index                             > >();
-   add_index< primary_index<account_balance_index                         > >();
+   auto acnt_balance_index = add_index< primary_index<account_balance_index> >();
    add_index< primary_index<account_balance_migrate_index                 > >();
-   add_index< primary_index<asset_bitasset_data_index                     > >();
+   auto bitasset_idx = add_index< primary_index<asset_bitasset_data_index> >();
    add_index< primary_index<simple_index<global_property_object          >> >();
    add_index< primary_index<simple_index<dynamic_global_property_object  >> >();
-   add_index< primary_index<simple_index<account_statistics_object       >> >();
+   auto acnt_stats_index = add_index< primary_index<account_statistics_index> >();
    add_index< primary_index<simple_index<asset_dynamic_data_object       >> >();
    add_index< primary_index<flat_index<  block_summary_object            >> >();
    add_index< primary_index<simple_index<chain_property_object          > > >();
@@ -210,6 +214,9 @@ void database::initialize_indexes()
    add_index< primary_index< buyback_index                                > >();
 
    add_index< primary_index< simple_index< fba_accumulator_object       > > >();
+
+   _vote_tally.observe( *acnt_index, *acnt_stats_index, *acnt_balance_index, *vesting_index );
+   _feed_expiration_schedule.observe( *asset_idx, *bitasset_idx );
 }
 
 void database::init_genesis(const genesis_state_type& genesis_state)
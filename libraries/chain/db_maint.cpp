@@ -398,8 +398,9 @@ void update_top_n_authorities( database& db )
 
          // find accounts
          const auto range = bal_idx.equal_range( boost::make_tuple( tha.asset ) );
-         for( const account_balance_object& bal : boost::make_iterator_range( range.first, range.second ) )
+         for( const account_balance_object* bal_ptr : boost::make_iterator_range( range.first, range.second ) )
          {
+             const account_balance_object& bal = *bal_ptr;
              assert( bal.asset_type == tha.asset );
              if( bal.owner == acct.id )
                 continue;
@@ -530,10 +531,10 @@ void create_buyback_orders( database& db )
          auto it = bal_idx.lower_bound( boost::make_tuple( buyback_account.id, next_asset ) );
          if( it == bal_idx.end() )
             break;
-         if( it->owner != buyback_account.id )
+         if( (*it)->owner != buyback_account.id )
             break;
-         asset_id_type asset_to_sell = it->asset_type;
-         share_type amount_to_sell = it->balance;
+         asset_id_type asset_to_sell = (*it)->asset_type;
+         share_type amount_to_sell = (*it)->balance;
          next_asset = asset_to_sell + 1;
          if( asset_to_sell == asset_to_buy.id )
             continue;
@@ -591,68 +592,14 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
 
    struct vote_tally_helper {
       database& d;
-      const global_property_object& props;
 
-      vote_tally_helper(database& d, const global_property_object& gpo)
-         : d(d), props(gpo)
-      {
-         d._vote_tally_buffer.resize(props.next_available_vote_id);
-         d._witness_count_histogram_buffer.resize(props.parameters.maximum_witness_count / 2 + 1);
-         d._committee_count_histogram_buffer.resize(props.parameters.maximum_committee_count / 2 + 1);
-         d._total_voting_stake = 0;
-      }
+      vote_tally_helper(database& d)
+         : d(d) {}
 
       void operator()(const account_object& stake_account) {
-         if( props.parameters.count_non_member_votes || stake_account.is_member(d.head_block_time()) )
-         {
-            // There may be a difference between the account whose stake is voting and the one specifying opinions.
-            // Usually they're the same, but if the stake account has specified a voting_account, that account is the one
-            // specifying the opinions.
-            const account_object& opinion_account =
-                  (stake_account.options.voting_account ==
-                   GRAPHENE_PROXY_TO_SELF_ACCOUNT)? stake_account
-                                     : d.get(stake_account.options.voting_account);
-
-            const auto& stats = stake_account.statistics(d);
-            uint64_t voting_stake = stats.total_core_in_orders.value
-                  + (stake_account.cashback_vb.valid() ? (*stake_account.cashback_vb)(d).balance.amount.value: 0)
-                  + d.get_balance(stake_account.get_id(), asset_id_type()).amount.value;
-
-            for( vote_id_type id : opinion_account.options.votes )
-            {
-               uint32_t offset = id.instance();
-               // if they somehow managed to specify an illegal offset, ignore it.
-               if( offset < d._vote_tally_buffer.size() )
-                  d._vote_tally_buffer[offset] += voting_stake;
-            }
-
-            if( opinion_account.options.num_witness <= props.parameters.maximum_witness_count )
-            {
-               uint16_t offset = std::min(size_t(opinion_account.options.num_witness/2),
-                                          d._witness_count_histogram_buffer.size() - 1);
-               // votes for a number greater than maximum_witness_count
-               // are turned into votes for maximum_witness_count.
-               //
-               // in particular, this takes care of the case where a
-               // member was voting for a high number, then the
-               // parameter was lowered.
-               d._witness_count_histogram_buffer[offset] += voting_stake;
-            }
-            if( opinion_account.options.num_committee <= props.parameters.maximum_committee_count )
-            {
-               uint16_t offset = std::min(size_t(opinion_account.options.num_committee/2),
-                                          d._committee_count_histogram_buffer.size() - 1);
-               // votes for a number greater than maximum_committee_count
-               // are turned into votes for maximum_committee_count.
-               //
-               // same rationale as for witnesses
-               d._committee_count_histogram_buffer[offset] += voting_stake;
-            }
-
-            d._total_voting_stake += voting_stake;
-         }
+         d._vote_tally.count_account(d, stake_account);
       }
-   } tally_helper(*this, gpo);
+   } tally_helper(*this);
    struct process_fees_helper {
       database& d;
       const global_property_object& props;
@@ -665,10 +612,48 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
       }
    } fee_helper(*this, gpo);
 
-   perform_account_maintenance(std::tie(
-      tally_helper,
-      fee_helper
-      ));
+   if( _vote_tally.begin_maintenance(*this) )
+   {
+      // Only accounts changed since the last maintenance need to be counted again. Visiting all accounts
+      // would count each one and then process its fees, in order of names, so the stake counted for an
+      // account includes the cashback paid by the fees of the accounts before it. The accounts with fees
+      // and those they pay are visited in that same order to count exactly the same stake.
+      vector<const account_object*> fee_payers;
+      _vote_tally.count_changed_accounts(*this, fee_payers);
+#ifndef NDEBUG
+      _vote_tally.verify(*this);
+#endif
+
+      flat_set<account_id_type> paying;
+      flat_set<account_id_type> paid;
+      vector<const account_object*> visit(fee_payers);
+      for( const account_object* a : fee_payers )
+      {
+         paying.insert(a->get_id());
+         for( account_id_type payee : { a->lifetime_referrer, a->referrer, a->registrar } )
+            if( paid.insert(payee).second )
+               visit.push_back(&payee(*this));
+      }
+      std::sort(visit.begin(), visit.end(), [](const account_object* a, const account_object* b) { return a->name < b->name; });
+      visit.erase(std::unique(visit.begin(), visit.end()), visit.end());
+
+      for( const account_object* a : visit )
+      {
+         if( paid.count(a->get_id()) )
+            tally_helper(*a);
+         if( paying.count(a->get_id()) )
+            fee_helper(*a);
+      }
+   }
+   else
+   {
+      perform_account_maintenance(std::tie(
+         tally_helper,
+         fee_helper
+         ));
+   }
+   _vote_tally.end_maintenance(*this, next_block.block_num(), next_block.id(), _vote_tally_buffer,
+                               _witness_count_histogram_buffer, _committee_count_histogram_buffer, _total_voting_stake);
 
    struct clear_canary {
       clear_canary(vector<uint64_t>& target): target(target){}
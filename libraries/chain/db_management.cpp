@@ -29,6 +29,8 @@
 
 #include <fc/io/fstream.hpp>
 
+#include <atomic>
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <iostream>
@@ -46,6 +48,63 @@ database::~database()
    clear_pending();
 }
 
+void database::set_signature_recovery_threads( uint32_t thread_count )
+{
+   _signature_recovery_threads.clear();
+   for( uint32_t i = 0; i < thread_count; ++i )
+      _signature_recovery_threads.emplace_back( new fc::thread( "sigrecovery" + fc::to_string(i) ) );
+}
+
+void database::set_transaction_precheck_threads( uint32_t thread_count )
+{
+   _transaction_precheck_threads.clear();
+   for( uint32_t i = 0; i < thread_count; ++i )
+      _transaction_precheck_threads.emplace_back( new fc::thread( "trxprecheck" + fc::to_string(i) ) );
+}
+
+void database::enable_state_snapshots( uint32_t thread_count )
+{
+   _state_snapshots.reset();
+   if( thread_count > 0 )
+      _state_snapshots.reset( new state_snapshots( *this, thread_count ) );
+}
+
+namespace detail {
+
+   /** a block read and hashed ahead of the apply stage of database::reindex() */
+   struct replay_block
+   {
+      optional<signed_block> block;
+      block_id_type          id;
+      bool                   merkle_root_valid = false;
+   };
+
+   /** per-stage counters of the reindex pipeline, the busy times are in microseconds */
+   struct replay_stats
+   {
+      std::atomic<uint64_t> read_blocks{0};
+      std::atomic<uint64_t> read_time{0};
+      std::atomic<uint64_t> hashed_blocks{0};
+      std::atomic<uint64_t> hash_time{0};
+      uint64_t              applied_blocks = 0;
+      uint64_t              apply_time = 0;
+
+      static double rate( uint64_t blocks, uint64_t usec )
+      {
+         return usec ? double(blocks) * 1000000.0 / usec : 0.0;
+      }
+   };
+
+} // detail
+
+void database::set_reindex_pipeline( uint32_t queue_depth, uint32_t hashing_threads )
+{
+   FC_ASSERT( queue_depth > 0 );
+   FC_ASSERT( hashing_threads > 0 );
+   _reindex_queue_depth     = queue_depth;
+   _reindex_hashing_threads = hashing_threads;
+}
+
 void database::reindex(fc::path data_dir, const genesis_state_type& initial_allocation)
 { try {
    ilog( "reindexing blockchain" );
@@ -62,43 +121,153 @@ void database::reindex(fc::path data_dir, const genesis_state_type& initial_allo
 
    const auto last_block_num = last_block->block_num();
 
-   ilog( "Replaying blocks..." );
+   ilog( "Replaying blocks with queue depth ${q} and ${h} hashing threads...",
+         ("q", _reindex_queue_depth)("h", _reindex_hashing_threads) );
+
+   // The reader thread is the only one touching _block_id_to_block until the queue is drained,
+   // the hashing threads compute the block id and merkle root, and this thread applies blocks in order.
+   fc::thread reader( "replay_reader" );
+   vector< std::unique_ptr<fc::thread> > hashers;
+   for( uint32_t i = 0; i < _reindex_hashing_threads; ++i )
+      hashers.emplace_back( new fc::thread( "replay_hasher" + fc::to_string(i) ) );
+
+   detail::replay_stats stats;
+   std::deque< fc::future<detail::replay_block> > queue;
+   uint32_t next_to_read = 1;
+
+   auto fill_queue = [&]()
+   {
+      while( next_to_read <= last_block_num && queue.size() < _reindex_queue_depth )
+      {
+         const uint32_t num = next_to_read++;
+         fc::future< optional<signed_block> > read = reader.async( [this,num,&stats]()
+         {
+            auto read_start = fc::time_point::now();
+            optional<signed_block> b = _block_id_to_block.fetch_by_number( num );
+            stats.read_time += (fc::time_point::now() - read_start).count();
+            ++stats.read_blocks;
+            return b;
+         }, "replay read" );
+         queue.push_back( hashers[num % hashers.size()]->async( [read,&stats]() mutable
+         {
+            detail::replay_block result;
+            result.block = read.wait();
+            if( result.block.valid() )
+            {
+               auto hash_start = fc::time_point::now();
+               result.id = result.block->id();
+               result.merkle_root_valid = result.block->transaction_merkle_root == result.block->calculate_merkle_root();
+               stats.hash_time += (fc::time_point::now() - hash_start).count();
+               ++stats.hashed_blocks;
+            }
+            return result;
+         }, "replay hash" ) );
+      }
+   };
+   auto drain_queue = [&]()
+   {
+      for( auto& f : queue )
+      {
+         try { f.wait(); } catch( ... ) {}
+      }
+      queue.clear();
+   };
+
    _undo_db.disable();
-   for( uint32_t i = 1; i <= last_block_num; ++i )
+   try
    {
-      if( i % 2000 == 0 ) std::cerr << "   " << double(i*100)/last_block_num << "%   "<<i << " of " <<last_block_num<<"   \n";
-      fc::optional< signed_block > block = _block_id_to_block.fetch_by_number(i);
-      if( !block.valid() )
+      for( uint32_t i = 1; i <= last_block_num; ++i )
       {
-         wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
-         uint32_t dropped_count = 0;
-         while( true )
+         if( i % 2000 == 0 )
+            std::cerr << "   " << double(i*100)/last_block_num << "%   " << i << " of " << last_block_num
+                      << "   read " << detail::replay_stats::rate( stats.read_blocks, stats.read_time ) << " blk/s"
+                      << "   hash " << detail::replay_stats::rate( stats.hashed_blocks, stats.hash_time ) << " blk/s"
+                      << "   apply " << detail::replay_stats::rate( stats.applied_blocks, stats.apply_time ) << " blk/s"
+                      << "   queued " << queue.size() << "   \n";
+
+         fill_queue();
+         detail::replay_block item = queue.front().wait();
+         queue.pop_front();
+
+         if( !item.block.valid() )
          {
-            fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
-            // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
-            if( !last_id.valid() )
-               break;
-            // we've caught up to the gap
-            if( block_header::num_from_id( *last_id ) <= i )
-               break;
-            _block_id_to_block.remove( *last_id );
-            dropped_count++;
+            drain_queue();
+            wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
+            uint32_t dropped_count = 0;
+            while( true )
+            {
+               fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
+               // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
+               if( !last_id.valid() )
+                  break;
+               // we've caught up to the gap
+               if( block_header::num_from_id( *last_id ) <= i )
+                  break;
+               _block_id_to_block.remove( *last_id );
+               dropped_count++;
+            }
+            wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
+            break;
          }
-         wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
-         break;
+
+         FC_ASSERT( item.merkle_root_valid, "", ("next_block.transaction_merkle_root",item.block->transaction_merkle_root)
+                                                ("calc",item.block->calculate_merkle_root())("id",item.id) );
+
+         auto apply_start = fc::time_point::now();
+         apply_block(*item.block, item.id, skip_witness_signature |
+                                           skip_transaction_signatures |
+                                           skip_transaction_dupe_check |
+                                           skip_tapos_check |
+                                           skip_witness_schedule_check |
+                                           skip_authority_check |
+                                           skip_merkle_check);
+         stats.apply_time += (fc::time_point::now() - apply_start).count();
+         ++stats.applied_blocks;
+         assert( head_block_id() == item.id );
       }
-      apply_block(*block, skip_witness_signature |
-                          skip_transaction_signatures |
-                          skip_transaction_dupe_check |
-                          skip_tapos_check |
-                          skip_witness_schedule_check |
-                          skip_authority_check);
+   }
+   catch( ... )
+   {
+      drain_queue();
+      _undo_db.enable();
+      throw;
    }
    _undo_db.enable();
    auto end = fc::time_point::now();
    ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
+   ilog( "Replay throughput: read ${r} blk/s, hash ${h} blk/s, apply ${a} blk/s",
+         ("r", detail::replay_stats::rate( stats.read_blocks, stats.read_time ))
+         ("h", detail::replay_stats::rate( stats.hashed_blocks, stats.hash_time ))
+         ("a", detail::replay_stats::rate( stats.applied_blocks, stats.apply_time )) );
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
+void database::apply_stored_blocks( uint32_t last_block_num )
+{ try {
+   ilog( "Applying stored blocks ${f} to ${l} to the saved state", ("f", head_block_num() + 1)("l", last_block_num) );
+   _undo_db.disable();
+   try
+   {
+      while( head_block_num() < last_block_num )
+      {
+         optional<signed_block> next = _block_id_to_block.fetch_by_number( head_block_num() + 1 );
+         FC_ASSERT( next.valid() && next->previous == head_block_id(), "Stored block ${n} does not follow the saved state",
+                    ("n", head_block_num() + 1) );
+         apply_block( *next, skip_witness_signature |
+                             skip_transaction_signatures |
+                             skip_transaction_dupe_check |
+                             skip_tapos_check |
+                             skip_witness_schedule_check |
+                             skip_authority_check );
+      }
+   }
+   catch( ... )
+   {
+      _undo_db.enable();
+      throw;
+   }
+   _undo_db.enable();
+} FC_CAPTURE_AND_RETHROW( (last_block_num) ) }
+
 void database::wipe(const fc::path& data_dir, bool include_blocks)
 {
    ilog("Wiping database", ("include_blocks", include_blocks));
@@ -128,16 +297,25 @@ void database::open(
          idump((last_block->id())(last_block->block_num()));
          if( last_block->id() != head_block_id() )
          {
-              FC_ASSERT( head_block_num() == 0, "last block ID does not match current chain state" );
+            // a state saved by the incremental persistence log while the node ran can be behind the blocks
+            // stored after it, those are applied again
+            if( head_block_num() > 0 && head_block_num() < last_block->block_num()
+                && _block_id_to_block.contains( head_block_id() ) )
+               apply_stored_blocks( last_block->block_num() );
+            else
+               FC_ASSERT( head_block_num() == 0, "last block ID does not match current chain state" );
          }
       }
       //idump((head_block_id())(head_block_num()));
+      _signature_key_cache.set_expiration_limit( head_block_time() + get_global_properties().parameters.maximum_time_until_expiration );
    }
    FC_CAPTURE_LOG_AND_RETHROW( (data_dir) )
 }
 
 void database::close(bool rewind)
 {
+   _state_snapshots.reset();
+
    // TODO:  Save pending tx's on close()
    clear_pending();
 
@@ -167,24 +167,48 @@ bool database::apply_order(const limit_order_object& new_order_object, bool allo
    if( called_some && !find_object(order_id) ) // then we were filled by call order
       return true;
 
-   const auto& limit_price_idx = get_index_type<limit_order_index>().indices().get<by_price>();
-
-   // TODO: it should be possible to simply check the NEXT/PREV iterator after new_order_object to
-   // determine whether or not this order has "changed the book" in a way that requires us to
-   // check orders. For now I just lookup the lower bound and check for equality... this is log(n) vs
-   // constant time check. Potential optimization.
-
    auto max_price = ~new_order_object.sell_price;
-   auto limit_itr = limit_price_idx.lower_bound(max_price.max());
-   auto limit_end = limit_price_idx.upper_bound(max_price);
-
    bool finished = false;
-   while( !finished && limit_itr != limit_end )
+
+   if( _flat_order_book_matching )
    {
-      auto old_limit_itr = limit_itr;
-      ++limit_itr;
-      // match returns 2 when only the old order was fully filled. In this case, we keep matching; otherwise, we stop.
-      finished = (match(new_order_object, *old_limit_itr, old_limit_itr->sell_price) != 2);
+      // Only the best order of the opposite book is matched at any time, and it is either filled and removed
+      // or the new order is done. So the book is looked up again after every match, and since nothing else
+      // changes it in between, its level count tells whether its best level still has to be compared to
+      // max_price.
+      const auto book_key = std::make_pair( max_price.base.asset_id, max_price.quote.asset_id );
+      size_t checked_levels = 0;
+      while( !finished )
+      {
+         const limit_order_book_index::book_type* book = _limit_order_book->find_book( book_key.first, book_key.second );
+         if( book == nullptr )
+            break;
+         const auto& best_level = book->back();
+         if( book->size() != checked_levels )
+         {
+            if( best_level.sell_price < max_price )
+               break;
+            checked_levels = book->size();
+         }
+         const limit_order_object& old_order = *best_level.orders.front();
+         // match returns 2 when only the old order was fully filled. In this case, we keep matching; otherwise, we stop.
+         finished = (match(new_order_object, old_order, old_order.sell_price) != 2);
+      }
+   }
+   else
+   {
+      const auto& limit_price_idx = get_index_type<limit_order_index>().indices().get<by_price>();
+
+      auto limit_itr = limit_price_idx.lower_bound(max_price.max());
+      auto limit_end = limit_price_idx.upper_bound(max_price);
+
+      while( !finished && limit_itr != limit_end )
+      {
+         auto old_limit_itr = limit_itr;
+         ++limit_itr;
+         // match returns 2 when only the old order was fully filled. In this case, we keep matching; otherwise, we stop.
+         finished = (match(new_order_object, *old_limit_itr, old_limit_itr->sell_price) != 2);
+      }
    }
 
    //Possible optimization: only check calls if the new order completely filled some old order
@@ -433,6 +457,14 @@ bool database::check_call_orders(const asset_object& mia, bool enable_black_swan
     if( bitasset.is_prediction_market ) return false;
     if( bitasset.current_feed.settlement_price.is_null() ) return false;
 
+    // nothing can be margin called while the feed protects the call order closest to a margin call
+    if( _margin_call_trigger_checks )
+    {
+       price trigger = _call_order_margins->margin_call_trigger( bitasset.options.short_backing_asset, mia.id );
+       if( trigger.is_null() || bitasset.current_feed.settlement_price > trigger )
+          return false;
+    }
+
     const call_order_index& call_index = get_index_type<call_order_index>();
     const auto& call_price_index = call_index.indices().get<by_price>();
 
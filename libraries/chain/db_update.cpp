@@ -40,7 +40,7 @@
 
 namespace graphene { namespace chain {
 
-void database::update_global_dynamic_data( const signed_block& b )
+void database::update_global_dynamic_data( const signed_block& b, const block_id_type& block_id )
 {
    const dynamic_global_property_object& _dgp =
       dynamic_global_property_id_type(0)(*this);
@@ -77,7 +77,7 @@ void database::update_global_dynamic_data( const signed_block& b )
          dgp.recently_missed_count--;
 
       dgp.head_block_number = b.block_num();
-      dgp.head_block_id = b.id();
+      dgp.head_block_id = block_id;
       dgp.time = b.timestamp;
       dgp.current_witness = b.witness;
       dgp.recent_slots_filled = (
@@ -207,6 +207,14 @@ bool database::check_for_blackswan( const asset_object& mia, bool enable_black_s
     auto settle_price = bitasset.current_feed.settlement_price;
     if( settle_price.is_null() ) return false; // no feed
 
+    // a black swan needs the least collateralized call to be worth less than the feed, whatever the bids are
+    if( _margin_call_trigger_checks )
+    {
+       const call_order_object* call = _call_order_margins->first_call( bitasset.options.short_backing_asset, mia.id );
+       if( call == nullptr || ~call->collateralization() < settle_price )
+          return false;
+    }
+
     const call_order_index& call_index = get_index_type<call_order_index>();
     const auto& call_price_index = call_index.indices().get<by_price>();
 
@@ -427,12 +435,13 @@ void database::clear_expired_orders()
 
 void database::update_expired_feeds()
 {
-   auto& asset_idx = get_index_type<asset_index>().indices().get<by_type>();
-   auto itr = asset_idx.lower_bound( true /** market issued */ );
-   while( itr != asset_idx.end() )
+   // Only assets whose feed expired or which changed since the previous block can need an update, in the same
+   // order a walk over all market issued assets would visit them.
+   _feed_expiration_schedule.begin( *this );
+   for( optional<asset_id_type> next = _feed_expiration_schedule.next( *this ); next.valid();
+        next = _feed_expiration_schedule.next( *this ) )
    {
-      const asset_object& a = *itr;
-      ++itr;
+      const asset_object& a = (*next)(*this);
       assert( a.is_market_issued() );
 
       const asset_bitasset_data_object& b = a.bitasset_data(*this);
@@ -453,6 +462,7 @@ void database::update_expired_feeds()
             a.options.core_exchange_rate = b.current_feed.core_exchange_rate;
          });
    }
+   _feed_expiration_schedule.end( *this );
 }
 
 void database::update_maintenance_flag( bool new_maintenance_flag )
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/expiration_schedule.hpp>
+#include <graphene/chain/database.hpp>
+
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/block_summary_object.hpp>
+
+namespace graphene { namespace chain {
+
+namespace {
+   void changed( feed_expiration_schedule& s, const asset_object& a )               { s.asset_changed( a ); }
+   void changed( feed_expiration_schedule& s, const asset_bitasset_data_object& b ) { s.bitasset_changed( b ); }
+   void removed( feed_expiration_schedule& s, const asset_object& a )               { s.asset_removed( a ); }
+   void removed( feed_expiration_schedule& s, const asset_bitasset_data_object& b ) { s.bitasset_removed( b ); }
+
+   template<typename ObjectType>
+   class feed_expiration_observer : public index_observer
+   {
+      public:
+         explicit feed_expiration_observer( feed_expiration_schedule& schedule ):_schedule(schedule){}
+
+         virtual void on_add( const object& obj )override    { changed( _schedule, cast( obj ) ); }
+         virtual void on_remove( const object& obj )override { removed( _schedule, cast( obj ) ); }
+         virtual void on_modify( const object& obj )override { changed( _schedule, cast( obj ) ); }
+
+      private:
+         static const ObjectType& cast( const object& obj )
+         {
+            assert( dynamic_cast<const ObjectType*>(&obj) );
+            return static_cast<const ObjectType&>(obj);
+         }
+
+         feed_expiration_schedule& _schedule;
+   };
+}
+
+void feed_expiration_schedule::observe( db::index& assets, db::index& bitassets )
+{
+   reset();
+   assets.add_observer( std::make_shared< feed_expiration_observer<asset_object> >( *this ) );
+   bitassets.add_observer( std::make_shared< feed_expiration_observer<asset_bitasset_data_object> >( *this ) );
+}
+
+void feed_expiration_schedule::reset()
+{
+   _feed_expirations.clear();
+   _asset_of.clear();
+   _changed.clear();
+   _last.reset();
+   _valid = false;
+}
+
+void feed_expiration_schedule::begin( const database& d )
+{
+   // What was looked at is only up to date if the previous block was the last one to look and was not popped
+   // since, which its block summary tells.
+   const uint32_t head = d.head_block_num();
+   bool valid = _valid && head == _block_num + 1;
+   if( valid )
+   {
+      const block_summary_object* summary = d.find( block_summary_id_type( _block_num & 0xffff ) );
+      valid = summary != nullptr && summary->block_id == _block_id;
+   }
+   _last.reset();
+   if( valid )
+      return;
+
+   reset();
+   const auto& asset_idx = d.get_index_type<asset_index>().indices().get<by_type>();
+   for( auto itr = asset_idx.lower_bound( true /** market issued */ ); itr != asset_idx.end(); ++itr )
+   {
+      asset_changed( *itr );
+      bitasset_changed( itr->bitasset_data( d ) );
+   }
+}
+
+optional<asset_id_type> feed_expiration_schedule::next( const database& d )
+{
+   _feed_expirations.pop_due( d.head_block_time(), [&]( asset_bitasset_data_id_type b ) {
+      auto itr = _asset_of.find( b );
+      if( itr != _asset_of.end() )
+         _changed.insert( itr->second );
+   });
+
+   auto changed_itr = _last.valid() ? _changed.upper_bound( *_last ) : _changed.begin();
+   if( changed_itr == _changed.end() )
+      return optional<asset_id_type>();
+   _last = *changed_itr;
+   _changed.erase( changed_itr );
+   return _last;
+}
+
+void feed_expiration_schedule::end( const database& d )
+{
+   _block_num = d.head_block_num();
+   _block_id = d.get( block_summary_id_type( _block_num & 0xffff ) ).block_id;
+   _valid = true;
+}
+
+void feed_expiration_schedule::asset_changed( const asset_object& a )
+{
+   if( !a.is_market_issued() )
+      return;
+   _asset_of[*a.bitasset_data_id] = a.get_id();
+   _changed.insert( a.get_id() );
+}
+
+void feed_expiration_schedule::asset_removed( const asset_object& a )
+{
+   if( !a.is_market_issued() )
+      return;
+   _asset_of.erase( *a.bitasset_data_id );
+   _changed.erase( a.get_id() );
+}
+
+void feed_expiration_schedule::bitasset_changed( const asset_bitasset_data_object& b )
+{
+   const asset_bitasset_data_id_type id = b.id;
+   _feed_expirations.schedule( id, b.feed_expiration_time() );
+   auto itr = _asset_of.find( id );
+   if( itr != _asset_of.end() )
+      _changed.insert( itr->second );
+}
+
+void feed_expiration_schedule::bitasset_removed( const asset_bitasset_data_object& b )
+{
+   const asset_bitasset_data_id_type id = b.id;
+   _feed_expirations.cancel( id );
+   auto itr = _asset_of.find( id );
+   if( itr != _asset_of.end() )
+   {
+      _changed.erase( itr->second );
+      _asset_of.erase( itr );
+   }
+}
+
+} } // graphene::chain
@@ -24,6 +24,7 @@
 #pragma once
 #include <graphene/chain/protocol/operations.hpp>
 #include <graphene/db/generic_index.hpp>
+#include <graphene/db/slab_index.hpp>
 #include <boost/multi_index/composite_key.hpp>
 
 namespace graphene { namespace chain {
@@ -321,12 +322,11 @@ namespace graphene { namespace chain {
    struct by_account_asset;
    struct by_asset_balance;
    /**
-    * @ingroup object_index
+    * Orders pointers to balances kept in an @ref account_balance_index.
     */
    typedef multi_index_container<
-      account_balance_object,
+      const account_balance_object*,
       indexed_by<
-         ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
          ordered_unique< tag<by_account_asset>,
             composite_key<
                account_balance_object,
@@ -350,10 +350,33 @@ namespace graphene { namespace chain {
       >
    > account_balance_object_multi_index_type;
 
+   /**
+    * @brief Stores balances in a slab_index and keeps them ordered by account and by asset
+    * @ingroup object_index
+    *
+    * The ordered views hold pointers into the slabs, so dereference the iterators of
+    * indices() to get at the balance objects.
+    */
+   class account_balance_index : public slab_index<account_balance_object>
+   {
+      public:
+         typedef account_balance_object_multi_index_type index_type;
+
+         virtual const object& create( const std::function<void(object&)>& constructor )override;
+         virtual const object& insert( object&& obj )override;
+         virtual void          modify( const object& obj, const std::function<void(object&)>& m )override;
+         virtual void          remove( const object& obj )override;
+
+         const index_type& indices()const { return _indices; }
+
+      private:
+         index_type _indices;
+   };
+
    /**
     * @ingroup object_index
     */
-   typedef generic_index<account_balance_object, account_balance_object_multi_index_type> account_balance_index;
+   typedef slab_index<account_statistics_object> account_statistics_index;
    
    struct by_migrate_account_id;
    struct by_migrate_eth_address;
@@ -418,6 +441,8 @@ FC_REFLECT_DERIVED( graphene::chain::account_object,
                     (top_n_control_flags)
                     (allowed_assets)
                     )
+GRAPHENE_DB_DELTA_UNDO( graphene::chain::account_object )
+GRAPHENE_DB_DENSE_ID_LOOKUP( graphene::chain::account_object )
 
 FC_REFLECT_DERIVED( graphene::chain::account_balance_object,
                     (graphene::db::object),
@@ -436,3 +461,4 @@ FC_REFLECT_DERIVED( graphene::chain::account_statistics_object,
                     (lifetime_fees_paid)
                     (pending_fees)(pending_vested_fees)
                   )
+GRAPHENE_DB_DENSE_ID_LOOKUP( graphene::chain::account_statistics_object )
@@ -251,6 +251,7 @@ namespace graphene { namespace chain {
 
 FC_REFLECT_DERIVED( graphene::chain::asset_dynamic_data_object, (graphene::db::object),
                     (current_supply)(confidential_supply)(accumulated_fees)(fee_pool) )
+GRAPHENE_DB_DENSE_ID_LOOKUP( graphene::chain::asset_dynamic_data_object )
 
 FC_REFLECT_DERIVED( graphene::chain::asset_bitasset_data_object, (graphene::db::object),
                     (feeds)
@@ -262,6 +263,8 @@ FC_REFLECT_DERIVED( graphene::chain::asset_bitasset_data_object, (graphene::db::
                     (settlement_price)
                     (settlement_fund)
                   )
+GRAPHENE_DB_DELTA_UNDO( graphene::chain::asset_bitasset_data_object )
+GRAPHENE_DB_DENSE_ID_LOOKUP( graphene::chain::asset_bitasset_data_object )
 
 FC_REFLECT_DERIVED( graphene::chain::asset_object, (graphene::db::object),
                     (symbol)
@@ -272,3 +275,4 @@ FC_REFLECT_DERIVED( graphene::chain::asset_object, (graphene::db::object),
                     (bitasset_data_id)
                     (buyback_account)
                   )
+GRAPHENE_DB_DENSE_ID_LOOKUP( graphene::chain::asset_object )
@@ -22,13 +22,36 @@
  * THE SOFTWARE.
  */
 #pragma once
-#include <fstream>
 #include <graphene/chain/protocol/block.hpp>
+#include <graphene/utilities/positional_file.hpp>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 namespace graphene { namespace chain {
+   struct index_entry;
+
+   /**
+    *  Stores blocks appended to the "blocks" file and keeps a flat array of
+    *  fixed size index_entry records, one per block number, in the "index" file.
+    *
+    *  The index is memory mapped and blocks are read with positional reads, so all
+    *  const methods may be called concurrently from any number of threads while a
+    *  single thread calls store() and remove().
+    *
+    *  Recently stored or fetched blocks are kept decoded in a size bounded LRU
+    *  cache keyed by block number, so repeated requests for the same block skip
+    *  reading, unpacking and re-hashing it.
+    */
    class block_database 
    {
       public:
+         block_database();
+         ~block_database();
+
          void open( const fc::path& dbdir );
          bool is_open()const;
          void flush();
@@ -43,8 +66,54 @@ namespace graphene { namespace chain {
          optional<signed_block> fetch_by_number( uint32_t block_num )const;
          optional<signed_block> last()const;
          optional<block_id_type> last_id()const;
+
+         /** Sets the maximum number of decoded blocks kept in memory, 0 disables the cache */
+         void     set_cache_size( size_t max_blocks );
+         size_t   cache_size()const { return _cache_max_size; }
+         uint64_t cache_hits()const { return _cache_hits; }
+         uint64_t cache_misses()const { return _cache_misses; }
       private:
-         mutable std::fstream _blocks;
-         mutable std::fstream _block_num_to_pos;
+         struct index_mapping;
+
+         /** true if the block of e lies within the blocks written so far */
+         bool                   in_blocks_file( const index_entry& e )const;
+         bool                   read_entry( uint32_t block_num, index_entry& e )const;
+         optional<index_entry>  last_entry()const;
+         signed_block           read_block( const index_entry& e )const;
+         void                   write_entry( uint32_t block_num, const index_entry& e );
+         void                   reserve_index( uint64_t entry_count );
+
+         typedef std::shared_ptr<const signed_block> block_ptr;
+         optional<signed_block> cache_find( uint32_t block_num, const block_id_type* id, uint64_t& generation )const;
+         void                   cache_insert( uint32_t block_num, const block_id_type& id, block_ptr b, uint64_t generation )const;
+         void                   cache_store( uint32_t block_num, const block_id_type& id, block_ptr b );
+         void                   cache_erase( uint32_t block_num );
+
+         fc::path                        _index_file;
+         /** written with positional I/O so readers on other threads never share a file position */
+         utilities::positional_file      _blocks;
+         /** the index file itself, only used to size it; entries go through _index */
+         utilities::positional_file      _index_data;
+         /** replaced with std::atomic_store when the index grows, readers keep the old mapping alive */
+         std::shared_ptr<index_mapping>  _index;
+         /** number of entries in use, always published after the mapping that covers them */
+         std::atomic<uint64_t>           _index_count;
+         std::atomic<uint64_t>           _blocks_size;
+
+         struct cached_block
+         {
+            uint32_t      block_num;
+            block_id_type id;
+            block_ptr     block;
+         };
+         /** most recently used first */
+         mutable std::list<cached_block>                                            _cache;
+         mutable std::unordered_map<uint32_t, std::list<cached_block>::iterator>   _cache_by_num;
+         mutable std::mutex                                                         _cache_mutex;
+         size_t                                                                     _cache_max_size = 1024;
+         /** bumped by store() and remove(), so readers never cache a block that was replaced while they read it */
+         uint64_t                                                                   _cache_generation = 0;
+         mutable std::atomic<uint64_t>                                              _cache_hits;
+         mutable std::atomic<uint64_t>                                              _cache_misses;
    };
 } }
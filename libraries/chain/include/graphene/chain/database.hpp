@@ -28,6 +28,10 @@
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/fork_database.hpp>
 #include <graphene/chain/block_database.hpp>
+#include <graphene/chain/signature_key_cache.hpp>
+#include <graphene/chain/vote_tally.hpp>
+#include <graphene/chain/expiration_schedule.hpp>
+#include <graphene/chain/state_snapshots.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/chain/evaluator.hpp>
 
@@ -35,6 +39,7 @@
 #include <graphene/db/object.hpp>
 #include <graphene/db/simple_index.hpp>
 #include <fc/signals.hpp>
+#include <fc/thread/thread.hpp>
 
 #include <graphene/chain/protocol/protocol.hpp>
 
@@ -47,9 +52,38 @@ namespace graphene { namespace chain {
    using graphene::db::object;
    class op_evaluator;
    class transaction_evaluation_state;
+   class limit_order_book_index;
+   class call_order_margin_index;
 
    struct budget_record;
 
+   /**
+    *  What a pending transaction depended on when it was last applied. When the pending state is rebuilt, its
+    *  authorities are only checked again if one of the accounts it read has changed since, or if they were not
+    *  checked when it was applied.
+    */
+   struct pending_transaction_dependencies
+   {
+      bool                      authority_checked = false; ///< false if the authority check was skipped
+      flat_set<account_id_type> authorities_read;  ///< accounts whose authorities the authority check read
+      flat_set<account_id_type> accounts_written;  ///< accounts created, modified or removed by the transaction
+   };
+
+   /**
+    *  Describes how the pending state was rebuilt after the most recent block. Every reapplied transaction was
+    *  evaluated again, rechecked counts those whose authority check was not skipped.
+    */
+   struct pending_revalidation_stats
+   {
+      uint32_t block_num    = 0; ///< head block the pending state was rebuilt on
+      uint32_t reapplied    = 0; ///< pending transactions applied again on top of the new head block
+      uint32_t rechecked    = 0; ///< of those, transactions whose authorities had to be checked again
+      uint32_t expired      = 0; ///< transactions dropped by expiration without being evaluated
+      uint32_t included     = 0; ///< transactions dropped because a new block contains them
+      uint32_t failed       = 0; ///< transactions dropped because they no longer apply
+      int64_t  microseconds = 0; ///< time spent rebuilding the pending state
+   };
+
    /**
     *   @class database
     *   @brief tracks the blockchain state in an extensible manner
@@ -102,6 +136,20 @@ namespace graphene { namespace chain {
           */
          void reindex(fc::path data_dir, const genesis_state_type& initial_allocation = genesis_state_type());
 
+         /**
+          * @brief Configure the block replay pipeline used by @ref database::reindex
+          * @param queue_depth Maximum number of blocks read and hashed ahead of the block being applied
+          * @param hashing_threads Number of threads computing block ids and merkle roots
+          */
+         void set_reindex_pipeline( uint32_t queue_depth, uint32_t hashing_threads );
+
+         /**
+          * @brief Apply the stored blocks following the head block, up to and including last_block_num
+          *
+          * Used by @ref database::open when the saved state is older than the block database.
+          */
+         void apply_stored_blocks( uint32_t last_block_num );
+
          /**
           * @brief wipe Delete database from disk, and potentially the raw chain as well.
           * @param include_blocks If true, delete the raw chain as well as the database.
@@ -111,6 +159,36 @@ namespace graphene { namespace chain {
          void wipe(const fc::path& data_dir, bool include_blocks);
          void close(bool rewind = true);
 
+         /**
+          * @brief Set the number of worker threads used to recover transaction signature keys
+          * @param thread_count Number of threads to start, 0 recovers keys serially on the calling thread
+          */
+         void set_signature_recovery_threads( uint32_t thread_count );
+
+         /**
+          * @brief Set how many recovered signature keys are remembered across pending transactions and blocks
+          * @param max_entries Maximum number of signatures cached, 0 to disable the cache
+          */
+         void set_signature_cache_size( size_t max_entries ) { _signature_key_cache.set_max_entries( max_entries ); }
+         signature_cache_stats get_signature_cache_stats()const { return _signature_key_cache.get_stats(); }
+         void clear_signature_cache() { _signature_key_cache.clear(); }
+
+         /**
+          * @brief Set the number of worker threads running precheck_transaction()
+          * @param thread_count Number of threads to start, 0 runs the checks on the calling thread
+          */
+         void set_transaction_precheck_threads( uint32_t thread_count );
+
+         /**
+          * @brief Keep copies of the chain state which queries can read on other threads while blocks are applied
+          * @param thread_count Number of threads running queries, 0 to drop the copies
+          *
+          * @see state_snapshots
+          */
+         void enable_state_snapshots( uint32_t thread_count );
+         /** @return the copies of the chain state for queries, or nullptr if not enabled */
+         const state_snapshots* get_state_snapshots()const { return _state_snapshots.get(); }
+
          //////////////////// db_block.cpp ////////////////////
 
          /**
@@ -125,6 +203,10 @@ namespace graphene { namespace chain {
          const signed_transaction&  get_recent_transaction( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
+         /// The block store backing fetch_block_by_id() and fetch_block_by_number(), e.g. for its cache statistics
+         const block_database&      get_block_database()const { return _block_id_to_block; }
+         void                       set_block_cache_size( size_t max_blocks ) { _block_id_to_block.set_cache_size( max_blocks ); }
+
          /**
           *  Calculate the percent of block production slots that were missed in the
           *  past 128 blocks, not including the current block.
@@ -138,7 +220,27 @@ namespace graphene { namespace chain {
          bool push_block( const signed_block& b, uint32_t skip = skip_nothing );
          processed_transaction push_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
          bool _push_block( const signed_block& b );
-         processed_transaction _push_transaction( const signed_transaction& trx );
+         /** appends the changed objects to the incremental persistence log once a new block became irreversible */
+         void save_irreversible_state();
+         /**
+          *  @param unchanged if given, trx was applied before and none of these dependencies have changed since,
+          *  so its authorities are not checked again
+          */
+         processed_transaction _push_transaction( const signed_transaction& trx,
+                                                  const pending_transaction_dependencies* unchanged = nullptr );
+
+         /**
+          *  Applies the popped and pending transactions again after the head block changed. Pending transactions
+          *  which expired or were included in a block are dropped without being evaluated, and authorities are only
+          *  checked again for transactions which read an account changed since they were last applied.
+          *
+          *  Every other pending transaction is evaluated again in full: the pending state is an undo session on top
+          *  of the head block, and which objects an evaluator read is not tracked, so neither the undo state nor the
+          *  results of a transaction can be kept across blocks. Only the authority check is saved.
+          */
+         void _restore_pending_transactions( vector<processed_transaction>&& pending,
+                                             vector<pending_transaction_dependencies>&& dependencies );
+         const pending_revalidation_stats& get_pending_revalidation_stats()const { return _pending_revalidation_stats; }
 
          ///@throws fc::exception if the proposed transaction fails to apply.
          processed_transaction push_proposal( const proposal_object& proposal );
@@ -158,6 +260,30 @@ namespace graphene { namespace chain {
          void pop_block();
          void clear_pending();
 
+         /**
+          *  Recovers the signature keys of every transaction in the block on the
+          *  signature recovery threads into the signature key cache, so that
+          *  authority checks while applying the block only walk the authority graph.
+          *  Does nothing if no signature recovery threads have been started.
+          *
+          *  Waiting for the threads yields to other tasks, so push_block() calls this
+          *  before it changes anything, never while a block is half applied.
+          */
+         void precompute_signature_keys( const signed_block& block )const;
+
+         /**
+          *  Runs the checks on a transaction that don't depend on the chain state -- its size, validate(),
+          *  its expiration bounds and signature recovery -- on a transaction precheck thread, leaving the
+          *  recovered keys in the signature key cache for push_transaction(). The calling thread only
+          *  reads the chain parameters and head block time, so a flood of bad transactions costs it
+          *  little. Runs on the calling thread if no precheck threads have been started.
+          *
+          *  @throws tx_malformed if the transaction is too large, fails validate() or has a bad signature,
+          *  which no chain state can change
+          *  @throws fc::exception if its expiration is out of bounds at the head block time
+          */
+         void precheck_transaction( const signed_transaction& trx )const;
+
          /**
           *  This method is used to track appied operations during the evaluation of a block, these
           *  operations should include any operation actually included in a transaction as well
@@ -342,6 +468,23 @@ namespace graphene { namespace chain {
           */
          bool apply_order(const limit_order_object& new_order_object, bool allow_black_swan = true);
 
+         /**
+          * @brief Choose how apply_order() finds the orders a new order is matched against
+          *
+          * By default it walks the price levels of limit_order_book_index. When disabled it walks the by_price index
+          * of limit_order_index instead. Both yield identical results, the latter is kept to cross check the former.
+          */
+         void set_flat_order_book_matching( bool enabled ) { _flat_order_book_matching = enabled; }
+
+         /**
+          * @brief Choose whether check_call_orders() and check_for_blackswan() may return early
+          *
+          * By default they first compare the current feed with the call order closest to a margin call, which
+          * call_order_margin_index keeps at hand, and only search the order books if the feed has reached it.
+          * When disabled they always search the books. Both yield identical results.
+          */
+         void set_margin_call_trigger_checks( bool enabled ) { _margin_call_trigger_checks = enabled; }
+
          /**
           * Matches the two orders,
           *
@@ -411,21 +554,27 @@ namespace graphene { namespace chain {
        public:
          // these were formerly private, but they have a fairly well-defined API, so let's make them public
          void                  apply_block( const signed_block& next_block, uint32_t skip = skip_nothing );
+         /// as above, for callers which already computed next_block.id()
+         void                  apply_block( const signed_block& next_block, const block_id_type& next_block_id, uint32_t skip );
          processed_transaction apply_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
          operation_result      apply_operation( transaction_evaluation_state& eval_state, const operation& op );
       private:
-         void                  _apply_block( const signed_block& next_block );
+         void                  _apply_block( const signed_block& next_block, const block_id_type& next_block_id );
          processed_transaction _apply_transaction( const signed_transaction& trx );
+         /// adds the accounts created, modified or removed in the head undo state to accounts
+         void                  collect_changed_accounts( flat_set<account_id_type>& accounts )const;
+         /// true if the head undo state modified the global properties, which every authority check depends on
+         bool                  global_properties_changed()const;
 
          ///Steps involved in applying a new block
          ///@{
 
          const witness_object& validate_block_header( uint32_t skip, const signed_block& next_block )const;
          const witness_object& _validate_block_header( const signed_block& next_block )const;
-         void create_block_summary(const signed_block& next_block);
+         void create_block_summary(const signed_block& next_block, const block_id_type& next_block_id);
 
          //////////////////// db_update.cpp ////////////////////
-         void update_global_dynamic_data( const signed_block& b );
+         void update_global_dynamic_data( const signed_block& b, const block_id_type& block_id );
          void update_signing_witness(const witness_object& signing_witness, const signed_block& new_block);
          void update_last_irreversible_block();
          void clear_expired_transactions();
@@ -453,6 +602,15 @@ namespace graphene { namespace chain {
          ///@}
 
          vector< processed_transaction >        _pending_tx;
+         vector< pending_transaction_dependencies > _pending_tx_dependencies; ///< one for each of _pending_tx
+         /// accounts changed by blocks applied since the pending state was cleared
+         flat_set<account_id_type>              _accounts_changed_since_pending;
+         bool                                   _all_accounts_changed_since_pending = false;
+         pending_revalidation_stats             _pending_revalidation_stats;
+         /// accounts whose authorities were read by the last authority check of _apply_transaction()
+         flat_set<account_id_type>              _trx_authorities_read;
+         /// false if _apply_transaction() skipped the authority check of the last transaction
+         bool                                   _trx_authority_checked = false;
          fork_database                          _fork_db;
 
          /**
@@ -483,9 +641,30 @@ namespace graphene { namespace chain {
          vector<uint64_t>                  _witness_count_histogram_buffer;
          vector<uint64_t>                  _committee_count_histogram_buffer;
          uint64_t                          _total_voting_stake;
+         vote_tally                        _vote_tally;
+         feed_expiration_schedule          _feed_expiration_schedule;
 
          flat_map<uint32_t,block_id_type>  _checkpoints;
 
+         vector< std::unique_ptr<fc::thread> > _signature_recovery_threads;
+         mutable signature_key_cache       _signature_key_cache;
+         vector< std::unique_ptr<fc::thread> > _transaction_precheck_threads;
+         mutable size_t                    _next_transaction_precheck_thread = 0;
+         std::unique_ptr<state_snapshots>  _state_snapshots;
+         /// the next transaction passed to _apply_transaction(), if its authority check from when it was pushed still holds
+         const signed_transaction*         _prevalidated_trx = nullptr;
+
+         const limit_order_book_index*     _limit_order_book = nullptr;
+         bool                              _flat_order_book_matching = true;
+         const call_order_margin_index*    _call_order_margins = nullptr;
+         bool                              _margin_call_trigger_checks = true;
+
+         /// the last irreversible block when the incremental persistence log was last written by push_block()
+         uint32_t                          _last_saved_irreversible_block = 0;
+
+         uint32_t                          _reindex_queue_depth     = 1000;
+         uint32_t                          _reindex_hashing_threads = 2;
+
          node_property_object              _node_property_object;
    };
 
@@ -509,3 +688,6 @@ namespace graphene { namespace chain {
    }
 
 } }
+
+FC_REFLECT( graphene::chain::pending_revalidation_stats,
+            (block_num)(reapplied)(rechecked)(expired)(included)(failed)(microseconds) )
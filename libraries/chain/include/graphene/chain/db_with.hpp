@@ -68,48 +68,21 @@ struct skip_flags_restorer
  */
 struct pending_transactions_restorer
 {
-   pending_transactions_restorer( database& db, std::vector<processed_transaction>&& pending_transactions )
-      : _db(db), _pending_transactions( std::move(pending_transactions) )
+   pending_transactions_restorer( database& db, std::vector<processed_transaction>&& pending_transactions,
+                                  std::vector<pending_transaction_dependencies>&& dependencies )
+      : _db(db), _pending_transactions( std::move(pending_transactions) ), _dependencies( std::move(dependencies) )
    {
       _db.clear_pending();
    }
 
    ~pending_transactions_restorer()
    {
-      for( const auto& tx : _db._popped_tx )
-      {
-         try {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               // since push_transaction() takes a signed_transaction,
-               // the operation_results field will be ignored.
-               _db._push_transaction( tx );
-            }
-         } catch ( const fc::exception&  ) {
-         }
-      }
-      _db._popped_tx.clear();
-      for( const processed_transaction& tx : _pending_transactions )
-      {
-         try
-         {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               // since push_transaction() takes a signed_transaction,
-               // the operation_results field will be ignored.
-               _db._push_transaction( tx );
-            }
-         }
-         catch( const fc::exception& e )
-         {
-            /*
-            wlog( "Pending transaction became invalid after switching to block ${b}  ${t}", ("b", _db.head_block_id())("t",_db.head_block_time()) );
-            wlog( "The invalid pending transaction caused exception ${e}", ("e", e.to_detail_string() ) );
-            */
-         }
-      }
+      _db._restore_pending_transactions( std::move(_pending_transactions), std::move(_dependencies) );
    }
 
    database& _db;
    std::vector< processed_transaction > _pending_transactions;
+   std::vector< pending_transaction_dependencies > _dependencies;
 };
 
 /**
@@ -140,9 +113,10 @@ template< typename Lambda >
 void without_pending_transactions(
    database& db,
    std::vector<processed_transaction>&& pending_transactions,
+   std::vector<pending_transaction_dependencies>&& dependencies,
    Lambda callback )
 {
-    pending_transactions_restorer restorer( db, std::move(pending_transactions) );
+    pending_transactions_restorer restorer( db, std::move(pending_transactions), std::move(dependencies) );
     callback();
     return;
 }
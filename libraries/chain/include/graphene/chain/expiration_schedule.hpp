@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/types.hpp>
+#include <graphene/db/index.hpp>
+
+namespace graphene { namespace chain {
+   class database;
+   class asset_object;
+   class asset_bitasset_data_object;
+
+   /**
+    *  Buckets ids by the block time at which they are due, so that per-block housekeeping only visits the
+    *  ids whose slot has been reached instead of every object that could expire.
+    */
+   template<typename IdType>
+   class expiration_schedule
+   {
+      public:
+         /** moves id to the slot of deadline, adding it if it is not scheduled yet */
+         void schedule( IdType id, time_point_sec deadline )
+         {
+            auto itr = _deadlines.find( id );
+            if( itr != _deadlines.end() )
+            {
+               if( itr->second == deadline )
+                  return;
+               remove_from_slot( id, itr->second );
+               itr->second = deadline;
+            }
+            else
+               _deadlines.emplace( id, deadline );
+            _slots[deadline].insert( id );
+         }
+
+         void cancel( IdType id )
+         {
+            auto itr = _deadlines.find( id );
+            if( itr == _deadlines.end() )
+               return;
+            remove_from_slot( id, itr->second );
+            _deadlines.erase( itr );
+         }
+
+         void clear()
+         {
+            _slots.clear();
+            _deadlines.clear();
+         }
+
+         /** removes every id whose deadline is at or before now and calls l with it, earliest slot first */
+         template<typename Lambda>
+         void pop_due( time_point_sec now, Lambda&& l )
+         {
+            while( !_slots.empty() && _slots.begin()->first <= now )
+            {
+               flat_set<IdType> due = std::move( _slots.begin()->second );
+               _slots.erase( _slots.begin() );
+               for( const IdType& id : due )
+               {
+                  _deadlines.erase( id );
+                  l( id );
+               }
+            }
+         }
+
+         size_t size()const { return _deadlines.size(); }
+
+      private:
+         void remove_from_slot( IdType id, time_point_sec deadline )
+         {
+            auto slot = _slots.find( deadline );
+            assert( slot != _slots.end() );
+            slot->second.erase( id );
+            if( slot->second.empty() )
+               _slots.erase( slot );
+         }
+
+         map<time_point_sec, flat_set<IdType>>   _slots;
+         flat_map<IdType, time_point_sec>        _deadlines;
+   };
+
+   /**
+    *  Finds the market issued assets update_expired_feeds() has to look at in a block: those whose feed expired
+    *  and those whose asset or bitasset data changed since they were last looked at, as only a change can make
+    *  the core exchange rate of an asset differ from the one of its feed.
+    *
+    *  Observers on the asset and bitasset indexes keep the feed expirations scheduled and mark changed assets,
+    *  including changes made by undo. An asset whose feed expired is taken out of the schedule when it becomes
+    *  due and marked as changed; looking at it renews its feed, which schedules it again. What was looked at in a block is only known to be up to date in the next
+    *  block, so after startup, a fork switch or a block which failed to apply every market issued asset is
+    *  looked at again.
+    */
+   class feed_expiration_schedule
+   {
+      public:
+         /** registers the observers which keep the schedule up to date and forgets everything */
+         void observe( db::index& assets, db::index& bitassets );
+
+         /** forgets everything, so that every market issued asset is looked at in the next block */
+         void reset();
+
+         /** starts looking at the assets of the block being applied */
+         void begin( const database& d );
+
+         /**
+          *  @return the lowest id of the assets to look at which is above the one returned before in this block,
+          *  including assets that became due or changed since
+          */
+         optional<asset_id_type> next( const database& d );
+
+         /** remembers that the assets are up to date as of the block being applied */
+         void end( const database& d );
+
+         void asset_changed( const asset_object& a );
+         void asset_removed( const asset_object& a );
+         void bitasset_changed( const asset_bitasset_data_object& b );
+         void bitasset_removed( const asset_bitasset_data_object& b );
+
+      private:
+         expiration_schedule<asset_bitasset_data_id_type>      _feed_expirations;
+         flat_map<asset_bitasset_data_id_type, asset_id_type>  _asset_of;
+         flat_set<asset_id_type>                               _changed;
+         optional<asset_id_type>                               _last;
+
+         bool                                                  _valid = false;
+         uint32_t                                              _block_num = 0;
+         block_id_type                                         _block_id;
+   };
+
+} } // graphene::chain
@@ -30,6 +30,8 @@
 
 #include <boost/multi_index/composite_key.hpp>
 
+#include <deque>
+
 namespace graphene { namespace chain {
 
 using namespace graphene::db;
@@ -97,6 +99,47 @@ typedef multi_index_container<
 
 typedef generic_index<limit_order_object, limit_order_multi_index_type> limit_order_index;
 
+/**
+ *  @brief This secondary index keeps the limit orders of each side of every market in price levels
+ *
+ *  The levels of a book are kept in a contiguous array sorted by ascending price, so the best price
+ *  is at the back, and each level queues its orders by ascending ID. Walking a book from its last
+ *  level to its first visits orders in the same sequence as the by_price index of limit_order_index.
+ */
+class limit_order_book_index : public secondary_index
+{
+   public:
+      struct price_level
+      {
+         price                                   sell_price;
+         std::deque<const limit_order_object*>   orders;
+      };
+      /** the levels of orders selling one asset for another, best price last */
+      typedef vector<price_level> book_type;
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
+
+      /** @return the book of orders selling base for quote, or nullptr if there are none */
+      const book_type* find_book( asset_id_type base, asset_id_type quote )const
+      {
+         auto itr = _books.find( std::make_pair( base, quote ) );
+         return itr == _books.end() ? nullptr : &itr->second;
+      }
+
+      /** every non-empty book, keyed by the asset sold and the asset received */
+      const map< pair<asset_id_type,asset_id_type>, book_type >& books()const { return _books; }
+
+   private:
+      void insert_order( const limit_order_object& order );
+      void remove_order( const limit_order_object& order, const price& sell_price );
+
+      map< pair<asset_id_type,asset_id_type>, book_type >   _books;
+      price                                                 _sell_price_before_modify;
+};
+
 /**
  * @class call_order_object
  * @brief tracks debt and call price information
@@ -122,6 +165,47 @@ class call_order_object : public abstract_object<call_order_object>
       price            call_price;  ///< Debt / Collateral
 };
 
+/**
+ *  @brief This secondary index keeps the call orders of every pair of collateral and debt asset in the order of
+ *  the by_price index of call_order_index
+ *
+ *  The first order of a pair is the one which a margin call or a black swan would reach first, so whether the
+ *  current feed leaves anything to do can be told without searching the indexes.
+ */
+class call_order_margin_index : public secondary_index
+{
+   public:
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
+
+      /** @return the call order backed by collateral which comes first in the by_price index, or nullptr if there
+       *  are none */
+      const call_order_object* first_call( asset_id_type collateral, asset_id_type debt )const
+      {
+         auto itr = _calls.find( std::make_pair( collateral, debt ) );
+         return itr == _calls.end() ? nullptr : itr->second.begin()->second;
+      }
+
+      /** @return the feed settlement price from which on the first call order of the pair can be margin called, or
+       *  a null price if there are none */
+      price margin_call_trigger( asset_id_type collateral, asset_id_type debt )const
+      {
+         const call_order_object* call = first_call( collateral, debt );
+         return call == nullptr ? price() : ~call->call_price;
+      }
+
+   private:
+      typedef std::map< pair<price,object_id_type>, const call_order_object* > calls_type;
+
+      void insert_call( const call_order_object& call );
+      void remove_call( const call_order_object& call, const price& call_price );
+
+      map< pair<asset_id_type,asset_id_type>, calls_type >   _calls;
+      price                                                  _call_price_before_modify;
+};
+
 /**
  *  @brief tracks bitassets scheduled for force settlement at some point in the future.
  *
@@ -24,6 +24,7 @@
 #pragma once
 #include <graphene/chain/protocol/operations.hpp>
 #include <graphene/db/object.hpp>
+#include <graphene/db/slab_index.hpp>
 #include <boost/multi_index/composite_key.hpp>
 
 namespace graphene { namespace chain {
@@ -64,6 +65,11 @@ namespace graphene { namespace chain {
          uint16_t          virtual_op = 0;
    };
 
+   /**
+    * @ingroup object_index
+    */
+   typedef slab_index<operation_history_object> operation_history_index;
+
    /**
     *  @brief a node in a linked list of operation_history_objects
     *  @ingroup implementation
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/transaction.hpp>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene { namespace chain {
+
+   struct signature_cache_stats
+   {
+      uint64_t hits    = 0; ///< signatures whose key was found in the cache
+      uint64_t misses  = 0; ///< signatures whose key had to be recovered
+      uint64_t entries = 0; ///< signatures currently cached
+   };
+
+   /**
+    *  Remembers the public key recovered from each (signature digest, signature) pair, so that a transaction
+    *  verified when it is first received is not recovered again when it is re-applied to the pending state or
+    *  arrives in a block. Entries are dropped once their transaction has expired, or earliest expiration first
+    *  when the cache is full. Expirations are not validated when an entry is added, so they are capped at the
+    *  latest one a valid transaction can have; otherwise far-future expirations would never be evicted.
+    *
+    *  May be used from several threads at once.
+    */
+   class signature_key_cache
+   {
+      public:
+         explicit signature_key_cache( size_t max_entries = 100000 ):_max_entries(max_entries){}
+
+         /**
+          *  @return the keys which signed trx, as signed_transaction::get_signature_keys() would
+          *  @throws tx_duplicate_sig if two signatures are by the same key
+          */
+         flat_set<public_key_type> get_signature_keys( const signed_transaction& trx, const chain_id_type& chain_id );
+
+         /** drops the signatures of transactions which expired before now */
+         void                      remove_expired( fc::time_point_sec now );
+         /** caps the expiration of signatures added from now on, normally at head block time + maximum_time_until_expiration */
+         void                      set_expiration_limit( fc::time_point_sec limit );
+
+         void                      set_max_entries( size_t max_entries );
+         void                      clear();
+         signature_cache_stats     get_stats()const;
+
+      private:
+         struct signature_id
+         {
+            digest_type     digest;
+            signature_type  signature;
+
+            bool operator == ( const signature_id& other )const;
+         };
+         struct signature_id_hash
+         {
+            size_t operator()( const signature_id& id )const;
+         };
+         struct cached_key
+         {
+            public_key_type     key;
+            fc::time_point_sec  expiration;
+         };
+
+         bool find( const signature_id& id, public_key_type& key )const;
+         void insert( const signature_id& id, const public_key_type& key, fc::time_point_sec expiration );
+         void evict_earliest();
+
+         mutable std::mutex                                             _mutex;
+         size_t                                                         _max_entries;
+         fc::time_point_sec                                             _expiration_limit = fc::time_point_sec::maximum();
+         std::unordered_map<signature_id, cached_key, signature_id_hash> _keys;
+         std::multimap<fc::time_point_sec, signature_id>                 _by_expiration;
+         mutable std::atomic<uint64_t>                                  _hits{0};
+         mutable std::atomic<uint64_t>                                  _misses{0};
+   };
+
+} } // graphene::chain
+
+FC_REFLECT( graphene::chain::signature_cache_stats, (hits)(misses)(entries) )
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/db/object_database.hpp>
+
+#include <fc/signals.hpp>
+#include <fc/thread/future.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <atomic>
+#include <memory>
+
+namespace graphene { namespace chain {
+   class database;
+
+   /**
+    *  Keeps read only copies of the chain state as of the last applied block, so that queries can run on a pool of
+    *  threads while the database keeps applying blocks.
+    *
+    *  Two copies of every object are kept. New queries read the newer copy, while the objects changed by every
+    *  applied block are packed and handed to a separate thread, which replays them into the other copy as soon as
+    *  no query reads it any more and then makes it the one new queries read. Applying a block never waits for
+    *  queries, at the cost of twice the memory of the chain state; a copy may lag behind until no query reads it.
+    *
+    *  Indexes added by plugins are copied without their secondary indexes.
+    */
+   class state_snapshots
+   {
+      public:
+         state_snapshots( database& db, uint32_t thread_count );
+         ~state_snapshots();
+
+         /**
+          *  Runs query with the newest copy of the chain state on one of the threads.
+          *  @return a future for the result of query
+          */
+         template<typename Query>
+         auto async( Query&& query )const -> fc::future<decltype( query( std::declval<const database&>() ) )>
+         {
+            std::shared_ptr<const database> snapshot = std::atomic_load( &_current );
+            fc::thread& worker = *_threads[ _next_thread++ % _threads.size() ];
+            return worker.async( [snapshot,query]() { return query( *snapshot ); }, "state_snapshot_query" );
+         }
+
+         /** @return the number of the block the copy given to new queries reflects */
+         uint32_t head_block_num()const;
+
+         /** waits until the changes of every block applied so far were handed to the copies */
+         void wait_for_updates()const;
+
+      private:
+         struct replica
+         {
+            std::shared_ptr<database>                                     db;
+            /// changes which were not replayed into db yet, oldest first
+            vector< std::shared_ptr<const graphene::db::object_change_set> > pending;
+         };
+
+         void on_applied_block();
+         void update( const std::shared_ptr<const graphene::db::object_change_set>& changes );
+
+         database&                                _db;
+         vector< std::unique_ptr<fc::thread> >    _threads;
+         mutable std::atomic<uint32_t>            _next_thread;
+         std::unique_ptr<fc::thread>              _update_thread;
+         fc::future<void>                         _last_update;
+         replica                                  _replicas[2];
+         std::shared_ptr<const database>          _current;
+         boost::signals2::scoped_connection       _applied_block_connection;
+   };
+
+} } // graphene::chain
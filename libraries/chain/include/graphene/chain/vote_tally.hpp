@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/chain/protocol/types.hpp>
+#include <graphene/chain/protocol/vote.hpp>
+#include <graphene/db/index.hpp>
+
+namespace graphene { namespace chain {
+   class database;
+   class account_object;
+
+   /**
+    *  Keeps the voting stake of every account summed up per vote, per desired witness count and per desired
+    *  committee count across maintenance intervals.
+    *
+    *  Observers on the account, statistics, balance and vesting balance indexes mark the accounts whose stake or
+    *  opinions may have changed. At the next maintenance only those accounts are counted again, unless the totals
+    *  can not be trusted (after startup, a fork switch or a change of count_non_member_votes), in which case every
+    *  account is counted.
+    *
+    *  The stake of an account is added to the opinions of the account it proxies to. That opinion is kept as a
+    *  snapshot, so that it can be taken back out of the totals when either side changes.
+    */
+   class vote_tally
+   {
+      public:
+         /** registers the observers which mark changed accounts and forgets all totals */
+         void observe( db::index& accounts, db::index& statistics, db::index& balances, db::index& vesting_balances );
+
+         /** forgets all totals, so that every account has to be counted at the next maintenance */
+         void reset();
+
+         /** the stake or the opinions of account may have changed */
+         void mark_changed( account_id_type account );
+
+         /**
+          *  Starts counting for a maintenance.
+          *  @return true if the totals of the previous maintenance are still valid and only changed accounts have
+          *  to be counted, false if they were reset and every account has to be counted
+          */
+         bool begin_maintenance( const database& d );
+
+         /**
+          *  Counts every account changed since the previous maintenance again.
+          *  @param fee_payers receives the changed accounts which have pending fees, which are all accounts that
+          *  have fees to process at this maintenance
+          */
+         void count_changed_accounts( const database& d, vector<const account_object*>& fee_payers );
+
+         /** replaces the stake account currently contributes by its current stake */
+         void count_account( const database& d, const account_object& stake_account );
+
+         /** copies the totals to the buffers the maintenance reads and remembers the block they are valid for */
+         void end_maintenance( const database& d, uint32_t block_num, const block_id_type& block_id,
+                               vector<uint64_t>& vote_tally, vector<uint64_t>& witness_count_histogram,
+                               vector<uint64_t>& committee_count_histogram, uint64_t& total_voting_stake );
+
+         /**
+          *  Counts the stake of every account from scratch and throws if the result differs from the totals.
+          *  Only meaningful right after count_changed_accounts().
+          */
+         void verify( const database& d )const;
+
+      private:
+         /** the opinions some stake was added to */
+         struct opinion
+         {
+            uint64_t                 stake = 0; ///< total stake following these opinions
+            flat_set<vote_id_type>   votes;
+            uint16_t                 num_witness = 0;
+            uint16_t                 num_committee = 0;
+         };
+
+         /** what an account currently contributes */
+         struct contribution
+         {
+            account_id_type  opinion_account;
+            uint64_t         stake = 0;
+            time_point_sec   membership_expiration; ///< key in _expirations, unless default
+         };
+
+         void add( const opinion& o, uint64_t stake );
+         void subtract( const opinion& o, uint64_t stake );
+         void refresh_opinion( const database& d, account_id_type account );
+
+         vector<contribution>                              _contributions;
+         map<account_id_type, opinion>                     _opinions;
+         set< pair<time_point_sec, account_id_type> > _expirations;
+
+         vector<uint64_t>                                  _votes;
+         flat_map<uint16_t, uint64_t>                      _witness_counts;
+         flat_map<uint16_t, uint64_t>                      _committee_counts;
+         uint64_t                                          _total_stake = 0;
+
+         vector<account_id_type>                           _changed;
+         vector<bool>                                      _is_changed;
+
+         bool                                              _valid = false;
+         uint32_t                                          _block_num = 0;
+         block_id_type                                     _block_id;
+         bool                                              _count_non_member_votes = false;
+   };
+
+} } // graphene::chain
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/market_object.hpp>
+
+namespace graphene { namespace chain {
+
+namespace {
+   bool same_representation( const price& a, const price& b )
+   {
+      return a.base == b.base && a.quote == b.quote;
+   }
+}
+
+void limit_order_book_index::insert_order( const limit_order_object& order )
+{
+   const price& p = order.sell_price;
+   book_type& book = _books[ std::make_pair( p.base.asset_id, p.quote.asset_id ) ];
+
+   auto level = std::lower_bound( book.begin(), book.end(), p,
+                                  []( const price_level& l, const price& p ){ return l.sell_price < p; } );
+   if( level == book.end() || p < level->sell_price )
+   {
+      level = book.insert( level, price_level() );
+      level->sell_price = p;
+   }
+
+   auto& orders = level->orders;
+   if( orders.empty() || orders.back()->id < order.id )
+      orders.push_back( &order ); // new orders always have the highest ID
+   else
+      orders.insert( std::upper_bound( orders.begin(), orders.end(), &order,
+                                       []( const limit_order_object* a, const limit_order_object* b ){ return a->id < b->id; } ),
+                     &order );
+}
+
+void limit_order_book_index::remove_order( const limit_order_object& order, const price& sell_price )
+{
+   auto book = _books.find( std::make_pair( sell_price.base.asset_id, sell_price.quote.asset_id ) );
+   assert( book != _books.end() );
+   if( book == _books.end() ) return;
+
+   auto& levels = book->second;
+   auto level = levels.end();
+   // orders are almost always removed from the best level, which is the last one
+   if( !levels.empty() && levels.back().sell_price == sell_price )
+      level = levels.end() - 1;
+   else
+   {
+      level = std::lower_bound( levels.begin(), levels.end(), sell_price,
+                                []( const price_level& l, const price& p ){ return l.sell_price < p; } );
+      assert( level != levels.end() && level->sell_price == sell_price );
+      if( level == levels.end() ) return;
+   }
+
+   auto& orders = level->orders;
+   auto itr = std::find( orders.begin(), orders.end(), &order );
+   assert( itr != orders.end() );
+   if( itr != orders.end() )
+      orders.erase( itr );
+
+   if( orders.empty() )
+   {
+      levels.erase( level );
+      if( levels.empty() )
+         _books.erase( book );
+   }
+}
+
+void limit_order_book_index::object_inserted( const object& obj )
+{
+   assert( dynamic_cast<const limit_order_object*>(&obj) );
+   insert_order( static_cast<const limit_order_object&>(obj) );
+}
+
+void limit_order_book_index::object_removed( const object& obj )
+{
+   assert( dynamic_cast<const limit_order_object*>(&obj) );
+   const limit_order_object& order = static_cast<const limit_order_object&>(obj);
+   remove_order( order, order.sell_price );
+}
+
+void limit_order_book_index::about_to_modify( const object& before )
+{
+   assert( dynamic_cast<const limit_order_object*>(&before) );
+   _sell_price_before_modify = static_cast<const limit_order_object&>(before).sell_price;
+}
+
+void limit_order_book_index::object_modified( const object& after )
+{
+   assert( dynamic_cast<const limit_order_object*>(&after) );
+   const limit_order_object& order = static_cast<const limit_order_object&>(after);
+   // fills only change the amount for sale, which leaves the order where it is
+   if( same_representation( order.sell_price, _sell_price_before_modify ) )
+      return;
+   remove_order( order, _sell_price_before_modify );
+   insert_order( order );
+}
+
+void call_order_margin_index::insert_call( const call_order_object& call )
+{
+   const price& p = call.call_price;
+   _calls[ std::make_pair( p.base.asset_id, p.quote.asset_id ) ].emplace( std::make_pair( call.call_price, call.id ), &call );
+}
+
+void call_order_margin_index::remove_call( const call_order_object& call, const price& call_price )
+{
+   auto calls = _calls.find( std::make_pair( call_price.base.asset_id, call_price.quote.asset_id ) );
+   assert( calls != _calls.end() );
+   if( calls == _calls.end() ) return;
+
+   calls->second.erase( std::make_pair( call_price, call.id ) );
+   if( calls->second.empty() )
+      _calls.erase( calls );
+}
+
+void call_order_margin_index::object_inserted( const object& obj )
+{
+   assert( dynamic_cast<const call_order_object*>(&obj) );
+   insert_call( static_cast<const call_order_object&>(obj) );
+}
+
+void call_order_margin_index::object_removed( const object& obj )
+{
+   assert( dynamic_cast<const call_order_object*>(&obj) );
+   const call_order_object& call = static_cast<const call_order_object&>(obj);
+   remove_call( call, call.call_price );
+}
+
+void call_order_margin_index::about_to_modify( const object& before )
+{
+   assert( dynamic_cast<const call_order_object*>(&before) );
+   _call_price_before_modify = static_cast<const call_order_object&>(before).call_price;
+}
+
+void call_order_margin_index::object_modified( const object& after )
+{
+   assert( dynamic_cast<const call_order_object*>(&after) );
+   const call_order_object& call = static_cast<const call_order_object&>(after);
+   if( same_representation( call.call_price, _call_price_before_modify ) )
+      return;
+   remove_call( call, _call_price_before_modify );
+   insert_call( call );
+}
+
+} } // graphene::chain
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/signature_key_cache.hpp>
+#include <graphene/chain/exceptions.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace graphene { namespace chain {
+
+bool signature_key_cache::signature_id::operator == ( const signature_id& other )const
+{
+   return digest == other.digest &&
+          memcmp( signature.data, other.signature.data, sizeof(signature.data) ) == 0;
+}
+
+size_t signature_key_cache::signature_id_hash::operator()( const signature_id& id )const
+{
+   // the digest is already uniformly distributed, the signature tells apart signers of the same transaction
+   size_t sig_bits;
+   memcpy( &sig_bits, id.signature.data + 1, sizeof(sig_bits) );
+   return size_t( id.digest._hash[0] ) ^ sig_bits;
+}
+
+flat_set<public_key_type> signature_key_cache::get_signature_keys( const signed_transaction& trx, const chain_id_type& chain_id )
+{ try {
+   signature_id id;
+   id.digest = trx.sig_digest( chain_id );
+   flat_set<public_key_type> result;
+   result.reserve( trx.signatures.size() );
+   for( const auto& sig : trx.signatures )
+   {
+      id.signature = sig;
+      public_key_type key;
+      if( find( id, key ) )
+         ++_hits;
+      else
+      {
+         ++_misses;
+         key = fc::ecc::public_key( sig, id.digest );
+         insert( id, key, trx.expiration );
+      }
+      GRAPHENE_ASSERT(
+         result.insert( key ).second,
+         tx_duplicate_sig,
+         "Duplicate Signature detected" );
+   }
+   return result;
+} FC_CAPTURE_AND_RETHROW() }
+
+void signature_key_cache::remove_expired( fc::time_point_sec now )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   while( !_by_expiration.empty() && _by_expiration.begin()->first < now )
+      evict_earliest();
+}
+
+void signature_key_cache::set_expiration_limit( fc::time_point_sec limit )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _expiration_limit = limit;
+}
+
+void signature_key_cache::set_max_entries( size_t max_entries )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _max_entries = max_entries;
+   while( _keys.size() > _max_entries )
+      evict_earliest();
+}
+
+void signature_key_cache::clear()
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _keys.clear();
+   _by_expiration.clear();
+}
+
+signature_cache_stats signature_key_cache::get_stats()const
+{
+   signature_cache_stats stats;
+   stats.hits = _hits;
+   stats.misses = _misses;
+   std::lock_guard<std::mutex> lock( _mutex );
+   stats.entries = _keys.size();
+   return stats;
+}
+
+bool signature_key_cache::find( const signature_id& id, public_key_type& key )const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto itr = _keys.find( id );
+   if( itr == _keys.end() )
+      return false;
+   key = itr->second.key;
+   return true;
+}
+
+void signature_key_cache::insert( const signature_id& id, const public_key_type& key, fc::time_point_sec expiration )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _max_entries == 0 )
+      return;
+   expiration = std::min( expiration, _expiration_limit );
+   // another thread may have recovered the same signature meanwhile
+   if( !_keys.emplace( id, cached_key{ key, expiration } ).second )
+      return;
+   _by_expiration.emplace( expiration, id );
+   while( _keys.size() > _max_entries )
+      evict_earliest();
+}
+
+void signature_key_cache::evict_earliest()
+{
+   auto itr = _by_expiration.begin();
+   _keys.erase( itr->second );
+   _by_expiration.erase( itr );
+}
+
+} } // graphene::chain
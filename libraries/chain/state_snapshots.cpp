@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/state_snapshots.hpp>
+#include <graphene/chain/database.hpp>
+
+namespace graphene { namespace chain {
+
+state_snapshots::state_snapshots( database& db, uint32_t thread_count )
+:_db(db),_next_thread(0)
+{ try {
+   FC_ASSERT( thread_count > 0 );
+
+   _db.enable_change_capture();
+   const graphene::db::object_change_set everything = _db.capture_all();
+   for( auto& r : _replicas )
+   {
+      r.db = std::make_shared<database>();
+      r.db->mirror_indexes( _db );
+      r.db->apply_changes( everything );
+   }
+   _current = _replicas[0].db;
+
+   _update_thread.reset( new fc::thread( "state_snapshot_update" ) );
+   for( uint32_t i = 0; i < thread_count; ++i )
+      _threads.emplace_back( new fc::thread( "state_snapshot" + fc::to_string(i) ) );
+
+   _applied_block_connection = _db.applied_block.connect( [this]( const signed_block& ) { on_applied_block(); } );
+   ilog( "Copied ${n} objects for queries on ${t} threads", ("n", everything.changes.size())("t", thread_count) );
+} FC_CAPTURE_AND_RETHROW( (thread_count) ) }
+
+state_snapshots::~state_snapshots()
+{
+   _applied_block_connection.disconnect();
+   _db.disable_change_capture();
+   wait_for_updates();
+}
+
+uint32_t state_snapshots::head_block_num()const
+{
+   return std::atomic_load( &_current )->head_block_num();
+}
+
+void state_snapshots::wait_for_updates()const
+{
+   if( _last_update.valid() && !_last_update.ready() )
+   {
+      try { _last_update.wait(); }
+      catch( const fc::exception& e ) { elog( "Updating the state snapshots failed: ${e}", ("e", e.to_detail_string()) ); }
+   }
+}
+
+void state_snapshots::on_applied_block()
+{
+   auto changes = std::make_shared<const graphene::db::object_change_set>( _db.capture_changes() );
+   // update() never yields, so the updates run one after the other in the order of the blocks
+   _last_update = _update_thread->async( [this,changes]() { update( changes ); }, "state_snapshot_update" );
+}
+
+void state_snapshots::update( const std::shared_ptr<const graphene::db::object_change_set>& changes )
+{ try {
+   for( auto& r : _replicas )
+      r.pending.push_back( changes );
+
+   // only this thread replaces _current, so the copy it does not point to can only be held by earlier queries
+   replica& standby = ( _replicas[0].db == std::atomic_load( &_current ) ) ? _replicas[1] : _replicas[0];
+   if( standby.db.use_count() > 1 )
+      return;
+
+   for( const auto& pending : standby.pending )
+      standby.db->apply_changes( *pending );
+   standby.pending.clear();
+   std::atomic_store( &_current, std::shared_ptr<const database>( standby.db ) );
+} FC_CAPTURE_AND_RETHROW() }
+
+} } // graphene::chain
@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/vote_tally.hpp>
+#include <graphene/chain/database.hpp>
+
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/block_summary_object.hpp>
+#include <graphene/chain/global_property_object.hpp>
+#include <graphene/chain/vesting_balance_object.hpp>
+
+namespace graphene { namespace chain {
+
+namespace {
+   account_id_type stake_owner( const account_object& a )            { return a.get_id(); }
+   account_id_type stake_owner( const account_statistics_object& s ) { return s.owner; }
+   account_id_type stake_owner( const account_balance_object& b )    { return b.owner; }
+   account_id_type stake_owner( const vesting_balance_object& v )    { return v.owner; }
+
+   template<typename ObjectType>
+   bool affects_stake( const ObjectType& )                  { return true; }
+   bool affects_stake( const account_balance_object& b )    { return b.asset_type == asset_id_type(); }
+
+   /** marks the account whose stake or opinions depend on the changed object */
+   template<typename ObjectType>
+   class vote_tally_observer : public index_observer
+   {
+      public:
+         explicit vote_tally_observer( vote_tally& tally ):_tally(tally){}
+
+         virtual void on_add( const object& obj )override    { changed( obj ); }
+         virtual void on_remove( const object& obj )override { changed( obj ); }
+         virtual void on_modify( const object& obj )override { changed( obj ); }
+
+      private:
+         void changed( const object& obj )
+         {
+            assert( dynamic_cast<const ObjectType*>(&obj) );
+            const ObjectType& o = static_cast<const ObjectType&>(obj);
+            if( affects_stake( o ) )
+               _tally.mark_changed( stake_owner( o ) );
+         }
+
+         vote_tally& _tally;
+   };
+
+   /** @return true if the votes of stake_account count, and its stake and the account holding its opinions if so */
+   bool voting_stake( const database& d, const account_object& stake_account,
+                      account_id_type& opinion_account, uint64_t& stake )
+   {
+      if( !d.get_global_properties().parameters.count_non_member_votes && !stake_account.is_member(d.head_block_time()) )
+         return false;
+
+      // There may be a difference between the account whose stake is voting and the one specifying opinions.
+      // Usually they're the same, but if the stake account has specified a voting_account, that account is the one
+      // specifying the opinions.
+      opinion_account = (stake_account.options.voting_account == GRAPHENE_PROXY_TO_SELF_ACCOUNT) ? stake_account.id
+                                                                                             : stake_account.options.voting_account;
+      const auto& stats = stake_account.statistics(d);
+      stake = stats.total_core_in_orders.value
+            + (stake_account.cashback_vb.valid() ? (*stake_account.cashback_vb)(d).balance.amount.value: 0)
+            + d.get_balance(stake_account.get_id(), asset_id_type()).amount.value;
+      return true;
+   }
+}
+
+void vote_tally::observe( db::index& accounts, db::index& statistics, db::index& balances, db::index& vesting_balances )
+{
+   reset();
+   accounts.add_observer( std::make_shared< vote_tally_observer<account_object> >( *this ) );
+   statistics.add_observer( std::make_shared< vote_tally_observer<account_statistics_object> >( *this ) );
+   balances.add_observer( std::make_shared< vote_tally_observer<account_balance_object> >( *this ) );
+   vesting_balances.add_observer( std::make_shared< vote_tally_observer<vesting_balance_object> >( *this ) );
+}
+
+void vote_tally::reset()
+{
+   _contributions.clear();
+   _opinions.clear();
+   _expirations.clear();
+   _votes.clear();
+   _witness_counts.clear();
+   _committee_counts.clear();
+   _total_stake = 0;
+   _changed.clear();
+   _is_changed.clear();
+   _valid = false;
+}
+
+void vote_tally::mark_changed( account_id_type account )
+{
+   const auto instance = account.instance.value;
+   if( instance >= _is_changed.size() )
+      _is_changed.resize( instance + 1 );
+   if( _is_changed[instance] )
+      return;
+   _is_changed[instance] = true;
+   _changed.push_back( account );
+}
+
+bool vote_tally::begin_maintenance( const database& d )
+{
+   // The totals are only valid on top of the state of the block whose maintenance produced them. The block
+   // summary of that block still names it unless it was popped, failed to apply or is too old to tell.
+   const uint32_t head = d.head_block_num();
+   bool valid = _valid
+             && _count_non_member_votes == d.get_global_properties().parameters.count_non_member_votes
+             && head > _block_num && head - _block_num < 0x10000;
+   if( valid )
+   {
+      const block_summary_object* summary = d.find( block_summary_id_type( _block_num & 0xffff ) );
+      valid = summary != nullptr && summary->block_id == _block_id;
+   }
+   if( !valid )
+      reset();
+   return valid;
+}
+
+void vote_tally::count_changed_accounts( const database& d, vector<const account_object*>& fee_payers )
+{
+   // annual members whose membership ran out stop voting unless non-member votes count
+   const time_point_sec now = d.head_block_time();
+   while( !_expirations.empty() && _expirations.begin()->first < now )
+   {
+      mark_changed( _expirations.begin()->second );
+      _expirations.erase( _expirations.begin() );
+   }
+
+   vector<account_id_type> changed;
+   changed.swap( _changed );
+   for( account_id_type id : changed )
+      _is_changed[id.instance.value] = false;
+
+   for( account_id_type id : changed )
+      refresh_opinion( d, id );
+   for( account_id_type id : changed )
+   {
+      const account_object& account = id(d);
+      count_account( d, account );
+      const auto& stats = account.statistics(d);
+      if( stats.pending_fees > 0 || stats.pending_vested_fees > 0 )
+         fee_payers.push_back( &account );
+   }
+}
+
+void vote_tally::count_account( const database& d, const account_object& stake_account )
+{
+   const auto instance = stake_account.id.instance();
+   if( instance >= _contributions.size() )
+      _contributions.resize( instance + 1 );
+   contribution& c = _contributions[instance];
+
+   if( c.stake > 0 )
+   {
+      auto itr = _opinions.find( c.opinion_account );
+      assert( itr != _opinions.end() );
+      subtract( itr->second, c.stake );
+      itr->second.stake -= c.stake;
+      if( itr->second.stake == 0 )
+         _opinions.erase( itr );
+      c.stake = 0;
+   }
+   if( c.membership_expiration != time_point_sec() )
+   {
+      _expirations.erase( std::make_pair( c.membership_expiration, stake_account.id ) );
+      c.membership_expiration = time_point_sec();
+   }
+
+   const time_point_sec expiration = stake_account.membership_expiration_date;
+   if( expiration >= d.head_block_time() && expiration != time_point_sec::maximum() )
+   {
+      c.membership_expiration = expiration;
+      _expirations.emplace( expiration, stake_account.id );
+   }
+
+   uint64_t stake = 0;
+   if( !voting_stake( d, stake_account, c.opinion_account, stake ) || stake == 0 )
+      return;
+
+   auto itr = _opinions.find( c.opinion_account );
+   if( itr == _opinions.end() )
+   {
+      const account_object& opinion_account = d.get( c.opinion_account );
+      opinion& o = _opinions[c.opinion_account];
+      o.votes = opinion_account.options.votes;
+      o.num_witness = opinion_account.options.num_witness;
+      o.num_committee = opinion_account.options.num_committee;
+      itr = _opinions.find( c.opinion_account );
+   }
+   c.stake = stake;
+   itr->second.stake += stake;
+   add( itr->second, stake );
+}
+
+void vote_tally::refresh_opinion( const database& d, account_id_type account )
+{
+   auto itr = _opinions.find( account );
+   if( itr == _opinions.end() )
+      return;
+   opinion& o = itr->second;
+   const account_object& opinion_account = account(d);
+   subtract( o, o.stake );
+   o.votes = opinion_account.options.votes;
+   o.num_witness = opinion_account.options.num_witness;
+   o.num_committee = opinion_account.options.num_committee;
+   add( o, o.stake );
+}
+
+void vote_tally::add( const opinion& o, uint64_t stake )
+{
+   for( vote_id_type id : o.votes )
+   {
+      const uint32_t offset = id.instance();
+      if( offset >= _votes.size() )
+         _votes.resize( offset + 1 );
+      _votes[offset] += stake;
+   }
+   _witness_counts[o.num_witness] += stake;
+   _committee_counts[o.num_committee] += stake;
+   _total_stake += stake;
+}
+
+void vote_tally::subtract( const opinion& o, uint64_t stake )
+{
+   for( vote_id_type id : o.votes )
+      _votes[id.instance()] -= stake;
+   _witness_counts[o.num_witness] -= stake;
+   _committee_counts[o.num_committee] -= stake;
+   _total_stake -= stake;
+}
+
+void vote_tally::end_maintenance( const database& d, uint32_t block_num, const block_id_type& block_id,
+                                  vector<uint64_t>& vote_tally, vector<uint64_t>& witness_count_histogram,
+                                  vector<uint64_t>& committee_count_histogram, uint64_t& total_voting_stake )
+{
+   const auto& gpo = d.get_global_properties();
+   const auto& params = gpo.parameters;
+
+   // votes for ids which do not exist (yet) are ignored
+   vote_tally.assign( gpo.next_available_vote_id, 0 );
+   std::copy( _votes.begin(), _votes.begin() + std::min( _votes.size(), vote_tally.size() ), vote_tally.begin() );
+
+   // votes for a number greater than maximum_witness_count are ignored, larger numbers up to it are
+   // turned into votes for maximum_witness_count. Same rationale as for the committee.
+   witness_count_histogram.assign( params.maximum_witness_count / 2 + 1, 0 );
+   for( const auto& item : _witness_counts )
+      if( item.first <= params.maximum_witness_count )
+         witness_count_histogram[ std::min( size_t(item.first / 2), witness_count_histogram.size() - 1 ) ] += item.second;
+
+   committee_count_histogram.assign( params.maximum_committee_count / 2 + 1, 0 );
+   for( const auto& item : _committee_counts )
+      if( item.first <= params.maximum_committee_count )
+         committee_count_histogram[ std::min( size_t(item.first / 2), committee_count_histogram.size() - 1 ) ] += item.second;
+
+   total_voting_stake = _total_stake;
+
+   _valid = true;
+   _block_num = block_num;
+   _block_id = block_id;
+   _count_non_member_votes = params.count_non_member_votes;
+}
+
+void vote_tally::verify( const database& d )const
+{
+   vector<uint64_t>             votes;
+   flat_map<uint16_t, uint64_t> witness_counts, committee_counts;
+   uint64_t                     total_stake = 0;
+
+   for( const account_object& stake_account : d.get_index_type<account_index>().indices() )
+   {
+      account_id_type opinion_id;
+      uint64_t stake = 0;
+      if( !voting_stake( d, stake_account, opinion_id, stake ) || stake == 0 )
+         continue;
+      const account_object& opinion_account = d.get( opinion_id );
+      for( vote_id_type id : opinion_account.options.votes )
+      {
+         if( id.instance() >= votes.size() )
+            votes.resize( id.instance() + 1 );
+         votes[id.instance()] += stake;
+      }
+      witness_counts[opinion_account.options.num_witness] += stake;
+      committee_counts[opinion_account.options.num_committee] += stake;
+      total_stake += stake;
+   }
+
+   auto same_votes = []( const vector<uint64_t>& a, const vector<uint64_t>& b )
+   {
+      for( size_t i = 0; i < std::max( a.size(), b.size() ); ++i )
+         if( (i < a.size() ? a[i] : 0) != (i < b.size() ? b[i] : 0) )
+            return false;
+      return true;
+   };
+   auto same_counts = []( const flat_map<uint16_t, uint64_t>& a, const flat_map<uint16_t, uint64_t>& b )
+   {
+      auto without_zeros = []( const flat_map<uint16_t, uint64_t>& m )
+      {
+         flat_map<uint16_t, uint64_t> result;
+         for( const auto& item : m )
+            if( item.second != 0 )
+               result.insert( item );
+         return result;
+      };
+      return without_zeros( a ) == without_zeros( b );
+   };
+
+   FC_ASSERT( total_stake == _total_stake, "Incremental voting stake differs from a full recount",
+              ("incremental", _total_stake)("recount", total_stake) );
+   FC_ASSERT( same_votes( votes, _votes ), "Incremental vote totals differ from a full recount" );
+   FC_ASSERT( same_counts( witness_counts, _witness_counts ), "Incremental witness count votes differ from a full recount" );
+   FC_ASSERT( same_counts( committee_counts, _committee_counts ), "Incremental committee count votes differ from a full recount" );
+}
+
+} } // graphene::chain
@@ -129,4 +129,8 @@ namespace graphene { namespace db {
          vector< T > _objects;
    };
 
+   /// growing the vector moves the objects
+   template<typename T>
+   struct stable_object_addresses< flat_index<T> > : public std::false_type {};
+
 } } // graphene::db
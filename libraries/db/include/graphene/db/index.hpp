@@ -96,6 +96,13 @@ namespace graphene { namespace db {
          virtual void open( const fc::path& db ) = 0;
          virtual void save( const fc::path& db ) = 0;
 
+         /**
+          *  Applies a record of the incremental persistence log: replaces the object with
+          *  the given id by the packed object in data, or removes it if data is empty.
+          *  Observers are not notified and no undo state is saved.
+          */
+         virtual void apply_logged_change( object_id_type id, const std::vector<char>& data ) = 0;
+
 
 
          /** @return the object with id or nullptr if not found */
@@ -132,6 +139,9 @@ namespace graphene { namespace db {
 
          virtual void               object_from_variant( const fc::variant& var, object& obj )const = 0;
          virtual void               object_default( object& obj )const = 0;
+
+         /** @return a new empty index of the same type for db, without secondary indexes or observers */
+         virtual unique_ptr<index>  create_empty( object_database& db )const = 0;
    };
 
    class secondary_index
@@ -144,13 +154,51 @@ namespace graphene { namespace db {
          virtual void object_modified( const object& after  ){};
    };
 
+   /**
+    *  Object types for which this is specialized to true_type keep only a delta of their
+    *  serialized value in the undo state when modified, rather than a complete copy. This
+    *  pays for itself on large objects which are modified often in small ways.
+    *
+    *  @see GRAPHENE_DB_DELTA_UNDO
+    */
+   template<typename ObjectType>
+   struct delta_undo : public std::false_type {};
+
+   /**
+    *  Object types for which this is specialized to true_type are also tracked in a dense
+    *  table from instance number to object, which typed lookups through object_database::get()
+    *  and find() consult without virtual dispatch. Intended for frequently read types whose
+    *  objects are rarely removed, as the table grows with the highest instance number used.
+    *
+    *  @see GRAPHENE_DB_DENSE_ID_LOOKUP
+    */
+   template<typename ObjectType>
+   struct dense_id_lookup : public std::false_type {};
+
+   /**
+    *  Whether an index keeps each object at the same address until it is removed, which
+    *  dense_id_lookup relies on.
+    */
+   template<typename IndexType>
+   struct stable_object_addresses : public std::true_type {};
+
    /**
     *   Defines the common implementation
     */
    class base_primary_index
    {
       public:
-         base_primary_index( object_database& db ):_db(db){}
+         base_primary_index( object_database& db, bool delta_undo = false, bool dense_lookup = false )
+         :_db(db),_delta_undo(delta_undo),_dense_lookup(dense_lookup){}
+
+         /** @return true if objects of this index are tracked by instance number */
+         bool          dense_lookup()const { return _dense_lookup; }
+
+         /** @return the object with the given instance number or nullptr, only valid if dense_lookup() */
+         const object* find_instance( uint64_t instance )const
+         {
+            return instance < _objects_by_instance.size() ? _objects_by_instance[instance] : nullptr;
+         }
 
          /** called just before obj is modified */
          void save_undo( const object& obj );
@@ -164,6 +212,9 @@ namespace graphene { namespace db {
          /** called just after obj is modified */
          void on_modify( const object& obj );
 
+         /** called just after a previously removed object is inserted again by undo */
+         void on_insert( const object& obj );
+
          template<typename T>
          void add_secondary_index()
          {
@@ -182,11 +233,28 @@ namespace graphene { namespace db {
          }
 
       protected:
+         void track_instance( const object& obj )
+         {
+            if( !_dense_lookup ) return;
+            const auto instance = obj.id.instance();
+            if( instance >= _objects_by_instance.size() )
+               _objects_by_instance.resize( instance + 1, nullptr );
+            _objects_by_instance[instance] = &obj;
+         }
+         void untrack_instance( const object& obj )
+         {
+            if( _dense_lookup && obj.id.instance() < _objects_by_instance.size() )
+               _objects_by_instance[obj.id.instance()] = nullptr;
+         }
+
          vector< shared_ptr<index_observer> >   _observers;
          vector< unique_ptr<secondary_index> >  _sindex;
 
       private:
-         object_database& _db;
+         object_database&       _db;
+         bool                   _delta_undo = false;
+         bool                   _dense_lookup = false;
+         vector<const object*>  _objects_by_instance;
    };
 
 
@@ -204,7 +272,12 @@ namespace graphene { namespace db {
          typedef typename DerivedIndex::object_type object_type;
 
          primary_index( object_database& db )
-         :base_primary_index(db),_next_id(object_type::space_id,object_type::type_id,0) {}
+         :base_primary_index(db,delta_undo<object_type>::value,dense_id_lookup<object_type>::value),
+          _next_id(object_type::space_id,object_type::type_id,0)
+         {
+            static_assert( !dense_id_lookup<object_type>::value || stable_object_addresses<DerivedIndex>::value,
+                           "dense_id_lookup requires an index which does not move its objects" );
+         }
 
          virtual uint8_t object_space_id()const override
          { return object_type::space_id; }
@@ -261,8 +334,33 @@ namespace graphene { namespace db {
          virtual const object&  load( const std::vector<char>& data )override
          {
             const auto& result = DerivedIndex::insert( fc::raw::unpack<object_type>( data ) );
+            track_instance( result );
+            for( const auto& item : _sindex )
+               item->object_inserted( result );
+            return result;
+         }
+
+         virtual void apply_logged_change( object_id_type id, const std::vector<char>& data )override
+         {
+            const object* existing = DerivedIndex::find( id );
+            if( existing != nullptr )
+            {
+               for( const auto& item : _sindex )
+                  item->object_removed( *existing );
+               untrack_instance( *existing );
+               DerivedIndex::remove( *existing );
+            }
+            if( !data.empty() )
+               load( data );
+         }
+
+         virtual const object& insert( object&& obj )override
+         {
+            const auto& result = DerivedIndex::insert( std::move(obj) );
+            track_instance( result );
             for( const auto& item : _sindex )
                item->object_inserted( result );
+            on_insert( result );
             return result;
          }
 
@@ -270,6 +368,7 @@ namespace graphene { namespace db {
          virtual const object&  create(const std::function<void(object&)>& constructor )override
          {
             const auto& result = DerivedIndex::create( constructor );
+            track_instance( result );
             for( const auto& item : _sindex )
                item->object_inserted( result );
             on_add( result );
@@ -281,6 +380,7 @@ namespace graphene { namespace db {
             for( const auto& item : _sindex )
                item->object_removed( obj );
             on_remove(obj);
+            untrack_instance(obj);
             DerivedIndex::remove(obj);
          }
 
@@ -300,6 +400,11 @@ namespace graphene { namespace db {
             _observers.emplace_back( o );
          }
 
+         virtual unique_ptr<index> create_empty( object_database& db )const override
+         {
+            return unique_ptr<index>( new primary_index( db ) );
+         }
+
          virtual void object_from_variant( const fc::variant& var, object& obj )const override
          {
             object_id_type id = obj.id;
@@ -323,3 +428,17 @@ namespace graphene { namespace db {
    };
 
 } } // graphene::db
+
+/**
+ *  Registers TYPE to keep deltas instead of complete copies in the undo state, must be used at
+ *  global scope before any primary_index of TYPE is instantiated.
+ */
+#define GRAPHENE_DB_DELTA_UNDO( TYPE ) \
+   namespace graphene { namespace db { template<> struct delta_undo< TYPE > : public std::true_type {}; } }
+
+/**
+ *  Registers TYPE for dense_id_lookup, must be used at global scope before any primary_index
+ *  of TYPE is instantiated.
+ */
+#define GRAPHENE_DB_DENSE_ID_LOOKUP( TYPE ) \
+   namespace graphene { namespace db { template<> struct dense_id_lookup< TYPE > : public std::true_type {}; } }
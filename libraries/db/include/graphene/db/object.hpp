@@ -27,6 +27,8 @@
 #include <fc/crypto/city.hpp>
 #include <fc/uint128.hpp>
 
+#include <new>
+
 namespace graphene { namespace db {
 
    /**
@@ -72,9 +74,14 @@ namespace graphene { namespace db {
 
          /// these methods are implemented for derived classes by inheriting abstract_object<DerivedClass>
          virtual unique_ptr<object> clone()const = 0;
+         /// copy constructs this object in storage, which must be at least object_size() bytes and max aligned
+         virtual object*            clone_into( void* storage )const = 0;
+         virtual size_t             object_size()const = 0;
          virtual void               move_from( object& obj ) = 0;
          virtual variant            to_variant()const  = 0;
          virtual vector<char>       pack()const = 0;
+         /// replaces the value of this object with one previously produced by pack()
+         virtual void               unpack_from( const vector<char>& data ) = 0;
          virtual fc::uint128        hash()const = 0;
    };
 
@@ -94,12 +101,28 @@ namespace graphene { namespace db {
             return unique_ptr<object>(new DerivedClass( *static_cast<const DerivedClass*>(this) ));
          }
 
+         virtual object* clone_into( void* storage )const
+         {
+            return new (storage) DerivedClass( *static_cast<const DerivedClass*>(this) );
+         }
+         virtual size_t  object_size()const { return sizeof(DerivedClass); }
+
          virtual void    move_from( object& obj )
          {
             static_cast<DerivedClass&>(*this) = std::move( static_cast<DerivedClass&>(obj) );
          }
          virtual variant to_variant()const { return variant( static_cast<const DerivedClass&>(*this) ); }
          virtual vector<char> pack()const  { return fc::raw::pack( static_cast<const DerivedClass&>(*this) ); }
+         virtual void unpack_from( const vector<char>& data )
+         {
+            // unpack into a fresh object: unpacking in place would leave fields that are absent
+            // from the data, such as an optional with its flag cleared, at their current value
+            DerivedClass tmp;
+            fc::datastream<const char*> ds( data.data(), data.size() );
+            fc::raw::unpack( ds, tmp );
+            tmp.id = this->id;
+            static_cast<DerivedClass&>(*this) = std::move( tmp );
+         }
          virtual fc::uint128  hash()const  {  
              auto tmp = this->pack();
              return fc::city_hash_crc_128( tmp.data(), tmp.size() );
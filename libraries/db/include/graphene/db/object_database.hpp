@@ -27,11 +27,31 @@
 #include <graphene/db/undo_database.hpp>
 
 #include <fc/log/logger.hpp>
+#include <fc/thread/thread.hpp>
 
+#include <array>
 #include <map>
+#include <unordered_set>
 
 namespace graphene { namespace db {
 
+   /** the packed value of an object, without data if the object was removed */
+   struct object_change
+   {
+      object_id_type id;
+      vector<char>   data;
+   };
+
+   /**
+    *  Changed objects along with the next id of every index at the time they were packed. Segments of the
+    *  incremental persistence log hold one of these.
+    */
+   struct object_change_set
+   {
+      vector<object_id_type> next_ids;
+      vector<object_change>  changes;
+   };
+
    /**
     *   @class object_database
     *   @brief maintains a set of indexed objects that can be modified with multi-level rollback support
@@ -42,17 +62,58 @@ namespace graphene { namespace db {
          object_database();
          ~object_database();
 
-         void reset_indexes() { _index.clear(); _index.resize(255); }
+         void reset_indexes()
+         {
+            _index.clear(); _index.resize(255);
+            for( auto& space : _dense_indexes ) space.clear();
+         }
 
          void open(const fc::path& data_dir );
 
          /**
-          * Saves the complete state of the object_database to disk, this could take a while
+          * Saves the state of the object_database to disk.  If incremental persistence is enabled
+          * only the objects changed since the last flush are appended to the change log, otherwise
+          * this writes a full checkpoint.
           */
          void flush();
+
+         /**
+          * Saves the complete state of the object_database to disk and discards the change log,
+          * this could take a while
+          */
+         void checkpoint();
          void wipe(const fc::path& data_dir); // remove from disk
          void close();
 
+         /**
+          * @brief Persist only changed objects on flush()
+          *
+          * Changes are tracked through the primary index hooks and appended to a new log segment
+          * in object_database/log on every flush().  Once more than compact_after_segments segments
+          * exist they are merged into one in the background.  Once the log takes more than
+          * checkpoint_after_bytes on disk, flush() writes a checkpoint instead, which discards the log;
+          * 0 never does.  open() replays the log on top of the last checkpoint.
+          */
+         void enable_incremental_persistence( uint32_t compact_after_segments = 16, uint64_t checkpoint_after_bytes = 0 );
+         bool incremental_persistence_enabled()const { return _track_changes; }
+
+         /**
+          * @brief Track changed objects for capture_changes()
+          *
+          * Together with capture_all() and apply_changes() this keeps copies of the objects in other
+          * object_databases up to date, independent of incremental persistence.
+          */
+         void enable_change_capture();
+         void disable_change_capture();
+         /** @return every object created, modified or removed since the previous call */
+         object_change_set capture_changes();
+         /** @return every object */
+         object_change_set capture_all()const;
+         /** replays changes captured from an object_database with the same indexes, bypassing undo */
+         void apply_changes( const object_change_set& changes );
+         /** adds an empty index of the same type for every index of other which this object_database lacks */
+         void mirror_indexes( const object_database& other );
+
          template<typename T, typename F>
          const T& create( F&& constructor )
          {
@@ -75,6 +136,8 @@ namespace graphene { namespace db {
          const index&  get_index()const { return get_index(T::space_id,T::type_id); }
          const index&  get_index(uint8_t space_id, uint8_t type_id)const;
          const index&  get_index(object_id_type id)const { return get_index(id.space(),id.type()); }
+         /// calls inspector with every index, ordered by space and type
+         void          inspect_all_indexes( const std::function<void(const index&)>& inspector )const;
          /// @}
 
          const object& get_object( object_id_type id )const;
@@ -121,11 +184,25 @@ namespace graphene { namespace db {
             return static_cast<const T*>(obj);
          }
 
+         /// typed lookups of dense_id_lookup types bypass get_index() and the virtual index::find()
          template<uint8_t SpaceID, uint8_t TypeID, typename T>
-         const T* find( object_id<SpaceID,TypeID,T> id )const { return find<T>(id); }
+         const T* find( object_id<SpaceID,TypeID,T> id )const
+         {
+            if( dense_id_lookup<T>::value )
+               if( const base_primary_index* idx = dense_index( SpaceID, TypeID ) )
+                  return static_cast<const T*>( idx->find_instance( id.instance.value ) );
+            return find<T>(id);
+         }
 
          template<uint8_t SpaceID, uint8_t TypeID, typename T>
-         const T& get( object_id<SpaceID,TypeID,T> id )const { return get<T>(id); }
+         const T& get( object_id<SpaceID,TypeID,T> id )const
+         {
+            if( dense_id_lookup<T>::value )
+               if( const base_primary_index* idx = dense_index( SpaceID, TypeID ) )
+                  if( const object* obj = idx->find_instance( id.instance.value ) )
+                     return static_cast<const T&>( *obj );
+            return get<T>(id);
+         }
 
          template<typename IndexType>
          IndexType* add_index()
@@ -136,7 +213,16 @@ namespace graphene { namespace db {
             assert(!_index[ObjectType::space_id][ObjectType::type_id]);
             unique_ptr<index> indexptr( new IndexType(*this) );
             _index[ObjectType::space_id][ObjectType::type_id] = std::move(indexptr);
-            return static_cast<IndexType*>(_index[ObjectType::space_id][ObjectType::type_id].get());
+            IndexType* result = static_cast<IndexType*>(_index[ObjectType::space_id][ObjectType::type_id].get());
+            const base_primary_index* primary = as_primary_index( result );
+            if( primary != nullptr && primary->dense_lookup() )
+            {
+               auto& space = _dense_indexes[ObjectType::space_id];
+               if( space.size() <= ObjectType::type_id )
+                  space.resize( ObjectType::type_id + 1, nullptr );
+               space[ObjectType::type_id] = primary;
+            }
+            return result;
          }
 
          void pop_undo();
@@ -161,13 +247,51 @@ namespace graphene { namespace db {
          friend class base_primary_index;
          friend class undo_database;
          void save_undo( const object& obj );
+         void save_undo_delta( const object& obj ) { _undo_db.on_modify_delta( obj ); }
+         void finish_undo_delta( const object& obj ) { _undo_db.on_modified_delta( obj ); }
          void save_undo_add( const object& obj );
          void save_undo_remove( const object& obj );
+         void mark_changed( object_id_type id )
+         {
+            if( _track_changes ) _changed_ids.insert( id );
+            if( _capture_changes ) _captured_ids.insert( id );
+         }
+         object_change_set pack_changes( const std::unordered_set<object_id_type>& ids )const;
+
+         fc::path log_dir()const { return _data_dir / "object_database" / "log"; }
+         vector<uint32_t> log_segments()const;
+         /** @return the bytes taken by the log segments on disk */
+         uint64_t log_size()const;
+         void replay_log();
+         void save_changes();
+         void compact_log( vector<uint32_t> segments );
+         void wait_for_compaction();
+
+         static const base_primary_index* as_primary_index( const base_primary_index* idx ) { return idx; }
+         static const base_primary_index* as_primary_index( const void* )                   { return nullptr; }
+
+         const base_primary_index* dense_index( uint8_t space_id, uint8_t type_id )const
+         {
+            const auto& space = _dense_indexes[space_id];
+            return type_id < space.size() ? space[type_id] : nullptr;
+         }
 
          fc::path                                                  _data_dir;
          vector< vector< unique_ptr<index> > >                     _index;
+         /// the indexes of dense_id_lookup types, by space and type
+         std::array< vector<const base_primary_index*>, 256 >      _dense_indexes;
+
+         bool                                                      _track_changes = false;
+         uint32_t                                                  _compact_after_segments = 16;
+         uint64_t                                                  _checkpoint_after_bytes = 0;
+         std::unordered_set<object_id_type>                        _changed_ids;
+         bool                                                      _capture_changes = false;
+         std::unordered_set<object_id_type>                        _captured_ids;
+         std::unique_ptr<fc::thread>                               _compaction_thread;
+         fc::future<void>                                          _compaction;
    };
 
 } } // graphene::db
 
-
+FC_REFLECT( graphene::db::object_change, (id)(data) )
+FC_REFLECT( graphene::db::object_change_set, (next_ids)(changes) )
@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/db/index.hpp>
+
+#include <bitset>
+#include <type_traits>
+
+namespace graphene { namespace db {
+
+   /**
+    *  @class slab_index
+    *  @brief A slab index stores objects in place in fixed size chunks addressed by instance number
+    *
+    *  Each chunk holds 2^ChunkBits consecutive instances, so objects created one after another
+    *  are adjacent in memory and iterating the index walks memory in order. Removing an object
+    *  only leaves a tombstone in its slot; once every slot of a chunk is dead the chunk is put on
+    *  a free-list and reused for the next chunk that is needed.
+    *
+    *  This index is preferred over simple_index for objects which are mostly appended, looked
+    *  up by ID and scanned in bulk. Objects never move once created.
+    */
+   template<typename T, uint32_t ChunkBits = 10>
+   class slab_index : public index
+   {
+      public:
+         typedef T object_type;
+
+         static const uint32_t chunk_size = 1u << ChunkBits;
+
+         slab_index(){}
+         slab_index( const slab_index& ) = delete;
+         slab_index& operator=( const slab_index& ) = delete;
+
+         ~slab_index()
+         {
+            for( auto& c : _chunks )
+               if( c ) c->clear();
+         }
+
+         virtual const object&  create( const std::function<void(object&)>& constructor ) override
+         {
+             auto id = get_next_id();
+             T* obj = new (slot_for( id.instance() )) T();
+             try {
+                obj->id = id;
+                constructor( *obj );
+                obj->id = id; // just in case it changed
+             } catch( ... ) {
+                obj->~T();
+                release_if_empty( id.instance() >> ChunkBits );
+                throw;
+             }
+             mark_live( id.instance() );
+             use_next_id();
+             return *obj;
+         }
+
+         virtual void modify( const object& obj, const std::function<void(object&)>& modify_callback ) override
+         {
+            assert( find( obj.id ) == &obj );
+            modify_callback( const_cast<object&>(obj) );
+         }
+
+         virtual const object& insert( object&& obj )override
+         {
+            assert( nullptr != dynamic_cast<T*>(&obj) );
+            const auto instance = obj.id.instance();
+            FC_ASSERT( find( obj.id ) == nullptr, "Could not insert object, instance is already in use" );
+            T* result = new (slot_for( instance )) T( std::move( static_cast<T&>(obj) ) );
+            mark_live( instance );
+            return *result;
+         }
+
+         virtual void remove( const object& obj ) override
+         {
+            assert( nullptr != dynamic_cast<const T*>(&obj) );
+            const auto instance = obj.id.instance();
+            chunk& c = *_chunks[instance >> ChunkBits];
+            const uint32_t slot = instance & (chunk_size - 1);
+            assert( c.live[slot] );
+            c.at(slot)->~T();
+            c.live.reset(slot);
+            --c.live_count;
+            --_size;
+            release_if_empty( instance >> ChunkBits );
+         }
+
+         virtual const object* find( object_id_type id )const override
+         {
+            assert( id.space() == T::space_id );
+            assert( id.type() == T::type_id );
+
+            const auto instance = id.instance();
+            const auto chunk_num = instance >> ChunkBits;
+            if( chunk_num >= _chunks.size() || !_chunks[chunk_num] ) return nullptr;
+            const chunk& c = *_chunks[chunk_num];
+            const uint32_t slot = instance & (chunk_size - 1);
+            return c.live[slot] ? c.at(slot) : nullptr;
+         }
+
+         virtual void inspect_all_objects(std::function<void (const object&)> inspector)const override
+         {
+            try {
+               for( const T& obj : *this )
+                  inspector(obj);
+            } FC_CAPTURE_AND_RETHROW()
+         }
+
+         virtual fc::uint128 hash()const override {
+            fc::uint128 result;
+            for( const T& obj : *this )
+               result += obj.hash();
+
+            return result;
+         }
+
+      private:
+         struct chunk
+         {
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type  slots[chunk_size];
+            std::bitset<chunk_size>                                      live;
+            uint32_t                                                     live_count = 0;
+
+            T*       at( uint32_t slot )      { return reinterpret_cast<T*>( &slots[slot] ); }
+            const T* at( uint32_t slot )const { return reinterpret_cast<const T*>( &slots[slot] ); }
+
+            /** destroys every live object in the chunk */
+            void clear()
+            {
+               for( uint32_t slot = 0; live_count > 0 && slot < chunk_size; ++slot )
+                  if( live[slot] )
+                  {
+                     at(slot)->~T();
+                     live.reset(slot);
+                     --live_count;
+                  }
+            }
+         };
+
+      public:
+         /** iterates over the live objects in instance order */
+         class const_iterator
+         {
+            public:
+               const_iterator( const vector<unique_ptr<chunk>>& chunks, uint64_t instance )
+               :_chunks(&chunks),_instance(instance) { skip_dead(); }
+
+               friend bool operator==( const const_iterator& a, const const_iterator& b ) { return a._instance == b._instance; }
+               friend bool operator!=( const const_iterator& a, const const_iterator& b ) { return a._instance != b._instance; }
+               const T& operator*()const  { return *(*_chunks)[_instance >> ChunkBits]->at( _instance & (chunk_size - 1) ); }
+               const T* operator->()const { return &**this; }
+               const_iterator operator++(int)     // postfix
+               {
+                  const_iterator result( *this );
+                  ++(*this);
+                  return result;
+               }
+               const_iterator& operator++()       // prefix
+               {
+                  ++_instance;
+                  skip_dead();
+                  return *this;
+               }
+               typedef std::forward_iterator_tag iterator_category;
+               typedef T                         value_type;
+               typedef std::ptrdiff_t            difference_type;
+               typedef const T*                  pointer;
+               typedef const T&                  reference;
+            private:
+               void skip_dead()
+               {
+                  const uint64_t end = uint64_t(_chunks->size()) << ChunkBits;
+                  while( _instance < end )
+                  {
+                     const auto& c = (*_chunks)[_instance >> ChunkBits];
+                     if( !c || c->live_count == 0 )
+                     {
+                        // skip the whole chunk
+                        _instance = ((_instance >> ChunkBits) + 1) << ChunkBits;
+                        continue;
+                     }
+                     if( c->live[_instance & (chunk_size - 1)] )
+                        return;
+                     ++_instance;
+                  }
+                  _instance = end;
+               }
+
+               const vector<unique_ptr<chunk>>* _chunks;
+               uint64_t                         _instance;
+         };
+         const_iterator begin()const { return const_iterator( _chunks, 0 ); }
+         const_iterator end()const   { return const_iterator( _chunks, uint64_t(_chunks.size()) << ChunkBits ); }
+
+         /** @return the number of live objects */
+         size_t size()const { return _size; }
+
+         /** @return the number of chunks currently holding objects */
+         size_t chunk_count()const
+         {
+            size_t result = 0;
+            for( const auto& c : _chunks )
+               if( c ) ++result;
+            return result;
+         }
+
+      private:
+         /** @return raw storage for instance, allocating or reusing a chunk if necessary */
+         void* slot_for( uint64_t instance )
+         {
+            const auto chunk_num = instance >> ChunkBits;
+            if( chunk_num >= _chunks.size() ) _chunks.resize( chunk_num + 1 );
+            auto& c = _chunks[chunk_num];
+            if( !c )
+            {
+               if( _free_chunks.size() )
+               {
+                  c = std::move( _free_chunks.back() );
+                  _free_chunks.pop_back();
+               }
+               else
+                  c.reset( new chunk );
+            }
+            assert( !c->live[instance & (chunk_size - 1)] );
+            return c->at( instance & (chunk_size - 1) );
+         }
+
+         void mark_live( uint64_t instance )
+         {
+            chunk& c = *_chunks[instance >> ChunkBits];
+            c.live.set( instance & (chunk_size - 1) );
+            ++c.live_count;
+            ++_size;
+         }
+
+         /** moves the chunk to the free-list once it holds no live objects */
+         void release_if_empty( uint64_t chunk_num )
+         {
+            auto& c = _chunks[chunk_num];
+            if( !c || c->live_count > 0 ) return;
+            if( _free_chunks.size() < max_free_chunks )
+               _free_chunks.emplace_back( std::move(c) );
+            else
+               c.reset();
+            while( _chunks.size() && !_chunks.back() )
+               _chunks.pop_back();
+         }
+
+         static const size_t max_free_chunks = 4;
+
+         vector< unique_ptr<chunk> >  _chunks;
+         vector< unique_ptr<chunk> >  _free_chunks;
+         size_t                       _size = 0;
+   };
+
+} } // graphene::db
@@ -24,20 +24,82 @@
 #pragma once
 #include <graphene/db/object.hpp>
 #include <deque>
+#include <memory>
+#include <fc/container/flat.hpp>
+#include <fc/optional.hpp>
 #include <fc/exception/exception.hpp>
 
 namespace graphene { namespace db {
 
    using std::unordered_map;
    using fc::flat_set;
+   using fc::flat_map;
    class object_database;
 
+   /**
+    * @class undo_arena
+    * @brief bump allocator holding the objects saved by a single undo_state
+    *
+    * Memory is handed out from chunks that are only released together when the
+    * arena is destroyed, so dropping an undo state is a single bulk free instead
+    * of one free per saved object.  Objects placed in the arena are owned by an
+    * undo_ptr which runs their destructor but never frees their memory.
+    */
+   class undo_arena
+   {
+      public:
+         undo_arena() = default;
+         undo_arena( undo_arena&& ) = default;
+         undo_arena& operator=( undo_arena&& ) = default;
+
+         void* allocate( size_t size );
+
+      private:
+         static const size_t first_chunk_size = 4 * 1024;
+         static const size_t max_chunk_size   = 64 * 1024;
+
+         vector< std::unique_ptr<char[]> > _chunks;
+         char*                             _next = nullptr;
+         size_t                            _remaining = 0;
+         size_t                            _chunk_size = first_chunk_size;
+   };
+
+   struct undo_object_deleter
+   {
+      void operator()( object* obj )const { obj->~object(); }
+   };
+   typedef std::unique_ptr<object, undo_object_deleter> undo_ptr;
+
+   /**
+    *  Recovers the serialized value an object had at the start of an undo state from its
+    *  serialized value at the end of that state. Only the byte ranges which differ are kept,
+    *  unless the serialized size changed in which case the entire earlier value is kept.
+    */
+   struct object_delta
+   {
+      static object_delta diff( const vector<char>& later, const vector<char>& earlier );
+      static object_delta full( vector<char> earlier );
+
+      vector<char> apply( const vector<char>& later )const;
+      bool         is_full()const { return full_value.valid(); }
+
+      fc::optional< vector<char> >              full_value;
+      vector< std::pair<uint32_t,uint32_t> >    ranges; ///< offset and length of each range in bytes
+      vector<char>                              bytes;  ///< earlier contents of all ranges, in order
+   };
+
    struct undo_state
    {
-      unordered_map<object_id_type, unique_ptr<object> > old_values;
-      unordered_map<object_id_type, object_id_type>      old_index_next_ids;
-      std::unordered_set<object_id_type>                 new_ids;
-      unordered_map<object_id_type, unique_ptr<object> > removed;
+      /** copies obj into the arena of this state */
+      undo_ptr save( const object& obj ) { return undo_ptr( obj.clone_into( arena.allocate( obj.object_size() ) ) ); }
+
+      // the arena must be declared first so it outlives the objects it holds
+      undo_arena                                 arena;
+      flat_map<object_id_type, undo_ptr>         old_values;
+      flat_map<object_id_type, object_delta>     old_deltas; ///< old values of indexes using delta undo
+      flat_map<object_id_type, object_id_type>   old_index_next_ids;
+      flat_set<object_id_type>                   new_ids;
+      flat_map<object_id_type, undo_ptr>         removed;
    };
 
 
@@ -108,6 +170,21 @@ namespace graphene { namespace db {
           * be removed if we undo.
           */
          void on_modify( const object& obj );
+         /**
+          * Used in place of on_modify() for objects whose index keeps undo state as deltas. The full
+          * value is recorded first so the state stays correct if the modification throws, and is
+          * reduced to a delta by on_modified_delta() once the modification has completed.
+          */
+         void on_modify_delta( const object& obj );
+         /**
+          * This should be called just after an object stored by delta has been modified.
+          */
+         void on_modified_delta( const object& obj );
+         /**
+          * Forgets the packed value kept from the last modification by delta, must be called when objects
+          * are replaced without passing through on_modify_delta() or on_remove().
+          */
+         void discard_packed_value() { _packed_value.clear(); }
          /**
           * This should be called just before an object is removed.
           *
@@ -136,12 +213,18 @@ namespace graphene { namespace db {
          void undo();
          void merge();
          void commit();
+         void restore_deltas( const undo_state& state );
+         vector<char> take_packed_value( const object& obj );
+         const vector<char>& packed_value( const object& obj, vector<char>& storage )const;
 
          uint32_t                _active_sessions = 0;
          bool                    _disabled = true;
          std::deque<undo_state>  _stack;
          object_database&        _db;
          size_t                  _max_size = 256;
+         /** packed value of the object most recently modified by delta, reused by its next modify, merge or undo */
+         object_id_type          _packed_id;
+         vector<char>            _packed_value;
    };
 
 } } // graphene::db
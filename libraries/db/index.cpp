@@ -27,17 +27,35 @@
 
 namespace graphene { namespace db {
    void base_primary_index::save_undo( const object& obj )
-   { _db.save_undo( obj ); }
+   {
+      if( _delta_undo ) _db.save_undo_delta( obj );
+      else _db.save_undo( obj );
+   }
 
    void base_primary_index::on_add( const object& obj )
    {
       _db.save_undo_add( obj );
+      _db.mark_changed( obj.id );
       for( auto ob : _observers ) ob->on_add( obj );
    }
 
    void base_primary_index::on_remove( const object& obj )
-   { _db.save_undo_remove( obj ); for( auto ob : _observers ) ob->on_remove( obj ); }
+   {
+      _db.save_undo_remove( obj );
+      _db.mark_changed( obj.id );
+      for( auto ob : _observers ) ob->on_remove( obj );
+   }
 
    void base_primary_index::on_modify( const object& obj )
-   {for( auto ob : _observers ) ob->on_modify(  obj ); }
+   {
+      if( _delta_undo ) _db.finish_undo_delta( obj );
+      _db.mark_changed( obj.id );
+      for( auto ob : _observers ) ob->on_modify(  obj );
+   }
+
+   void base_primary_index::on_insert( const object& obj )
+   {
+      _db.mark_changed( obj.id );
+      for( auto ob : _observers ) ob->on_add( obj );
+   }
 } } // graphene::chain
@@ -23,12 +23,47 @@
  */
 #include <graphene/db/object_database.hpp>
 
+#include <fc/io/fstream.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/string.hpp>
 #include <fc/container/flat.hpp>
 #include <fc/uint128.hpp>
 
+#include <fstream>
+
 namespace graphene { namespace db {
 
+namespace detail {
+
+   static fc::path segment_path( const fc::path& dir, uint32_t seq )
+   {
+      return dir / ( fc::to_string( seq ) + ".log" );
+   }
+
+   static object_change_set read_segment( const fc::path& file )
+   {
+      std::string contents;
+      fc::read_file_contents( file, contents );
+      return fc::raw::unpack<object_change_set>( vector<char>( contents.begin(), contents.end() ) );
+   }
+
+   static void write_segment( const fc::path& file, const object_change_set& seg )
+   {
+      // write to a temporary file first so a crash never leaves a truncated segment behind
+      fc::path tmp( file.generic_string() + ".tmp" );
+      {
+         std::ofstream out( tmp.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+         FC_ASSERT( out, "Unable to write ${f}", ("f",tmp) );
+         auto packed = fc::raw::pack( seg );
+         out.write( packed.data(), packed.size() );
+         out.flush();
+         FC_ASSERT( out, "Unable to write ${f}", ("f",tmp) );
+      }
+      fc::rename( tmp, file );
+   }
+
+} // detail
+
 object_database::object_database()
 :_undo_db(*this)
 {
@@ -36,10 +71,14 @@ object_database::object_database()
    _undo_db.enable();
 }
 
-object_database::~object_database(){}
+object_database::~object_database()
+{
+   wait_for_compaction();
+}
 
 void object_database::close()
 {
+   wait_for_compaction();
 }
 
 const object* object_database::find_object( object_id_type id )const
@@ -59,6 +98,13 @@ const index& object_database::get_index(uint8_t space_id, uint8_t type_id)const
    FC_ASSERT( tmp );
    return *tmp;
 }
+void object_database::inspect_all_indexes( const std::function<void(const index&)>& inspector )const
+{
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx ) inspector( *idx );
+}
+
 index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
 {
    FC_ASSERT( _index.size() > space_id, "", ("space_id",space_id)("type_id",type_id)("index.size",_index.size()) );
@@ -69,6 +115,14 @@ index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
 }
 
 void object_database::flush()
+{
+   if( _track_changes )
+      save_changes();
+   else
+      checkpoint();
+}
+
+void object_database::checkpoint()
 {
 //   ilog("Save object_database in ${d}", ("d", _data_dir));
    for( uint32_t space = 0; space < _index.size(); ++space )
@@ -79,8 +133,203 @@ void object_database::flush()
          if( _index[space][type] )
             _index[space][type]->save( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
    }
+
+   // everything in the log is contained in the checkpoint now
+   wait_for_compaction();
+   fc::remove_all( log_dir() );
+   _changed_ids.clear();
+}
+
+void object_database::enable_incremental_persistence( uint32_t compact_after_segments, uint64_t checkpoint_after_bytes )
+{
+   FC_ASSERT( compact_after_segments > 1 );
+   _track_changes = true;
+   _compact_after_segments = compact_after_segments;
+   _checkpoint_after_bytes = checkpoint_after_bytes;
+}
+
+vector<uint32_t> object_database::log_segments()const
+{
+   vector<uint32_t> result;
+   if( !fc::exists( log_dir() ) )
+      return result;
+   for( fc::directory_iterator itr( log_dir() ); itr != fc::directory_iterator(); ++itr )
+   {
+      const fc::path file = *itr;
+      if( file.extension().string() != ".log" )
+         continue;
+      result.push_back( fc::to_uint64( file.stem().string() ) );
+   }
+   std::sort( result.begin(), result.end() );
+   return result;
+}
+
+uint64_t object_database::log_size()const
+{
+   uint64_t result = 0;
+   for( uint32_t seq : log_segments() )
+      result += fc::file_size( detail::segment_path( log_dir(), seq ) );
+   return result;
+}
+
+void object_database::save_changes()
+{ try {
+   if( _changed_ids.empty() )
+      return;
+
+   object_change_set seg = pack_changes( _changed_ids );
+
+   fc::create_directories( log_dir() );
+   auto segments = log_segments();
+   uint32_t seq = segments.empty() ? 1 : segments.back() + 1;
+   detail::write_segment( detail::segment_path( log_dir(), seq ), seg );
+   _changed_ids.clear();
+   segments.push_back( seq );
+
+   // once the changed objects take this much space, a checkpoint is cheaper to open than the log; the size is
+   // only looked at between compactions, which remove segments
+   const bool compacting = _compaction.valid() && !_compaction.ready();
+   if( _checkpoint_after_bytes > 0 && !compacting && log_size() > _checkpoint_after_bytes )
+   {
+      ilog( "Object database log exceeds ${n} bytes, writing a checkpoint", ("n", _checkpoint_after_bytes) );
+      checkpoint();
+      return;
+   }
+
+   if( segments.size() > _compact_after_segments && !compacting )
+   {
+      if( !_compaction_thread )
+         _compaction_thread.reset( new fc::thread( "object_log_compaction" ) );
+      _compaction = _compaction_thread->async( [this,segments]() { compact_log( segments ); }, "compact_log" );
+   }
+} FC_CAPTURE_AND_RETHROW() }
+
+object_change_set object_database::pack_changes( const std::unordered_set<object_id_type>& ids )const
+{
+   object_change_set result;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            result.next_ids.push_back( idx->get_next_id() );
+
+   result.changes.reserve( ids.size() );
+   for( const auto& id : ids )
+   {
+      const object* obj = find_object( id );
+      result.changes.push_back( { id, obj ? obj->pack() : vector<char>() } );
+   }
+   return result;
+}
+
+void object_database::enable_change_capture()
+{
+   _capture_changes = true;
+   _captured_ids.clear();
+}
+
+void object_database::disable_change_capture()
+{
+   _capture_changes = false;
+   _captured_ids.clear();
+}
+
+object_change_set object_database::capture_changes()
+{
+   FC_ASSERT( _capture_changes );
+   object_change_set result = pack_changes( _captured_ids );
+   _captured_ids.clear();
+   return result;
+}
+
+object_change_set object_database::capture_all()const
+{
+   object_change_set result = pack_changes( {} );
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            idx->inspect_all_objects( [&]( const object& obj ) {
+               result.changes.push_back( { obj.id, obj.pack() } );
+            });
+   return result;
+}
+
+void object_database::apply_changes( const object_change_set& changes )
+{
+   _undo_db.discard_packed_value();
+   for( const auto& change : changes.changes )
+      get_mutable_index( change.id.space(), change.id.type() ).apply_logged_change( change.id, change.data );
+   for( const auto& next_id : changes.next_ids )
+      get_mutable_index( next_id.space(), next_id.type() ).set_next_id( next_id );
+}
+
+void object_database::mirror_indexes( const object_database& other )
+{
+   for( uint32_t space = 0; space < other._index.size(); ++space )
+      for( uint32_t type = 0; type < other._index[space].size(); ++type )
+      {
+         if( !other._index[space][type] )
+            continue;
+         if( _index[space].size() <= type )
+            _index[space].resize( 255 );
+         if( _index[space][type] )
+            continue;
+         _index[space][type] = other._index[space][type]->create_empty( *this );
+         const base_primary_index* primary = dynamic_cast<const base_primary_index*>( _index[space][type].get() );
+         if( primary != nullptr && primary->dense_lookup() )
+         {
+            auto& dense = _dense_indexes[space];
+            if( dense.size() <= type )
+               dense.resize( type + 1, nullptr );
+            dense[type] = primary;
+         }
+      }
+}
+
+void object_database::compact_log( vector<uint32_t> segments )
+{ try {
+   // Only reads closed segments and replaces them by one segment with the newest sequence
+   // number, so it is safe to run while new segments are appended.
+   std::map<object_id_type, vector<char>> latest;
+   object_change_set merged;
+   for( uint32_t seq : segments )
+   {
+      object_change_set seg = detail::read_segment( detail::segment_path( log_dir(), seq ) );
+      for( auto& change : seg.changes )
+         latest[change.id] = std::move( change.data );
+      merged.next_ids = std::move( seg.next_ids );
+   }
+   merged.changes.reserve( latest.size() );
+   for( auto& item : latest )
+      merged.changes.push_back( { item.first, std::move(item.second) } );
+
+   detail::write_segment( detail::segment_path( log_dir(), segments.back() ), merged );
+   for( size_t i = 0; i + 1 < segments.size(); ++i )
+      fc::remove( detail::segment_path( log_dir(), segments[i] ) );
+   ilog( "Compacted ${n} object database log segments into ${c} changes", ("n", segments.size())("c", merged.changes.size()) );
+} FC_CAPTURE_LOG_AND_RETHROW( (segments) ) }
+
+void object_database::wait_for_compaction()
+{
+   if( _compaction.valid() && !_compaction.ready() )
+   {
+      try { _compaction.wait(); }
+      catch( const fc::exception& e ) { elog( "Object database log compaction failed: ${e}", ("e", e.to_detail_string()) ); }
+   }
 }
 
+void object_database::replay_log()
+{ try {
+   auto segments = log_segments();
+   if( segments.empty() )
+      return;
+
+   ilog( "Replaying ${n} object database log segments...", ("n", segments.size()) );
+   for( uint32_t seq : segments )
+   {
+      apply_changes( detail::read_segment( detail::segment_path( log_dir(), seq ) ) );
+   }
+} FC_CAPTURE_AND_RETHROW() }
+
 void object_database::wipe(const fc::path& data_dir)
 {
    close();
@@ -97,6 +346,7 @@ void object_database::open(const fc::path& data_dir)
       for( uint32_t type = 0; type  < _index[space].size(); ++type )
          if( _index[space][type] )
             _index[space][type]->open( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
+   replay_log();
    ilog( "Done opening object database." );
 
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
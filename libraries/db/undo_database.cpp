@@ -25,8 +25,81 @@
 #include <graphene/db/undo_database.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <cstddef>
+
 namespace graphene { namespace db {
 
+void* undo_arena::allocate( size_t size )
+{
+   const size_t align = alignof(std::max_align_t);
+   size = (size + align - 1) & ~(align - 1);
+   if( size > _remaining )
+   {
+      // oversized objects get a chunk of their own and leave the current chunk in use
+      if( size > _chunk_size )
+      {
+         _chunks.emplace_back( new char[size] );
+         return _chunks.back().get();
+      }
+      _chunks.emplace_back( new char[_chunk_size] );
+      _next = _chunks.back().get();
+      _remaining = _chunk_size;
+      _chunk_size = _chunk_size * 2 < max_chunk_size ? _chunk_size * 2 : max_chunk_size;
+   }
+   void* result = _next;
+   _next += size;
+   _remaining -= size;
+   return result;
+}
+
+object_delta object_delta::diff( const vector<char>& later, const vector<char>& earlier )
+{
+   if( later.size() != earlier.size() )
+      return full( earlier );
+
+   // ranges separated by only a few equal bytes are joined, as each range costs more than that
+   const uint32_t max_gap = 8;
+   object_delta result;
+   const uint32_t size = earlier.size();
+   uint32_t i = 0;
+   while( i < size )
+   {
+      if( later[i] == earlier[i] ) { ++i; continue; }
+      uint32_t end = i + 1;
+      uint32_t same = 0;
+      for( uint32_t j = end; j < size && same <= max_gap; ++j )
+      {
+         if( later[j] != earlier[j] ) { end = j + 1; same = 0; }
+         else ++same;
+      }
+      result.ranges.emplace_back( i, end - i );
+      result.bytes.insert( result.bytes.end(), earlier.begin() + i, earlier.begin() + end );
+      i = end;
+   }
+   return result;
+}
+
+object_delta object_delta::full( vector<char> earlier )
+{
+   object_delta result;
+   result.full_value = std::move(earlier);
+   return result;
+}
+
+vector<char> object_delta::apply( const vector<char>& later )const
+{
+   if( full_value.valid() ) return *full_value;
+   vector<char> result( later );
+   auto src = bytes.begin();
+   for( const auto& range : ranges )
+   {
+      FC_ASSERT( range.first + range.second <= result.size(), "delta does not match the object it is applied to" );
+      std::copy( src, src + range.second, result.begin() + range.first );
+      src += range.second;
+   }
+   return result;
+}
+
 void undo_database::enable()  { _disabled = false; }
 void undo_database::disable() { _disabled = true; }
 
@@ -68,10 +141,58 @@ void undo_database::on_modify( const object& obj )
       return;
    auto itr =  state.old_values.find(obj.id);
    if( itr != state.old_values.end() ) return;
-   state.old_values[obj.id] = obj.clone();
+   state.old_values[obj.id] = state.save( obj );
+}
+void undo_database::on_modify_delta( const object& obj )
+{
+   // taken even when nothing is recorded, as the kept value is stale once obj is modified
+   vector<char> before = take_packed_value( obj );
+   if( _disabled ) return;
+
+   if( _stack.empty() )
+      _stack.emplace_back();
+   auto& state = _stack.back();
+   if( state.new_ids.find(obj.id) != state.new_ids.end() )
+      return;
+   auto itr = state.old_deltas.find(obj.id);
+   if( itr != state.old_deltas.end() && itr->second.is_full() )
+      return;
+   if( before.empty() )
+      before = obj.pack();
+   if( itr == state.old_deltas.end() )
+      state.old_deltas[obj.id] = object_delta::full( std::move(before) );
+   else
+      itr->second = object_delta::full( itr->second.apply( before ) );
+}
+void undo_database::on_modified_delta( const object& obj )
+{
+   if( _disabled || _stack.empty() ) return;
+
+   auto& state = _stack.back();
+   auto itr = state.old_deltas.find(obj.id);
+   if( itr == state.old_deltas.end() || !itr->second.is_full() ) return;
+   vector<char> after = obj.pack();
+   itr->second = object_delta::diff( after, *itr->second.full_value );
+   _packed_id = obj.id;
+   _packed_value = std::move(after);
+}
+vector<char> undo_database::take_packed_value( const object& obj )
+{
+   vector<char> result;
+   if( !_packed_value.empty() && _packed_id == obj.id )
+      result.swap( _packed_value );
+   return result;
+}
+const vector<char>& undo_database::packed_value( const object& obj, vector<char>& storage )const
+{
+   if( !_packed_value.empty() && _packed_id == obj.id )
+      return _packed_value;
+   storage = obj.pack();
+   return storage;
 }
 void undo_database::on_remove( const object& obj )
 {
+   vector<char> packed = take_packed_value( obj );
    if( _disabled ) return;
 
    if( _stack.empty() )
@@ -88,8 +209,19 @@ void undo_database::on_remove( const object& obj )
       state.old_values.erase(obj.id);
       return;
    }
+   auto ditr = state.old_deltas.find(obj.id);
+   if( ditr != state.old_deltas.end() )
+   {
+      if( packed.empty() )
+         packed = obj.pack();
+      auto old_value = state.save( obj );
+      old_value->unpack_from( ditr->second.apply( packed ) );
+      state.removed[obj.id] = std::move(old_value);
+      state.old_deltas.erase(ditr);
+      return;
+   }
    if( state.removed.count(obj.id) ) return;
-   state.removed[obj.id] = obj.clone();
+   state.removed[obj.id] = state.save( obj );
 }
 
 void undo_database::undo()
@@ -103,6 +235,7 @@ void undo_database::undo()
    {
       _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
    }
+   restore_deltas( state );
 
    for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
    {
@@ -189,7 +322,34 @@ void undo_database::merge()
       // del+upd -> N/A
       assert( prev_state.removed.find(obj.second->id) == prev_state.removed.end() );
       // nop+upd(was=Y) -> upd(was=Y), type B
-      prev_state.old_values[obj.second->id] = std::move(obj.second);
+      prev_state.old_values[obj.second->id] = prev_state.save( *obj.second );
+   }
+
+   // *+upd for objects stored by delta, which differs from the above only in the type C case where
+   // both deltas must be composed into one leading from the current value back to X
+   for( auto& item : state.old_deltas )
+   {
+      if( prev_state.new_ids.find(item.first) != prev_state.new_ids.end() )
+      {
+         // new+upd -> new, type A
+         continue;
+      }
+      auto it = prev_state.old_deltas.find(item.first);
+      if( it != prev_state.old_deltas.end() )
+      {
+         // upd(was=X) + upd(was=Y) -> upd(was=X)
+         if( !it->second.is_full() )
+         {
+            vector<char> storage;
+            const vector<char>& current = packed_value( _db.get_object( item.first ), storage );
+            it->second = object_delta::diff( current, it->second.apply( item.second.apply( current ) ) );
+         }
+         continue;
+      }
+      // del+upd -> N/A
+      assert( prev_state.removed.find(item.first) == prev_state.removed.end() );
+      // nop+upd(was=Y) -> upd(was=Y), type B
+      prev_state.old_deltas[item.first] = std::move(item.second);
    }
 
    // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
@@ -230,11 +390,22 @@ void undo_database::merge()
          prev_state.old_values.erase(obj.second->id);
          continue;
       }
+      auto dit = prev_state.old_deltas.find(obj.second->id);
+      if( dit != prev_state.old_deltas.end() )
+      {
+         // upd(was=X) + del(was=Y) -> del(was=X), where X is recovered from Y
+         obj.second->unpack_from( dit->second.apply( obj.second->pack() ) );
+         prev_state.removed[obj.second->id] = prev_state.save( *obj.second );
+         prev_state.old_deltas.erase(dit);
+         continue;
+      }
       // del + del -> N/A
       assert( prev_state.removed.find( obj.second->id ) == prev_state.removed.end() );
       // nop + del(was=Y) -> del(was=Y)
-      prev_state.removed[obj.second->id] = std::move(obj.second);
+      prev_state.removed[obj.second->id] = prev_state.save( *obj.second );
    }
+   // the values prev_state keeps were copied into its own arena, so the chunks of state are freed with it instead
+   // of piling up in prev_state for every merged pending transaction
    _stack.pop_back();
    --_active_sessions;
 }
@@ -257,6 +428,7 @@ void undo_database::pop_commit()
       {
          _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
       }
+      restore_deltas( state );
 
       for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
       {
@@ -281,6 +453,17 @@ void undo_database::pop_commit()
    }
    enable();
 }
+void undo_database::restore_deltas( const undo_state& state )
+{
+   for( const auto& item : state.old_deltas )
+   {
+      const object& current = _db.get_object( item.first );
+      vector<char> storage;
+      auto old_value = item.second.apply( packed_value( current, storage ) );
+      _db.modify( current, [&]( object& obj ){ obj.unpack_from( old_value ); } );
+   }
+}
+
 const undo_state& undo_database::head()const
 {
    FC_ASSERT( !_stack.empty() );
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/net/compact_block.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace net { namespace detail {
+
+  compact_block_message make_compact_block_message( const signed_block& block, const block_id_type& block_id,
+                                                    const item_hash_t& block_message_hash )
+  {
+    compact_block_message compact_block( block, block_id, block_message_hash );
+    compact_block.transaction_message_ids.reserve( block.transactions.size() );
+    compact_block.operation_results.reserve( block.transactions.size() );
+    for( const graphene::chain::processed_transaction& transaction : block.transactions )
+    {
+      compact_block.transaction_message_ids.push_back( message( trx_message( transaction ) ).id() );
+      compact_block.operation_results.push_back( transaction.operation_results );
+    }
+    return compact_block;
+  }
+
+  bool is_expected_compact_block( const peer_connection& peer, const compact_block_message& compact_block )
+  {
+    if( peer.items_requested_from_peer.find( item_id( block_message_type, compact_block.block_message_hash ) ) ==
+        peer.items_requested_from_peer.end() )
+      return false;
+    bool already_pending = std::any_of( peer.compact_blocks_awaiting_transactions.begin(),
+                                        peer.compact_blocks_awaiting_transactions.end(),
+                                        [&]( const std::pair<const block_id_type, peer_connection::partial_compact_block>& pending ) {
+                                          return pending.first == compact_block.block_id ||
+                                                 pending.second.block_message_hash == compact_block.block_message_hash;
+                                        } );
+    if( already_pending )
+      return false;
+    size_t blocks_requested = std::count_if( peer.items_requested_from_peer.begin(),
+                                             peer.items_requested_from_peer.end(),
+                                             []( const peer_connection::item_to_time_map_type::value_type& item ) {
+                                               return item.first.item_type == block_message_type;
+                                             } );
+    return peer.compact_blocks_awaiting_transactions.size() < blocks_requested;
+  }
+
+  std::vector<uint32_t> rebuild_compact_block( const compact_block_message& compact_block,
+                                               const std::function<fc::optional<signed_transaction>(const item_hash_t&)>& lookup_transaction,
+                                               signed_block& block )
+  {
+    FC_ASSERT( compact_block.operation_results.size() == compact_block.transaction_message_ids.size(),
+               "Compact block has ${r} sets of operation results for ${t} transactions",
+               ("r", compact_block.operation_results.size())("t", compact_block.transaction_message_ids.size()) );
+    std::vector<uint32_t> missing_transaction_indices;
+    static_cast<signed_block_header&>( block ) = compact_block.header;
+    block.transactions.clear();
+    block.transactions.resize( compact_block.transaction_message_ids.size() );
+    for( uint32_t i = 0; i < compact_block.transaction_message_ids.size(); ++i )
+    {
+      fc::optional<signed_transaction> transaction = lookup_transaction( compact_block.transaction_message_ids[i] );
+      if( transaction )
+        static_cast<signed_transaction&>( block.transactions[i] ) = *transaction;
+      else
+        missing_transaction_indices.push_back( i );
+      block.transactions[i].operation_results = compact_block.operation_results[i];
+    }
+    return missing_transaction_indices;
+  }
+
+  void fill_compact_block_transactions( const std::vector<uint32_t>& missing_transaction_indices,
+                                        const std::vector<signed_transaction>& transactions,
+                                        signed_block& block )
+  {
+    FC_ASSERT( transactions.size() == missing_transaction_indices.size(),
+               "Expected ${n} transactions, got ${m}",
+               ("n", missing_transaction_indices.size())("m", transactions.size()) );
+    for( uint32_t i = 0; i < transactions.size(); ++i )
+    {
+      FC_ASSERT( missing_transaction_indices[i] < block.transactions.size(),
+                 "Transaction index ${i} is past the end of a block of ${n} transactions",
+                 ("i", missing_transaction_indices[i])("n", block.transactions.size()) );
+      static_cast<signed_transaction&>( block.transactions[missing_transaction_indices[i]] ) = transactions[i];
+    }
+  }
+
+} } } // end namespace graphene::net::detail
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/peer_connection.hpp>
+
+#include <functional>
+#include <vector>
+
+namespace graphene { namespace net { namespace detail {
+
+  /**
+   * The halves of the compact block exchange that don't need a connection: building the
+   * compact block we send, and rebuilding the block from one we receive.
+   */
+
+  /**
+   * Each transaction is identified by the id of the trx_message it was relayed in, which
+   * is the key our peers' message caches already use for it.
+   */
+  compact_block_message make_compact_block_message( const signed_block& block, const block_id_type& block_id,
+                                                    const item_hash_t& block_message_hash );
+
+  /**
+   * We only ask for compact blocks in place of blocks during normal operation, so the block message
+   * a compact block stands in for must be one we requested from the peer and aren't already rebuilding.
+   * Each pending entry answers a distinct outstanding request, which also bounds how many can pile up.
+   */
+  bool is_expected_compact_block( const peer_connection& peer, const compact_block_message& compact_block );
+
+  /**
+   * Fills in as much of block as lookup_transaction can supply and returns the positions
+   * of the transactions that still have to be fetched from the peer.
+   */
+  std::vector<uint32_t> rebuild_compact_block( const compact_block_message& compact_block,
+                                               const std::function<fc::optional<signed_transaction>(const item_hash_t&)>& lookup_transaction,
+                                               signed_block& block );
+
+  /// puts the transactions the peer sent us into the positions rebuild_compact_block couldn't fill
+  void fill_compact_block_transactions( const std::vector<uint32_t>& missing_transaction_indices,
+                                        const std::vector<signed_transaction>& transactions,
+                                        signed_block& block );
+
+} } } // end namespace graphene::net::detail
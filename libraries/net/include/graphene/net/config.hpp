@@ -57,6 +57,14 @@
 
 #define GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES        (1024 * 1024)
 
+/**
+ * Size of the buffers stcp_socket encrypts into and decrypts out of.  Queued
+ * messages are sent in batches of up to this many bytes, encrypted with one
+ * call and written with one socket write.  Must be a multiple of the 16 byte
+ * AES block size.
+ */
+#define GRAPHENE_NET_STCP_BUFFER_SIZE                        (64 * 1024)
+
 /**
  * When we receive a message from the network, we advertise it to
  * our peers and save a copy in a cache were we will find it if
@@ -81,6 +89,22 @@
 
 #define GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING      200
 
+/**
+ * Once we've measured how fast a peer delivers sync blocks, we size its
+ * windows to take about this long, within the bounds below.  Windows are
+ * requested in a single fetch_items_message, so larger windows keep fast
+ * peers from waiting on a round trip between windows.
+ */
+#define GRAPHENE_NET_SYNC_WINDOW_TARGET_DURATION_SEC         5
+#define GRAPHENE_NET_MIN_BLOCKS_PER_SYNC_WINDOW              20
+#define GRAPHENE_NET_MAX_BLOCKS_PER_SYNC_WINDOW              1000
+
+/**
+ * A sync window that takes twice as long as the peer's measured rate predicts,
+ * and at least this long, is handed to other peers as well.
+ */
+#define GRAPHENE_NET_MIN_SYNC_STRAGGLER_TIMEOUT_SEC          2
+
 /**
  * During normal operation, how many items will be fetched from each
  * peer at a time.  This will only come into play when the network
@@ -103,3 +127,10 @@
 #define GRAPHENE_NET_MIN_BLOCK_IDS_TO_PREFETCH               10000
 
 #define GRAPHENE_NET_MAX_TRX_PER_SECOND                      1000
+
+/**
+ * A peer that relays more than this many transactions in a minute that the
+ * client rejects as invalid in any chain state is disconnected.  Transactions
+ * that are merely stale or conflicting don't count.
+ */
+#define GRAPHENE_NET_MAX_INVALID_TRANSACTIONS_PER_MINUTE     20
@@ -44,6 +44,7 @@ namespace graphene { namespace net {
   using graphene::chain::block_id_type;
   using graphene::chain::transaction_id_type;
   using graphene::chain::signed_block;
+  using graphene::chain::signed_block_header;
 
   typedef fc::ecc::public_key_data node_id_t;
   typedef fc::ripemd160 item_hash_t;
@@ -86,6 +87,9 @@ namespace graphene { namespace net {
     check_firewall_reply_message_type            = 5015,
     get_current_connections_request_message_type = 5016,
     get_current_connections_reply_message_type   = 5017,
+    compact_block_message_type                   = 5018,
+    fetch_compact_block_transactions_message_type = 5019,
+    compact_block_transactions_message_type      = 5020,
     core_message_type_last                       = 5099
   };
 
@@ -400,6 +404,63 @@ namespace graphene { namespace net {
     std::vector<current_connection_data> current_connections;
   };
 
+  /**
+   * A block with its transactions replaced by the ids of the trx_messages that carried
+   * them.  Sent in place of a block_message to peers that asked for it with a
+   * fetch_items_message of type compact_block_message_type; the receiver rebuilds the
+   * block from its message cache and asks for whatever it is missing with a
+   * fetch_compact_block_transactions_message.
+   *
+   * The operation results are part of the merkle root but never travel in a trx_message,
+   * so they are sent along with the ids.  block_message_hash is the hash of the
+   * block_message this stands in for, which is what the receiver asked for.
+   */
+  struct compact_block_message
+  {
+    static const core_message_type_enum type;
+
+    signed_block_header       header;
+    block_id_type             block_id;
+    item_hash_t               block_message_hash;
+    std::vector<item_hash_t>  transaction_message_ids;
+    std::vector<std::vector<graphene::chain::operation_result> > operation_results;
+
+    compact_block_message() {}
+    compact_block_message(const signed_block& block, const block_id_type& block_id, const item_hash_t& block_message_hash) :
+      header(block),
+      block_id(block_id),
+      block_message_hash(block_message_hash)
+    {}
+  };
+
+  struct fetch_compact_block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    block_id_type          block_id;
+    std::vector<uint32_t>  transaction_indices; // positions in the block's transaction list
+
+    fetch_compact_block_transactions_message() {}
+    fetch_compact_block_transactions_message(const block_id_type& block_id, std::vector<uint32_t> transaction_indices) :
+      block_id(block_id),
+      transaction_indices(std::move(transaction_indices))
+    {}
+  };
+
+  struct compact_block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    block_id_type                    block_id;
+    std::vector<signed_transaction>  transactions; // in the order they were requested
+
+    compact_block_transactions_message() {}
+    compact_block_transactions_message(const block_id_type& block_id, std::vector<signed_transaction> transactions) :
+      block_id(block_id),
+      transactions(std::move(transactions))
+    {}
+  };
+
 
 } } // graphene::net
 
@@ -424,6 +485,9 @@ FC_REFLECT_ENUM( graphene::net::core_message_type_enum,
                  (check_firewall_reply_message_type)
                  (get_current_connections_request_message_type)
                  (get_current_connections_reply_message_type)
+                 (compact_block_message_type)
+                 (fetch_compact_block_transactions_message_type)
+                 (compact_block_transactions_message_type)
                  (core_message_type_last) )
 
 FC_REFLECT( graphene::net::trx_message, (trx) )
@@ -508,6 +572,9 @@ FC_REFLECT(graphene::net::get_current_connections_reply_message, (upload_rate_on
                                                             (upload_rate_one_hour)
                                                             (download_rate_one_hour)
                                                             (current_connections))
+FC_REFLECT(graphene::net::compact_block_message, (header)(block_id)(block_message_hash)(transaction_message_ids)(operation_results))
+FC_REFLECT(graphene::net::fetch_compact_block_transactions_message, (block_id)(transaction_indices))
+FC_REFLECT(graphene::net::compact_block_transactions_message, (block_id)(transactions))
 
 #include <unordered_map>
 #include <fc/crypto/city.hpp>
@@ -29,6 +29,9 @@
 #include <fc/crypto/ripemd160.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <cstring>
+#include <memory>
+
 namespace graphene { namespace net {
 
   /**
@@ -108,8 +111,34 @@ namespace graphene { namespace net {
      }
   };
 
+  /**
+   *  A message as it goes out on the wire: its header followed by its data, padded to a
+   *  multiple of 16 bytes for the connection's stream cipher.  It is never modified once
+   *  built, so one copy can be queued on every connection that sends it.
+   */
+  typedef std::shared_ptr<const std::vector<char> > serialized_message_ptr;
 
+  inline serialized_message_ptr serialize_message( const message& message_to_serialize )
+  {
+     size_t size_of_message_and_header = sizeof(message_header) + message_to_serialize.data.size();
+     std::shared_ptr<std::vector<char> > serialized_message =
+        std::make_shared<std::vector<char> >( 16 * ((size_of_message_and_header + 15) / 16) );
+     memcpy( serialized_message->data(), (const message_header*)&message_to_serialize, sizeof(message_header) );
+     if( !message_to_serialize.data.empty() )
+        memcpy( serialized_message->data() + sizeof(message_header), message_to_serialize.data.data(), message_to_serialize.data.size() );
+     return serialized_message;
+  }
 
+  inline message deserialize_message( const std::vector<char>& serialized_message )
+  {
+     FC_ASSERT( serialized_message.size() >= sizeof(message_header) );
+     message deserialized_message;
+     memcpy( (message_header*)&deserialized_message, serialized_message.data(), sizeof(message_header) );
+     FC_ASSERT( sizeof(message_header) + deserialized_message.size <= serialized_message.size() );
+     deserialized_message.data.assign( serialized_message.begin() + sizeof(message_header),
+                                       serialized_message.begin() + sizeof(message_header) + deserialized_message.size );
+     return deserialized_message;
+  }
 
 } } // graphene::net
 
@@ -52,11 +52,16 @@ namespace graphene { namespace net {
        void connect_to(const fc::ip::endpoint& remote_endpoint);
 
        void send_message(const message& message_to_send);
+       /** sends a message framed by serialize_message(), without copying it */
+       void send_message(const serialized_message_ptr& message_to_send);
+       /** sends the messages in order, encrypting and writing them to the socket in as few pieces as possible */
+       void send_messages(const std::vector<serialized_message_ptr>& messages_to_send);
        void close_connection();
        void destroy_connection();
 
        uint64_t       get_total_bytes_sent() const;
        uint64_t       get_total_bytes_received() const;
+       uint64_t       get_total_messages_sent() const;
        fc::time_point get_last_message_sent_time() const;
        fc::time_point get_last_message_received_time() const;
        fc::time_point get_connection_time() const;
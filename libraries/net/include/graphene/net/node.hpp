@@ -314,11 +314,36 @@ namespace graphene { namespace net {
       void      broadcast(const message& item_to_broadcast) override;
       void      add_node_delegate(node_delegate* node_delegate_to_add);
 
+      /**
+       * Make each delivery take as long as it would over a link with the given one-way
+       * latency and bandwidth.  Both default to zero, which delivers immediately.
+       */
+      void      set_link_characteristics(fc::microseconds one_way_latency, uint32_t bytes_per_second);
+      /** Relay blocks as compact blocks, rebuilding them from the transactions each node has already received */
+      void      set_compact_blocks_enabled(bool enabled) { _compact_blocks_enabled = enabled; }
+
+      struct traffic_statistics
+      {
+        uint64_t         bytes_sent = 0;             ///< including message headers
+        uint64_t         block_bytes_sent = 0;       ///< blocks, or compact blocks and the transactions fetched to complete them
+        uint32_t         blocks_delivered = 0;
+        uint32_t         transactions_fetched_for_blocks = 0;
+        fc::microseconds total_block_latency;        ///< summed over deliveries, from broadcast until handed to the delegate
+      };
+      const traffic_statistics& get_traffic_statistics() const { return _statistics; }
+
       virtual uint32_t get_connection_count() const override { return 8; }
     private:
       struct node_info;
       void message_sender(node_info* destination_node);
+      block_message relay_block(node_info* destination_node, const message& block_message_to_relay);
+      void transmit(uint64_t bytes, uint32_t one_way_trips, bool is_block_traffic);
       std::list<node_info*> network_nodes;
+
+      fc::microseconds   _one_way_latency;
+      uint32_t           _bytes_per_second = 0;
+      bool               _compact_blocks_enabled = false;
+      traffic_statistics _statistics;
     };
 
 
@@ -329,3 +354,5 @@ namespace graphene { namespace net {
 
 FC_REFLECT(graphene::net::message_propagation_data, (received_time)(validated_time)(originating_peer));
 FC_REFLECT( graphene::net::peer_status, (version)(host)(info) );
+FC_REFLECT( graphene::net::simulated_network::traffic_statistics, (bytes_sent)(block_bytes_sent)(blocks_delivered)
+                                                                 (transactions_fetched_for_blocks)(total_block_latency) );
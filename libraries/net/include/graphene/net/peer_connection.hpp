@@ -41,6 +41,7 @@
 #include <boost/multi_index/hashed_index.hpp>
 
 #include <queue>
+#include <list>
 #include <boost/container/deque.hpp>
 #include <fc/thread/future.hpp>
 
@@ -68,7 +69,7 @@ namespace graphene { namespace net
       virtual void on_message(peer_connection* originating_peer,
                               const message& received_message) = 0;
       virtual void on_connection_closed(peer_connection* originating_peer) = 0;
-      virtual message get_message_for_item(const item_id& item) = 0;
+      virtual serialized_message_ptr get_serialized_message_for_item(const item_id& item) = 0;
     };
 
     class peer_connection;
@@ -123,11 +124,13 @@ namespace graphene { namespace net
           enqueue_time(enqueue_time)
         {}
 
-        virtual message get_message(peer_connection_delegate* node) = 0;
+        virtual serialized_message_ptr get_serialized_message(peer_connection_delegate* node) = 0;
         /** returns roughly the number of bytes of memory the message is consuming while
          * it is sitting on the queue
          */
         virtual size_t get_size_in_queue() = 0;
+        /** true if get_serialized_message() frames a copy of the message for this connection alone */
+        virtual bool is_serialized_per_connection() const { return false; }
         virtual ~queued_message() {}
       };
 
@@ -145,7 +148,23 @@ namespace graphene { namespace net
           message_send_time_field_offset(message_send_time_field_offset)
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        serialized_message_ptr get_serialized_message(peer_connection_delegate* node) override;
+        size_t get_size_in_queue() override;
+        bool is_serialized_per_connection() const override { return true; }
+      };
+
+      /* when you queue up a 'shared_queued_message', only a reference to a message that
+       * was serialized once for all of the peers it is going to is stored until it is sent
+       */
+      struct shared_queued_message : queued_message
+      {
+        serialized_message_ptr message_to_send;
+
+        shared_queued_message(serialized_message_ptr message_to_send) :
+          message_to_send(std::move(message_to_send))
+        {}
+
+        serialized_message_ptr get_serialized_message(peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
       };
 
@@ -161,13 +180,14 @@ namespace graphene { namespace net
           item_to_send(std::move(item_to_send))
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        serialized_message_ptr get_serialized_message(peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
       };
 
 
       size_t _total_queued_messages_size;
-      std::queue<std::unique_ptr<queued_message>, std::list<std::unique_ptr<queued_message> > > _queued_messages;
+      uint64_t _total_messages_serialized; /// messages this connection framed a copy of for itself, rather than sending a shared one
+      std::list<std::unique_ptr<queued_message> > _queued_messages;
       fc::future<void> _send_queued_messages_done;
     public:
       fc::time_point connection_initiation_time;
@@ -230,6 +250,9 @@ namespace graphene { namespace net
       item_hash_t last_block_delegate_has_seen; /// the hash of the last block  this peer has told us about that the peer knows
       fc::time_point_sec last_block_time_delegate_has_seen;
       bool inhibit_fetching_sync_blocks;
+      fc::time_point sync_window_requested_time; /// when we sent this peer the request for its current window of sync blocks
+      uint32_t sync_window_size; /// number of blocks in that window, zero once we've timed it
+      double sync_blocks_per_second; /// smoothed rate at which this peer has delivered its sync windows, zero until measured
       /// @}
 
       /// non-synchronization state data
@@ -253,12 +276,25 @@ namespace graphene { namespace net
       timestamped_items_set_type inventory_advertised_to_peer;
 
       item_to_time_map_type items_requested_from_peer;  /// items we've requested from this peer during normal operation.  fetch from another peer if this peer disconnects
+
+      bool supports_compact_blocks; /// set from the hello message; if true, we ask this peer for compact blocks instead of full ones
+      struct partial_compact_block
+      {
+        item_hash_t block_message_hash;
+        signed_block block;
+        std::vector<uint32_t> missing_transaction_indices;
+      };
+      std::map<block_id_type, partial_compact_block> compact_blocks_awaiting_transactions; /// compact blocks this peer sent us that we couldn't rebuild from our cache, at most one per block requested from it
       /// @}
 
       // if they're flooding us with transactions, we set this to avoid fetching for a few seconds to let the
       // blockchain catch up
       fc::time_point transaction_fetching_inhibited_until;
 
+      uint32_t invalid_transactions_received; /// transactions from this peer the client found invalid in any chain state
+      uint32_t invalid_transactions_this_minute;
+      fc::time_point invalid_transactions_minute_start;
+
       uint32_t last_known_fork_block_number;
 
       fc::future<void> accept_or_connect_task_done;
@@ -285,12 +321,15 @@ namespace graphene { namespace net
 
       void send_queueable_message(std::unique_ptr<queued_message>&& message_to_send);
       void send_message(const message& message_to_send, size_t message_send_time_field_offset = (size_t)-1);
+      void send_message(const serialized_message_ptr& message_to_send);
       void send_item(const item_id& item_to_send);
       void close_connection();
       void destroy_connection();
 
       uint64_t get_total_bytes_sent() const;
       uint64_t get_total_bytes_received() const;
+      uint64_t get_total_messages_sent() const;
+      uint64_t get_total_messages_serialized() const;
 
       fc::time_point get_last_message_sent_time() const;
       fc::time_point get_last_message_received_time() const;
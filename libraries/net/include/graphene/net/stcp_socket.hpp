@@ -26,6 +26,9 @@
 #include <fc/crypto/aes.hpp>
 #include <fc/crypto/elliptic.hpp>
 
+#include <utility>
+#include <vector>
+
 namespace graphene { namespace net {
 
 /**
@@ -49,6 +52,13 @@ class stcp_socket : public virtual fc::iostream
 
     virtual size_t   writesome( const char* buffer, size_t len );
     virtual size_t   writesome( const std::shared_ptr<const char>& buf, size_t len, size_t offset );
+    /// a run of bytes for write_buffers(), padded to a multiple of the 16 byte AES block size
+    typedef std::pair<const char*, size_t> const_buffer;
+    /**
+     *  Writes all of the buffers, filling the write buffer with as many as fit before
+     *  encrypting it in one pass and writing it in one call to the socket.
+     */
+    void             write_buffers( const std::vector<const_buffer>& buffers_to_write );
 
     virtual void     flush();
     virtual void     close();
@@ -67,6 +77,9 @@ class stcp_socket : public virtual fc::iostream
     fc::aes_encoder      _send_aes;
     fc::aes_decoder      _recv_aes;
     std::shared_ptr<char> _read_buffer;
+    /// decrypted bytes read ahead of what readsome() has been asked for, at the end of _read_buffer
+    size_t                _read_buffer_begin;
+    size_t                _read_buffer_end;
     std::shared_ptr<char> _write_buffer;
 #ifndef NDEBUG
     bool _read_buffer_in_use;
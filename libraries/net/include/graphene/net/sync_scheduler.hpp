@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/peer_connection.hpp>
+
+#include <map>
+#include <set>
+#include <unordered_set>
+#include <vector>
+
+namespace graphene { namespace net { namespace detail {
+
+  /**
+   * The pieces of node_impl's sync download scheduler that only look at peer state.  They're kept
+   * apart from node_impl so the scheduling decisions can be exercised without a network.
+   */
+
+  /// sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
+  typedef std::map<block_id_type, block_message> sync_reorder_buffer;
+
+  /// the number of blocks to ask for in the peer's next sync window
+  uint32_t get_sync_window_size( const peer_connection& peer, uint32_t default_window_size );
+
+  /// true if the peer's outstanding sync window has taken well over what its measured rate predicts
+  bool is_straggling_sync_peer( const peer_connection& peer, fc::time_point now );
+
+  /**
+   * Hands the blocks the straggler still owes us to the first of idle_peers (fastest first) that
+   * has them and has room left in its window.  The straggler's own request stands.
+   * @return the number of blocks reassigned
+   */
+  unsigned reassign_straggling_sync_items( const peer_connection& straggler,
+                                           const std::vector<peer_connection_ptr>& idle_peers,
+                                           uint32_t default_window_size,
+                                           const sync_reorder_buffer& received_sync_items,
+                                           std::set<item_hash_t>& reassigned_sync_requests,
+                                           std::set<item_hash_t>& sync_items_to_request,
+                                           std::map<peer_connection_ptr, std::vector<item_hash_t> >& sync_item_requests_to_send );
+
+  /// the received block that is at the front of some peer's list of blocks we still need, or end() if there's none yet
+  sync_reorder_buffer::iterator find_next_sync_block( const std::unordered_set<peer_connection_ptr>& peers,
+                                                      sync_reorder_buffer& received_sync_items );
+
+  /// true while some peer still lists the block among those we need from it
+  bool is_sync_block_still_needed( const std::unordered_set<peer_connection_ptr>& peers, const block_id_type& block_id );
+
+  /// drops the blocks no peer lists any more, such as late copies from a straggler; returns how many were dropped
+  size_t remove_unneeded_sync_blocks( const std::unordered_set<peer_connection_ptr>& peers,
+                                      sync_reorder_buffer& received_sync_items );
+
+} } } // end namespace graphene::net::detail
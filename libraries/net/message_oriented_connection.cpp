@@ -55,6 +55,7 @@ namespace graphene { namespace net {
       fc::future<void> _read_loop_done;
       uint64_t _bytes_received;
       uint64_t _bytes_sent;
+      uint64_t _messages_sent;
 
       fc::time_point _connected_time;
       fc::time_point _last_message_received_time;
@@ -78,12 +79,13 @@ namespace graphene { namespace net {
                                        message_oriented_connection_delegate* delegate = nullptr);
       ~message_oriented_connection_impl();
 
-      void send_message(const message& message_to_send);
+      void send_messages(const std::vector<serialized_message_ptr>& messages_to_send);
       void close_connection();
       void destroy_connection();
 
       uint64_t get_total_bytes_sent() const;
       uint64_t get_total_bytes_received() const;
+      uint64_t get_total_messages_sent() const;
 
       fc::time_point get_last_message_sent_time() const;
       fc::time_point get_last_message_received_time() const;
@@ -97,6 +99,7 @@ namespace graphene { namespace net {
       _delegate(delegate),
       _bytes_received(0),
       _bytes_sent(0),
+      _messages_sent(0),
       _send_message_in_progress(false)
 #ifndef NDEBUG
       ,_thread(&fc::thread::current())
@@ -226,7 +229,7 @@ namespace graphene { namespace net {
         throw *exception_to_rethrow;
     }
 
-    void message_oriented_connection_impl::send_message(const message& message_to_send)
+    void message_oriented_connection_impl::send_messages(const std::vector<serialized_message_ptr>& messages_to_send)
     {
       VERIFY_CORRECT_THREAD();
 #if 0 // this gets too verbose
@@ -255,17 +258,22 @@ namespace graphene { namespace net {
 
       try
       {
-        size_t size_of_message_and_header = sizeof(message_header) + message_to_send.size;
-        if( message_to_send.size > MAX_MESSAGE_SIZE )
-           elog("Trying to send a message larger than MAX_MESSAGE_SIZE. This probably won't work...");
-        //pad the message we send to a multiple of 16 bytes
-        size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
-        std::unique_ptr<char[]> padded_message(new char[size_with_padding]);
-        memcpy(padded_message.get(), (char*)&message_to_send, sizeof(message_header));
-        memcpy(padded_message.get() + sizeof(message_header), message_to_send.data.data(), message_to_send.size );
-        _sock.write(padded_message.get(), size_with_padding);
+        // the messages were already padded to a multiple of 16 bytes by serialize_message(), and may be
+        // queued on other connections too, so they go to the socket as they are
+        size_t bytes_to_send = 0;
+        std::vector<stcp_socket::const_buffer> buffers_to_send;
+        buffers_to_send.reserve(messages_to_send.size());
+        for( const serialized_message_ptr& message_to_send : messages_to_send )
+        {
+          if( ((const message_header*)message_to_send->data())->size > MAX_MESSAGE_SIZE )
+             elog("Trying to send a message larger than MAX_MESSAGE_SIZE. This probably won't work...");
+          buffers_to_send.emplace_back(message_to_send->data(), message_to_send->size());
+          bytes_to_send += message_to_send->size();
+        }
+        _sock.write_buffers(buffers_to_send);
         _sock.flush();
-        _bytes_sent += size_with_padding;
+        _bytes_sent += bytes_to_send;
+        _messages_sent += messages_to_send.size();
         _last_message_sent_time = fc::time_point::now();
       } FC_RETHROW_EXCEPTIONS( warn, "unable to send message" );
     }
@@ -316,6 +324,12 @@ namespace graphene { namespace net {
       return _bytes_received;
     }
 
+    uint64_t message_oriented_connection_impl::get_total_messages_sent() const
+    {
+      VERIFY_CORRECT_THREAD();
+      return _messages_sent;
+    }
+
     fc::time_point message_oriented_connection_impl::get_last_message_sent_time() const
     {
       VERIFY_CORRECT_THREAD();
@@ -368,7 +382,17 @@ namespace graphene { namespace net {
 
   void message_oriented_connection::send_message(const message& message_to_send)
   {
-    my->send_message(message_to_send);
+    my->send_messages(std::vector<serialized_message_ptr>{serialize_message(message_to_send)});
+  }
+
+  void message_oriented_connection::send_message(const serialized_message_ptr& message_to_send)
+  {
+    my->send_messages(std::vector<serialized_message_ptr>{message_to_send});
+  }
+
+  void message_oriented_connection::send_messages(const std::vector<serialized_message_ptr>& messages_to_send)
+  {
+    my->send_messages(messages_to_send);
   }
 
   void message_oriented_connection::close_connection()
@@ -391,6 +415,11 @@ namespace graphene { namespace net {
     return my->get_total_bytes_received();
   }
 
+  uint64_t message_oriented_connection::get_total_messages_sent() const
+  {
+    return my->get_total_messages_sent();
+  }
+
   fc::time_point message_oriented_connection::get_last_message_sent_time() const
   {
     return my->get_last_message_sent_time();
@@ -30,6 +30,7 @@
 #include <iostream>
 #include <algorithm>
 #include <tuple>
+#include <functional>
 #include <boost/tuple/tuple.hpp>
 #include <boost/circular_buffer.hpp>
 
@@ -75,6 +76,8 @@
 #include <graphene/net/peer_database.hpp>
 #include <graphene/net/peer_connection.hpp>
 #include <graphene/net/stcp_socket.hpp>
+#include <graphene/net/sync_scheduler.hpp>
+#include <graphene/net/compact_block.hpp>
 #include <graphene/net/config.hpp>
 #include <graphene/net/exceptions.hpp>
 
@@ -135,7 +138,7 @@ namespace graphene { namespace net {
       struct message_info
       {
         message_hash_type message_hash;
-        message           message_body;
+        serialized_message_ptr serialized_message; // shared with the send queues of the peers it's going to
         uint32_t          block_clock_when_received;
 
         // for network performance stats
@@ -143,12 +146,12 @@ namespace graphene { namespace net {
         fc::uint160_t     message_contents_hash; // hash of whatever the message contains (if it's a transaction, this is the transaction id, if it's a block, it's the block_id)
 
         message_info( const message_hash_type& message_hash,
-                      const message&           message_body,
+                      serialized_message_ptr   serialized_message,
                       uint32_t                 block_clock_when_received,
                       const message_propagation_data& propagation_data,
                       fc::uint160_t            message_contents_hash ) :
           message_hash( message_hash ),
-          message_body( message_body ),
+          serialized_message( std::move(serialized_message) ),
           block_clock_when_received( block_clock_when_received ),
           propagation_data( propagation_data ),
           message_contents_hash( message_contents_hash )
@@ -176,6 +179,11 @@ namespace graphene { namespace net {
       void cache_message( const message& message_to_cache, const message_hash_type& hash_of_message_to_cache,
                         const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
       message get_message( const message_hash_type& hash_of_message_to_lookup );
+      /** like get_message(), but returns the copy every peer shares instead of deserializing one.
+       * If message_contents_hash is given, it's set to the block or transaction id the message was cached with */
+      serialized_message_ptr get_serialized_message( const message_hash_type& hash_of_message_to_lookup,
+                                                     fc::uint160_t* message_contents_hash = nullptr ) const;
+      serialized_message_ptr get_serialized_message_by_contents_hash( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
       message_propagation_data get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
       size_t size() const { return _message_cache.size(); }
     };
@@ -194,18 +202,40 @@ namespace graphene { namespace net {
                                                      const fc::uint160_t& message_content_hash )
     {
       _message_cache.insert( message_info(hash_of_message_to_cache,
-                                         message_to_cache,
+                                         serialize_message( message_to_cache ),
                                          block_clock,
                                          propagation_data,
                                          message_content_hash ) );
     }
 
     message blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
+    {
+      return deserialize_message( *get_serialized_message( hash_of_message_to_lookup ) );
+    }
+
+    serialized_message_ptr blockchain_tied_message_cache::get_serialized_message( const message_hash_type& hash_of_message_to_lookup,
+                                                                                  fc::uint160_t* message_contents_hash ) const
     {
       message_cache_container::index<message_hash_index>::type::const_iterator iter =
          _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
       if( iter != _message_cache.get<message_hash_index>().end() )
-        return iter->message_body;
+      {
+        if( message_contents_hash )
+          *message_contents_hash = iter->message_contents_hash;
+        return iter->serialized_message;
+      }
+      FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
+    }
+
+    serialized_message_ptr blockchain_tied_message_cache::get_serialized_message_by_contents_hash( const fc::uint160_t& hash_of_message_contents_to_lookup ) const
+    {
+      if( hash_of_message_contents_to_lookup != fc::uint160_t() )
+      {
+        message_cache_container::index<message_contents_hash_index>::type::const_iterator iter =
+           _message_cache.get<message_contents_hash_index>().find(hash_of_message_contents_to_lookup );
+        if( iter != _message_cache.get<message_contents_hash_index>().end() )
+          return iter->serialized_message;
+      }
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
     }
 
@@ -449,8 +479,8 @@ namespace graphene { namespace net { namespace detail {
       typedef std::unordered_map<graphene::net::block_id_type, fc::time_point> active_sync_requests_map;
 
       active_sync_requests_map              _active_sync_requests; /// list of sync blocks we've asked for from peers but have not yet received
-      std::list<graphene::net::block_message> _new_received_sync_items; /// list of sync blocks we've just received but haven't yet tried to process
-      std::list<graphene::net::block_message> _received_sync_items; /// list of sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
+      std::set<graphene::net::block_id_type> _reassigned_sync_requests; /// sync blocks we've asked a second peer for because the first one was straggling
+      sync_reorder_buffer _received_sync_items; /// reorder buffer of sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
       // @}
 
       fc::future<void> _process_backlog_of_sync_blocks_done;
@@ -577,7 +607,17 @@ namespace graphene { namespace net { namespace detail {
       unsigned _maximum_number_of_sync_blocks_to_prefetch;
       unsigned _maximum_blocks_per_peer_during_syncing;
 
-      std::list<fc::future<void> > _handle_message_calls_in_progress;
+      bool _compact_blocks_enabled; /// ask peers that support it for compact blocks instead of full ones
+
+      struct recent_compact_block
+      {
+        item_hash_t            block_message_hash;
+        block_id_type          block_id;
+        fc::time_point_sec     timestamp;
+        serialized_message_ptr compact_block;
+      };
+      /// compact blocks we've built recently, built once and shared by every peer that asks for them
+      std::deque<recent_compact_block> _recent_compact_blocks;
 
       node_impl(const std::string& user_agent);
       virtual ~node_impl();
@@ -590,6 +630,8 @@ namespace graphene { namespace net { namespace detail {
       bool have_already_received_sync_item( const item_hash_t& item_hash );
       void request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request );
       void request_sync_items_from_peer( const peer_connection_ptr& peer, const std::vector<item_hash_t>& items_to_request );
+      uint32_t get_sync_window_size( const peer_connection_ptr& peer ) const;
+      void record_sync_window_completed( peer_connection* peer );
       void fetch_sync_items_loop();
       void trigger_fetch_sync_items_loop();
 
@@ -687,6 +729,14 @@ namespace graphene { namespace net { namespace detail {
       void process_block_during_normal_operation(peer_connection* originating_peer, const graphene::net::block_message& block_message, const message_hash_type& message_hash);
       void process_block_message(peer_connection* originating_peer, const message& message_to_process, const message_hash_type& message_hash);
 
+      void send_compact_blocks(peer_connection* originating_peer, const std::vector<item_hash_t>& block_message_hashes);
+      void on_compact_block_message(peer_connection* originating_peer, const compact_block_message& compact_block_message_received);
+      void on_fetch_compact_block_transactions_message(peer_connection* originating_peer,
+                                                       const fetch_compact_block_transactions_message& fetch_compact_block_transactions_message_received);
+      void on_compact_block_transactions_message(peer_connection* originating_peer,
+                                                 const compact_block_transactions_message& compact_block_transactions_message_received);
+      void process_rebuilt_compact_block(peer_connection* originating_peer, const signed_block& block);
+
       void process_ordinary_message(peer_connection* originating_peer, const message& message_to_process, const message_hash_type& message_hash);
 
       void start_synchronizing();
@@ -751,7 +801,8 @@ namespace graphene { namespace net { namespace detail {
       void                       set_total_bandwidth_limit( uint32_t upload_bytes_per_second, uint32_t download_bytes_per_second );
       void                       disable_peer_advertising();
       fc::variant_object         get_call_statistics() const;
-      message                    get_message_for_item(const item_id& item) override;
+      message                    get_message_for_item(const item_id& item);
+      serialized_message_ptr     get_serialized_message_for_item(const item_id& item) override;
 
       fc::variant_object         network_get_info() const;
       fc::variant_object         network_get_usage_stats() const;
@@ -789,6 +840,7 @@ namespace graphene { namespace net { namespace detail {
 # define VERIFY_CORRECT_THREAD() do {} while (0)
 #endif
 
+// how many sync blocks we push to the client in a row before letting the fetch loop top up the reorder buffer
 #define MAXIMUM_NUMBER_OF_BLOCKS_TO_HANDLE_AT_ONE_TIME 200
 #define MAXIMUM_NUMBER_OF_BLOCKS_TO_PREFETCH (10 * MAXIMUM_NUMBER_OF_BLOCKS_TO_HANDLE_AT_ONE_TIME)
 
@@ -825,7 +877,8 @@ namespace graphene { namespace net { namespace detail {
       _node_is_shutting_down(false),
       _maximum_number_of_blocks_to_handle_at_one_time(MAXIMUM_NUMBER_OF_BLOCKS_TO_HANDLE_AT_ONE_TIME),
       _maximum_number_of_sync_blocks_to_prefetch(MAXIMUM_NUMBER_OF_BLOCKS_TO_PREFETCH),
-      _maximum_blocks_per_peer_during_syncing(GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING)
+      _maximum_blocks_per_peer_during_syncing(GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING),
+      _compact_blocks_enabled(true)
     {
       _rate_limiter.set_actual_rate_time_constant(fc::seconds(2));
       fc::rand_pseudo_bytes(&_node_id.data[0], (int)_node_id.size());
@@ -994,10 +1047,7 @@ namespace graphene { namespace net { namespace detail {
     bool node_impl::have_already_received_sync_item( const item_hash_t& item_hash )
     {
       VERIFY_CORRECT_THREAD();
-      return std::find_if(_received_sync_items.begin(), _received_sync_items.end(),
-                          [&item_hash]( const graphene::net::block_message& message ) { return message.block_id == item_hash; } ) != _received_sync_items.end() ||
-             std::find_if(_new_received_sync_items.begin(), _new_received_sync_items.end(),
-                          [&item_hash]( const graphene::net::block_message& message ) { return message.block_id == item_hash; } ) != _new_received_sync_items.end();                          ;
+      return _received_sync_items.find(item_hash) != _received_sync_items.end();
     }
 
     void node_impl::request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request )
@@ -1022,9 +1072,33 @@ namespace graphene { namespace net { namespace detail {
         item_id item_id_to_request( graphene::net::block_message_type, item_to_request );
         peer->sync_items_requested_from_peer.insert( peer_connection::item_to_time_map_type::value_type(item_id_to_request, fc::time_point::now() ) );
       }
+      peer->sync_window_requested_time = fc::time_point::now();
+      peer->sync_window_size = items_to_request.size();
       peer->send_message(fetch_items_message(graphene::net::block_message_type, items_to_request));
     }
 
+    uint32_t node_impl::get_sync_window_size( const peer_connection_ptr& peer ) const
+    {
+      VERIFY_CORRECT_THREAD();
+      return detail::get_sync_window_size(*peer, _maximum_blocks_per_peer_during_syncing);
+    }
+
+    void node_impl::record_sync_window_completed( peer_connection* peer )
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::microseconds window_duration = fc::time_point::now() - peer->sync_window_requested_time;
+      if (window_duration <= fc::microseconds(0) || peer->sync_window_size == 0)
+        return;
+      double blocks_per_second = peer->sync_window_size * 1000000.0 / window_duration.count();
+      // smooth the rate so one slow window doesn't starve a peer that is usually fast
+      peer->sync_blocks_per_second = peer->sync_blocks_per_second > 0 ?
+                                       (3 * peer->sync_blocks_per_second + blocks_per_second) / 4 :
+                                       blocks_per_second;
+      peer->sync_window_size = 0;
+      dlog("peer ${endpoint} delivered its sync window at ${rate} blocks/s, smoothed rate is now ${smoothed}",
+           ("endpoint", peer->get_remote_endpoint())("rate", blocks_per_second)("smoothed", peer->sync_blocks_per_second));
+    }
+
     void node_impl::fetch_sync_items_loop()
     {
       VERIFY_CORRECT_THREAD();
@@ -1033,39 +1107,71 @@ namespace graphene { namespace net { namespace detail {
         _sync_items_to_fetch_updated = false;
         dlog( "beginning another iteration of the sync items loop" );
 
-        if (!_suspend_fetching_sync_blocks)
+        if (_active_sync_requests.empty())
+          _reassigned_sync_requests.clear();
+
         {
           std::map<peer_connection_ptr, std::vector<item_hash_t> > sync_item_requests_to_send;
 
           {
             ASSERT_TASK_NOT_PREEMPTED();
             std::set<item_hash_t> sync_items_to_request;
+            fc::time_point now = fc::time_point::now();
 
-            // for each idle peer that we're syncing with
+            // the fastest peers get the earliest windows, which are the ones the reorder buffer is waiting on
+            std::vector<peer_connection_ptr> idle_sync_peers;
+            std::vector<peer_connection_ptr> straggling_sync_peers;
             for( const peer_connection_ptr& peer : _active_connections )
             {
-              if( peer->we_need_sync_items_from_peer &&
-                  sync_item_requests_to_send.find(peer) == sync_item_requests_to_send.end() && // if we've already scheduled a request for this peer, don't consider scheduling another
-                  peer->idle() )
+              if( !peer->we_need_sync_items_from_peer || peer->inhibit_fetching_sync_blocks )
+                continue;
+              if( peer->idle() )
+                idle_sync_peers.push_back(peer);
+              else if( is_straggling_sync_peer(*peer, now) )
+                straggling_sync_peers.push_back(peer);
+            }
+            std::sort(idle_sync_peers.begin(), idle_sync_peers.end(),
+                      [](const peer_connection_ptr& a, const peer_connection_ptr& b) {
+                        return a->sync_blocks_per_second > b->sync_blocks_per_second;
+                      });
+
+            // hand the blocks a straggler still owes us to the fastest idle peers that can provide them.
+            // The straggler's request stands; whichever copy arrives first is used
+            for( const peer_connection_ptr& straggler : straggling_sync_peers )
+            {
+              unsigned items_reassigned = reassign_straggling_sync_items(*straggler, idle_sync_peers,
+                                                                         _maximum_blocks_per_peer_during_syncing,
+                                                                         _received_sync_items, _reassigned_sync_requests,
+                                                                         sync_items_to_request, sync_item_requests_to_send);
+              if( items_reassigned )
               {
-                if (!peer->inhibit_fetching_sync_blocks)
+                wlog( "sync peer ${endpoint} is straggling, asking other peers for ${count} of its blocks",
+                      ("endpoint", straggler->get_remote_endpoint())("count", items_reassigned) );
+                // it has shown it can't keep up with its measured rate, so its next window should be smaller
+                straggler->sync_blocks_per_second /= 2;
+              }
+            }
+
+            // then give each idle peer the next window of blocks it has that nobody has been asked for yet.
+            // While the reorder buffer is full we only chase stragglers, since they are what it's waiting on
+            if( _suspend_fetching_sync_blocks )
+              dlog("fetch_sync_items_loop is suspended pending backlog processing");
+            else for( const peer_connection_ptr& peer : idle_sync_peers )
+            {
+              std::vector<item_hash_t>& peer_requests = sync_item_requests_to_send[peer];
+              uint32_t window_size = get_sync_window_size(peer);
+              // loop through the items it has that we don't yet have on our blockchain
+              for( unsigned i = 0; i < peer->ids_of_items_to_get.size() && peer_requests.size() < window_size; ++i )
+              {
+                item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[i];
+                // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
+                if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
+                    sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
+                    _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() ) // we've requested it in a previous iteration and we're still waiting for it to arrive
                 {
-                  // loop through the items it has that we don't yet have on our blockchain
-                  for( unsigned i = 0; i < peer->ids_of_items_to_get.size(); ++i )
-                  {
-                    item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[i];
-                    // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
-                    if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
-                        sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
-                        _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() ) // we've requested it in a previous iteration and we're still waiting for it to arrive
-                    {
-                      // then schedule a request from this peer
-                      sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
-                      sync_items_to_request.insert( item_to_potentially_request );
-                      if (sync_item_requests_to_send[peer].size() >= _maximum_blocks_per_peer_during_syncing)
-                        break;
-                    }
-                  }
+                  // then schedule a request from this peer
+                  peer_requests.push_back(item_to_potentially_request);
+                  sync_items_to_request.insert( item_to_potentially_request );
                 }
               }
             }
@@ -1073,17 +1179,26 @@ namespace graphene { namespace net { namespace detail {
 
           // make all the requests we scheduled in the loop above
           for( auto sync_item_request : sync_item_requests_to_send )
-            request_sync_items_from_peer( sync_item_request.first, sync_item_request.second );
+            if( !sync_item_request.second.empty() )
+              request_sync_items_from_peer( sync_item_request.first, sync_item_request.second );
           sync_item_requests_to_send.clear();
         }
-        else
-          dlog("fetch_sync_items_loop is suspended pending backlog processing");
 
         if( !_sync_items_to_fetch_updated )
         {
           dlog( "no sync items to fetch right now, going to sleep" );
           _retrigger_fetch_sync_items_loop_promise = fc::promise<void>::ptr( new fc::promise<void>("graphene::net::retrigger_fetch_sync_items_loop") );
-          _retrigger_fetch_sync_items_loop_promise->wait();
+          try
+          {
+            // while requests are outstanding, wake up periodically to look for stragglers
+            if( _active_sync_requests.empty() )
+              _retrigger_fetch_sync_items_loop_promise->wait();
+            else
+              _retrigger_fetch_sync_items_loop_promise->wait(fc::seconds(GRAPHENE_NET_MIN_SYNC_STRAGGLER_TIMEOUT_SEC));
+          }
+          catch (const fc::timeout_exception&)
+          {
+          }
           _retrigger_fetch_sync_items_loop_promise.reset();
         }
       } // while( !canceled )
@@ -1201,7 +1316,12 @@ namespace graphene { namespace net { namespace detail {
                  ("count", items_by_type.second.size())("type", (uint32_t)items_by_type.first)
                  ("endpoint", peer_and_items.peer->get_remote_endpoint())
                  ("hashes", items_by_type.second));
-            peer_and_items.peer->send_message(fetch_items_message(items_by_type.first,
+            uint32_t item_type_to_request = items_by_type.first;
+            // the peer answers this with compact_block_messages; the block we rebuild from them
+            // has the same message hash, so the request is still tracked as a block_message
+            if (item_type_to_request == block_message_type && _compact_blocks_enabled && peer_and_items.peer->supports_compact_blocks)
+              item_type_to_request = compact_block_message_type;
+            peer_and_items.peer->send_message(fetch_items_message(item_type_to_request,
                                                                   items_by_type.second));
           }
         }
@@ -1811,6 +1931,15 @@ namespace graphene { namespace net { namespace detail {
       case core_message_type_enum::get_current_connections_reply_message_type:
         on_get_current_connections_reply_message(originating_peer, received_message.as<get_current_connections_reply_message>());
         break;
+      case core_message_type_enum::compact_block_message_type:
+        on_compact_block_message(originating_peer, received_message.as<compact_block_message>());
+        break;
+      case core_message_type_enum::fetch_compact_block_transactions_message_type:
+        on_fetch_compact_block_transactions_message(originating_peer, received_message.as<fetch_compact_block_transactions_message>());
+        break;
+      case core_message_type_enum::compact_block_transactions_message_type:
+        on_compact_block_transactions_message(originating_peer, received_message.as<compact_block_transactions_message>());
+        break;
 
       default:
         // ignore any message in between core_message_type_first and _last that we don't handle above
@@ -1854,6 +1983,9 @@ namespace graphene { namespace net { namespace detail {
       if (!_hard_fork_block_numbers.empty())
         user_data["last_known_fork_block_number"] = _hard_fork_block_numbers.back();
 
+      if (_compact_blocks_enabled)
+        user_data["compact_blocks"] = true;
+
       return user_data;
     }
     void node_impl::parse_hello_user_data_for_peer(peer_connection* originating_peer, const fc::variant_object& user_data)
@@ -1876,6 +2008,8 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->node_id = user_data["node_id"].as<node_id_t>();
       if (user_data.contains("last_known_fork_block_number"))
         originating_peer->last_known_fork_block_number = user_data["last_known_fork_block_number"].as<uint32_t>();
+      if (user_data.contains("compact_blocks"))
+        originating_peer->supports_compact_blocks = user_data["compact_blocks"].as<bool>();
     }
 
     void node_impl::on_hello_message( peer_connection* originating_peer, const hello_message& hello_message_received )
@@ -2702,6 +2836,27 @@ namespace graphene { namespace net { namespace detail {
       }
     }
 
+    serialized_message_ptr node_impl::get_serialized_message_for_item(const item_id& item)
+    {
+      try
+      {
+        return _message_cache.get_serialized_message(item.item_hash);
+      }
+      catch (fc::key_not_found_exception&)
+      {}
+      // blocks are queued for sending by block id, which is what the cache knows as their contents
+      if (item.item_type == block_message_type)
+      {
+        try
+        {
+          return _message_cache.get_serialized_message_by_contents_hash(item.item_hash);
+        }
+        catch (fc::key_not_found_exception&)
+        {}
+      }
+      return serialize_message(get_message_for_item(item));
+    }
+
     message node_impl::get_message_for_item(const item_id& item)
     {
       try
@@ -2727,20 +2882,38 @@ namespace graphene { namespace net { namespace detail {
            ("type", fetch_items_message_received.item_type)
            ("endpoint", originating_peer->get_remote_endpoint()));
 
-      fc::optional<message> last_block_message_sent;
+      if (fetch_items_message_received.item_type == compact_block_message_type)
+      {
+        send_compact_blocks(originating_peer, fetch_items_message_received.items_to_fetch);
+        return;
+      }
+
+      fc::optional<block_id_type> last_block_id_sent;
 
-      std::list<message> reply_messages;
+      struct reply
+      {
+        serialized_message_ptr      cached_message;  // the copy serialized when the item was cached, if it was
+        message                     message_to_send;
+        fc::optional<block_id_type> block_id;        // blocks are queued by id instead
+      };
+      std::list<reply> reply_messages;
       for (const item_hash_t& item_hash : fetch_items_message_received.items_to_fetch)
       {
         try
         {
-          message requested_message = _message_cache.get_message(item_hash);
+          fc::uint160_t message_contents_hash;
+          serialized_message_ptr requested_message = _message_cache.get_serialized_message(item_hash, &message_contents_hash);
           dlog("received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
                ("endpoint", originating_peer->get_remote_endpoint())
-               ("id", requested_message.id()));
-          reply_messages.push_back(requested_message);
+               ("id", item_hash));
           if (fetch_items_message_received.item_type == block_message_type)
-            last_block_message_sent = requested_message;
+          {
+            // blocks are cached under their block id
+            last_block_id_sent = block_id_type(message_contents_hash);
+            reply_messages.push_back(reply{serialized_message_ptr(), message(), last_block_id_sent});
+          }
+          else
+            reply_messages.push_back(reply{requested_message, message(), fc::optional<block_id_type>()});
           continue;
         }
         catch (fc::key_not_found_exception&)
@@ -2756,33 +2929,41 @@ namespace graphene { namespace net { namespace detail {
                ("id", requested_message.id())
                ("size", requested_message.size)
                ("endpoint", originating_peer->get_remote_endpoint()));
-          reply_messages.push_back(requested_message);
           if (fetch_items_message_received.item_type == block_message_type)
-            last_block_message_sent = requested_message;
+          {
+            last_block_id_sent = requested_message.as<graphene::net::block_message>().block_id;
+            reply_messages.push_back(reply{serialized_message_ptr(), message(), last_block_id_sent});
+          }
+          else
+            reply_messages.push_back(reply{serialized_message_ptr(), requested_message, fc::optional<block_id_type>()});
           continue;
         }
         catch (fc::key_not_found_exception&)
         {
-          reply_messages.push_back(item_not_available_message(item_to_fetch));
+          reply_messages.push_back(reply{serialized_message_ptr(), item_not_available_message(item_to_fetch), fc::optional<block_id_type>()});
           dlog("received item request from peer ${endpoint} but we don't have it",
                ("endpoint", originating_peer->get_remote_endpoint()));
         }
       }
 
       // if we sent them a block, update our record of the last block they've seen accordingly
-      if (last_block_message_sent)
+      if (last_block_id_sent)
       {
-        graphene::net::block_message block = last_block_message_sent->as<graphene::net::block_message>();
-        originating_peer->last_block_delegate_has_seen = block.block_id;
-        originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(block.block_id);
+        originating_peer->last_block_delegate_has_seen = *last_block_id_sent;
+        originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(*last_block_id_sent);
       }
 
-      for (const message& reply : reply_messages)
+      for (const reply& reply_to_send : reply_messages)
       {
-        if (reply.msg_type == block_message_type)
-          originating_peer->send_item(item_id(block_message_type, reply.as<graphene::net::block_message>().block_id));
+        // blocks only count as an item id against the peer's queue limit while they wait.  When one reaches
+        // the front of the queue, get_serialized_message_for_item() takes it from the message cache if it's
+        // still there, or has the delegate load it again
+        if (reply_to_send.block_id)
+          originating_peer->send_item(item_id(block_message_type, *reply_to_send.block_id));
+        else if (reply_to_send.cached_message)
+          originating_peer->send_message(reply_to_send.cached_message);
         else
-          originating_peer->send_message(reply);
+          originating_peer->send_message(reply_to_send.message_to_send);
       }
     }
 
@@ -3170,126 +3351,86 @@ namespace graphene { namespace net { namespace detail {
         start_synchronizing_with_peer(peer);
 
       dlog("Leaving send_sync_block_to_node_delegate");
-
-      if (// _suspend_fetching_sync_blocks && <-- you can use this if "maximum_number_of_blocks_to_handle_at_one_time" == "maximum_number_of_sync_blocks_to_prefetch"
-          !_node_is_shutting_down &&
-          (!_process_backlog_of_sync_blocks_done.valid() || _process_backlog_of_sync_blocks_done.ready()))
-        _process_backlog_of_sync_blocks_done = fc::async([=](){ process_backlog_of_sync_blocks(); },
-                                                         "process_backlog_of_sync_blocks");
     }
 
     void node_impl::process_backlog_of_sync_blocks()
     {
       VERIFY_CORRECT_THREAD();
-      // garbage-collect the list of async tasks here for lack of a better place
-      for (auto calls_iter = _handle_message_calls_in_progress.begin();
-            calls_iter != _handle_message_calls_in_progress.end();)
-      {
-        if (calls_iter->ready())
-          calls_iter = _handle_message_calls_in_progress.erase(calls_iter);
-        else
-          ++calls_iter;
-      }
-
-      dlog("in process_backlog_of_sync_blocks");
-      if (_handle_message_calls_in_progress.size() >= _maximum_number_of_blocks_to_handle_at_one_time)
-      {
-        dlog("leaving process_backlog_of_sync_blocks because we're already processing too many blocks");
-        return; // we will be rescheduled when the next block finishes its processing
-      }
-      dlog("currently ${count} blocks in the process of being handled", ("count", _handle_message_calls_in_progress.size()));
-
-
-      if (_suspend_fetching_sync_blocks)
-      {
-        dlog("resuming processing sync block backlog because we only ${count} blocks in progress",
-             ("count", _handle_message_calls_in_progress.size()));
-        _suspend_fetching_sync_blocks = false;
-      }
+      dlog("in process_backlog_of_sync_blocks, ${count} sync items to consider", ("count", _received_sync_items.size()));
 
-
-      // when syncing with multiple peers, it's possible that we'll have hundreds of blocks ready to push
-      // to the client at once.  This can be slow, and we need to limit the number we push at any given
-      // time to allow network traffic to continue so we don't end up disconnecting from peers
-      //fc::time_point start_time = fc::time_point::now();
-      //fc::time_point when_we_should_yield = start_time + fc::seconds(1);
-
-      bool block_processed_this_iteration;
+      // blocks arrive from many peers in whatever order their windows complete.  Push the
+      // contiguous run that starts at the head of the chain to the client, one block after the
+      // other in this task, and leave the rest in the reorder buffer until the gap before them fills
       unsigned blocks_processed = 0;
-
-      std::set<peer_connection_ptr> peers_with_newly_empty_item_lists;
-      std::set<peer_connection_ptr> peers_we_need_to_sync_to;
-      std::map<peer_connection_ptr, fc::oexception> peers_with_rejected_block;
-
-      do
+      unsigned blocks_processed_since_fetch = 0;
+      while (!_node_is_shutting_down)
       {
-        std::copy(std::make_move_iterator(_new_received_sync_items.begin()),
-                  std::make_move_iterator(_new_received_sync_items.end()),
-                  std::front_inserter(_received_sync_items));
-        _new_received_sync_items.clear();
-        dlog("currently ${count} sync items to consider", ("count", _received_sync_items.size()));
-
-        block_processed_this_iteration = false;
-        for (auto received_block_iter = _received_sync_items.begin();
-             received_block_iter != _received_sync_items.end();
-             ++received_block_iter)
+        graphene::net::block_message block_message_to_process;
+        bool already_accepted = false;
         {
+          ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
+
+          // the next block is the one at the front of some peer's list of blocks we still need
+          auto next_block_iter = find_next_sync_block(_active_connections, _received_sync_items);
+          if (next_block_iter == _received_sync_items.end())
+            break;
 
-          // find out if this block is the next block on the active chain or one of the forks
-          bool potential_first_block = false;
+          block_message_to_process = std::move(next_block_iter->second);
+          _received_sync_items.erase(next_block_iter);
+
+          // we can get into an interesting situation near the end of synchronization.  We can be in
+          // sync with one peer who is sending us the last block on the chain via a regular inventory
+          // message, while at the same time still be synchronizing with a peer who is sending us the
+          // block through the sync mechanism.  Further, we must request both blocks because
+          // we don't know they're the same (for the peer in normal operation, it has only told us the
+          // message id, for the peer in the sync case we only known the block_id).
+          already_accepted = std::find(_most_recent_blocks_accepted.begin(), _most_recent_blocks_accepted.end(),
+                                       block_message_to_process.block_id) != _most_recent_blocks_accepted.end();
           for (const peer_connection_ptr& peer : _active_connections)
-          {
-            ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
             if (!peer->ids_of_items_to_get.empty() &&
-                peer->ids_of_items_to_get.front() == received_block_iter->block_id)
+                peer->ids_of_items_to_get.front() == block_message_to_process.block_id)
             {
-              potential_first_block = true;
               peer->ids_of_items_to_get.pop_front();
-              peer->ids_of_items_being_processed.insert(received_block_iter->block_id);
+              if (!already_accepted)
+                peer->ids_of_items_being_processed.insert(block_message_to_process.block_id);
             }
-          }
+        }
 
-          // if it is, process it, remove it from all sync peers lists
-          if (potential_first_block)
-          {
-            // we can get into an interesting situation near the end of synchronization.  We can be in
-            // sync with one peer who is sending us the last block on the chain via a regular inventory
-            // message, while at the same time still be synchronizing with a peer who is sending us the
-            // block through the sync mechanism.  Further, we must request both blocks because
-            // we don't know they're the same (for the peer in normal operation, it has only told us the
-            // message id, for the peer in the sync case we only known the block_id).
-            if (std::find(_most_recent_blocks_accepted.begin(), _most_recent_blocks_accepted.end(),
-                          received_block_iter->block_id) == _most_recent_blocks_accepted.end())
-            {
-              graphene::net::block_message block_message_to_process = *received_block_iter;
-              _received_sync_items.erase(received_block_iter);
-              _handle_message_calls_in_progress.emplace_back(fc::async([this, block_message_to_process](){
-                send_sync_block_to_node_delegate(block_message_to_process);
-              }, "send_sync_block_to_node_delegate"));
-              ++blocks_processed;
-              block_processed_this_iteration = true;
-            }
-            else
-              dlog("Already received and accepted this block (presumably through normal inventory mechanism), treating it as accepted");
+        if (already_accepted)
+        {
+          dlog("Already received and accepted this block (presumably through normal inventory mechanism), treating it as accepted");
+          continue;
+        }
 
-            break; // start iterating _received_sync_items from the beginning
-          } // end if potential_first_block
-        } // end for each block in _received_sync_items
+        send_sync_block_to_node_delegate(block_message_to_process);
+        ++blocks_processed;
 
-        if (_handle_message_calls_in_progress.size() >= _maximum_number_of_blocks_to_handle_at_one_time)
+        if (++blocks_processed_since_fetch >= _maximum_number_of_blocks_to_handle_at_one_time)
         {
-          dlog("stopping processing sync block backlog because we have ${count} blocks in progress",
-               ("count", _handle_message_calls_in_progress.size()));
-          //ulog("stopping processing sync block backlog because we have ${count} blocks in progress, total on hand: ${received}",
-          //     ("count", _handle_message_calls_in_progress.size())("received", _received_sync_items.size()));
-          if (_received_sync_items.size() >= _maximum_number_of_sync_blocks_to_prefetch)
-            _suspend_fetching_sync_blocks = true;
-          break;
+          // a long run can take a while to push; keep the download going behind it
+          blocks_processed_since_fetch = 0;
+          if (_received_sync_items.size() < _maximum_number_of_sync_blocks_to_prefetch)
+          {
+            _suspend_fetching_sync_blocks = false;
+            trigger_fetch_sync_items_loop();
+          }
         }
-      } while (block_processed_this_iteration);
+      }
+
+      // a full buffer that can't drain may be holding blocks nobody lists any more, e.g. ones whose
+      // peer disconnected; they'd otherwise count against the prefetch limit forever
+      if (_received_sync_items.size() >= _maximum_number_of_sync_blocks_to_prefetch)
+      {
+        ASSERT_TASK_NOT_PREEMPTED();
+        size_t blocks_removed = remove_unneeded_sync_blocks(_active_connections, _received_sync_items);
+        if (blocks_removed)
+          dlog("dropped ${count} sync blocks no peer lists any more", ("count", blocks_removed));
+      }
 
-      dlog("leaving process_backlog_of_sync_blocks, ${count} processed", ("count", blocks_processed));
+      dlog("leaving process_backlog_of_sync_blocks, ${count} processed, ${remaining} waiting in the reorder buffer",
+           ("count", blocks_processed)("remaining", _received_sync_items.size()));
 
+      _suspend_fetching_sync_blocks = _received_sync_items.size() >= _maximum_number_of_sync_blocks_to_prefetch;
       if (!_suspend_fetching_sync_blocks)
         trigger_fetch_sync_items_loop();
     }
@@ -3307,9 +3448,23 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "received a sync block from peer ${endpoint}", ("endpoint", originating_peer->get_remote_endpoint() ) );
 
-      // add it to the front of _received_sync_items, then process _received_sync_items to try to
-      // pass as many messages as possible to the client.
-      _new_received_sync_items.push_front( block_message_to_process );
+      // a straggler we also asked another peer for may deliver a block we've already handled.  Once
+      // handled it's gone from every peer's ids_of_items_to_get; _most_recent_blocks_accepted is too
+      // short to catch it, and a copy left in the reorder buffer would never drain
+      if (have_already_received_sync_item(block_message_to_process.block_id) ||
+          !is_sync_block_still_needed(_active_connections, block_message_to_process.block_id))
+      {
+        dlog("ignoring a second copy of sync block ${id}", ("id", block_message_to_process.block_id));
+        return;
+      }
+      if (_delegate->has_item(item_id(block_message_type, block_message_to_process.block_id)))
+      {
+        dlog("ignoring sync block ${id}, we already have it", ("id", block_message_to_process.block_id));
+        return;
+      }
+
+      // add it to the reorder buffer, then push as many blocks from it as possible to the client
+      _received_sync_items[block_message_to_process.block_id] = block_message_to_process;
       trigger_process_backlog_of_sync_blocks();
     }
 
@@ -3487,6 +3642,9 @@ namespace graphene { namespace net { namespace detail {
         {
           originating_peer->sync_items_requested_from_peer.erase(sync_item_iter);
           _active_sync_requests.erase(block_message_to_process.block_id);
+          _reassigned_sync_requests.erase(block_message_to_process.block_id);
+          if (originating_peer->sync_items_requested_from_peer.empty())
+            record_sync_window_completed(originating_peer);
           process_block_during_sync(originating_peer, block_message_to_process, message_hash);
           if (originating_peer->idle())
           {
@@ -3515,6 +3673,202 @@ namespace graphene { namespace net { namespace detail {
       disconnect_from_peer(originating_peer, "You sent me a block that I didn't ask for", true, detailed_error);
     }
 
+    void node_impl::send_compact_blocks(peer_connection* originating_peer, const std::vector<item_hash_t>& block_message_hashes)
+    {
+      VERIFY_CORRECT_THREAD();
+      for (const item_hash_t& block_message_hash : block_message_hashes)
+      {
+        // most requests are for the block we've just advertised to all of our peers
+        auto recent_iter = std::find_if(_recent_compact_blocks.begin(), _recent_compact_blocks.end(),
+                                        [&block_message_hash](const recent_compact_block& recent_block) {
+                                          return recent_block.block_message_hash == block_message_hash;
+                                        });
+        recent_compact_block compact_block;
+        if (recent_iter != _recent_compact_blocks.end())
+          compact_block = *recent_iter;
+        else
+        {
+          item_id requested_item(block_message_type, block_message_hash);
+          message requested_message = get_message_for_item(requested_item);
+          if (requested_message.msg_type != block_message_type)
+          {
+            dlog("received compact block request from peer ${endpoint} but we don't have it",
+                 ("endpoint", originating_peer->get_remote_endpoint()));
+            originating_peer->send_message(item_not_available_message(requested_item));
+            continue;
+          }
+
+          graphene::net::block_message block = requested_message.as<graphene::net::block_message>();
+          compact_block = recent_compact_block{block_message_hash, block.block_id, block.block.timestamp,
+                                               serialize_message(make_compact_block_message(block.block, block.block_id, block_message_hash))};
+          _recent_compact_blocks.push_back(compact_block);
+          if (_recent_compact_blocks.size() > GRAPHENE_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS)
+            _recent_compact_blocks.pop_front();
+        }
+
+        originating_peer->last_block_delegate_has_seen = compact_block.block_id;
+        originating_peer->last_block_time_delegate_has_seen = compact_block.timestamp;
+        originating_peer->send_message(compact_block.compact_block);
+      }
+    }
+
+    void node_impl::on_compact_block_message(peer_connection* originating_peer, const compact_block_message& compact_block_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      const item_hash_t& block_message_hash = compact_block_message_received.block_message_hash;
+      if (!is_expected_compact_block(*originating_peer, compact_block_message_received))
+      {
+        wlog("received a compact block ${block_id} I didn't ask for from peer ${endpoint}, disconnecting from peer",
+             ("endpoint", originating_peer->get_remote_endpoint())
+             ("block_id", compact_block_message_received.block_id));
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a compact block that I didn't ask for, block_id: ${block_id}",
+                                                    ("block_id", compact_block_message_received.block_id)));
+        disconnect_from_peer(originating_peer, "You sent me a compact block that I didn't ask for", true, detailed_error);
+        return;
+      }
+
+      if (compact_block_message_received.block_id != compact_block_message_received.header.id())
+      {
+        wlog("compact block ${block_id} from peer ${endpoint} doesn't match its header",
+             ("endpoint", originating_peer->get_remote_endpoint())
+             ("block_id", compact_block_message_received.block_id));
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "The id of compact block ${block_id} doesn't match its header",
+                                                    ("block_id", compact_block_message_received.block_id)));
+        disconnect_from_peer(originating_peer, "You sent me a compact block whose id doesn't match its header", true, detailed_error);
+        return;
+      }
+
+      auto lookup_transaction = [this](const item_hash_t& transaction_message_hash) -> fc::optional<signed_transaction> {
+        try
+        {
+          message transaction_message = _message_cache.get_message(transaction_message_hash);
+          if (transaction_message.msg_type == trx_message_type)
+            return transaction_message.as<trx_message>().trx;
+        }
+        catch (fc::key_not_found_exception&)
+        {}
+        return fc::optional<signed_transaction>();
+      };
+
+      peer_connection::partial_compact_block partial_block;
+      partial_block.block_message_hash = block_message_hash;
+      try
+      {
+        partial_block.missing_transaction_indices = rebuild_compact_block(compact_block_message_received, lookup_transaction, partial_block.block);
+      }
+      catch (const fc::exception& e)
+      {
+        wlog("peer ${endpoint} sent me an invalid compact block: ${e}",
+             ("endpoint", originating_peer->get_remote_endpoint())("e", e));
+        disconnect_from_peer(originating_peer, "You sent me an invalid compact block", true, e);
+        return;
+      }
+
+      if (partial_block.missing_transaction_indices.empty())
+      {
+        process_rebuilt_compact_block(originating_peer, partial_block.block);
+        return;
+      }
+
+      dlog("missing ${count} of ${total} transactions for compact block ${block_id}, asking peer ${endpoint} for them",
+           ("count", partial_block.missing_transaction_indices.size())
+           ("total", partial_block.block.transactions.size())
+           ("block_id", compact_block_message_received.block_id)
+           ("endpoint", originating_peer->get_remote_endpoint()));
+      fetch_compact_block_transactions_message request(compact_block_message_received.block_id,
+                                                       partial_block.missing_transaction_indices);
+      originating_peer->compact_blocks_awaiting_transactions[compact_block_message_received.block_id] = std::move(partial_block);
+      originating_peer->send_message(request);
+    }
+
+    void node_impl::on_fetch_compact_block_transactions_message(peer_connection* originating_peer,
+                                                                const fetch_compact_block_transactions_message& fetch_compact_block_transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      std::vector<signed_transaction> transactions;
+      try
+      {
+        // they ask right after we send them the compact block, by which time we have accepted the block
+        graphene::net::block_message requested_block_message =
+          _delegate->get_item(item_id(block_message_type, fetch_compact_block_transactions_message_received.block_id)).as<graphene::net::block_message>();
+        const signed_block& requested_block = requested_block_message.block;
+        transactions.reserve(fetch_compact_block_transactions_message_received.transaction_indices.size());
+        for (uint32_t transaction_index : fetch_compact_block_transactions_message_received.transaction_indices)
+        {
+          FC_ASSERT(transaction_index < requested_block.transactions.size());
+          transactions.push_back(requested_block.transactions[transaction_index]);
+        }
+      }
+      catch (const fc::canceled_exception&)
+      {
+        throw;
+      }
+      catch (const fc::exception& e)
+      {
+        // an empty reply tells the peer we can't complete the block, it will get it from someone else
+        wlog("unable to supply transactions for compact block ${block_id} to peer ${endpoint}: ${e}",
+             ("block_id", fetch_compact_block_transactions_message_received.block_id)
+             ("endpoint", originating_peer->get_remote_endpoint())("e", e));
+        transactions.clear();
+      }
+      originating_peer->send_message(compact_block_transactions_message(fetch_compact_block_transactions_message_received.block_id,
+                                                                        std::move(transactions)));
+    }
+
+    void node_impl::on_compact_block_transactions_message(peer_connection* originating_peer,
+                                                          const compact_block_transactions_message& compact_block_transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      auto partial_block_iter = originating_peer->compact_blocks_awaiting_transactions.find(compact_block_transactions_message_received.block_id);
+      if (partial_block_iter == originating_peer->compact_blocks_awaiting_transactions.end())
+      {
+        wlog("received transactions for compact block ${block_id} I didn't ask for from peer ${endpoint}",
+             ("endpoint", originating_peer->get_remote_endpoint())
+             ("block_id", compact_block_transactions_message_received.block_id));
+        return;
+      }
+      peer_connection::partial_compact_block partial_block = std::move(partial_block_iter->second);
+      originating_peer->compact_blocks_awaiting_transactions.erase(partial_block_iter);
+
+      try
+      {
+        fill_compact_block_transactions(partial_block.missing_transaction_indices,
+                                        compact_block_transactions_message_received.transactions,
+                                        partial_block.block);
+      }
+      catch (const fc::exception& e)
+      {
+        // the block is still in items_requested_from_peer, so disconnecting puts it back
+        // on the list of items to fetch from our other peers
+        wlog("peer ${endpoint} couldn't complete compact block ${block_id}: ${e}",
+             ("endpoint", originating_peer->get_remote_endpoint())
+             ("block_id", compact_block_transactions_message_received.block_id)("e", e));
+        disconnect_from_peer(originating_peer, "You didn't send me the transactions for the compact block I asked for", true, e);
+        return;
+      }
+      process_rebuilt_compact_block(originating_peer, partial_block.block);
+    }
+
+    void node_impl::process_rebuilt_compact_block(peer_connection* originating_peer, const signed_block& block)
+    {
+      VERIFY_CORRECT_THREAD();
+      // the chain would reject it anyway, but checking here keeps a bad peer from reaching the delegate
+      if (block.calculate_merkle_root() != block.transaction_merkle_root)
+      {
+        wlog("compact block ${block_id} from peer ${endpoint} doesn't match its merkle root",
+             ("block_id", block.id())("endpoint", originating_peer->get_remote_endpoint()));
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "The transactions in compact block ${block_id} don't match its merkle root",
+                                                    ("block_id", block.id())));
+        disconnect_from_peer(originating_peer, "You sent me a compact block that doesn't match its merkle root", true, detailed_error);
+        return;
+      }
+
+      // a rebuilt block serializes to exactly the block_message the peer advertised, so its
+      // hash matches the entry in items_requested_from_peer
+      message rebuilt_block_message(graphene::net::block_message{block});
+      process_block_message(originating_peer, rebuilt_block_message, rebuilt_block_message.id());
+    }
+
     void node_impl::on_current_time_request_message(peer_connection* originating_peer,
                                                     const current_time_request_message& current_time_request_message_received)
     {
@@ -3820,6 +4174,27 @@ namespace graphene { namespace net { namespace detail {
         {
           throw;
         }
+        catch ( const invalid_transaction_exception& e )
+        {
+          // unlike a stale or conflicting transaction, this one was never going to be accepted by anyone
+          _recently_failed_items.insert(peer_connection::timestamped_item_id(item_id(message_to_process.msg_type, message_hash ), fc::time_point::now()));
+          ++originating_peer->invalid_transactions_received;
+          fc::time_point now = fc::time_point::now();
+          if (now - originating_peer->invalid_transactions_minute_start > fc::minutes(1))
+          {
+            originating_peer->invalid_transactions_minute_start = now;
+            originating_peer->invalid_transactions_this_minute = 0;
+          }
+          if (++originating_peer->invalid_transactions_this_minute > GRAPHENE_NET_MAX_INVALID_TRANSACTIONS_PER_MINUTE)
+          {
+            wlog( "disconnecting peer ${peer}, it sent us ${count} invalid transactions in the last minute",
+                  ("peer", originating_peer->get_remote_endpoint())("count", originating_peer->invalid_transactions_this_minute) );
+            disconnect_from_peer( originating_peer, "You sent me too many invalid transactions", true, e );
+          }
+          else
+            dlog( "client rejected invalid transaction sent by peer ${peer}, ${e}", ("peer", originating_peer->get_remote_endpoint() )("e", e) );
+          return;
+        }
         catch ( const fc::exception& e )
         {
           wlog( "client rejected message sent by peer ${peer}, ${e}", ("peer", originating_peer->get_remote_endpoint() )("e", e) );
@@ -3951,37 +4326,6 @@ namespace graphene { namespace net { namespace detail {
         wlog( "Exception thrown while terminating Process backlog of sync items task, ignoring" );
       }
 
-      unsigned handle_message_call_count = 0;
-      while( true )
-      {
-        auto it = _handle_message_calls_in_progress.begin();
-        if( it == _handle_message_calls_in_progress.end() )
-           break;
-        if( it->ready() || it->error() || it->canceled() )
-        {
-           _handle_message_calls_in_progress.erase( it );
-           continue;
-        }
-        ++handle_message_call_count;
-        try
-        {
-          it->cancel_and_wait("node_impl::close()");
-          dlog("handle_message call #${count} task terminated", ("count", handle_message_call_count));
-        }
-        catch ( const fc::canceled_exception& )
-        {
-          dlog("handle_message call #${count} task terminated", ("count", handle_message_call_count));
-        }
-        catch ( const fc::exception& e )
-        {
-          wlog("Exception thrown while terminating handle_message call #${count} task, ignoring: ${e}", ("e", e)("count", handle_message_call_count));
-        }
-        catch (...)
-        {
-          wlog("Exception thrown while terminating handle_message call #${count} task, ignoring",("count", handle_message_call_count));
-        }
-      }
-
       try
       {
         _fetch_sync_items_loop_done.cancel("node_impl::close()");
@@ -4678,7 +5022,7 @@ namespace graphene { namespace net { namespace detail {
       ilog( "--------- MEMORY USAGE ------------" );
       ilog( "node._active_sync_requests size: ${size}", ("size", _active_sync_requests.size() ) );
       ilog( "node._received_sync_items size: ${size}", ("size", _received_sync_items.size() ) );
-      ilog( "node._new_received_sync_items size: ${size}", ("size", _new_received_sync_items.size() ) );
+      ilog( "node._reassigned_sync_requests size: ${size}", ("size", _reassigned_sync_requests.size() ) );
       ilog( "node._items_to_fetch size: ${size}", ("size", _items_to_fetch.size() ) );
       ilog( "node._new_inventory size: ${size}", ("size", _new_inventory.size() ) );
       ilog( "node._message_cache size: ${size}", ("size", _message_cache.size() ) );
@@ -4806,6 +5150,7 @@ namespace graphene { namespace net { namespace detail {
         peer_details["firewall_status"] = peer->is_firewalled;
         peer_details["startingheight"] = "";
         peer_details["banscore"] = "";
+        peer_details["invalid_transactions_received"] = peer->invalid_transactions_received;
         peer_details["syncnode"] = "";
 
         if (peer->fc_git_revision_sha)
@@ -4924,6 +5269,8 @@ namespace graphene { namespace net { namespace detail {
         _maximum_number_of_sync_blocks_to_prefetch = params["maximum_number_of_sync_blocks_to_prefetch"].as<uint32_t>();
       if (params.contains("maximum_blocks_per_peer_during_syncing"))
         _maximum_blocks_per_peer_during_syncing = params["maximum_blocks_per_peer_during_syncing"].as<uint32_t>();
+      if (params.contains("enable_compact_blocks"))
+        _compact_blocks_enabled = params["enable_compact_blocks"].as<bool>();
 
       _desired_number_of_connections = std::min(_desired_number_of_connections, _maximum_number_of_connections);
 
@@ -4943,6 +5290,7 @@ namespace graphene { namespace net { namespace detail {
       result["maximum_number_of_blocks_to_handle_at_one_time"] = _maximum_number_of_blocks_to_handle_at_one_time;
       result["maximum_number_of_sync_blocks_to_prefetch"] = _maximum_number_of_sync_blocks_to_prefetch;
       result["maximum_blocks_per_peer_during_syncing"] = _maximum_blocks_per_peer_during_syncing;
+      result["enable_compact_blocks"] = _compact_blocks_enabled;
       return result;
     }
 
@@ -5228,9 +5576,15 @@ namespace graphene { namespace net { namespace detail {
 
   struct simulated_network::node_info
   {
+    struct queued_message
+    {
+      message        message_body;
+      fc::time_point broadcast_time;
+    };
     node_delegate* delegate;
     fc::future<void> message_sender_task_done;
-    std::queue<message> messages_to_deliver;
+    std::queue<queued_message> messages_to_deliver;
+    std::map<item_hash_t, signed_transaction> transactions_received; // stands in for node_impl's message cache
     node_info(node_delegate* delegate) : delegate(delegate) {}
   };
 
@@ -5243,22 +5597,101 @@ namespace graphene { namespace net { namespace detail {
     }
   }
 
+  void simulated_network::set_link_characteristics(fc::microseconds one_way_latency, uint32_t bytes_per_second)
+  {
+    _one_way_latency = one_way_latency;
+    _bytes_per_second = bytes_per_second;
+  }
+
+  void simulated_network::transmit(uint64_t bytes, uint32_t one_way_trips, bool is_block_traffic)
+  {
+    _statistics.bytes_sent += bytes;
+    if (is_block_traffic)
+      _statistics.block_bytes_sent += bytes;
+    fc::microseconds transfer_time = fc::microseconds(_one_way_latency.count() * one_way_trips);
+    if (_bytes_per_second)
+      transfer_time += fc::microseconds(bytes * 1000000 / _bytes_per_second);
+    if (transfer_time > fc::microseconds(0))
+      fc::usleep(transfer_time);
+  }
+
+  block_message simulated_network::relay_block(node_info* destination_node, const message& block_message_to_relay)
+  {
+    block_message full_block = block_message_to_relay.as<block_message>();
+    if (!_compact_blocks_enabled)
+    {
+      transmit(block_message_to_relay.size + sizeof(message_header), 1, true);
+      return full_block;
+    }
+
+    // the same exchange node_impl has with a peer: the compact block, then a round trip
+    // for the transactions the destination hasn't seen
+    compact_block_message compact_block = detail::make_compact_block_message(full_block.block, full_block.block_id,
+                                                                                     block_message_to_relay.id());
+    uint64_t bytes = message(compact_block).size + sizeof(message_header);
+    uint32_t one_way_trips = 1;
+
+    auto lookup_transaction = [destination_node](const item_hash_t& transaction_message_hash) -> fc::optional<signed_transaction> {
+      auto iter = destination_node->transactions_received.find(transaction_message_hash);
+      if (iter == destination_node->transactions_received.end())
+        return fc::optional<signed_transaction>();
+      return iter->second;
+    };
+    signed_block rebuilt_block;
+    std::vector<uint32_t> missing_transaction_indices =
+      detail::rebuild_compact_block(compact_block, lookup_transaction, rebuilt_block);
+    if (!missing_transaction_indices.empty())
+    {
+      std::vector<signed_transaction> missing_transactions;
+      for (uint32_t transaction_index : missing_transaction_indices)
+        missing_transactions.push_back(full_block.block.transactions[transaction_index]);
+      message request(fetch_compact_block_transactions_message(full_block.block_id, missing_transaction_indices));
+      message reply(compact_block_transactions_message(full_block.block_id, missing_transactions));
+      bytes += request.size + reply.size + 2 * sizeof(message_header);
+      one_way_trips += 2;
+      detail::fill_compact_block_transactions(missing_transaction_indices, missing_transactions, rebuilt_block);
+      _statistics.transactions_fetched_for_blocks += missing_transaction_indices.size();
+    }
+    transmit(bytes, one_way_trips, true);
+
+    for (const graphene::chain::processed_transaction& transaction : rebuilt_block.transactions)
+      destination_node->transactions_received.erase(message(trx_message(transaction)).id());
+
+    block_message rebuilt_block_message(rebuilt_block);
+    FC_ASSERT(message(rebuilt_block_message).id() == block_message_to_relay.id(),
+              "Compact block ${id} did not rebuild to the block that was broadcast", ("id", full_block.block_id));
+    return rebuilt_block_message;
+  }
+
   void simulated_network::message_sender(node_info* destination_node)
   {
     while (!destination_node->messages_to_deliver.empty())
     {
       try
       {
-        const message& message_to_deliver = destination_node->messages_to_deliver.front();
+        const node_info::queued_message& queued_message = destination_node->messages_to_deliver.front();
+        const message& message_to_deliver = queued_message.message_body;
         if (message_to_deliver.msg_type == trx_message_type)
-          destination_node->delegate->handle_transaction(message_to_deliver.as<trx_message>());
+        {
+          // transactions stream in back to back, so only the bandwidth they use holds up the messages behind them
+          transmit(message_to_deliver.size + sizeof(message_header), 0, false);
+          trx_message transaction_message = message_to_deliver.as<trx_message>();
+          destination_node->transactions_received[message_to_deliver.id()] = transaction_message.trx;
+          destination_node->delegate->handle_transaction(transaction_message);
+        }
         else if (message_to_deliver.msg_type == block_message_type)
         {
+          block_message block_message_to_deliver = relay_block(destination_node, message_to_deliver);
           std::vector<fc::uint160_t> contained_transaction_message_ids;
-          destination_node->delegate->handle_block(message_to_deliver.as<block_message>(), false, contained_transaction_message_ids);
+          destination_node->delegate->handle_block(block_message_to_deliver, false, contained_transaction_message_ids);
+          ++_statistics.blocks_delivered;
+          _statistics.total_block_latency += fc::time_point::now() - queued_message.broadcast_time;
         }
         else
+        {
+          transmit(message_to_deliver.size + sizeof(message_header), 1, false);
           destination_node->delegate->handle_message(message_to_deliver);
+        }
       }
       catch ( const fc::exception& e )
       {
@@ -5270,9 +5703,10 @@ namespace graphene { namespace net { namespace detail {
 
   void simulated_network::broadcast( const message& item_to_broadcast  )
   {
+    fc::time_point broadcast_time = fc::time_point::now();
     for (node_info* network_node_info : network_nodes)
     {
-      network_node_info->messages_to_deliver.emplace(item_to_broadcast);
+      network_node_info->messages_to_deliver.push(node_info::queued_message{item_to_broadcast, broadcast_time});
       if (!network_node_info->message_sender_task_done.valid() || network_node_info->message_sender_task_done.ready())
         network_node_info->message_sender_task_done = fc::async([=](){ message_sender(network_node_info); }, "simulated_network_sender");
     }
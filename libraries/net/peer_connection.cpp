@@ -42,7 +42,7 @@
 
 namespace graphene { namespace net
   {
-    message peer_connection::real_queued_message::get_message(peer_connection_delegate*)
+    serialized_message_ptr peer_connection::real_queued_message::get_serialized_message(peer_connection_delegate*)
     {
       if (message_send_time_field_offset != (size_t)-1)
       {
@@ -53,15 +53,26 @@ namespace graphene { namespace net
         memcpy(message_to_send.data.data() + message_send_time_field_offset,
                packed_current_time.data(), packed_current_time.size());
       }
-      return message_to_send;
+      return serialize_message(message_to_send);
     }
     size_t peer_connection::real_queued_message::get_size_in_queue()
     {
       return message_to_send.data.size();
     }
-    message peer_connection::virtual_queued_message::get_message(peer_connection_delegate* node)
+    serialized_message_ptr peer_connection::shared_queued_message::get_serialized_message(peer_connection_delegate*)
+    {
+      return message_to_send;
+    }
+    size_t peer_connection::shared_queued_message::get_size_in_queue()
+    {
+      // the message is shared with other peers' queues, but it's what this peer is holding up
+      // until it reads it, so it counts towards the limit of what we'll queue for the peer.
+      // Full blocks are queued as virtual_queued_messages instead, so these are transactions and compact blocks
+      return message_to_send->size();
+    }
+    serialized_message_ptr peer_connection::virtual_queued_message::get_serialized_message(peer_connection_delegate* node)
     {
-      return node->get_message_for_item(item_to_send);
+      return node->get_serialized_message_for_item(item_to_send);
     }
 
     size_t peer_connection::virtual_queued_message::get_size_in_queue()
@@ -73,6 +84,7 @@ namespace graphene { namespace net
       _node(delegate),
       _message_connection(this),
       _total_queued_messages_size(0),
+      _total_messages_serialized(0),
       direction(peer_connection_direction::unknown),
       is_firewalled(firewalled_state::unknown),
       our_state(our_connection_state::disconnected),
@@ -84,7 +96,12 @@ namespace graphene { namespace net
       peer_needs_sync_items_from_us(true),
       we_need_sync_items_from_peer(true),
       inhibit_fetching_sync_blocks(false),
+      sync_window_size(0),
+      sync_blocks_per_second(0),
+      supports_compact_blocks(false),
       transaction_fetching_inhibited_until(fc::time_point::min()),
+      invalid_transactions_received(0),
+      invalid_transactions_this_minute(0),
       last_known_fork_block_number(0),
       firewall_check_state(nullptr)
 #ifndef NDEBUG
@@ -287,14 +304,27 @@ namespace graphene { namespace net
 #endif
       while (!_queued_messages.empty())
       {
-        _queued_messages.front()->transmission_start_time = fc::time_point::now();
-        message message_to_send = _queued_messages.front()->get_message(_node);
+        // send queued messages until they fill one socket write buffer, stopping after the one that
+        // does.  The size in the queue of a virtual message is only its item id, so this goes by the
+        // serialized messages.  Messages queued while they're being sent stay behind them on the list
+        std::vector<serialized_message_ptr> messages_to_send;
+        size_t bytes_to_send = 0;
+        for (const std::unique_ptr<queued_message>& message_to_send : _queued_messages)
+        {
+          message_to_send->transmission_start_time = fc::time_point::now();
+          messages_to_send.push_back(message_to_send->get_serialized_message(_node));
+          if (message_to_send->is_serialized_per_connection())
+            ++_total_messages_serialized;
+          bytes_to_send += messages_to_send.back()->size();
+          if (bytes_to_send >= GRAPHENE_NET_STCP_BUFFER_SIZE)
+            break;
+        }
         try
         {
-          //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_message() "
-          //     "to send message of type ${type} for peer ${endpoint}",
-          //     ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint()));
-          _message_connection.send_message(message_to_send);
+          //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_messages() "
+          //     "to send ${count} messages for peer ${endpoint}",
+          //     ("count", messages_to_send.size())("endpoint", get_remote_endpoint()));
+          _message_connection.send_messages(messages_to_send);
           //dlog("peer_connection::send_queued_messages_task()'s call to message_oriented_connection::send_message() completed normally for peer ${endpoint}",
           //     ("endpoint", get_remote_endpoint()));
         }
@@ -324,9 +354,13 @@ namespace graphene { namespace net
         {
           elog("message_oriented_exception::send_message() threw an unhandled exception");
         }
-        _queued_messages.front()->transmission_finish_time = fc::time_point::now();
-        _total_queued_messages_size -= _queued_messages.front()->get_size_in_queue();
-        _queued_messages.pop();
+        fc::time_point transmission_finish_time = fc::time_point::now();
+        for (size_t i = 0; i < messages_to_send.size(); ++i)
+        {
+          _queued_messages.front()->transmission_finish_time = transmission_finish_time;
+          _total_queued_messages_size -= _queued_messages.front()->get_size_in_queue();
+          _queued_messages.pop_front();
+        }
       }
       //dlog("leaving peer_connection::send_queued_messages_task() due to queue exhaustion");
     }
@@ -335,7 +369,7 @@ namespace graphene { namespace net
     {
       VERIFY_CORRECT_THREAD();
       _total_queued_messages_size += message_to_send->get_size_in_queue();
-      _queued_messages.emplace(std::move(message_to_send));
+      _queued_messages.emplace_back(std::move(message_to_send));
       if (_total_queued_messages_size > GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)
       {
         elog("send queue exceeded maximum size of ${max} bytes (current size ${current} bytes)",
@@ -372,6 +406,13 @@ namespace graphene { namespace net
       send_queueable_message(std::move(message_to_enqueue));
     }
 
+    void peer_connection::send_message(const serialized_message_ptr& message_to_send)
+    {
+      VERIFY_CORRECT_THREAD();
+      std::unique_ptr<queued_message> message_to_enqueue(new shared_queued_message(message_to_send));
+      send_queueable_message(std::move(message_to_enqueue));
+    }
+
     void peer_connection::send_item(const item_id& item_to_send)
     {
       VERIFY_CORRECT_THREAD();
@@ -409,6 +450,18 @@ namespace graphene { namespace net
       return _message_connection.get_total_bytes_received();
     }
 
+    uint64_t peer_connection::get_total_messages_sent() const
+    {
+      VERIFY_CORRECT_THREAD();
+      return _message_connection.get_total_messages_sent();
+    }
+
+    uint64_t peer_connection::get_total_messages_serialized() const
+    {
+      VERIFY_CORRECT_THREAD();
+      return _total_messages_serialized;
+    }
+
     fc::time_point peer_connection::get_last_message_sent_time() const
     {
       VERIFY_CORRECT_THREAD();
@@ -33,13 +33,18 @@
 #include <fc/exception/exception.hpp>
 
 #include <graphene/net/stcp_socket.hpp>
+#include <graphene/net/config.hpp>
 
 namespace graphene { namespace net {
 
+static_assert(GRAPHENE_NET_STCP_BUFFER_SIZE % 16 == 0, "stcp_socket buffers must hold whole AES blocks");
+
 stcp_socket::stcp_socket()
 //:_buf_len(0)
+   : _read_buffer_begin(0),
+     _read_buffer_end(0)
 #ifndef NDEBUG
-   : _read_buffer_in_use(false),
+   , _read_buffer_in_use(false),
      _write_buffer_in_use(false)
 #endif
 {
@@ -83,7 +88,8 @@ void stcp_socket::bind( const fc::ip::endpoint& local_endpoint )
 /**
  *   This method must read at least 16 bytes at a time from
  *   the underlying TCP socket so that it can decrypt them. It
- *   will buffer any left-over.
+ *   reads and decrypts as much as the socket has ready, up to the
+ *   size of the read buffer, and hands out the rest on later calls.
  */
 size_t stcp_socket::readsome( char* buffer, size_t len )
 { try {
@@ -100,20 +106,28 @@ size_t stcp_socket::readsome( char* buffer, size_t len )
     } buffer_in_use_checker(_read_buffer_in_use);
 #endif
 
-    const size_t read_buffer_length = 4096;
+    const size_t read_buffer_length = GRAPHENE_NET_STCP_BUFFER_SIZE;
     if (!_read_buffer)
       _read_buffer.reset(new char[read_buffer_length], [](char* p){ delete[] p; });
 
-    len = std::min<size_t>(read_buffer_length, len);
-
-    size_t s = _sock.readsome( _read_buffer, len, 0 );
-    if( s % 16 ) 
+    if (_read_buffer_begin == _read_buffer_end)
     {
-      _sock.read(_read_buffer, 16 - (s%16), s);
-      s += 16-(s%16);
+      size_t s = _sock.readsome( _read_buffer, read_buffer_length, 0 );
+      if( s % 16 )
+      {
+        _sock.read(_read_buffer, 16 - (s%16), s);
+        s += 16-(s%16);
+      }
+      // the stream is decrypted in order, so everything read is decrypted now, in place
+      _recv_aes.decode( _read_buffer.get(), s, _read_buffer.get() );
+      _read_buffer_begin = 0;
+      _read_buffer_end = s;
     }
-    _recv_aes.decode( _read_buffer.get(), s, buffer );
-    return s;
+
+    len = std::min<size_t>(_read_buffer_end - _read_buffer_begin, len);
+    memcpy( buffer, _read_buffer.get() + _read_buffer_begin, len );
+    _read_buffer_begin += len;
+    return len;
 } FC_RETHROW_EXCEPTIONS( warn, "", ("len",len) ) }
 
 size_t stcp_socket::readsome( const std::shared_ptr<char>& buf, size_t len, size_t offset ) 
@@ -141,7 +155,7 @@ size_t stcp_socket::writesome( const char* buffer, size_t len )
     } buffer_in_use_checker(_write_buffer_in_use);
 #endif
 
-    const std::size_t write_buffer_length = 4096;
+    const std::size_t write_buffer_length = GRAPHENE_NET_STCP_BUFFER_SIZE;
     if (!_write_buffer)
       _write_buffer.reset(new char[write_buffer_length], [](char* p){ delete[] p; });
     len = std::min<size_t>(write_buffer_length, len);
@@ -163,6 +177,49 @@ size_t stcp_socket::writesome( const std::shared_ptr<const char>& buf, size_t le
   return writesome(buf.get() + offset, len);
 }
 
+void stcp_socket::write_buffers( const std::vector<const_buffer>& buffers_to_write )
+{ try {
+#ifndef NDEBUG
+    struct check_buffer_in_use {
+      bool& _buffer_in_use;
+      check_buffer_in_use(bool& buffer_in_use) : _buffer_in_use(buffer_in_use) { assert(!_buffer_in_use); _buffer_in_use = true; }
+      ~check_buffer_in_use() { assert(_buffer_in_use); _buffer_in_use = false; }
+    } buffer_in_use_checker(_write_buffer_in_use);
+#endif
+
+    const std::size_t write_buffer_length = GRAPHENE_NET_STCP_BUFFER_SIZE;
+    if (!_write_buffer)
+      _write_buffer.reset(new char[write_buffer_length], [](char* p){ delete[] p; });
+
+    // gather the plaintext, then encrypt and write it a full buffer at a time.  The buffers are
+    // padded to the AES block size, so every write holds whole blocks
+    size_t buffered = 0;
+    auto write_buffer = [&]() {
+      uint32_t ciphertext_len = _send_aes.encode( _write_buffer.get(), buffered, _write_buffer.get() );
+      assert(ciphertext_len == buffered);
+      _sock.write( _write_buffer, ciphertext_len );
+      buffered = 0;
+    };
+    for( const const_buffer& buffer_to_write : buffers_to_write )
+    {
+      assert( buffer_to_write.second % 16 == 0 );
+      const char* data = buffer_to_write.first;
+      size_t remaining = buffer_to_write.second;
+      while( remaining )
+      {
+        size_t chunk = std::min<size_t>( remaining, write_buffer_length - buffered );
+        memcpy( _write_buffer.get() + buffered, data, chunk );
+        buffered += chunk;
+        data += chunk;
+        remaining -= chunk;
+        if( buffered == write_buffer_length )
+          write_buffer();
+      }
+    }
+    if( buffered )
+      write_buffer();
+} FC_RETHROW_EXCEPTIONS( warn, "", ("buffers",buffers_to_write.size()) ) }
+
 void stcp_socket::flush()
 {
   _sock.flush();
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/net/sync_scheduler.hpp>
+#include <graphene/net/config.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace net { namespace detail {
+
+  uint32_t get_sync_window_size( const peer_connection& peer, uint32_t default_window_size )
+  {
+    // until we've timed a window from this peer, it gets the configured default
+    if( peer.sync_blocks_per_second <= 0 )
+      return default_window_size;
+    // size the window to keep the peer busy for a while, so we pay a round trip per window
+    // rather than letting it bound our download rate
+    double window_size = peer.sync_blocks_per_second * GRAPHENE_NET_SYNC_WINDOW_TARGET_DURATION_SEC;
+    return (uint32_t)std::max<double>(GRAPHENE_NET_MIN_BLOCKS_PER_SYNC_WINDOW,
+                                      std::min<double>(GRAPHENE_NET_MAX_BLOCKS_PER_SYNC_WINDOW, window_size));
+  }
+
+  bool is_straggling_sync_peer( const peer_connection& peer, fc::time_point now )
+  {
+    if( peer.sync_items_requested_from_peer.empty() )
+      return false;
+    // a peer is straggling once its window has taken well over what its measured rate
+    // predicts; that's usually a peer whose bandwidth has dropped since we measured it
+    fc::microseconds expected_duration = fc::seconds(GRAPHENE_NET_MIN_SYNC_STRAGGLER_TIMEOUT_SEC);
+    if( peer.sync_blocks_per_second > 0 )
+      expected_duration = std::max(expected_duration,
+                                   fc::microseconds((int64_t)(2 * peer.sync_window_size * 1000000.0 / peer.sync_blocks_per_second)));
+    return peer.sync_window_requested_time + expected_duration < now;
+  }
+
+  unsigned reassign_straggling_sync_items( const peer_connection& straggler,
+                                           const std::vector<peer_connection_ptr>& idle_peers,
+                                           uint32_t default_window_size,
+                                           const sync_reorder_buffer& received_sync_items,
+                                           std::set<item_hash_t>& reassigned_sync_requests,
+                                           std::set<item_hash_t>& sync_items_to_request,
+                                           std::map<peer_connection_ptr, std::vector<item_hash_t> >& sync_item_requests_to_send )
+  {
+    unsigned items_reassigned = 0;
+    for( const peer_connection::item_to_time_map_type::value_type& item_and_time : straggler.sync_items_requested_from_peer )
+    {
+      const item_hash_t& item_to_reassign = item_and_time.first.item_hash;
+      if( reassigned_sync_requests.find(item_to_reassign) != reassigned_sync_requests.end() ||
+          received_sync_items.find(item_to_reassign) != received_sync_items.end() )
+        continue;
+      for( const peer_connection_ptr& peer : idle_peers )
+      {
+        std::vector<item_hash_t>& peer_requests = sync_item_requests_to_send[peer];
+        if( peer_requests.size() < get_sync_window_size(*peer, default_window_size) &&
+            std::find(peer->ids_of_items_to_get.begin(), peer->ids_of_items_to_get.end(), item_to_reassign) != peer->ids_of_items_to_get.end() )
+        {
+          peer_requests.push_back(item_to_reassign);
+          sync_items_to_request.insert(item_to_reassign);
+          reassigned_sync_requests.insert(item_to_reassign);
+          ++items_reassigned;
+          break;
+        }
+      }
+    }
+    return items_reassigned;
+  }
+
+  sync_reorder_buffer::iterator find_next_sync_block( const std::unordered_set<peer_connection_ptr>& peers,
+                                                      sync_reorder_buffer& received_sync_items )
+  {
+    for( const peer_connection_ptr& peer : peers )
+      if( !peer->ids_of_items_to_get.empty() )
+      {
+        auto next_block_iter = received_sync_items.find(peer->ids_of_items_to_get.front());
+        if( next_block_iter != received_sync_items.end() )
+          return next_block_iter;
+      }
+    return received_sync_items.end();
+  }
+
+  bool is_sync_block_still_needed( const std::unordered_set<peer_connection_ptr>& peers, const block_id_type& block_id )
+  {
+    return std::any_of(peers.begin(), peers.end(), [&block_id](const peer_connection_ptr& peer) {
+      return std::find(peer->ids_of_items_to_get.begin(), peer->ids_of_items_to_get.end(), block_id) != peer->ids_of_items_to_get.end();
+    });
+  }
+
+  size_t remove_unneeded_sync_blocks( const std::unordered_set<peer_connection_ptr>& peers,
+                                      sync_reorder_buffer& received_sync_items )
+  {
+    std::set<item_hash_t> needed_items;
+    for( const peer_connection_ptr& peer : peers )
+      needed_items.insert(peer->ids_of_items_to_get.begin(), peer->ids_of_items_to_get.end());
+
+    size_t blocks_removed = 0;
+    for( auto iter = received_sync_items.begin(); iter != received_sync_items.end(); )
+      if( needed_items.find(iter->first) == needed_items.end() )
+      {
+        iter = received_sync_items.erase(iter);
+        ++blocks_removed;
+      }
+      else
+        ++iter;
+    return blocks_removed;
+  }
+
+} } } // end namespace graphene::net::detail
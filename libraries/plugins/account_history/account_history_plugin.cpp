@@ -23,6 +23,7 @@
  */
 
 #include <graphene/account_history/account_history_plugin.hpp>
+#include <graphene/account_history/operation_history_store.hpp>
 
 #include <graphene/app/impacted.hpp>
 
@@ -64,6 +65,21 @@ class account_history_plugin_impl
 
       account_history_plugin& _self;
       flat_set<account_id_type> _tracked_accounts;
+
+      /** 0 keeps the whole history in memory, otherwise older operations are moved to _history_store */
+      uint32_t                  _max_ops_in_memory = 0;
+      operation_history_store   _history_store;
+      /** set until the first block after the store is opened has been checked against the history in memory */
+      bool                      _check_history_store = false;
+
+   private:
+      /** links the operation into the history of the account */
+      void add_account_history( account_id_type account_id, const operation_history_object& op );
+      /** moves the operations of the account which fall out of the in-memory window to _history_store */
+      void spill_account_history( const account_statistics_object& stats_obj );
+      /** returns true if the history of an impacted account in memory still links to the operation */
+      bool is_linked( const operation_history_object& op );
+      flat_set<account_id_type> get_impacted_accounts( const operation_history_object& op )const;
 };
 
 account_history_plugin_impl::~account_history_plugin_impl()
@@ -74,6 +90,18 @@ account_history_plugin_impl::~account_history_plugin_impl()
 void account_history_plugin_impl::update_account_histories( const signed_block& b )
 {
    graphene::chain::database& db = database();
+   if( _check_history_store )
+   {
+      // every account with history keeps its most recent operation in memory, so history on disk without any
+      // history in memory was written before the object database was wiped and replayed
+      _check_history_store = false;
+      if( db.get_index_type<account_transaction_history_index>().indices().empty() && !_history_store.empty() )
+      {
+         ilog( "Wiping stale account history store" );
+         _history_store.wipe();
+      }
+   }
+
    const vector<optional< operation_history_object > >& hist = db.get_applied_operations();
    for( const optional< operation_history_object >& o_op : hist )
    {
@@ -91,21 +119,8 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
          continue;
       }
 
-      const operation_history_object& op = *o_op;
-
       // get the set of accounts this operation applies to
-      flat_set<account_id_type> impacted;
-      vector<authority> other;
-      operation_get_required_authorities( op.op, impacted, impacted, other );
-
-      if( op.op.which() == operation::tag< account_create_operation >::value )
-         impacted.insert( oho.result.get<object_id_type>() );
-      else
-         graphene::app::operation_get_impacted_accounts( op.op, impacted );
-
-      for( auto& a : other )
-         for( auto& item : a.account_auths )
-            impacted.insert( item.first );
+      const flat_set<account_id_type> impacted = get_impacted_accounts( oho );
 
       // for each operation this account applies to that is in the config link it into the history
       if( _tracked_accounts.size() == 0 )
@@ -114,19 +129,7 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
          {
             // we don't do index_account_keys here anymore, because
             // that indexing now happens in observers' post_evaluate()
-
-            // add history
-            const auto& stats_obj = account_id(db).statistics(db);
-            const auto& ath = db.create<account_transaction_history_object>( [&]( account_transaction_history_object& obj ){
-                obj.operation_id = oho.id;
-                obj.account = account_id;
-                obj.sequence = stats_obj.total_ops+1;
-                obj.next = stats_obj.most_recent_op;
-            });
-            db.modify( stats_obj, [&]( account_statistics_object& obj ){
-                obj.most_recent_op = ath.id;
-                obj.total_ops = ath.sequence;
-            });
+            add_account_history( account_id, oho );
          }
       }
       else
@@ -134,21 +137,74 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
          for( auto account_id : _tracked_accounts )
          {
             if( impacted.find( account_id ) != impacted.end() )
-            {
-               // add history
-               const auto& stats_obj = account_id(db).statistics(db);
-               const auto& ath = db.create<account_transaction_history_object>( [&]( account_transaction_history_object& obj ){
-                   obj.operation_id = oho.id;
-                   obj.next = stats_obj.most_recent_op;
-               });
-               db.modify( stats_obj, [&]( account_statistics_object& obj ){
-                   obj.most_recent_op = ath.id;
-               });
-            }
+               add_account_history( account_id, oho );
          }
       }
    }
 }
+
+flat_set<account_id_type> account_history_plugin_impl::get_impacted_accounts( const operation_history_object& op )const
+{
+   flat_set<account_id_type> impacted;
+   vector<authority> other;
+   operation_get_required_authorities( op.op, impacted, impacted, other );
+
+   if( op.op.which() == operation::tag< account_create_operation >::value )
+      impacted.insert( op.result.get<object_id_type>() );
+   else
+      graphene::app::operation_get_impacted_accounts( op.op, impacted );
+
+   for( auto& a : other )
+      for( auto& item : a.account_auths )
+         impacted.insert( item.first );
+   return impacted;
+}
+
+void account_history_plugin_impl::add_account_history( account_id_type account_id, const operation_history_object& op )
+{
+   graphene::chain::database& db = database();
+   const auto& stats_obj = account_id(db).statistics(db);
+   const auto& ath = db.create<account_transaction_history_object>( [&]( account_transaction_history_object& obj ){
+       obj.operation_id = op.id;
+       obj.account = account_id;
+       obj.sequence = stats_obj.total_ops+1;
+       obj.next = stats_obj.most_recent_op;
+   });
+   db.modify( stats_obj, [&]( account_statistics_object& obj ){
+       obj.most_recent_op = ath.id;
+       obj.total_ops = ath.sequence;
+   });
+
+   if( _max_ops_in_memory > 0 )
+      spill_account_history( stats_obj );
+}
+
+void account_history_plugin_impl::spill_account_history( const account_statistics_object& stats_obj )
+{
+   graphene::chain::database& db = database();
+   const auto& by_seq_idx = db.get_index_type<account_transaction_history_index>().indices().get<by_seq>();
+   auto itr = by_seq_idx.lower_bound( boost::make_tuple( stats_obj.owner, 1 ) );
+   while( itr != by_seq_idx.end() && itr->account == stats_obj.owner
+          && stats_obj.total_ops - itr->sequence >= _max_ops_in_memory )
+   {
+      const account_transaction_history_object& ath = *itr++;
+      const operation_history_object& oho = ath.operation_id(db);
+      _history_store.store( ath.account, ath.sequence, oho );
+      // the newer node still links to the removed one, readers go to the store when the link can not be followed
+      db.remove( ath );
+      if( !is_linked( oho ) )
+         db.remove( oho );
+   }
+}
+
+bool account_history_plugin_impl::is_linked( const operation_history_object& op )
+{
+   const auto& by_op_idx = database().get_index_type<account_transaction_history_index>().indices().get<by_op>();
+   for( const account_id_type& account_id : get_impacted_accounts( op ) )
+      if( by_op_idx.find( boost::make_tuple( account_id, operation_history_id_type( op.id ) ) ) != by_op_idx.end() )
+         return true;
+   return false;
+}
 } // end namespace detail
 
 
@@ -177,6 +233,8 @@ void account_history_plugin::plugin_set_program_options(
 {
    cli.add_options()
          ("track-account", boost::program_options::value<std::vector<std::string>>()->composing()->multitoken(), "Account ID to track history for (may specify multiple times)")
+         ("max-ops-per-account-in-memory", boost::program_options::value<uint32_t>()->default_value(0),
+          "Number of most recent operations of every account kept in memory, older ones are moved to disk (0 keeps all in memory)")
          ;
    cfg.add(cli);
 }
@@ -184,10 +242,13 @@ void account_history_plugin::plugin_set_program_options(
 void account_history_plugin::plugin_initialize(const boost::program_options::variables_map& options)
 {
    database().applied_block.connect( [&]( const signed_block& b){ my->update_account_histories(b); } );
-   database().add_index< primary_index< simple_index< operation_history_object > > >();
+   database().add_index< primary_index< operation_history_index > >();
    database().add_index< primary_index< account_transaction_history_index > >();
 
    LOAD_VALUE_SET(options, "tracked-accounts", my->_tracked_accounts, graphene::chain::account_id_type);
+
+   if( options.count("max-ops-per-account-in-memory") && options.at("max-ops-per-account-in-memory").as<uint32_t>() > 0 )
+      enable_history_spill( options.at("max-ops-per-account-in-memory").as<uint32_t>(), app().data_dir() / "account_history" );
 }
 
 void account_history_plugin::plugin_startup()
@@ -199,4 +260,27 @@ flat_set<account_id_type> account_history_plugin::tracked_accounts() const
    return my->_tracked_accounts;
 }
 
+void account_history_plugin::enable_history_spill( uint32_t max_ops_in_memory, const fc::path& dir )
+{
+   FC_ASSERT( max_ops_in_memory > 0 );
+   if( !my->_history_store.is_open() )
+   {
+      my->_history_store.open( dir );
+      my->_check_history_store = true;
+   }
+   my->_max_ops_in_memory = max_ops_in_memory;
+}
+
+optional<operation_history_object> account_history_plugin::get_account_operation( account_id_type account, uint32_t sequence )const
+{
+   const graphene::chain::database& db = *app().chain_database();
+   const auto& by_seq_idx = db.get_index_type<account_transaction_history_index>().indices().get<by_seq>();
+   auto itr = by_seq_idx.find( boost::make_tuple( account, sequence ) );
+   if( itr != by_seq_idx.end() )
+      return itr->operation_id(db);
+   if( my->_history_store.is_open() )
+      return my->_history_store.fetch( account, sequence );
+   return optional<operation_history_object>();
+}
+
 } }
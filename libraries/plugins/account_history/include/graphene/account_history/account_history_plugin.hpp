@@ -53,7 +53,8 @@ namespace graphene { namespace account_history {
 enum account_history_object_type
 {
    key_account_object_type = 0,
-   bucket_object_type = 1 ///< used in market_history_plugin
+   bucket_object_type = 1, ///< used in market_history_plugin
+   market_ticker_object_type = 2 ///< used in market_history_plugin
 };
 
 
@@ -77,6 +78,14 @@ class account_history_plugin : public graphene::app::plugin
 
       flat_set<account_id_type> tracked_accounts()const;
 
+      /**
+       * Keeps only the most recent max_ops_in_memory operations of every account in memory and moves older
+       * ones to an operation_history_store in dir as new operations arrive.
+       */
+      void enable_history_spill( uint32_t max_ops_in_memory, const fc::path& dir );
+      /** returns the operation with the given sequence number in the history of the account, from memory or disk */
+      optional<operation_history_object> get_account_operation( account_id_type account, uint32_t sequence )const;
+
       friend class detail::account_history_plugin_impl;
       std::unique_ptr<detail::account_history_plugin_impl> my;
 };
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <graphene/chain/operation_history_object.hpp>
+#include <graphene/utilities/positional_file.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <map>
+
+namespace fc { class file_mapping; class mapped_region; }
+
+namespace graphene { namespace account_history {
+   using namespace chain;
+
+   /**
+    *  @brief an append-only file of account history that no longer fits the in-memory window
+    *
+    *  Each record holds a copy of the operation_history_object together with the account and the
+    *  sequence number it had in that account's history. Records are read back through a read-only
+    *  memory mapping of the file, so old history is paged in by the operating system on demand.
+    *
+    *  Only the file offset of every record is kept in memory. Storing the same account and
+    *  sequence again, which happens when a block is popped and its replacement moves different
+    *  operations out of memory, replaces the record and forgets every later record of that account.
+    *  The replaced records stay in the file until it is wiped.
+    */
+   class operation_history_store
+   {
+      public:
+         operation_history_store();
+         ~operation_history_store();
+
+         void open( const fc::path& dir );
+         bool is_open()const;
+         void close();
+         /** removes every record, used when the history in memory is rebuilt from scratch */
+         void wipe();
+
+         void store( account_id_type account, uint32_t sequence, const operation_history_object& op );
+         optional<operation_history_object> fetch( account_id_type account, uint32_t sequence )const;
+
+         /** returns the number of operations stored for the account, they have sequence numbers 1 to count */
+         uint32_t count( account_id_type account )const;
+         bool     empty()const { return _offsets.empty(); }
+      private:
+         void load();
+         void map_file()const;
+
+         fc::path                                      _file;
+         utilities::positional_file                    _data;
+         uint64_t                                      _file_size = 0;
+         std::map<account_id_type, vector<uint64_t>>   _offsets;
+
+         mutable std::unique_ptr<fc::file_mapping>     _mapping;
+         mutable std::unique_ptr<fc::mapped_region>    _region;
+         mutable uint64_t                              _mapped_size = 0;
+   };
+
+} } // graphene::account_history
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <graphene/account_history/operation_history_store.hpp>
+
+#include <fc/interprocess/file_mapping.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/smart_ref_impl.hpp>
+
+#include <limits>
+
+namespace graphene { namespace account_history {
+
+struct spilled_operation
+{
+   account_id_type            account;
+   uint32_t                   sequence = 0;
+   operation_history_object   op;
+};
+
+} }
+
+FC_REFLECT( graphene::account_history::spilled_operation, (account)(sequence)(op) )
+
+namespace graphene { namespace account_history {
+
+/** marks sequence numbers of an account which have no record, e.g. history from before the store was enabled */
+static const uint64_t no_record = std::numeric_limits<uint64_t>::max();
+
+operation_history_store::operation_history_store(){}
+
+operation_history_store::~operation_history_store()
+{
+   if( is_open() )
+      close();
+}
+
+void operation_history_store::open( const fc::path& dir )
+{ try {
+   fc::create_directories( dir );
+   _file = dir / "operations";
+   _data.open( _file );
+   _file_size = _data.size();
+   load();
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+bool operation_history_store::is_open()const
+{
+   return _data.is_open();
+}
+
+void operation_history_store::close()
+{
+   _region.reset();
+   _mapping.reset();
+   _mapped_size = 0;
+   _offsets.clear();
+   _data.close();
+   _file_size = 0;
+}
+
+void operation_history_store::wipe()
+{
+   FC_ASSERT( is_open() );
+   _region.reset();
+   _mapping.reset();
+   _mapped_size = 0;
+   _offsets.clear();
+   _data.resize( 0 );
+   _file_size = 0;
+}
+
+void operation_history_store::load()
+{
+   if( _file_size == 0 )
+      return;
+   map_file();
+
+   const char* base = (const char*)_region->get_address();
+   fc::datastream<const char*> ds( base, _mapped_size );
+   uint64_t good_size = 0;
+   try {
+      while( ds.remaining() > 0 )
+      {
+         const uint64_t offset = ds.pos() - base;
+         fc::unsigned_int size;
+         spilled_operation rec;
+         fc::raw::unpack( ds, size );
+         fc::raw::unpack( ds, rec );
+         FC_ASSERT( rec.sequence > 0 );
+
+         auto& offsets = _offsets[rec.account];
+         offsets.resize( rec.sequence, no_record );
+         offsets.back() = offset;
+         good_size = ds.pos() - base;
+      }
+   } catch( const fc::exception& e ) {
+      // the last record was only partially written before an unclean shutdown
+      wlog( "Dropping ${n} bytes at the end of the history store", ("n", _file_size - good_size) );
+   }
+
+   if( good_size < _file_size )
+   {
+      _region.reset();
+      _mapping.reset();
+      _mapped_size = 0;
+      _data.resize( good_size );
+      _file_size = good_size;
+   }
+}
+
+void operation_history_store::map_file()const
+{
+   _region.reset();
+   _mapping.reset( new fc::file_mapping( _file.generic_string().c_str(), fc::read_only ) );
+   _region.reset( new fc::mapped_region( *_mapping, fc::read_only, 0, _file_size ) );
+   _mapped_size = _file_size;
+}
+
+void operation_history_store::store( account_id_type account, uint32_t sequence, const operation_history_object& op )
+{ try {
+   FC_ASSERT( is_open() );
+   FC_ASSERT( sequence > 0 );
+   spilled_operation rec;
+   rec.account  = account;
+   rec.sequence = sequence;
+   rec.op       = op;
+   const vector<char> data = fc::raw::pack( fc::raw::pack( rec ) );
+   _data.write( data.data(), data.size(), _file_size );
+
+   auto& offsets = _offsets[account];
+   offsets.resize( sequence, no_record );
+   offsets.back() = _file_size;
+   _file_size += data.size();
+} FC_CAPTURE_AND_RETHROW( (account)(sequence) ) }
+
+optional<operation_history_object> operation_history_store::fetch( account_id_type account, uint32_t sequence )const
+{ try {
+   auto itr = _offsets.find( account );
+   if( itr == _offsets.end() || sequence == 0 || sequence > itr->second.size() )
+      return optional<operation_history_object>();
+   const uint64_t offset = itr->second[sequence-1];
+   if( offset == no_record )
+      return optional<operation_history_object>();
+
+   // records are appended whole, so a record is either entirely inside the mapping or entirely after it
+   if( offset >= _mapped_size )
+      map_file();
+
+   const char* base = (const char*)_region->get_address();
+   fc::datastream<const char*> ds( base + offset, _mapped_size - offset );
+   fc::unsigned_int size;
+   spilled_operation rec;
+   fc::raw::unpack( ds, size );
+   fc::raw::unpack( ds, rec );
+   FC_ASSERT( rec.account == account && rec.sequence == sequence, "Corrupt history store" );
+   return rec.op;
+} FC_CAPTURE_AND_RETHROW( (account)(sequence) ) }
+
+uint32_t operation_history_store::count( account_id_type account )const
+{
+   auto itr = _offsets.find( account );
+   return itr == _offsets.end() ? 0 : itr->second.size();
+}
+
+} } // graphene::account_history
@@ -28,6 +28,8 @@
 
 #include <fc/thread/future.hpp>
 
+#include <boost/multi_index/composite_key.hpp>
+
 namespace graphene { namespace market_history {
 using namespace chain;
 
@@ -106,7 +108,41 @@ struct order_history_object : public abstract_object<order_history_object>
   fill_order_operation op;
 };
 
+/**
+ *  @brief rolling 24 hour statistics of a market, kept up to date by the market_history_plugin
+ *
+ *  Like bucket_object the market is identified by the pair of assets with base < quote, and only the fill
+ *  orders which pay base are counted. The trades counted in the window are the order_history_objects from
+ *  oldest_sequence to the most recent one, when a block moves the window forward the trades falling out of
+ *  it are subtracted again and the last of them becomes the opening price of the window.
+ */
+struct market_ticker_object : public abstract_object<market_ticker_object>
+{
+   static const uint8_t space_id = ACCOUNT_HISTORY_SPACE_ID;
+   static const uint8_t type_id  = 2; // market_history_plugin type, referenced from account_history_plugin.hpp
+
+   price latest()const { return asset( latest_base, base ) / asset( latest_quote, quote ); }
+   price open()const { return asset( open_base, base ) / asset( open_quote, quote ); }
+   bool  has_open()const { return open_quote != 0; }
+
+   asset_id_type       base;
+   asset_id_type       quote;
+   share_type          base_volume;
+   share_type          quote_volume;
+   share_type          latest_base;
+   share_type          latest_quote;
+   /** the price of the last trade before the window, 0 if there is none */
+   share_type          open_base;
+   share_type          open_quote;
+   /** history_key::sequence of the oldest trade in the window */
+   int64_t             oldest_sequence = 0;
+   /** time of the oldest trade in the window, maximum() if the window is empty */
+   fc::time_point_sec  oldest_time = fc::time_point_sec::maximum();
+};
+
 struct by_key;
+struct by_market;
+struct by_oldest_time;
 typedef multi_index_container<
    bucket_object,
    indexed_by<
@@ -124,8 +160,28 @@ typedef multi_index_container<
 > order_history_multi_index_type;
 
 
+typedef multi_index_container<
+   market_ticker_object,
+   indexed_by<
+      hashed_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
+      ordered_unique< tag<by_market>,
+         composite_key< market_ticker_object,
+            member< market_ticker_object, asset_id_type, &market_ticker_object::base >,
+            member< market_ticker_object, asset_id_type, &market_ticker_object::quote >
+         >
+      >,
+      ordered_unique< tag<by_oldest_time>,
+         composite_key< market_ticker_object,
+            member< market_ticker_object, fc::time_point_sec, &market_ticker_object::oldest_time >,
+            member< object, object_id_type, &object::id >
+         >
+      >
+   >
+> market_ticker_multi_index_type;
+
 typedef generic_index<bucket_object, bucket_object_multi_index_type> bucket_index;
 typedef generic_index<order_history_object, order_history_multi_index_type> history_index;
+typedef generic_index<market_ticker_object, market_ticker_multi_index_type> market_ticker_index;
 
 
 namespace detail
@@ -136,7 +192,8 @@ namespace detail
 /**
  *  The market history plugin can be configured to track any number of intervals via its configuration.  Once per block it
  *  will scan the virtual operations and look for fill_order_operations and then adjust the appropriate bucket objects for
- *  each fill order.
+ *  each fill order.  It also keeps a market_ticker_object for every traded market, so the 24 hour statistics of a market
+ *  can be looked up without scanning its trades.
  */
 class market_history_plugin : public graphene::app::plugin
 {
@@ -172,4 +229,9 @@ FC_REFLECT_DERIVED( graphene::market_history::bucket_object, (graphene::db::obje
                     (open_base)(open_quote)
                     (close_base)(close_quote)
                     (base_volume)(quote_volume) )
-
+FC_REFLECT_DERIVED( graphene::market_history::market_ticker_object, (graphene::db::object),
+                    (base)(quote)
+                    (base_volume)(quote_volume)
+                    (latest_base)(latest_quote)
+                    (open_base)(open_quote)
+                    (oldest_sequence)(oldest_time) )
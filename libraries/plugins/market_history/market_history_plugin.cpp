@@ -58,11 +58,20 @@ class market_history_plugin_impl
          return _self.database();
       }
 
+      /** subtracts the trades which fell out of the 24 hour window from every market_ticker_object */
+      void expire_tickers( fc::time_point_sec cutoff );
+
+      /** recomputes a ticker from the trades of its market in the history which are at or after cutoff */
+      void rebuild_ticker( const market_ticker_object& ticker, fc::time_point_sec cutoff );
+
       market_history_plugin&     _self;
       flat_set<uint32_t>         _tracked_buckets;
       uint32_t                   _maximum_history_per_bucket_size = 1000;
 };
 
+/** the length of the window of market_ticker_object */
+static const uint32_t ticker_window_seconds = 86400;
+
 
 struct operation_process_fill_order
 {
@@ -78,6 +87,31 @@ struct operation_process_fill_order
    template<typename T>
    void operator()( const T& )const{}
 
+   /** adds the trade recorded by the order_history_object with the given sequence to the ticker of its market */
+   void update_ticker( int64_t sequence, fc::time_point_sec time, const fill_order_operation& o )const
+   {
+      auto& db = _plugin.database();
+      const auto& ticker_idx = db.get_index_type<market_ticker_index>().indices().get<by_market>();
+      auto itr = ticker_idx.find( boost::make_tuple( o.pays.asset_id, o.receives.asset_id ) );
+      const market_ticker_object& ticker = itr != ticker_idx.end() ? *itr :
+         db.create<market_ticker_object>( [&]( market_ticker_object& t ) {
+            t.base = o.pays.asset_id;
+            t.quote = o.receives.asset_id;
+         });
+
+      db.modify( ticker, [&]( market_ticker_object& t ) {
+         t.base_volume += o.pays.amount;
+         t.quote_volume += o.receives.amount;
+         t.latest_base = o.pays.amount;
+         t.latest_quote = o.receives.amount;
+         if( t.oldest_time == fc::time_point_sec::maximum() )
+         {
+            t.oldest_sequence = sequence;
+            t.oldest_time = time;
+         }
+      });
+   }
+
    void operator()( const fill_order_operation& o )const 
    {
       //ilog( "processing ${o}", ("o",o) );
@@ -108,15 +142,25 @@ struct operation_process_fill_order
          ho.op = o;
       });
 
+      if( o.pays.asset_id < o.receives.asset_id )
+         update_ticker( hkey.sequence, time, o );
+
       hkey.sequence += 200;
       itr = history_idx.lower_bound( hkey );
 
+      // trades which are still counted by the ticker of the market are kept beyond the 200 most recent ones
+      const auto ticker_cutoff = time - ticker_window_seconds;
+      while( itr != history_idx.end() && itr->key.base == hkey.base && itr->key.quote == hkey.quote
+             && itr->time >= ticker_cutoff )
+         ++itr;
+
       while( itr != history_idx.end() )
       {
          if( itr->key.base == hkey.base && itr->key.quote == hkey.quote )
          {
-            db.remove( *itr );
-            itr = history_idx.lower_bound( hkey );
+            auto old_itr = itr;
+            ++itr;
+            db.remove( *old_itr );
          }
          else break;
       }
@@ -215,10 +259,12 @@ market_history_plugin_impl::~market_history_plugin_impl()
 
 void market_history_plugin_impl::update_market_histories( const signed_block& b )
 {
+   // the fill history and tickers are kept even if no bucket sizes are tracked
    if( _maximum_history_per_bucket_size == 0 ) return;
-   if( _tracked_buckets.size() == 0 ) return;
 
    graphene::chain::database& db = database();
+   expire_tickers( b.timestamp - ticker_window_seconds );
+
    const vector<optional< operation_history_object > >& hist = db.get_applied_operations();
    for( const optional< operation_history_object >& o_op : hist )
    {
@@ -227,6 +273,101 @@ void market_history_plugin_impl::update_market_histories( const signed_block& b
    }
 }
 
+void market_history_plugin_impl::expire_tickers( fc::time_point_sec cutoff )
+{
+   graphene::chain::database& db = database();
+   const auto& history_idx = db.get_index_type<history_index>().indices().get<by_key>();
+   const auto& by_oldest_idx = db.get_index_type<market_ticker_index>().indices().get<by_oldest_time>();
+
+   while( !by_oldest_idx.empty() && by_oldest_idx.begin()->oldest_time < cutoff )
+   {
+      const market_ticker_object& ticker = *by_oldest_idx.begin();
+      history_key hkey;
+      hkey.base = ticker.base;
+      hkey.quote = ticker.quote;
+      hkey.sequence = ticker.oldest_sequence;
+      auto itr = history_idx.find( hkey );
+      if( itr == history_idx.end() )
+      {
+         elog( "The oldest trade counted by the ticker of ${b}/${q} was removed from the history, rebuilding it",
+               ("b",ticker.base)("q",ticker.quote) );
+         rebuild_ticker( ticker, cutoff );
+         continue;
+      }
+
+      db.modify( ticker, [&]( market_ticker_object& t ) {
+         t.oldest_time = fc::time_point_sec::maximum();
+         // newer trades of the market have lower sequence numbers, so the window moves towards the front of the index
+         while( true )
+         {
+            const fill_order_operation& o = itr->op;
+            if( o.pays.asset_id < o.receives.asset_id )
+            {
+               if( itr->time >= cutoff )
+               {
+                  t.oldest_sequence = itr->key.sequence;
+                  t.oldest_time = itr->time;
+                  break;
+               }
+               t.base_volume -= o.pays.amount;
+               t.quote_volume -= o.receives.amount;
+               t.open_base = o.pays.amount;
+               t.open_quote = o.receives.amount;
+            }
+            if( itr == history_idx.begin() )
+               break;
+            --itr;
+            if( itr->key.base != t.base || itr->key.quote != t.quote )
+               break;
+         }
+      });
+   }
+}
+
+void market_history_plugin_impl::rebuild_ticker( const market_ticker_object& ticker, fc::time_point_sec cutoff )
+{
+   graphene::chain::database& db = database();
+   const auto& history_idx = db.get_index_type<history_index>().indices().get<by_key>();
+
+   history_key hkey;
+   hkey.base = ticker.base;
+   hkey.quote = ticker.quote;
+   hkey.sequence = std::numeric_limits<int64_t>::min();
+
+   db.modify( ticker, [&]( market_ticker_object& t ) {
+      t.base_volume = 0;
+      t.quote_volume = 0;
+      t.open_base = 0;
+      t.open_quote = 0;
+      t.oldest_time = fc::time_point_sec::maximum();
+      bool latest_found = false;
+      // the most recent trade of the market comes first
+      for( auto itr = history_idx.lower_bound( hkey );
+           itr != history_idx.end() && itr->key.base == t.base && itr->key.quote == t.quote; ++itr )
+      {
+         const fill_order_operation& o = itr->op;
+         if( o.pays.asset_id > o.receives.asset_id )
+            continue;
+         if( !latest_found )
+         {
+            t.latest_base = o.pays.amount;
+            t.latest_quote = o.receives.amount;
+            latest_found = true;
+         }
+         if( itr->time < cutoff )
+         {
+            t.open_base = o.pays.amount;
+            t.open_quote = o.receives.amount;
+            break;
+         }
+         t.base_volume += o.pays.amount;
+         t.quote_volume += o.receives.amount;
+         t.oldest_sequence = itr->key.sequence;
+         t.oldest_time = itr->time;
+      }
+   });
+}
+
 } // end namespace detail
 
 
@@ -267,6 +408,7 @@ void market_history_plugin::plugin_initialize(const boost::program_options::vari
    database().applied_block.connect( [&]( const signed_block& b){ my->update_market_histories(b); } );
    database().add_index< primary_index< bucket_index  > >();
    database().add_index< primary_index< history_index  > >();
+   database().add_index< primary_index< market_ticker_index  > >();
 
    if( options.count( "bucket-size" ) )
    {
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/filesystem.hpp>
+
+#include <cstdint>
+
+namespace graphene { namespace utilities {
+
+/**
+ *  A file read and written at explicit offsets, which several threads may do at once since no
+ *  file position is shared.  Uses pread()/pwrite(), or ReadFile()/WriteFile() with an offset on Windows.
+ *  Failures throw fc::exception.
+ */
+class positional_file
+{
+   public:
+      positional_file() {}
+      ~positional_file();
+      positional_file( const positional_file& ) = delete;
+      positional_file& operator=( const positional_file& ) = delete;
+
+      /** opens path for reading and writing, creating it if it doesn't exist */
+      void     open( const fc::path& path );
+      bool     is_open()const;
+      void     close();
+
+      /** reads exactly size bytes at pos, or throws */
+      void     read( char* data, size_t size, uint64_t pos )const;
+      void     write( const char* data, size_t size, uint64_t pos );
+      uint64_t size()const;
+      /** grows or truncates the file to new_size bytes */
+      void     resize( uint64_t new_size );
+      /** waits until everything written has reached the disk */
+      void     sync();
+
+   private:
+      fc::path _path;
+#ifdef _WIN32
+      void*    _handle = nullptr;
+#else
+      int      _fd = -1;
+#endif
+};
+
+} } // graphene::utilities
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/utilities/positional_file.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <algorithm>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <cerrno>
+# include <cstring>
+# include <fcntl.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+namespace graphene { namespace utilities {
+
+positional_file::~positional_file()
+{
+   close();
+}
+
+#ifdef _WIN32
+
+void positional_file::open( const fc::path& path )
+{
+   FC_ASSERT( !is_open(), "${path} is already open", ("path", _path) );
+   HANDLE handle = CreateFileW( path.wstring().c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr );
+   FC_ASSERT( handle != INVALID_HANDLE_VALUE, "Unable to open ${path}: error ${e}", ("path", path)("e", uint64_t(GetLastError())) );
+   _path = path;
+   _handle = handle;
+}
+
+bool positional_file::is_open()const
+{
+   return _handle != nullptr;
+}
+
+void positional_file::close()
+{
+   if( _handle != nullptr )
+      CloseHandle( (HANDLE)_handle );
+   _handle = nullptr;
+}
+
+void positional_file::read( char* data, size_t size, uint64_t pos )const
+{
+   while( size > 0 )
+   {
+      OVERLAPPED at = {};
+      at.Offset     = DWORD( pos );
+      at.OffsetHigh = DWORD( pos >> 32 );
+      DWORD got = 0;
+      BOOL ok = ReadFile( (HANDLE)_handle, data, DWORD( std::min<size_t>( size, 1 << 30 ) ), &got, &at );
+      FC_ASSERT( ok && got > 0, "Unable to read from ${path}: ${e}",
+                 ("path", _path)("e", ok ? std::string("end of file") : "error " + std::to_string( GetLastError() )) );
+      data += got;
+      size -= got;
+      pos  += got;
+   }
+}
+
+void positional_file::write( const char* data, size_t size, uint64_t pos )
+{
+   while( size > 0 )
+   {
+      OVERLAPPED at = {};
+      at.Offset     = DWORD( pos );
+      at.OffsetHigh = DWORD( pos >> 32 );
+      DWORD written = 0;
+      BOOL ok = WriteFile( (HANDLE)_handle, data, DWORD( std::min<size_t>( size, 1 << 30 ) ), &written, &at );
+      FC_ASSERT( ok && written > 0, "Unable to write to ${path}: error ${e}", ("path", _path)("e", uint64_t(GetLastError())) );
+      data += written;
+      size -= written;
+      pos  += written;
+   }
+}
+
+uint64_t positional_file::size()const
+{
+   LARGE_INTEGER size;
+   FC_ASSERT( GetFileSizeEx( (HANDLE)_handle, &size ), "Unable to stat ${path}: error ${e}", ("path", _path)("e", uint64_t(GetLastError())) );
+   return size.QuadPart;
+}
+
+void positional_file::resize( uint64_t new_size )
+{
+   FILE_END_OF_FILE_INFO end_of_file;
+   end_of_file.EndOfFile.QuadPart = new_size;
+   FC_ASSERT( SetFileInformationByHandle( (HANDLE)_handle, FileEndOfFileInfo, &end_of_file, sizeof(end_of_file) ),
+              "Unable to resize ${path}: error ${e}", ("path", _path)("e", uint64_t(GetLastError())) );
+}
+
+void positional_file::sync()
+{
+   FC_ASSERT( FlushFileBuffers( (HANDLE)_handle ), "Unable to sync ${path}: error ${e}", ("path", _path)("e", uint64_t(GetLastError())) );
+}
+
+#else
+
+void positional_file::open( const fc::path& path )
+{
+   FC_ASSERT( !is_open(), "${path} is already open", ("path", _path) );
+   int fd = ::open( path.generic_string().c_str(), O_RDWR | O_CREAT, 0644 );
+   FC_ASSERT( fd >= 0, "Unable to open ${path}: ${e}", ("path", path)("e", strerror(errno)) );
+   _path = path;
+   _fd = fd;
+}
+
+bool positional_file::is_open()const
+{
+   return _fd >= 0;
+}
+
+void positional_file::close()
+{
+   if( _fd >= 0 )
+      ::close( _fd );
+   _fd = -1;
+}
+
+void positional_file::read( char* data, size_t size, uint64_t pos )const
+{
+   while( size > 0 )
+   {
+      ssize_t got = ::pread( _fd, data, size, pos );
+      if( got < 0 && errno == EINTR )
+         continue;
+      FC_ASSERT( got > 0, "Unable to read from ${path}: ${e}", ("path", _path)("e", got < 0 ? strerror(errno) : "end of file") );
+      data += got;
+      size -= got;
+      pos  += got;
+   }
+}
+
+void positional_file::write( const char* data, size_t size, uint64_t pos )
+{
+   while( size > 0 )
+   {
+      ssize_t written = ::pwrite( _fd, data, size, pos );
+      if( written < 0 && errno == EINTR )
+         continue;
+      FC_ASSERT( written > 0, "Unable to write to ${path}: ${e}", ("path", _path)("e", strerror(errno)) );
+      data += written;
+      size -= written;
+      pos  += written;
+   }
+}
+
+uint64_t positional_file::size()const
+{
+   struct stat st;
+   FC_ASSERT( ::fstat( _fd, &st ) == 0, "Unable to stat ${path}: ${e}", ("path", _path)("e", strerror(errno)) );
+   return st.st_size;
+}
+
+void positional_file::resize( uint64_t new_size )
+{
+   FC_ASSERT( ::ftruncate( _fd, new_size ) == 0, "Unable to resize ${path}: ${e}", ("path", _path)("e", strerror(errno)) );
+}
+
+void positional_file::sync()
+{
+   FC_ASSERT( ::fsync( _fd ) == 0, "Unable to sync ${path}: ${e}", ("path", _path)("e", strerror(errno)) );
+}
+
+#endif
+
+} } // graphene::utilities
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/block_database.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include <fstream>
+#include <random>
+
+using namespace graphene::chain;
+
+namespace {
+
+   /** reads blocks the way block_database did before it was memory mapped: seekg/read on shared streams */
+   struct stream_block_reader
+   {
+      struct entry
+      {
+         uint64_t      block_pos = 0;
+         uint32_t      block_size = 0;
+         block_id_type block_id;
+      };
+
+      stream_block_reader( const fc::path& dir )
+      :index( (dir/"index").generic_string().c_str(), std::fstream::binary | std::fstream::in ),
+       blocks( (dir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in ){}
+
+      optional<signed_block> fetch_by_number( uint32_t block_num )
+      {
+         entry e;
+         index.seekg( sizeof(e) * block_num );
+         index.read( (char*)&e, sizeof(e) );
+         vector<char> data( e.block_size );
+         blocks.seekg( e.block_pos );
+         blocks.read( data.data(), e.block_size );
+         auto result = fc::raw::unpack<signed_block>( data );
+         FC_ASSERT( result.id() == e.block_id );
+         return result;
+      }
+
+      std::ifstream index;
+      std::ifstream blocks;
+   };
+
+   double fetches_per_second( uint64_t count, const fc::microseconds& elapsed )
+   {
+      return elapsed.count() ? double(count) * 1000000.0 / elapsed.count() : 0.0;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_random_fetch_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t block_count = 100000;
+      const uint32_t fetch_count = 200000;
+#else
+      const uint32_t block_count = 5000;
+      const uint32_t fetch_count = 20000;
+#endif
+
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      block_database bdb;
+      bdb.open( data_dir.path() );
+
+      signed_block b;
+      for( uint32_t i = 0; i < block_count; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type( i % 101 );
+         b.timestamp = fc::time_point_sec( i * 3 );
+         bdb.store( b.id(), b );
+      }
+      bdb.flush();
+
+      std::mt19937 rng( 1234 );
+      std::uniform_int_distribution<uint32_t> pick( 1, block_count );
+      vector<uint32_t> nums( fetch_count );
+      for( auto& n : nums )
+         n = pick( rng );
+
+      {
+         stream_block_reader reader( data_dir.path() );
+         auto start = fc::time_point::now();
+         for( uint32_t n : nums )
+            FC_ASSERT( reader.fetch_by_number( n ).valid() );
+         auto elapsed = fc::time_point::now() - start;
+         ilog( "fstream reader, 1 thread: ${r} fetches/s", ("r", fetches_per_second( nums.size(), elapsed )) );
+      }
+
+      for( uint32_t thread_count : { 1, 2, 4, 8 } )
+      {
+         vector< std::unique_ptr<fc::thread> > threads;
+         for( uint32_t t = 0; t < thread_count; ++t )
+            threads.emplace_back( new fc::thread( "fetch" + fc::to_string(t) ) );
+
+         const size_t chunk = nums.size() / thread_count;
+         auto start = fc::time_point::now();
+         vector< fc::future<void> > done;
+         for( uint32_t t = 0; t < thread_count; ++t )
+         {
+            done.push_back( threads[t]->async( [&bdb,&nums,chunk,t]() {
+               for( size_t i = t * chunk; i < (t + 1) * chunk; ++i )
+                  FC_ASSERT( bdb.fetch_by_number( nums[i] ).valid() );
+            } ) );
+         }
+         for( auto& f : done )
+            f.wait();
+         auto elapsed = fc::time_point::now() - start;
+         ilog( "block_database, ${t} threads: ${r} fetches/s",
+               ("t", thread_count)("r", fetches_per_second( chunk * thread_count, elapsed )) );
+      }
+
+      bdb.close();
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
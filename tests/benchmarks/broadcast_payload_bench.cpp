@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/net/peer_connection.hpp>
+
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+using namespace graphene::net;
+
+namespace
+{
+   /**
+    * Both ends of the benchmark's connections.  The sending end resolves queued items from
+    * its message cache the way node_impl does, the receiving end counts what arrives.
+    */
+   class broadcast_peer_delegate : public peer_connection_delegate
+   {
+   public:
+      std::map<item_hash_t, serialized_message_ptr> message_cache;
+      uint32_t blocks_received = 0;
+      uint32_t transactions_received = 0;
+
+      void on_message( peer_connection* originating_peer, const message& received_message ) override
+      {
+         if( received_message.msg_type == block_message_type )
+            ++blocks_received;
+         else if( received_message.msg_type == trx_message_type )
+            ++transactions_received;
+      }
+      void on_connection_closed( peer_connection* originating_peer ) override {}
+      serialized_message_ptr get_serialized_message_for_item( const item_id& item ) override
+      {
+         return message_cache.at( item.item_hash );
+      }
+   };
+
+   struct broadcast_totals
+   {
+      uint64_t frames_sent = 0;        ///< messages written to the sockets
+      uint64_t bytes_sent = 0;
+      uint64_t buffers_framed = 0;     ///< serialized copies allocated, by the cache or by the connections themselves
+      uint64_t bytes_framed = 0;
+   };
+}
+
+BOOST_FIXTURE_TEST_CASE( broadcast_payload_bench, database_fixture )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t block_count = 20;
+      const uint32_t transfers_per_block = 200;
+      const uint32_t node_count = 100;
+#else
+      const uint32_t block_count = 5;
+      const uint32_t transfers_per_block = 50;
+      const uint32_t node_count = 50;
+#endif
+
+      ACTORS((alice)(bob));
+      transfer( committee_account, alice_id, asset( 100000000 ) );
+      generate_block();
+
+      std::vector<signed_block> blocks;
+      for( uint32_t i = 0; i < block_count; ++i )
+      {
+         for( uint32_t j = 0; j < transfers_per_block; ++j )
+            transfer( alice_id, bob_id, asset( 1 + j ) );
+         blocks.push_back( generate_block() );
+      }
+      uint64_t message_count = 0;
+      for( const signed_block& block : blocks )
+         message_count += block.transactions.size() + 1;
+
+      // every message goes out through peer_connection's send queue, message_oriented_connection
+      // and stcp_socket to a peer on the other end of a loopback connection
+      auto relay = [&]( bool shared_payloads )
+      {
+         fc::tcp_server server;
+         server.listen( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ) );
+         broadcast_peer_delegate sending_end;
+         broadcast_peer_delegate receiving_end;
+         std::vector<peer_connection_ptr> senders;
+         std::vector<peer_connection_ptr> receivers;
+         for( uint32_t i = 0; i < node_count; ++i )
+         {
+            receivers.push_back( peer_connection::make_shared( &receiving_end ) );
+            senders.push_back( peer_connection::make_shared( &sending_end ) );
+            fc::future<void> accepted = fc::async( [&]() {
+               server.accept( receivers.back()->get_socket() );
+               receivers.back()->accept_connection();
+            }, "accept" );
+            senders.back()->connect_to( server.get_local_endpoint() );
+            accepted.wait();
+         }
+
+         broadcast_totals totals;
+         auto add_to_cache = [&]( const message& message_to_cache ) {
+            serialized_message_ptr serialized_message = serialize_message( message_to_cache );
+            ++totals.buffers_framed;
+            totals.bytes_framed += serialized_message->size();
+            sending_end.message_cache[message_to_cache.id()] = serialized_message;
+            return serialized_message;
+         };
+
+         // each block is relayed after its transactions, as it would be on the network, and the next
+         // one waits until every peer has it so no send queue grows past what one block needs
+         fc::time_point start = fc::time_point::now();
+         for( uint32_t i = 0; i < blocks.size(); ++i )
+         {
+            for( const processed_transaction& trx : blocks[i].transactions )
+            {
+               message transaction_message = trx_message( trx );
+               if( shared_payloads )
+               {
+                  serialized_message_ptr serialized_message = add_to_cache( transaction_message );
+                  for( const peer_connection_ptr& sender : senders )
+                     sender->send_message( serialized_message );
+               }
+               else
+               {
+                  for( const peer_connection_ptr& sender : senders )
+                     sender->send_message( transaction_message );
+               }
+            }
+            message block_message_to_send = block_message( blocks[i] );
+            if( shared_payloads )
+            {
+               add_to_cache( block_message_to_send );
+               for( const peer_connection_ptr& sender : senders )
+                  sender->send_item( item_id( block_message_type, block_message_to_send.id() ) );
+            }
+            else
+            {
+               for( const peer_connection_ptr& sender : senders )
+                  sender->send_message( block_message_to_send );
+            }
+            while( receiving_end.blocks_received < (i + 1) * node_count )
+               fc::yield();
+         }
+         fc::microseconds elapsed = fc::time_point::now() - start;
+
+         for( const peer_connection_ptr& sender : senders )
+         {
+            totals.frames_sent += sender->get_total_messages_sent();
+            totals.bytes_sent += sender->get_total_bytes_sent();
+            totals.buffers_framed += sender->get_total_messages_serialized();
+         }
+         if( !shared_payloads )
+            totals.bytes_framed = totals.bytes_sent;
+         BOOST_CHECK_EQUAL( receiving_end.blocks_received, node_count * block_count );
+         BOOST_CHECK_EQUAL( receiving_end.transactions_received, node_count * block_count * transfers_per_block );
+         BOOST_CHECK_EQUAL( totals.frames_sent, message_count * node_count );
+         ilog( "shared payloads ${s}, ${m} messages to ${n} peers: ${f} frames (${b} bytes) sent from ${c} buffers framed (${a} bytes) in ${e} us",
+               ("s", shared_payloads)("m", message_count)("n", node_count)("f", totals.frames_sent)("b", totals.bytes_sent)
+               ("c", totals.buffers_framed)("a", totals.bytes_framed)("e", elapsed.count()) );
+         return totals;
+      };
+
+      broadcast_totals per_peer = relay( false );
+      broadcast_totals shared = relay( true );
+
+      // the same bytes go out on every connection, but only the shared mode frames each message just once
+      BOOST_CHECK_EQUAL( shared.bytes_sent, per_peer.bytes_sent );
+      BOOST_CHECK_EQUAL( per_peer.buffers_framed, message_count * node_count );
+      BOOST_CHECK_EQUAL( shared.buffers_framed, message_count );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
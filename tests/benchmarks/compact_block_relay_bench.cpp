@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/net/node.hpp>
+
+#include <fc/thread/thread.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+#include "counting_node_delegate.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+BOOST_FIXTURE_TEST_CASE( compact_block_relay_bench, database_fixture )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t block_count = 20;
+      const uint32_t transfers_per_block = 200;
+#else
+      const uint32_t block_count = 5;
+      const uint32_t transfers_per_block = 50;
+#endif
+      const uint32_t node_count = 4;
+
+      ACTORS((alice)(bob));
+      transfer( committee_account, alice_id, asset( 100000000 ) );
+      generate_block();
+
+      std::vector<signed_block> blocks;
+      for( uint32_t i = 0; i < block_count; ++i )
+      {
+         for( uint32_t j = 0; j < transfers_per_block; ++j )
+            transfer( alice_id, bob_id, asset( 1 + j ) );
+         blocks.push_back( generate_block() );
+      }
+
+      // every transaction is relayed ahead of its block, except every unseen_every-th one,
+      // which the nodes only learn about from the block
+      auto relay = [&]( bool compact_blocks, uint32_t unseen_every )
+      {
+         graphene::net::simulated_network network( "compact_block_relay_bench" );
+         network.set_link_characteristics( fc::milliseconds( 20 ), 256 * 1024 );
+         network.set_compact_blocks_enabled( compact_blocks );
+         std::vector<std::unique_ptr<counting_node_delegate>> nodes;
+         for( uint32_t i = 0; i < node_count; ++i )
+         {
+            nodes.emplace_back( new counting_node_delegate );
+            network.add_node_delegate( nodes.back().get() );
+         }
+
+         for( const signed_block& block : blocks )
+         {
+            for( uint32_t i = 0; i < block.transactions.size(); ++i )
+               if( !unseen_every || i % unseen_every != 0 )
+                  network.broadcast( graphene::net::trx_message( block.transactions[i] ) );
+            network.broadcast( graphene::net::block_message( block ) );
+         }
+         auto all_delivered = [&]() {
+            for( const auto& node : nodes )
+               if( node->blocks_received < blocks.size() )
+                  return false;
+            return true;
+         };
+         while( !all_delivered() )
+            fc::usleep( fc::milliseconds( 10 ) );
+
+         graphene::net::simulated_network::traffic_statistics statistics = network.get_traffic_statistics();
+         BOOST_CHECK_EQUAL( statistics.blocks_delivered, node_count * block_count );
+         ilog( "compact blocks ${c}, 1 in ${u} transactions unseen: ${b} block bytes of ${t} total, "
+               "${f} transactions fetched, ${l} us mean block latency",
+               ("c", compact_blocks)("u", unseen_every)("b", statistics.block_bytes_sent)("t", statistics.bytes_sent)
+               ("f", statistics.transactions_fetched_for_blocks)
+               ("l", statistics.total_block_latency.count() / statistics.blocks_delivered) );
+         return statistics;
+      };
+
+      auto full = relay( false, 0 );
+      auto compact = relay( true, 0 );
+      auto compact_with_misses = relay( true, 10 );
+
+      BOOST_CHECK_EQUAL( compact.transactions_fetched_for_blocks, 0u );
+      BOOST_CHECK_GT( compact_with_misses.transactions_fetched_for_blocks, 0u );
+      BOOST_CHECK_LT( compact.block_bytes_sent, full.block_bytes_sent );
+      BOOST_CHECK_LT( compact_with_misses.block_bytes_sent, full.block_bytes_sent );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
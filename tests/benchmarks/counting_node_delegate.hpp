@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/config.hpp>
+#include <graphene/net/node.hpp>
+
+namespace graphene { namespace chain { namespace test {
+
+/** Stands in for a node's blockchain, counting what the simulated network hands it */
+class counting_node_delegate : public graphene::net::node_delegate
+{
+public:
+   uint32_t blocks_received = 0;
+   uint32_t transactions_received = 0;
+
+   bool has_item( const graphene::net::item_id& id ) override { return false; }
+   bool handle_block( const graphene::net::block_message& blk_msg, bool sync_mode,
+                      std::vector<fc::uint160_t>& contained_transaction_message_ids ) override
+   {
+      ++blocks_received;
+      return false;
+   }
+   void handle_transaction( const graphene::net::trx_message& trx_msg ) override { ++transactions_received; }
+   void handle_message( const graphene::net::message& message_to_process ) override {}
+   std::vector<graphene::net::item_hash_t> get_block_ids( const std::vector<graphene::net::item_hash_t>& blockchain_synopsis,
+                                                          uint32_t& remaining_item_count, uint32_t limit ) override { return {}; }
+   graphene::net::message get_item( const graphene::net::item_id& id ) override { FC_THROW_EXCEPTION( fc::key_not_found_exception, "" ); }
+   chain_id_type get_chain_id()const override { return chain_id_type(); }
+   std::vector<graphene::net::item_hash_t> get_blockchain_synopsis( const graphene::net::item_hash_t& reference_point,
+                                                                    uint32_t number_of_blocks_after_reference_point ) override { return {}; }
+   void sync_status( uint32_t item_type, uint32_t item_count ) override {}
+   void connection_count_changed( uint32_t c ) override {}
+   uint32_t get_block_number( const graphene::net::item_hash_t& block_id ) override { return 0; }
+   fc::time_point_sec get_block_time( const graphene::net::item_hash_t& block_id ) override { return fc::time_point_sec(); }
+   fc::time_point_sec get_blockchain_now() override { return fc::time_point_sec(); }
+   graphene::net::item_hash_t get_head_block_id()const override { return graphene::net::item_hash_t(); }
+   uint32_t estimate_last_known_fork_from_git_revision_timestamp( uint32_t unix_timestamp )const override { return 0; }
+   void error_encountered( const std::string& message, const fc::oexception& error ) override {}
+   uint8_t get_current_block_interval_in_seconds()const override { return GRAPHENE_DEFAULT_BLOCK_INTERVAL; }
+};
+
+} } } // graphene::chain::test
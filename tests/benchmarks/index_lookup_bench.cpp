@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+BOOST_FIXTURE_TEST_CASE( index_lookup_bench, database_fixture )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t rounds = 2000;
+#else
+      const uint32_t rounds = 100;
+#endif
+      for( uint32_t i = 0; i < 1000; ++i )
+         create_account( "lookup" + fc::to_string(i) );
+      generate_block();
+
+      vector<account_id_type> ids;
+      for( const auto& acct : db.get_index_type<account_index>().indices() )
+         ids.push_back( acct.id );
+      const uint64_t lookups = uint64_t(rounds) * ids.size();
+
+      // the generic path: get_index() with its checks, then the virtual index::find()
+      uint64_t checksum = 0;
+      auto start = fc::time_point::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         for( const auto& id : ids )
+            checksum += static_cast<const account_object&>( db.get_object( id ) ).network_fee_percentage;
+      auto generic_elapsed = fc::time_point::now() - start;
+
+      // the typed path through the dense instance table
+      uint64_t typed_checksum = 0;
+      start = fc::time_point::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         for( const auto& id : ids )
+            typed_checksum += id(db).network_fee_percentage;
+      auto typed_elapsed = fc::time_point::now() - start;
+
+      BOOST_CHECK_EQUAL( checksum, typed_checksum );
+      auto rate = []( uint64_t n, const fc::microseconds& t ) { return t.count() ? double(n) * 1000000.0 / t.count() : 0.0; };
+      ilog( "${n} account lookups: generic ${g} lookups/s, typed ${t} lookups/s",
+            ("n", lookups)("g", rate( lookups, generic_elapsed ))("t", rate( lookups, typed_elapsed )) );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
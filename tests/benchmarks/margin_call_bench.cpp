@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/market_object.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+BOOST_FIXTURE_TEST_CASE( margin_call_bench, database_fixture )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t borrowers = 3000;
+      const uint32_t publications = 2000;
+      const uint32_t checks = 200000;
+#else
+      const uint32_t borrowers = 300;
+      const uint32_t publications = 200;
+      const uint32_t checks = 20000;
+#endif
+      ACTORS((feedproducer)(seller));
+      const asset_id_type usd_id = create_bitasset( "USDBIT", feedproducer_id ).id;
+      update_feed_producers( usd_id(db), {feedproducer_id} );
+
+      price_feed feed;
+      feed.settlement_price = asset( 100, usd_id ) / asset( 100 );
+      publish_feed( usd_id(db), feedproducer_id(db), feed );
+
+      // call orders collateralized between 3x and 6x, far from a margin call
+      transfer( committee_account, seller_id, asset( 10000000 ) );
+      borrow( seller_id(db), asset( 100000, usd_id ), asset( 500000 ) );
+      for( uint32_t i = 0; i < borrowers; ++i )
+      {
+         const account_object& borrower = create_account( "borrower" + fc::to_string(i) );
+         transfer( committee_account(db), borrower, asset( 100000 ) );
+         borrow( borrower, asset( 1000, usd_id ), asset( 3000 + i % 3000 ) );
+         if( i % 100 == 99 )
+            generate_block();
+      }
+      // a bid for core within the short squeeze limit, so check_call_orders() has to look at the calls
+      create_sell_order( seller_id(db), asset( 1000, usd_id ), asset( 1000 ) );
+      generate_block();
+
+      auto rate = []( uint64_t n, const fc::microseconds& t ) { return t.count() ? double(n) * 1000000.0 / t.count() : 0.0; };
+      auto bench = [&]( bool trigger_checks )
+      {
+         db.set_margin_call_trigger_checks( trigger_checks );
+
+         auto start = fc::time_point::now();
+         for( uint32_t i = 0; i < checks; ++i )
+            BOOST_CHECK( !db.check_call_orders( usd_id(db) ) );
+         auto check_elapsed = fc::time_point::now() - start;
+
+         start = fc::time_point::now();
+         for( uint32_t i = 0; i < publications; ++i )
+         {
+            // every publication differs, so that no transaction repeats
+            feed.settlement_price = asset( 100000, usd_id ) / asset( 90000 + i );
+            publish_feed( usd_id(db), feedproducer_id(db), feed );
+         }
+         auto publish_elapsed = fc::time_point::now() - start;
+         db.clear_pending();
+
+         ilog( "${b} call orders, trigger checks ${c}: ${r} check_call_orders/s, ${p} feed publications/s",
+               ("b", borrowers)("c", trigger_checks)("r", rate( checks, check_elapsed ))
+               ("p", rate( publications, publish_elapsed )) );
+      };
+      bench( false );
+      bench( true );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
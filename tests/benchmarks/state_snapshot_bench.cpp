@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+/**
+ *  Runs queries similar to lookup_accounts against the state snapshots with a growing number of threads, while
+ *  blocks keep being applied on the main thread.
+ */
+BOOST_FIXTURE_TEST_CASE( state_snapshot_bench, database_fixture )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t accounts = 2000;
+      const uint32_t queries = 20000;
+      const uint32_t blocks = 50;
+#else
+      const uint32_t accounts = 200;
+      const uint32_t queries = 2000;
+      const uint32_t blocks = 10;
+#endif
+      for( uint32_t i = 0; i < accounts; ++i )
+         create_account( "snapshot" + fc::to_string(i) );
+      generate_block();
+
+      auto rate = []( uint64_t n, const fc::microseconds& t ) { return t.count() ? double(n) * 1000000.0 / t.count() : 0.0; };
+      for( uint32_t threads : { 1, 2, 4, 8 } )
+      {
+         db.enable_state_snapshots( threads );
+         const state_snapshots& snapshots = *db.get_state_snapshots();
+
+         vector< fc::future<size_t> > results;
+         results.reserve( queries );
+         fc::microseconds block_time;
+         auto start = fc::time_point::now();
+         for( uint32_t i = 0; i < queries; ++i )
+         {
+            results.push_back( snapshots.async( []( const database& snapshot ) {
+               const auto& idx = snapshot.get_index_type<account_index>().indices().get<by_name>();
+               size_t names = 0;
+               for( auto itr = idx.lower_bound( "snapshot" ); itr != idx.end() && names < 1000; ++itr )
+                  names += itr->name.size();
+               return names;
+            }));
+            if( i % (queries / blocks) == 0 )
+            {
+               auto block_start = fc::time_point::now();
+               transfer( account_id_type(), get_account( "snapshot" + fc::to_string( i % accounts ) ).id, asset( 1000 ) );
+               generate_block();
+               block_time += fc::time_point::now() - block_start;
+            }
+         }
+         size_t checksum = 0;
+         for( auto& result : results )
+            checksum += result.wait();
+         auto elapsed = fc::time_point::now() - start;
+         BOOST_CHECK( checksum > 0 );
+
+         ilog( "${t} snapshot threads: ${q} queries/s, ${b} blocks applied in ${ms} ms meanwhile",
+               ("t", threads)("q", rate( queries, elapsed ))("b", blocks)("ms", block_time.count() / 1000) );
+      }
+      db.enable_state_snapshots( 0 );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/net/config.hpp>
+#include <graphene/net/message.hpp>
+#include <graphene/net/stcp_socket.hpp>
+
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include <cstring>
+
+using namespace graphene::net;
+
+BOOST_AUTO_TEST_CASE( stcp_socket_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t total_bytes = 256 * 1024 * 1024;
+#else
+      const uint32_t total_bytes = 16 * 1024 * 1024;
+#endif
+
+      fc::tcp_server server;
+      server.listen( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ) );
+      stcp_socket receiver;
+      stcp_socket sender;
+      fc::future<void> accepted = fc::async( [&]() {
+         server.accept( receiver.get_socket() );
+         receiver.accept();
+      }, "accept" );
+      sender.connect_to( server.get_local_endpoint() );
+      accepted.wait();
+
+      // transactions are a few hundred bytes, blocks up to a few megabytes
+      auto run = [&]( uint32_t message_size, bool batched )
+      {
+         std::vector<serialized_message_ptr> messages;
+         for( uint32_t sent = 0; sent < total_bytes; sent += message_size )
+         {
+            message message_to_send;
+            message_to_send.msg_type = 0;
+            message_to_send.data.resize( message_size - sizeof(message_header) );
+            for( size_t i = 0; i < message_to_send.data.size(); ++i )
+               message_to_send.data[i] = char( messages.size() + i );
+            message_to_send.size = (uint32_t)message_to_send.data.size();
+            messages.push_back( serialize_message( message_to_send ) );
+         }
+
+         // reads them back the way message_oriented_connection does: the first 16 bytes, then the rest
+         fc::future<uint32_t> received = fc::async( [&]() {
+            uint32_t mismatches = 0;
+            std::vector<char> buffer;
+            for( const serialized_message_ptr& expected : messages )
+            {
+               buffer.resize( expected->size() );
+               receiver.read( buffer.data(), 16 );
+               receiver.read( buffer.data() + 16, buffer.size() - 16 );
+               if( memcmp( buffer.data(), expected->data(), buffer.size() ) != 0 )
+                  ++mismatches;
+            }
+            return mismatches;
+         }, "receive" );
+
+         fc::time_point start = fc::time_point::now();
+         if( batched )
+         {
+            // batches the way peer_connection does: up to and including the message that fills the buffer
+            std::vector<stcp_socket::const_buffer> batch;
+            size_t batch_bytes = 0;
+            for( const serialized_message_ptr& message_to_send : messages )
+            {
+               batch.emplace_back( message_to_send->data(), message_to_send->size() );
+               batch_bytes += message_to_send->size();
+               if( batch_bytes >= GRAPHENE_NET_STCP_BUFFER_SIZE )
+               {
+                  sender.write_buffers( batch );
+                  sender.flush();
+                  batch.clear();
+                  batch_bytes = 0;
+               }
+            }
+            if( !batch.empty() )
+            {
+               sender.write_buffers( batch );
+               sender.flush();
+            }
+         }
+         else
+         {
+            for( const serialized_message_ptr& message_to_send : messages )
+            {
+               sender.write( message_to_send->data(), message_to_send->size() );
+               sender.flush();
+            }
+         }
+         uint32_t mismatches = received.wait();
+         fc::microseconds elapsed = fc::time_point::now() - start;
+
+         BOOST_CHECK_EQUAL( mismatches, 0u );
+         double megabytes_per_second = double( messages.size() * messages.front()->size() ) / elapsed.count();
+         ilog( "${n} messages of ${s} bytes ${b}: ${t} ms, ${r} MB/s",
+               ("n", messages.size())("s", message_size)("b", batched ? "batched" : "one write each")
+               ("t", elapsed.count() / 1000)("r", megabytes_per_second) );
+         return megabytes_per_second;
+      };
+
+      for( uint32_t message_size : { 256u, 4096u, 1024u * 1024u } )
+      {
+         double unbatched = run( message_size, false );
+         double batched = run( message_size, true );
+         ilog( "${s} byte messages: batching sends at ${x}x the throughput", ("s", message_size)("x", batched / unbatched) );
+      }
+
+      sender.close();
+      receiver.close();
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+BOOST_FIXTURE_TEST_CASE( undo_session_bench, database_fixture )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t cycles = 200000;
+#else
+      const uint32_t cycles = 10000;
+#endif
+      vector<const account_statistics_object*> stats;
+      vector<share_type> initial_fees;
+      for( const auto& acct : db.get_index_type<account_index>().indices() )
+      {
+         stats.push_back( &acct.statistics(db) );
+         initial_fees.push_back( stats.back()->lifetime_fees_paid );
+      }
+
+      // Each cycle opens a block-like session and a nested pending-transaction-like session,
+      // modifies every account statistics object and then either merges or undoes them.
+      auto start = fc::time_point::now();
+      for( uint32_t i = 0; i < cycles; ++i )
+      {
+         auto outer = db._undo_db.start_undo_session();
+         for( const auto* s : stats )
+            db.modify( *s, [&]( account_statistics_object& o ) { o.total_core_in_orders += 1; } );
+
+         auto inner = db._undo_db.start_undo_session();
+         for( const auto* s : stats )
+            db.modify( *s, [&]( account_statistics_object& o ) { o.lifetime_fees_paid += 1; } );
+         if( i % 2 )
+            inner.merge();
+         else
+            inner.undo();
+         outer.undo();
+      }
+      auto elapsed = fc::time_point::now() - start;
+
+      for( size_t i = 0; i < stats.size(); ++i )
+         BOOST_CHECK( stats[i]->lifetime_fees_paid == initial_fees[i] );
+      ilog( "${c} undo session cycles over ${n} objects in ${ms} ms, ${r} cycles/s",
+            ("c", cycles)("n", stats.size())("ms", elapsed.count() / 1000)
+            ("r", elapsed.count() ? double(cycles) * 1000000.0 / elapsed.count() : 0.0) );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
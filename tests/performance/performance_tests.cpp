@@ -51,6 +51,47 @@ BOOST_AUTO_TEST_CASE( sigcheck_benchmark )
    auto elapsed = end-start;
    wdump( ((100000.0*1000000.0) / elapsed.count()) );
 }
+
+BOOST_FIXTURE_TEST_CASE( parallel_signature_recovery_benchmark, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   transfer( committee_account, alice_id, asset(10000000) );
+
+   signed_block blk;
+   for( uint32_t i = 0; i < 1000; ++i )
+   {
+      signed_transaction tx;
+      transfer_operation op;
+      op.from   = alice_id;
+      op.to     = bob_id;
+      op.amount = asset( i + 1 );
+      tx.operations.push_back( op );
+      test::set_expiration( db, tx );
+      tx.sign( alice_private_key, db.get_chain_id() );
+      blk.transactions.push_back( tx );
+   }
+
+   for( uint32_t thread_count : { 1, 2, 4, 8 } )
+   {
+      signed_block copy = blk;
+      db.set_signature_recovery_threads( thread_count );
+      // every run has to recover all of the keys, not look up the ones the previous run cached
+      db.clear_signature_cache();
+
+      auto start = fc::time_point::now();
+      db.precompute_signature_keys( copy );
+      auto elapsed = fc::time_point::now() - start;
+
+      for( const auto& tx : copy.transactions )
+      {
+         auto keys = tx.get_signature_keys( db.get_chain_id() );
+         BOOST_CHECK( keys.size() == 1 && *keys.begin() == alice_public_key );
+      }
+      ilog( "Recovered signature keys of ${n} transactions using ${t} threads in ${ms} ms",
+            ("n", copy.transactions.size())("t", thread_count)("ms", elapsed.count() / 1000) );
+   }
+   db.set_signature_recovery_threads( 0 );
+} FC_LOG_AND_RETHROW() }
 /*
 BOOST_AUTO_TEST_CASE( transfer_benchmark )
 {
@@ -1313,4 +1313,124 @@ BOOST_FIXTURE_TEST_CASE( nonminimal_sig_test, database_fixture )
    }
 }
 
+BOOST_AUTO_TEST_CASE( signature_key_cache_test )
+{ try {
+   fc::ecc::private_key key1 = generate_private_key( "key1" );
+   fc::ecc::private_key key2 = generate_private_key( "key2" );
+   const chain_id_type& chain_id = db.get_chain_id();
+
+   signed_transaction trx;
+   trx.operations.push_back( transfer_operation() );
+   trx.set_expiration( db.head_block_time() + fc::minutes(1) );
+   trx.sign( key1, chain_id );
+   trx.sign( key2, chain_id );
+
+   signature_key_cache cache;
+   auto keys = cache.get_signature_keys( trx, chain_id );
+   BOOST_CHECK( keys == trx.get_signature_keys( chain_id ) );
+   BOOST_CHECK_EQUAL( cache.get_stats().misses, 2 );
+   BOOST_CHECK_EQUAL( cache.get_stats().hits, 0 );
+
+   // a copy of the transaction reuses the keys recovered before
+   signed_transaction copy = trx;
+   BOOST_CHECK( cache.get_signature_keys( copy, chain_id ) == keys );
+   BOOST_CHECK_EQUAL( cache.get_stats().misses, 2 );
+   BOOST_CHECK_EQUAL( cache.get_stats().hits, 2 );
+   BOOST_CHECK_EQUAL( cache.get_stats().entries, 2 );
+
+   // the same signature on a changed transaction is recovered again
+   copy.set_expiration( copy.expiration + 1 );
+   BOOST_CHECK( cache.get_signature_keys( copy, chain_id ) != keys );
+   BOOST_CHECK_EQUAL( cache.get_stats().misses, 4 );
+
+   trx.signatures.push_back( trx.signatures.front() );
+   GRAPHENE_REQUIRE_THROW( cache.get_signature_keys( trx, chain_id ), tx_duplicate_sig );
+
+   // entries are dropped when their transaction expires, or earliest first when the cache is full
+   cache.set_max_entries( 3 );
+   BOOST_CHECK_EQUAL( cache.get_stats().entries, 3 );
+   cache.remove_expired( trx.expiration + 1 );
+   BOOST_CHECK_EQUAL( cache.get_stats().entries, 2 );
+   cache.remove_expired( copy.expiration + 1 );
+   BOOST_CHECK_EQUAL( cache.get_stats().entries, 0 );
+
+   // an expiration later than any valid transaction can have doesn't keep an entry around longer
+   cache.set_expiration_limit( trx.expiration );
+   signed_transaction far = trx;
+   far.signatures.clear();
+   far.set_expiration( trx.expiration + 365*24*60*60 );
+   far.sign( key1, chain_id );
+   cache.get_signature_keys( far, chain_id );
+   BOOST_CHECK_EQUAL( cache.get_stats().entries, 1 );
+   cache.remove_expired( trx.expiration + 1 );
+   BOOST_CHECK_EQUAL( cache.get_stats().entries, 0 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( precheck_transaction_test )
+{ try {
+   ACTORS( (alice) );
+   fund( alice );
+   generate_block();
+   const chain_id_type& chain_id = db.get_chain_id();
+
+   transfer_operation op;
+   op.from = alice_id;
+   op.to = account_id_type();
+   op.amount = asset( 1 );
+
+   signed_transaction trx;
+   trx.operations.push_back( op );
+   trx.set_expiration( db.head_block_time() + fc::minutes(1) );
+   trx.sign( alice_private_key, chain_id );
+
+   // only failures no chain state can change are reported as malformed
+   auto is_malformed = [&]( const signed_transaction& t ) -> bool
+   {
+      try
+      {
+         db.precheck_transaction( t );
+      }
+      catch( const tx_malformed& )
+      {
+         return true;
+      }
+      catch( const fc::exception& )
+      {
+         return false;
+      }
+      BOOST_ERROR( "precheck_transaction accepted an invalid transaction" );
+      return false;
+   };
+
+   for( uint32_t threads : { 0, 2 } )
+   {
+      db.set_transaction_precheck_threads( threads );
+      db.precheck_transaction( trx );
+
+      signed_transaction expired = trx;
+      expired.set_expiration( db.head_block_time() - 1 );
+      BOOST_CHECK( !is_malformed( expired ) );
+
+      signed_transaction too_far = trx;
+      too_far.set_expiration( db.head_block_time() + db.get_global_properties().parameters.maximum_time_until_expiration + 1 );
+      BOOST_CHECK( !is_malformed( too_far ) );
+
+      signed_transaction empty = trx;
+      empty.operations.clear();
+      BOOST_CHECK( is_malformed( empty ) );
+
+      signed_transaction duplicate_sig = trx;
+      duplicate_sig.signatures.push_back( trx.signatures.front() );
+      BOOST_CHECK( is_malformed( duplicate_sig ) );
+   }
+   db.set_transaction_precheck_threads( 0 );
+
+   // the keys recovered by the precheck are reused when the transaction is pushed
+   signature_cache_stats before = db.get_signature_cache_stats();
+   PUSH_TX( db, trx );
+   signature_cache_stats after = db.get_signature_cache_stats();
+   BOOST_CHECK_EQUAL( after.misses, before.misses );
+   BOOST_CHECK_EQUAL( after.hits, before.hits + trx.signatures.size() );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
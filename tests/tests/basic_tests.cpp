@@ -410,4 +410,97 @@ BOOST_AUTO_TEST_CASE( merkle_root )
    BOOST_CHECK( block.calculate_merkle_root() == c(dO) );
 }
 
+BOOST_AUTO_TEST_CASE( expiration_schedule_test )
+{
+   expiration_schedule<account_id_type> schedule;
+   const time_point_sec t( 1000 );
+   auto pop = [&]( time_point_sec now ) {
+      vector<account_id_type> result;
+      schedule.pop_due( now, [&]( account_id_type id ) { result.push_back( id ); } );
+      return result;
+   };
+   typedef vector<account_id_type> ids;
+
+   // ids are visited by deadline, then by id, and each only once
+   schedule.schedule( account_id_type(3), t + 10 );
+   schedule.schedule( account_id_type(2), t + 10 );
+   schedule.schedule( account_id_type(1), t + 20 );
+   schedule.schedule( account_id_type(4), t );
+   BOOST_CHECK( schedule.size() == 4 );
+   BOOST_CHECK( pop( t - 1 ).empty() );
+   BOOST_CHECK( pop( t + 10 ) == ids({ account_id_type(4), account_id_type(2), account_id_type(3) }) );
+   BOOST_CHECK( pop( t + 10 ).empty() );
+   BOOST_CHECK( schedule.size() == 1 );
+
+   // scheduling a scheduled id again moves it
+   schedule.schedule( account_id_type(1), t + 30 );
+   BOOST_CHECK( schedule.size() == 1 );
+   BOOST_CHECK( pop( t + 29 ).empty() );
+   schedule.schedule( account_id_type(1), t + 15 );
+   BOOST_CHECK( pop( t + 15 ) == ids({ account_id_type(1) }) );
+   BOOST_CHECK( schedule.size() == 0 );
+
+   // cancelled ids are not visited
+   schedule.schedule( account_id_type(5), t + 40 );
+   schedule.schedule( account_id_type(6), t + 40 );
+   schedule.cancel( account_id_type(5) );
+   schedule.cancel( account_id_type(7) );
+   BOOST_CHECK( pop( t + 50 ) == ids({ account_id_type(6) }) );
+   BOOST_CHECK( schedule.size() == 0 );
+}
+
+BOOST_AUTO_TEST_CASE( feed_expiration_schedule_test )
+{ try {
+   ACTORS((feedproducer));
+   const asset_id_type usd_id = create_bitasset( "USDBIT", feedproducer_id ).get_id();
+   const asset_id_type eur_id = create_bitasset( "EURBIT", feedproducer_id ).get_id();
+   generate_block();
+
+   // the schedule is not observing the indexes, so the changes the observers would report are made by hand
+   feed_expiration_schedule schedule;
+   typedef vector<asset_id_type> ids;
+   auto next_block = [&]() {
+      generate_block();
+      ids result;
+      schedule.begin( db );
+      for( optional<asset_id_type> next = schedule.next( db ); next.valid(); next = schedule.next( db ) )
+         result.push_back( *next );
+      schedule.end( db );
+      return result;
+   };
+   auto expiring_copy = [&]( asset_id_type id, time_point_sec expiration ) {
+      asset_bitasset_data_object b = id(db).bitasset_data(db);
+      b.current_feed_publication_time = expiration - b.options.feed_lifetime_sec;
+      return b;
+   };
+
+   BOOST_TEST_MESSAGE( "A new schedule looks at every market issued asset, in id order" );
+   BOOST_CHECK( next_block() == ids({ usd_id, eur_id }) );
+   BOOST_CHECK( next_block().empty() );
+
+   BOOST_TEST_MESSAGE( "Changed and due assets are looked at in id order, a due asset only once" );
+   schedule.bitasset_changed( expiring_copy( eur_id, db.get_slot_time( 1 ) + 1 ) );
+   schedule.bitasset_changed( usd_id(db).bitasset_data(db) );
+   BOOST_CHECK( next_block() == ids({ usd_id, eur_id }) );
+   BOOST_CHECK( next_block() == ids({ eur_id }) );
+   BOOST_CHECK( next_block().empty() );
+
+   BOOST_TEST_MESSAGE( "A feed update moves the expiration" );
+   schedule.bitasset_changed( expiring_copy( eur_id, db.get_slot_time( 1 ) + 1 ) );
+   schedule.bitasset_changed( expiring_copy( eur_id, db.head_block_time() + 86400 ) );
+   BOOST_CHECK( next_block() == ids({ eur_id }) );
+   BOOST_CHECK( next_block().empty() );
+
+   BOOST_TEST_MESSAGE( "Removed assets are not looked at" );
+   const asset_bitasset_data_object usd_bitasset = expiring_copy( usd_id, db.get_slot_time( 1 ) + 1 );
+   schedule.bitasset_changed( usd_bitasset );
+   schedule.asset_removed( usd_id(db) );
+   schedule.bitasset_removed( usd_bitasset );
+   BOOST_CHECK( next_block().empty() );
+   BOOST_CHECK( next_block().empty() );
+} catch( const fc::exception& e ) {
+   edump((e.to_detail_string()));
+   throw;
+} }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -125,6 +125,51 @@ BOOST_AUTO_TEST_CASE( block_database_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( block_database_cache_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+      bdb.set_cache_size( 2 );
+
+      vector<signed_block> blocks;
+      signed_block b;
+      for( uint32_t i = 0; i < 4; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         bdb.store( b.id(), b );
+         blocks.push_back( b );
+      }
+
+      // the two most recently stored blocks are cached, older ones are read from disk
+      uint64_t hits = bdb.cache_hits();
+      BOOST_CHECK( bdb.fetch_by_number( 4 )->witness == witness_id_type(4) );
+      BOOST_CHECK( bdb.fetch_optional( blocks[2].id() )->witness == witness_id_type(3) );
+      BOOST_CHECK_EQUAL( bdb.cache_hits(), hits + 2 );
+      uint64_t misses = bdb.cache_misses();
+      BOOST_CHECK( bdb.fetch_by_number( 1 )->witness == witness_id_type(1) );
+      BOOST_CHECK_EQUAL( bdb.cache_misses(), misses + 1 );
+
+      // replacing a block on a fork must not serve the old one from the cache
+      bdb.remove( blocks[3].id() );
+      BOOST_CHECK( !bdb.fetch_by_number( 4 ).valid() );
+      BOOST_CHECK( !bdb.fetch_optional( blocks[3].id() ).valid() );
+
+      signed_block fork = blocks[3];
+      fork.witness = witness_id_type(10);
+      bdb.store( fork.id(), fork );
+      BOOST_CHECK( bdb.fetch_by_number( 4 )->witness == witness_id_type(10) );
+      BOOST_CHECK( !bdb.fetch_optional( blocks[3].id() ).valid() );
+      BOOST_CHECK( bdb.fetch_optional( fork.id() )->witness == witness_id_type(10) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
 {
    try {
@@ -180,6 +225,37 @@ BOOST_AUTO_TEST_CASE( generate_empty_blocks )
    }
 }
 
+BOOST_AUTO_TEST_CASE( incremental_persistence_saves_irreversible_state )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      block_id_type head_id;
+      {
+         database db;
+         db.enable_incremental_persistence( 4 );
+         db.open(data_dir.path(), make_genesis );
+         while( db.get_dynamic_global_properties().last_irreversible_block_num < 50 )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         BOOST_CHECK( fc::exists( data_dir.path() / "object_database" / "log" ) );
+         head_id = db.head_block_id();
+         // the database is not closed, as after a crash only what push_block() saved is on disk
+      }
+      {
+         database db;
+         db.enable_incremental_persistence( 4 );
+         db.open(data_dir.path(), make_genesis );
+         // the saved state is brought up to the last stored block
+         BOOST_CHECK( db.head_block_id() == head_id );
+         db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         db.close();
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( undo_block )
 {
    try {
@@ -549,6 +625,115 @@ BOOST_AUTO_TEST_CASE( duplicate_transactions )
    }
 }
 
+BOOST_AUTO_TEST_CASE( pending_transaction_revalidation )
+{
+   try {
+      fc::temp_directory dir1( graphene::utilities::temp_directory_path() ),
+                         dir2( graphene::utilities::temp_directory_path() );
+      database db1,
+               db2;
+      db1.open(dir1.path(), make_genesis);
+      db2.open(dir2.path(), make_genesis);
+
+      auto skip_sigs = database::skip_transaction_signatures | database::skip_authority_check;
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      public_key_type init_account_pub_key  = init_account_priv_key.get_public_key();
+      auto new_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("new_key")) );
+      public_key_type new_pub_key = new_key.get_public_key();
+
+      // get past the maintenance of the first block, which changes the global properties
+      auto b = db1.generate_block( db1.get_slot_time(1), db1.get_scheduled_witness( 1 ), init_account_priv_key, database::skip_nothing );
+      PUSH_BLOCK( db2, b );
+
+      const auto& accounts_by_name = db2.get_index_type<account_index>().indices().get<by_name>();
+      const account_id_type init0_id = accounts_by_name.find("init0")->id;
+      const account_id_type init1_id = accounts_by_name.find("init1")->id;
+
+      auto create_account = [&]( const string& name, account_id_type registrar, uint32_t skip )
+      {
+         signed_transaction trx;
+         set_expiration( db2, trx );
+         account_create_operation cop;
+         cop.registrar = registrar;
+         cop.referrer = registrar;
+         cop.name = name;
+         cop.owner = authority(1, init_account_pub_key, 1);
+         cop.active = cop.owner;
+         cop.options.memo_key = init_account_pub_key;
+         trx.operations.push_back(cop);
+         trx.sign( init_account_priv_key, db2.get_chain_id() );
+         PUSH_TX( db2, trx, skip );
+         return trx;
+      };
+      auto update_init0 = [&]( const authority& auth )
+      {
+         signed_transaction trx;
+         set_expiration( db1, trx );
+         account_update_operation uop;
+         uop.account = init0_id;
+         uop.owner = auth;
+         uop.active = auth;
+         trx.operations.push_back(uop);
+         trx.sign( init_account_priv_key, db1.get_chain_id() );
+         PUSH_TX( db1, trx );
+         return db1.generate_block( db1.get_slot_time(1), db1.get_scheduled_witness( 1 ), init_account_priv_key, database::skip_nothing );
+      };
+
+      // alice and bob are registered by init0, carol by init1, and dave's authorities aren't checked
+      create_account( "alice", init0_id, database::skip_nothing );
+      create_account( "bob", init0_id, database::skip_nothing );
+      signed_transaction carol_trx = create_account( "carol", init1_id, database::skip_nothing );
+      create_account( "dave", init1_id, skip_sigs );
+
+      // a block that changes none of the accounts they read only checks the one that was never checked
+      b = db1.generate_block( db1.get_slot_time(1), db1.get_scheduled_witness( 1 ), init_account_priv_key, database::skip_nothing );
+      PUSH_BLOCK( db2, b );
+      pending_revalidation_stats stats = db2.get_pending_revalidation_stats();
+      BOOST_CHECK_EQUAL( stats.reapplied, 4 );
+      BOOST_CHECK_EQUAL( stats.rechecked, 1 );
+      BOOST_CHECK_EQUAL( stats.failed, 0 );
+
+      // after which it isn't checked again either
+      b = db1.generate_block( db1.get_slot_time(1), db1.get_scheduled_witness( 1 ), init_account_priv_key, database::skip_nothing );
+      PUSH_BLOCK( db2, b );
+      stats = db2.get_pending_revalidation_stats();
+      BOOST_CHECK_EQUAL( stats.reapplied, 4 );
+      BOOST_CHECK_EQUAL( stats.rechecked, 0 );
+
+      // changing init0's authorities checks the transactions it signed again; the old key still satisfies them
+      authority both_keys(1, init_account_pub_key, 1, new_pub_key, 1);
+      PUSH_BLOCK( db2, update_init0( both_keys ) );
+      stats = db2.get_pending_revalidation_stats();
+      BOOST_CHECK_EQUAL( stats.reapplied, 4 );
+      BOOST_CHECK_EQUAL( stats.rechecked, 2 );
+      BOOST_CHECK_EQUAL( stats.failed, 0 );
+
+      // and once it doesn't, they are dropped
+      PUSH_BLOCK( db2, update_init0( authority(1, new_pub_key, 1) ) );
+      stats = db2.get_pending_revalidation_stats();
+      BOOST_CHECK_EQUAL( stats.reapplied, 2 );
+      BOOST_CHECK_EQUAL( stats.rechecked, 0 );
+      BOOST_CHECK_EQUAL( stats.failed, 2 );
+      BOOST_CHECK( accounts_by_name.find("alice") == accounts_by_name.end() );
+      BOOST_CHECK( accounts_by_name.find("bob") == accounts_by_name.end() );
+      BOOST_CHECK( accounts_by_name.find("carol") != accounts_by_name.end() );
+      BOOST_CHECK( accounts_by_name.find("dave") != accounts_by_name.end() );
+
+      // a block containing one of them drops it without evaluating it again
+      PUSH_TX( db1, carol_trx );
+      b = db1.generate_block( db1.get_slot_time(1), db1.get_scheduled_witness( 1 ), init_account_priv_key, database::skip_nothing );
+      PUSH_BLOCK( db2, b );
+      stats = db2.get_pending_revalidation_stats();
+      BOOST_CHECK_EQUAL( stats.reapplied, 1 );
+      BOOST_CHECK_EQUAL( stats.included, 1 );
+      BOOST_CHECK_EQUAL( stats.failed, 0 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( tapos )
 {
    try {
@@ -1257,4 +1442,83 @@ BOOST_FIXTURE_TEST_CASE( miss_many_blocks, database_fixture )
    }
 }
 
+BOOST_FIXTURE_TEST_CASE( signature_recovery_determinism, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob)(carol)(dan) );
+      const account_id_type accounts[] = { alice_id, bob_id, carol_id, dan_id };
+      fc::ecc::private_key keys[] = { alice_private_key, bob_private_key, carol_private_key, dan_private_key };
+      for( const auto& id : accounts )
+         fund( id(db), asset(1000000) );
+      generate_block();
+
+      const fc::ecc::private_key alice_new_key = generate_private_key( "alice_new" );
+      for( uint32_t round = 0; round < 4; ++round )
+      {
+         for( uint32_t i = 0; i < 40; ++i )
+         {
+            const uint32_t from = i % 4, to = (i + 1 + round) % 4;
+            if( from == to ) continue;
+            signed_transaction trx;
+            transfer_operation op;
+            op.from = accounts[from];
+            op.to = accounts[to];
+            op.amount = asset( 1 + i + 100 * round );
+            trx.operations.push_back( op );
+            set_expiration( db, trx );
+            sign( trx, keys[from] );
+            PUSH_TX( db, trx );
+
+            // change a key part way through a block, so later transactions must be checked against the new authority
+            if( round == 2 && i == 20 )
+            {
+               signed_transaction update;
+               account_update_operation uop;
+               uop.account = alice_id;
+               uop.active = authority( 1, public_key_type( alice_new_key.get_public_key() ), 1 );
+               update.operations.push_back( uop );
+               set_expiration( db, update );
+               sign( update, alice_private_key );
+               PUSH_TX( db, update );
+               keys[0] = alice_new_key;
+            }
+         }
+         generate_block();
+      }
+
+      vector<signed_block> blocks;
+      for( uint32_t num = 1; num <= db.head_block_num(); ++num )
+         blocks.push_back( *db.fetch_block_by_number( num ) );
+
+      auto index_hashes = []( const database& d )
+      {
+         vector<fc::uint128> result;
+         d.inspect_all_indexes( [&]( const graphene::db::index& idx ) { result.push_back( idx.hash() ); } );
+         return result;
+      };
+
+      // replay the same blocks with keys recovered serially and on worker threads
+      vector< vector<fc::uint128> > results;
+      for( uint32_t threads : { 0, 4 } )
+      {
+         fc::temp_directory replay_dir( graphene::utilities::temp_directory_path() );
+         database replay;
+         replay.set_signature_recovery_threads( threads );
+         replay.open( replay_dir.path(), [this]{ return genesis_state; } );
+         for( const auto& b : blocks )
+            PUSH_BLOCK( replay, b, database::skip_undo_history_check );
+         BOOST_CHECK( replay.head_block_id() == db.head_block_id() );
+         results.push_back( index_hashes( replay ) );
+      }
+      BOOST_CHECK( results[0] == results[1] );
+      BOOST_CHECK( results[0] == index_hashes( db ) );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
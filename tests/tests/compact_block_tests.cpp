@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/compact_block.hpp>
+
+using namespace graphene::net;
+using namespace graphene::net::detail;
+
+namespace
+{
+   signed_block make_compact_test_block( uint32_t transaction_count )
+   {
+      signed_block b;
+      b.timestamp = fc::time_point_sec( 3 );
+      for( uint32_t i = 0; i < transaction_count; ++i )
+      {
+         graphene::chain::processed_transaction transaction;
+         transaction.ref_block_num = i;
+         transaction.expiration = fc::time_point_sec( 60 + i );
+         transaction.operation_results.push_back( graphene::chain::void_result() );
+         b.transactions.push_back( transaction );
+      }
+      b.transaction_merkle_root = b.calculate_merkle_root();
+      return b;
+   }
+
+   /// a message cache holding every transaction of the block except those at the given positions
+   std::map<item_hash_t, signed_transaction> cache_all_but( const signed_block& b, const std::set<uint32_t>& unseen )
+   {
+      std::map<item_hash_t, signed_transaction> cache;
+      for( uint32_t i = 0; i < b.transactions.size(); ++i )
+         if( !unseen.count( i ) )
+            cache[message( trx_message( b.transactions[i] ) ).id()] = b.transactions[i];
+      return cache;
+   }
+
+   std::function<fc::optional<signed_transaction>(const item_hash_t&)> lookup_in( const std::map<item_hash_t, signed_transaction>& cache )
+   {
+      return [&cache]( const item_hash_t& transaction_message_hash ) -> fc::optional<signed_transaction> {
+         auto iter = cache.find( transaction_message_hash );
+         if( iter == cache.end() )
+            return fc::optional<signed_transaction>();
+         return iter->second;
+      };
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(compact_block_tests)
+
+BOOST_AUTO_TEST_CASE( missing_transaction )
+{
+   try {
+      signed_block original = make_compact_test_block( 3 );
+      message original_message = block_message( original );
+      compact_block_message compact_block = make_compact_block_message( original, original.id(), original_message.id() );
+
+      // everything in the cache rebuilds the block with nothing left to fetch
+      std::map<item_hash_t, signed_transaction> cache = cache_all_but( original, {} );
+      signed_block rebuilt;
+      BOOST_CHECK( rebuild_compact_block( compact_block, lookup_in( cache ), rebuilt ).empty() );
+      BOOST_CHECK( message( block_message( rebuilt ) ).id() == original_message.id() );
+
+      // a transaction we never saw is left for the peer to send
+      cache = cache_all_but( original, { 1 } );
+      std::vector<uint32_t> missing = rebuild_compact_block( compact_block, lookup_in( cache ), rebuilt );
+      BOOST_REQUIRE_EQUAL( missing.size(), 1u );
+      BOOST_CHECK_EQUAL( missing[0], 1u );
+      BOOST_CHECK( rebuilt.calculate_merkle_root() != original.transaction_merkle_root );
+      // its operation results came with the compact block
+      BOOST_CHECK_EQUAL( rebuilt.transactions[1].operation_results.size(), 1u );
+
+      fill_compact_block_transactions( missing, { original.transactions[1] }, rebuilt );
+      BOOST_CHECK( rebuilt.calculate_merkle_root() == original.transaction_merkle_root );
+      BOOST_CHECK( message( block_message( rebuilt ) ).id() == original_message.id() );
+
+      // operation results that don't line up with the transactions are rejected
+      compact_block.operation_results.pop_back();
+      BOOST_CHECK_THROW( rebuild_compact_block( compact_block, lookup_in( cache ), rebuilt ), fc::exception );
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( mismatched_index )
+{
+   try {
+      signed_block original = make_compact_test_block( 3 );
+      compact_block_message compact_block = make_compact_block_message( original, original.id(),
+                                                                        message( block_message( original ) ).id() );
+      std::map<item_hash_t, signed_transaction> cache = cache_all_but( original, { 0, 2 } );
+      signed_block rebuilt;
+      std::vector<uint32_t> missing = rebuild_compact_block( compact_block, lookup_in( cache ), rebuilt );
+      BOOST_REQUIRE_EQUAL( missing.size(), 2u );
+
+      // a reply with the wrong number of transactions
+      BOOST_CHECK_THROW( fill_compact_block_transactions( missing, { original.transactions[0] }, rebuilt ), fc::exception );
+
+      // an index past the end of the block
+      BOOST_CHECK_THROW( fill_compact_block_transactions( { 0, 3 }, { original.transactions[0], original.transactions[2] }, rebuilt ),
+                         fc::exception );
+
+      // transactions sent in the wrong order land at the wrong index and no longer match the merkle root
+      fill_compact_block_transactions( missing, { original.transactions[2], original.transactions[0] }, rebuilt );
+      BOOST_CHECK( rebuilt.calculate_merkle_root() != original.transaction_merkle_root );
+
+      fill_compact_block_transactions( missing, { original.transactions[0], original.transactions[2] }, rebuilt );
+      BOOST_CHECK( rebuilt.calculate_merkle_root() == original.transaction_merkle_root );
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( unrequested_block )
+{
+   try {
+      signed_block first = make_compact_test_block( 1 );
+      signed_block second = make_compact_test_block( 2 );
+      compact_block_message first_compact = make_compact_block_message( first, first.id(), message( block_message( first ) ).id() );
+      compact_block_message second_compact = make_compact_block_message( second, second.id(), message( block_message( second ) ).id() );
+
+      peer_connection_ptr peer = peer_connection::make_shared( nullptr );
+      BOOST_CHECK( !is_expected_compact_block( *peer, first_compact ) );
+
+      // asking for something else under the same hash doesn't count
+      peer->items_requested_from_peer[item_id( trx_message_type, first_compact.block_message_hash )] = fc::time_point::now();
+      BOOST_CHECK( !is_expected_compact_block( *peer, first_compact ) );
+
+      peer->items_requested_from_peer[item_id( block_message_type, first_compact.block_message_hash )] = fc::time_point::now();
+      BOOST_CHECK( is_expected_compact_block( *peer, first_compact ) );
+      BOOST_CHECK( !is_expected_compact_block( *peer, second_compact ) );
+
+      // once we are rebuilding it, a second copy is unexpected
+      peer_connection::partial_compact_block pending;
+      pending.block_message_hash = first_compact.block_message_hash;
+      peer->compact_blocks_awaiting_transactions[first_compact.block_id] = pending;
+      BOOST_CHECK( !is_expected_compact_block( *peer, first_compact ) );
+
+      // a peer can't have more compact blocks pending than blocks we asked it for
+      peer->compact_blocks_awaiting_transactions.clear();
+      peer->compact_blocks_awaiting_transactions[second_compact.block_id] = pending;
+      peer->compact_blocks_awaiting_transactions[second_compact.block_id].block_message_hash = second_compact.block_message_hash;
+      BOOST_CHECK( !is_expected_compact_block( *peer, first_compact ) );
+      peer->items_requested_from_peer[item_id( block_message_type, second_compact.block_message_hash )] = fc::time_point::now();
+      BOOST_CHECK( is_expected_compact_block( *peer, first_compact ) );
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
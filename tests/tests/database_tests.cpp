@@ -28,7 +28,13 @@
 
 #include <graphene/chain/account_object.hpp>
 
+#include <graphene/account_history/account_history_plugin.hpp>
+#include <graphene/app/api.hpp>
+#include <graphene/app/database_api.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
 #include <fc/crypto/digest.hpp>
+#include <fc/thread/thread.hpp>
 
 #include "../common/database_fixture.hpp"
 
@@ -59,3 +65,450 @@ BOOST_AUTO_TEST_CASE( undo_test )
       throw;
    }
 }
+
+BOOST_FIXTURE_TEST_CASE( delta_undo_test, database_fixture )
+{
+   try {
+      const account_object& alice = create_account( "alice" );
+      const account_id_type alice_id = alice.id;
+      const auto original = fc::raw::pack( alice );
+
+      // undo of a single state restores the object
+      {
+         auto ses = db._undo_db.start_undo_session( true );
+         db.modify( alice, [&]( account_object& a ){ a.network_fee_percentage = 1234; } );
+         db.modify( alice, [&]( account_object& a ){ a.referrer_rewards_percentage = 4321; } );
+         BOOST_CHECK( !db._undo_db.head().old_deltas.empty() );
+         BOOST_CHECK( db._undo_db.head().old_values.count( alice_id ) == 0 );
+         ses.undo();
+      }
+      BOOST_CHECK( fc::raw::pack( alice_id(db) ) == original );
+
+      // merged states compose their deltas
+      {
+         auto outer = db._undo_db.start_undo_session( true );
+         db.modify( alice, [&]( account_object& a ){ a.network_fee_percentage = 1; } );
+         {
+            auto inner = db._undo_db.start_undo_session( true );
+            db.modify( alice, [&]( account_object& a ){ a.lifetime_referrer_fee_percentage = 2; } );
+            db.modify( alice, [&]( account_object& a ){ a.name = "alice-renamed-to-something-longer"; } );
+            inner.merge();
+         }
+         outer.undo();
+      }
+      BOOST_CHECK( fc::raw::pack( alice_id(db) ) == original );
+
+      // removing an object modified in an earlier state restores the original value
+      {
+         auto outer = db._undo_db.start_undo_session( true );
+         db.modify( alice, [&]( account_object& a ){ a.network_fee_percentage = 7; } );
+         {
+            auto inner = db._undo_db.start_undo_session( true );
+            db.remove( alice );
+            inner.merge();
+         }
+         outer.undo();
+      }
+      BOOST_CHECK( fc::raw::pack( alice_id(db) ) == original );
+
+      // optional fields set within a state are cleared again by undo
+      {
+         auto ses = db._undo_db.start_undo_session( true );
+         db.modify( alice, [&]( account_object& a ){
+            a.cashback_vb = vesting_balance_id_type( 5 );
+            a.allowed_assets = flat_set<asset_id_type>{ asset_id_type() };
+         } );
+         ses.undo();
+      }
+      BOOST_CHECK( !alice_id(db).cashback_vb.valid() );
+      BOOST_CHECK( !alice_id(db).allowed_assets.valid() );
+      BOOST_CHECK( fc::raw::pack( alice_id(db) ) == original );
+
+      // and optional fields cleared within a state are restored
+      db.modify( alice, [&]( account_object& a ){ a.cashback_vb = vesting_balance_id_type( 5 ); } );
+      const auto with_cashback = fc::raw::pack( alice_id(db) );
+      {
+         auto ses = db._undo_db.start_undo_session( true );
+         db.modify( alice, [&]( account_object& a ){ a.cashback_vb.reset(); } );
+         ses.undo();
+      }
+      BOOST_REQUIRE( alice_id(db).cashback_vb.valid() );
+      BOOST_CHECK( *alice_id(db).cashback_vb == vesting_balance_id_type( 5 ) );
+      BOOST_CHECK( fc::raw::pack( alice_id(db) ) == with_cashback );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( slab_index_test, database_fixture )
+{
+   try {
+      const account_object& alice = create_account( "alice" );
+      const account_object& bob = create_account( "bob" );
+      const account_id_type alice_id = alice.id;
+      const account_id_type bob_id = bob.id;
+      const auto& balances = db.get_index_type<account_balance_index>();
+
+      // every live object is visited once, in instance order, and the ordered views agree
+      auto check_index = [&]()
+      {
+         size_t count = 0;
+         object_id_type last;
+         for( const account_balance_object& b : balances )
+         {
+            if( count ) BOOST_CHECK( last < b.id );
+            last = b.id;
+            BOOST_CHECK( balances.find( b.id ) == &b );
+            auto itr = balances.indices().get<by_account_asset>().find( boost::make_tuple( b.owner, b.asset_type ) );
+            BOOST_REQUIRE( itr != balances.indices().get<by_account_asset>().end() );
+            BOOST_CHECK( *itr == &b );
+            ++count;
+         }
+         BOOST_CHECK_EQUAL( count, balances.size() );
+         BOOST_CHECK_EQUAL( count, balances.indices().size() );
+
+         const auto& by_balance = balances.indices().get<by_asset_balance>();
+         for( auto itr = by_balance.begin(); itr != by_balance.end(); ++itr )
+         {
+            auto next = itr;
+            if( ++next == by_balance.end() ) break;
+            if( (*itr)->asset_type == (*next)->asset_type )
+               BOOST_CHECK( (*itr)->balance >= (*next)->balance );
+         }
+      };
+
+      fund( alice, asset(1000) );
+      fund( bob, asset(3000) );
+      check_index();
+      BOOST_CHECK_EQUAL( db.get_balance( alice_id, asset_id_type() ).amount.value, 1000 );
+
+      const size_t before = balances.size();
+      {
+         auto ses = db._undo_db.start_undo_session( true );
+         db.adjust_balance( alice_id, asset(5000) );
+         const auto& b = *balances.indices().get<by_account_asset>().find( boost::make_tuple( bob_id, asset_id_type() ) );
+         db.remove( *b );
+         BOOST_CHECK_EQUAL( balances.size(), before - 1 );
+         BOOST_CHECK_EQUAL( db.get_balance( bob_id, asset_id_type() ).amount.value, 0 );
+         check_index();
+         ses.undo();
+      }
+      BOOST_CHECK_EQUAL( balances.size(), before );
+      BOOST_CHECK_EQUAL( db.get_balance( alice_id, asset_id_type() ).amount.value, 1000 );
+      BOOST_CHECK_EQUAL( db.get_balance( bob_id, asset_id_type() ).amount.value, 3000 );
+      check_index();
+
+      // statistics live in a slab_index too
+      BOOST_CHECK( db.find( alice.statistics ) == &alice.statistics( db ) );
+      BOOST_CHECK( db.get_index_type<account_statistics_index>().find( alice.statistics ) == &alice.statistics( db ) );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( incremental_persistence_log, database_fixture )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const fc::path log_dir = data_dir.path() / "object_database" / "log";
+      auto count_segments = [&]() {
+         size_t count = 0;
+         for( fc::directory_iterator itr( log_dir ); itr != fc::directory_iterator(); ++itr )
+            if( fc::path( *itr ).extension().string() == ".log" )
+               ++count;
+         return count;
+      };
+      auto balance_of = [&]( const database& d, account_balance_id_type id ) {
+         const account_balance_object* b = d.find( id );
+         BOOST_REQUIRE( b != nullptr );
+         return b->balance.value;
+      };
+
+      account_balance_id_type kept_id;
+      account_balance_id_type removed_id;
+      {
+         database db;
+         db.enable_incremental_persistence( 2 );
+         db.open( data_dir.path(), [this]{ return genesis_state; } );
+         db.flush();
+         const auto& kept = db.create<account_balance_object>( []( account_balance_object& b ) {
+            b.owner = account_id_type( 1 );
+            b.balance = 10;
+         } );
+         const auto& removed = db.create<account_balance_object>( []( account_balance_object& b ) {
+            b.owner = account_id_type( 2 );
+            b.balance = 20;
+         } );
+         kept_id = kept.id;
+         removed_id = removed.id;
+         db.flush();
+         BOOST_CHECK_EQUAL( count_segments(), 2 );
+         db.close( false );
+      }
+
+      BOOST_TEST_MESSAGE( "Reopening replays the log on top of the empty checkpoint" );
+      {
+         database db;
+         db.enable_incremental_persistence( 2 );
+         db.open( data_dir.path(), [this]{ return genesis_state; } );
+         BOOST_CHECK( db.find( global_property_id_type() ) != nullptr );
+         BOOST_CHECK_EQUAL( balance_of( db, kept_id ), 10 );
+         BOOST_CHECK_EQUAL( balance_of( db, removed_id ), 20 );
+
+         db.modify( kept_id( db ), []( account_balance_object& b ) { b.balance = 42; } );
+         db.remove( removed_id( db ) );
+         // a third segment exceeds the limit and merges the log in the background, close() waits for it
+         db.flush();
+         db.close( false );
+      }
+      BOOST_CHECK_EQUAL( count_segments(), 1 );
+
+      BOOST_TEST_MESSAGE( "The compacted segment restores the latest state" );
+      {
+         database db;
+         db.enable_incremental_persistence( 2 );
+         db.open( data_dir.path(), [this]{ return genesis_state; } );
+         BOOST_CHECK_EQUAL( balance_of( db, kept_id ), 42 );
+         BOOST_CHECK( db.find( removed_id ) == nullptr );
+         // the next id was restored too, so the removed id is not handed out again
+         const auto& created = db.create<account_balance_object>( []( account_balance_object& b ) { b.owner = account_id_type( 3 ); } );
+         BOOST_CHECK( created.id == object_id_type( removed_id ) + 1 );
+
+         db.checkpoint();
+         BOOST_CHECK( !fc::exists( log_dir ) );
+         db.close( false );
+      }
+      {
+         database db;
+         db.open( data_dir.path(), [this]{ return genesis_state; } );
+         BOOST_CHECK_EQUAL( balance_of( db, kept_id ), 42 );
+         BOOST_CHECK( db.find( removed_id ) == nullptr );
+         db.close( false );
+      }
+
+      BOOST_TEST_MESSAGE( "A log above the checkpoint size is replaced by a checkpoint" );
+      {
+         database db;
+         db.enable_incremental_persistence( 2, 1 );
+         db.open( data_dir.path(), [this]{ return genesis_state; } );
+         db.modify( kept_id( db ), []( account_balance_object& b ) { b.balance = 43; } );
+         db.flush();
+         BOOST_CHECK( !fc::exists( log_dir ) );
+         db.close( false );
+      }
+      {
+         database db;
+         db.open( data_dir.path(), [this]{ return genesis_state; } );
+         BOOST_CHECK_EQUAL( balance_of( db, kept_id ), 43 );
+         db.close( false );
+      }
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( state_snapshots_follow_applied_blocks, database_fixture )
+{
+   try {
+      db.enable_state_snapshots( 2 );
+      const state_snapshots& snapshots = *db.get_state_snapshots();
+
+      auto find_account = [&]( const string& name ) {
+         return snapshots.async( [name]( const database& snapshot ) -> optional<account_id_type> {
+            const auto& idx = snapshot.get_index_type<account_index>().indices().get<by_name>();
+            auto itr = idx.find( name );
+            if( itr == idx.end() )
+               return optional<account_id_type>();
+            return itr->get_id();
+         }).wait();
+      };
+      auto snapshot_hashes = [&]() {
+         return snapshots.async( []( const database& snapshot ) {
+            vector<fc::uint128> result;
+            snapshot.inspect_all_indexes( [&]( const graphene::db::index& idx ) { result.push_back( idx.hash() ); } );
+            return result;
+         }).wait();
+      };
+      auto hashes = [&]() {
+         vector<fc::uint128> result;
+         db.inspect_all_indexes( [&]( const graphene::db::index& idx ) { result.push_back( idx.hash() ); } );
+         return result;
+      };
+
+      BOOST_CHECK( snapshot_hashes() == hashes() );
+      BOOST_CHECK_EQUAL( snapshots.head_block_num(), db.head_block_num() );
+
+      const account_object& alice = create_account( "alice" );
+      const account_id_type alice_id = alice.id;
+      // pending transactions are not part of the snapshots
+      BOOST_CHECK( !find_account( "alice" ).valid() );
+
+      generate_block();
+      snapshots.wait_for_updates();
+      BOOST_CHECK_EQUAL( snapshots.head_block_num(), db.head_block_num() );
+      BOOST_REQUIRE( find_account( "alice" ).valid() );
+      BOOST_CHECK( *find_account( "alice" ) == alice_id );
+      BOOST_CHECK( snapshot_hashes() == hashes() );
+
+      BOOST_TEST_MESSAGE( "Removed objects disappear from the snapshots" );
+      const asset_id_type uia_id = create_user_issued_asset( "SNAP" ).id;
+      transfer( account_id_type()(db), alice_id(db), asset( 100000 ) );
+      const limit_order_id_type order_id = create_sell_order( alice_id, asset( 1000 ), asset( 1000, uia_id ) )->id;
+      generate_block();
+      snapshots.wait_for_updates();
+      auto find_order = [&]() {
+         return snapshots.async( [order_id]( const database& snapshot ) { return snapshot.find( order_id ) != nullptr; } ).wait();
+      };
+      BOOST_CHECK( find_order() );
+      cancel_limit_order( order_id(db) );
+      generate_block();
+      snapshots.wait_for_updates();
+      BOOST_CHECK( !find_order() );
+      BOOST_CHECK( snapshot_hashes() == hashes() );
+
+      db.enable_state_snapshots( 0 );
+      BOOST_CHECK( db.get_state_snapshots() == nullptr );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( account_history_spills_to_disk, database_fixture )
+{
+   try {
+      fc::temp_directory history_dir( graphene::utilities::temp_directory_path() );
+      auto plugin = app.get_plugin<graphene::account_history::account_history_plugin>( "account_history" );
+      plugin->enable_history_spill( 3, history_dir.path() );
+      graphene::app::history_api hist( app );
+
+      const account_id_type alice_id = create_account( "alice" ).id;
+      generate_block();
+      for( int i = 1; i <= 10; ++i )
+      {
+         transfer( account_id_type(), alice_id, asset( i ) );
+         generate_block();
+      }
+
+      const auto& by_seq_idx = db.get_index_type<account_transaction_history_index>().indices().get<by_seq>();
+      auto check_history = [&]() {
+         const uint32_t total_ops = alice_id(db).statistics(db).total_ops;
+         auto in_memory = by_seq_idx.equal_range( boost::make_tuple( alice_id ) );
+         BOOST_CHECK_LE( std::distance( in_memory.first, in_memory.second ), 3 );
+
+         auto by_seq = hist.get_relative_account_history( alice_id, 0, 100, 0 );
+         auto by_id = hist.get_account_history( alice_id, operation_history_id_type(), 100, operation_history_id_type() );
+         BOOST_REQUIRE_EQUAL( by_seq.size(), total_ops );
+         BOOST_REQUIRE_EQUAL( by_id.size(), total_ops );
+         for( size_t i = 0; i < by_seq.size(); ++i )
+         {
+            BOOST_CHECK( by_seq[i].id == by_id[i].id );
+            BOOST_CHECK_EQUAL( by_seq[i].block_num, by_id[i].block_num );
+            if( i > 0 )
+               BOOST_CHECK( by_seq[i].id < by_seq[i-1].id );
+         }
+         return by_seq;
+      };
+
+      auto ops = check_history();
+      BOOST_REQUIRE_EQUAL( ops.size(), 11 );
+      for( int i = 0; i < 10; ++i )
+         BOOST_CHECK_EQUAL( ops[i].op.get<transfer_operation>().amount.amount.value, 10 - i );
+      BOOST_CHECK( ops[10].op.which() == operation::tag<account_create_operation>::value );
+      // the first transfer fell out of the window of both accounts, so it is only on disk
+      BOOST_CHECK( db.find( operation_history_id_type( ops[9].id ) ) == nullptr );
+      BOOST_CHECK( db.find( operation_history_id_type( ops[0].id ) ) != nullptr );
+
+      // part of a page
+      auto page = hist.get_relative_account_history( alice_id, 2, 4, 8 );
+      BOOST_REQUIRE_EQUAL( page.size(), 4 );
+      BOOST_CHECK( page.front().id == ops[3].id );
+      BOOST_CHECK( page.back().id == ops[6].id );
+
+      BOOST_TEST_MESSAGE( "Popping a block brings back the history it moved to disk" );
+      db.pop_block();
+      check_history();
+      generate_block();
+      transfer( account_id_type(), alice_id, asset( 11 ) );
+      generate_block();
+      ops = check_history();
+      BOOST_CHECK_EQUAL( ops[0].op.get<transfer_operation>().amount.amount.value, 11 );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( subscriptions_get_coalesced_notifications, database_fixture )
+{
+   try {
+      graphene::app::database_api first( db );
+      graphene::app::database_api second( db );
+      vector<fc::variants> first_updates;
+      vector<fc::variants> second_updates;
+      vector<block_id_type> applied;
+      // the block applied notification is the last one a block sends to second
+      fc::promise<void>::ptr first_notified( new fc::promise<void>( "first_notified" ) );
+      fc::promise<void>::ptr block_notified( new fc::promise<void>( "block_notified" ) );
+      first.set_subscribe_callback( [&]( const fc::variant& v ) {
+         first_updates.push_back( v.get_array() );
+         if( !first_notified->ready() )
+            first_notified->set_value();
+      }, true );
+      second.set_subscribe_callback( [&]( const fc::variant& v ) { second_updates.push_back( v.get_array() ); }, true );
+      second.set_block_applied_callback( [&]( const fc::variant& v ) {
+         applied.push_back( v.as<block_id_type>() );
+         if( !block_notified->ready() )
+            block_notified->set_value();
+      } );
+
+      // the pending transaction and the block which includes it change the account, it is sent once
+      const account_id_type alice_id = create_account( "alice" ).id;
+      generate_block();
+      first_notified->wait( fc::seconds( 10 ) );
+      block_notified->wait( fc::seconds( 10 ) );
+
+      BOOST_REQUIRE_EQUAL( first_updates.size(), 1 );
+      BOOST_REQUIRE_EQUAL( second_updates.size(), 1 );
+      BOOST_CHECK( first_updates[0] == second_updates[0] );
+      size_t alice_updates = 0;
+      flat_set<object_id_type> ids;
+      for( const fc::variant& update : first_updates[0] )
+      {
+         const object_id_type id = update.is_object() ? update["id"].as<object_id_type>() : update.as<object_id_type>();
+         BOOST_CHECK( ids.insert( id ).second );
+         if( id == alice_id )
+            ++alice_updates;
+      }
+      BOOST_CHECK_EQUAL( alice_updates, 1 );
+      BOOST_REQUIRE_EQUAL( applied.size(), 1 );
+      BOOST_CHECK( applied[0] == db.head_block_id() );
+
+      graphene::app::subscription_queue_info info = second.get_subscription_queue_info();
+      BOOST_CHECK_EQUAL( info.queued, 0 );
+      BOOST_CHECK_EQUAL( info.delivered, 2 );
+      BOOST_CHECK_EQUAL( info.dropped, 0 );
+
+      BOOST_TEST_MESSAGE( "Cancelled subscriptions get nothing" );
+      first.cancel_all_subscriptions();
+      block_notified.reset( new fc::promise<void>( "block_notified" ) );
+      generate_block();
+      block_notified->wait( fc::seconds( 10 ) );
+      // every subscriber's notifications are queued by the same flush, so anything for first would be queued by now
+      BOOST_CHECK_EQUAL( first.get_subscription_queue_info().queued, 0 );
+      BOOST_CHECK_EQUAL( first_updates.size(), 1 );
+      BOOST_CHECK_EQUAL( applied.size(), 2 );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
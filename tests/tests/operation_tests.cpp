@@ -36,8 +36,12 @@
 #include <graphene/chain/withdraw_permission_object.hpp>
 #include <graphene/chain/witness_object.hpp>
 
+#include <graphene/app/database_api.hpp>
+
 #include <fc/crypto/digest.hpp>
 
+#include <random>
+
 #include "../common/database_fixture.hpp"
 
 using namespace graphene::chain;
@@ -1180,6 +1184,57 @@ BOOST_AUTO_TEST_CASE( witness_feeds )
 }
 
 
+BOOST_AUTO_TEST_CASE( feed_expiration_schedule )
+{ try {
+   ACTORS((feedproducer));
+
+   const auto& bitusd = create_bitasset("USDBIT", feedproducer_id);
+   const auto& biteur = create_bitasset("EURBIT", feedproducer_id);
+   const auto& core   = asset_id_type()(db);
+   const asset_id_type bitusd_id = bitusd.get_id();
+   update_feed_producers(bitusd, {feedproducer.id});
+   update_feed_producers(biteur, {feedproducer.id});
+
+   price_feed current_feed;
+   current_feed.settlement_price = bitusd.amount( 1 ) / core.amount( 5 );
+   publish_feed( bitusd, feedproducer, current_feed );
+   generate_block();
+   BOOST_CHECK( bitusd_id(db).options.core_exchange_rate == current_feed.settlement_price );
+
+   BOOST_TEST_MESSAGE( "A core exchange rate set by the issuer is replaced by the one of the feed in the next block" );
+   asset_update_operation uop;
+   uop.issuer = feedproducer_id;
+   uop.asset_to_update = bitusd_id;
+   uop.new_options = bitusd_id(db).options;
+   uop.new_options.core_exchange_rate = bitusd.amount( 1 ) / core.amount( 7 );
+   trx.operations.push_back( uop );
+   PUSH_TX( db, trx, ~0 );
+   trx.clear();
+   BOOST_CHECK( bitusd_id(db).options.core_exchange_rate == uop.new_options.core_exchange_rate );
+   generate_block();
+   BOOST_CHECK( bitusd_id(db).options.core_exchange_rate == current_feed.settlement_price );
+
+   BOOST_TEST_MESSAGE( "The feed is dropped in the first block at or after its expiration" );
+   const time_point_sec expiration = bitusd_id(db).bitasset_data(db).feed_expiration_time();
+   generate_blocks( expiration - db.get_global_properties().parameters.block_interval );
+   BOOST_CHECK( db.head_block_time() < expiration );
+   BOOST_CHECK( !bitusd_id(db).bitasset_data(db).current_feed.settlement_price.is_null() );
+   generate_block();
+   BOOST_CHECK( db.head_block_time() >= expiration );
+   BOOST_CHECK( bitusd_id(db).bitasset_data(db).current_feed.settlement_price.is_null() );
+   BOOST_CHECK( bitusd_id(db).bitasset_data(db).feed_expiration_time() > db.head_block_time() );
+
+   BOOST_TEST_MESSAGE( "Popping the block brings the feed back and applying a block again drops it" );
+   db.pop_block();
+   BOOST_CHECK( !bitusd_id(db).bitasset_data(db).current_feed.settlement_price.is_null() );
+   generate_block();
+   BOOST_CHECK( bitusd_id(db).bitasset_data(db).current_feed.settlement_price.is_null() );
+   BOOST_CHECK( bitusd_id(db).options.core_exchange_rate == current_feed.settlement_price );
+} catch( const fc::exception& e) {
+   edump((e.to_detail_string()));
+   throw;
+} }
+
 /**
  *  Create an order such that when the trade executes at the
  *  requested price the resulting payout to one party is 0
@@ -1214,6 +1269,69 @@ BOOST_AUTO_TEST_CASE( trade_amount_equals_zero )
 }
 
 
+BOOST_AUTO_TEST_CASE( market_ticker_rolls_over_24_hours )
+{
+   try {
+      INVOKE(issue_uia);
+      const asset_object& test = get_asset( "TEST" );
+      const asset_object& core = get_asset( GRAPHENE_SYMBOL );
+      const account_object& core_seller = create_account( "shorter1" );
+      const account_object& core_buyer = get_account("nathan");
+      transfer( committee_account(db), core_seller, asset( 100000000 ) );
+      generate_block();
+
+      graphene::app::database_api db_api( db );
+      auto real = [&]( int64_t amount, const asset_object& a ) { return double( amount ) / pow( 10, a.precision ); };
+      auto trade = [&]( int64_t core_amount, int64_t test_amount ) {
+         create_sell_order( core_seller, core.amount( core_amount ), test.amount( test_amount ) );
+         create_sell_order( core_buyer, test.amount( test_amount ), core.amount( core_amount ) );
+         generate_block();
+      };
+      auto check_ticker = [&]( int64_t core_volume, int64_t test_volume, double latest, double percent_change ) {
+         graphene::app::market_ticker ticker = db_api.get_ticker( GRAPHENE_SYMBOL, "TEST" );
+         BOOST_CHECK_CLOSE( ticker.base_volume, real( core_volume, core ), 0.0001 );
+         BOOST_CHECK_CLOSE( ticker.quote_volume, real( test_volume, test ), 0.0001 );
+         BOOST_CHECK_CLOSE( ticker.latest, latest, 0.0001 );
+         BOOST_CHECK_CLOSE( ticker.percent_change, percent_change, 0.0001 );
+
+         // the same market the other way around
+         auto tickers = db_api.get_tickers( { { GRAPHENE_SYMBOL, "TEST" }, { "TEST", GRAPHENE_SYMBOL } } );
+         BOOST_REQUIRE_EQUAL( tickers.size(), 2 );
+         BOOST_CHECK_CLOSE( tickers[1].base_volume, ticker.quote_volume, 0.0001 );
+         BOOST_CHECK_CLOSE( tickers[1].quote_volume, ticker.base_volume, 0.0001 );
+         BOOST_CHECK_CLOSE( tickers[1].latest * ticker.latest, 1, 0.0001 );
+
+         graphene::app::market_volume volume = db_api.get_24_volume( GRAPHENE_SYMBOL, "TEST" );
+         BOOST_CHECK_CLOSE( volume.base_volume, ticker.base_volume, 0.0001 );
+         BOOST_CHECK_CLOSE( volume.quote_volume, ticker.quote_volume, 0.0001 );
+      };
+
+      graphene::app::market_ticker empty = db_api.get_ticker( GRAPHENE_SYMBOL, "TEST" );
+      BOOST_CHECK_EQUAL( empty.base_volume, 0 );
+      BOOST_CHECK_EQUAL( empty.latest, 0 );
+
+      const double first_price = real( 100, core ) / real( 200, test );
+      const double second_price = real( 100, core ) / real( 400, test );
+      trade( 100, 200 );
+      const fc::time_point_sec first_trade = db.head_block_time();
+      check_ticker( 100, 200, first_price, 0 );
+
+      generate_blocks( first_trade + fc::hours( 12 ) );
+      trade( 100, 400 );
+      check_ticker( 200, 600, second_price, 0 );
+
+      BOOST_TEST_MESSAGE( "The first trade leaves the window and becomes its opening price" );
+      generate_blocks( first_trade + fc::hours( 24 ) + fc::minutes( 1 ) );
+      check_ticker( 100, 400, second_price, -50 );
+
+      generate_blocks( first_trade + fc::hours( 48 ) );
+      check_ticker( 0, 0, second_price, 0 );
+   } catch( const fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 /**
  *  Create an order that cannot be filled immediately and have the
  *  transaction fail.
@@ -1239,6 +1357,183 @@ BOOST_AUTO_TEST_CASE( limit_order_fill_or_kill )
    PUSH_TX( db, trx, ~0 );
 } FC_LOG_AND_RETHROW() }
 
+/**
+ *  Feeds the same randomized stream of limit orders and cancellations through the flat order book
+ *  and through the by_price index, and requires every intermediate state to be identical.
+ */
+BOOST_AUTO_TEST_CASE( flat_order_book_matches_by_price_index )
+{ try {
+   const asset_id_type uia_id = create_user_issued_asset( "BOOK" ).id;
+   vector<account_id_type> traders;
+   for( const string name : { "trader-a", "trader-b", "trader-c", "trader-d" } )
+   {
+      const account_object& trader = create_account( name );
+      transfer( committee_account(db), trader, asset( 100000000 ) );
+      issue_uia( trader, asset( 100000000, uia_id ) );
+      traders.push_back( trader.id );
+   }
+   generate_block();
+
+   struct step
+   {
+      bool      cancel;
+      uint32_t  trader;
+      bool      sell_core;
+      int64_t   amount;
+      int64_t   receive;
+      uint32_t  pick;
+   };
+   std::mt19937 rng( 1337 );
+   vector<step> stream;
+   for( uint32_t i = 0; i < 300; ++i )
+   {
+      step s;
+      s.cancel    = rng() % 8 == 0;
+      s.trader    = rng() % traders.size();
+      s.sell_core = rng() % 2;
+      s.amount    = 1 + rng() % 1000;
+      // prices spread around 1:1, with repeats, so orders cross and share levels
+      s.receive   = std::max<int64_t>( 1, s.amount * (90 + rng() % 21) / 100 );
+      s.pick      = rng();
+      stream.push_back( s );
+   }
+
+   const auto& limit_index = db.get_index_type<limit_order_index>();
+   const auto& book_index = dynamic_cast<const primary_index<limit_order_index>&>( limit_index ).get_secondary_index<limit_order_book_index>();
+
+   auto check_books = [&]()
+   {
+      // by_price sorts books by descending asset ids and levels by descending price
+      vector<const limit_order_object*> flat, by_price;
+      for( auto book = book_index.books().rbegin(); book != book_index.books().rend(); ++book )
+         for( auto level = book->second.rbegin(); level != book->second.rend(); ++level )
+            for( const limit_order_object* order : level->orders )
+            {
+               BOOST_CHECK( order->sell_price == level->sell_price );
+               flat.push_back( order );
+            }
+      for( const limit_order_object& order : limit_index.indices().get<by_price>() )
+         by_price.push_back( &order );
+      BOOST_CHECK( flat == by_price );
+   };
+
+   auto run = [&]( bool flat_order_book )
+   {
+      db.set_flat_order_book_matching( flat_order_book );
+      vector<fc::uint128> result;
+      for( const step& s : stream )
+      {
+         const auto& orders = limit_index.indices().get<by_id>();
+         if( s.cancel )
+         {
+            if( orders.empty() )
+               continue;
+            auto itr = orders.begin();
+            std::advance( itr, s.pick % orders.size() );
+            cancel_limit_order( *itr );
+         }
+         else if( s.sell_core )
+            create_sell_order( traders[s.trader](db), asset( s.amount ), asset( s.receive, uia_id ) );
+         else
+            create_sell_order( traders[s.trader](db), asset( s.amount, uia_id ), asset( s.receive ) );
+
+         check_books();
+         db.inspect_all_indexes( [&]( const graphene::db::index& idx ) { result.push_back( idx.hash() ); } );
+      }
+      db.clear_pending();
+      return result;
+   };
+
+   const auto flat_result = run( true );
+   const auto by_price_result = run( false );
+   BOOST_CHECK( flat_result == by_price_result );
+   db.set_flat_order_book_matching( true );
+} FC_LOG_AND_RETHROW() }
+
+/**
+ *  Feeds the same randomized stream of feed publications, borrows and sell orders through check_call_orders()
+ *  with and without the early margin call trigger checks, and requires every intermediate state to be identical.
+ */
+BOOST_AUTO_TEST_CASE( margin_call_trigger_checks_match_full_search )
+{ try {
+   ACTORS((feedproducer));
+   const asset_id_type usd_id = create_bitasset( "USDBIT", feedproducer_id ).id;
+   update_feed_producers( usd_id(db), {feedproducer_id} );
+   vector<account_id_type> traders;
+   for( const string name : { "trader-a", "trader-b", "trader-c", "trader-d" } )
+   {
+      const account_object& trader = create_account( name );
+      transfer( committee_account(db), trader, asset( 100000000 ) );
+      traders.push_back( trader.id );
+   }
+   price_feed feed;
+   feed.settlement_price = asset( 100, usd_id ) / asset( 100 );
+   publish_feed( usd_id(db), feedproducer_id(db), feed );
+   generate_block();
+
+   struct step
+   {
+      uint32_t  kind;
+      uint32_t  trader;
+      int64_t   amount;
+      int64_t   percent;
+   };
+   std::mt19937 rng( 4242 );
+   vector<step> stream;
+   for( uint32_t i = 0; i < 300; ++i )
+   {
+      step s;
+      s.kind    = rng() % 4;
+      s.trader  = rng() % traders.size();
+      s.amount  = 100 + rng() % 1000;
+      s.percent = s.kind == 1 ? 150 + rng() % 300 : 80 + rng() % 60;
+      stream.push_back( s );
+   }
+
+   const auto& call_index = db.get_index_type<call_order_index>();
+   const auto& margin_index = dynamic_cast<const primary_index<call_order_index>&>( call_index ).get_secondary_index<call_order_margin_index>();
+
+   auto run = [&]( bool trigger_checks )
+   {
+      db.set_margin_call_trigger_checks( trigger_checks );
+      vector<fc::uint128> result;
+      for( const step& s : stream )
+      {
+         bool failed = false;
+         try {
+            const account_object& trader = traders[s.trader](db);
+            if( s.kind == 0 )
+            {
+               feed.settlement_price = asset( 100, usd_id ) / asset( s.percent );
+               publish_feed( usd_id(db), feedproducer_id(db), feed );
+            }
+            else if( s.kind == 1 )
+               borrow( trader, asset( s.amount, usd_id ), asset( s.amount * s.percent / 100 ) );
+            else
+               create_sell_order( trader, asset( s.amount, usd_id ), asset( s.amount * s.percent / 100 ) );
+         } catch( const fc::exception& ) {
+            failed = true;
+         }
+         trx.clear();
+
+         const auto& by_price = call_index.indices().get<by_price>();
+         auto first = by_price.lower_bound( price::min( asset_id_type(), usd_id ) );
+         const call_order_object* expected = first == by_price.end() || first->debt_type() != usd_id ? nullptr : &*first;
+         BOOST_CHECK( margin_index.first_call( asset_id_type(), usd_id ) == expected );
+
+         result.push_back( fc::uint128( failed ? 1 : 0 ) );
+         db.inspect_all_indexes( [&]( const graphene::db::index& idx ) { result.push_back( idx.hash() ); } );
+      }
+      db.clear_pending();
+      return result;
+   };
+
+   const auto checked_result = run( true );
+   const auto searched_result = run( false );
+   BOOST_CHECK( checked_result == searched_result );
+   db.set_margin_call_trigger_checks( true );
+} FC_LOG_AND_RETHROW() }
+
 /// Shameless code coverage plugging. Otherwise, these calls never happen.
 BOOST_AUTO_TEST_CASE( fill_order )
 { try {
@@ -469,6 +469,79 @@ BOOST_AUTO_TEST_CASE( witness_create )
    BOOST_CHECK_GE( produced, 1 );
 } FC_LOG_AND_RETHROW() }
 
+/**
+ *  Changes stake, votes and proxies between maintenance intervals, and checks that the votes counted
+ *  incrementally for every witness match a count over all accounts.
+ */
+BOOST_AUTO_TEST_CASE( incremental_vote_tally )
+{ try {
+   ACTORS( (alice)(bob)(carol) );
+   const auto& all_witnesses = db.get_index_type<witness_index>().indices();
+   BOOST_REQUIRE_GE( all_witnesses.size(), 2u );
+   const witness_id_type first_witness = all_witnesses.begin()->id;
+   const witness_id_type second_witness = std::next( all_witnesses.begin() )->id;
+   const vote_id_type first_vote = first_witness(db).vote_id;
+   const vote_id_type second_vote = second_witness(db).vote_id;
+
+   transfer( committee_account, alice_id, asset( 3000000 ) );
+   transfer( committee_account, bob_id, asset( 5000000 ) );
+   transfer( committee_account, carol_id, asset( 7000000 ) );
+
+   auto update_votes = [&]( account_id_type account, const fc::ecc::private_key& key,
+                            flat_set<vote_id_type> votes, account_id_type proxy )
+   {
+      account_update_operation op;
+      op.account = account;
+      op.new_options = account(db).options;
+      op.new_options->votes = votes;
+      op.new_options->voting_account = proxy;
+      op.new_options->num_witness = votes.size();
+      trx.operations.push_back( op );
+      set_expiration( db, trx );
+      sign( trx, key );
+      PUSH_TX( db, trx );
+      trx.clear();
+   };
+
+   auto check_votes = [&]()
+   {
+      map<vote_id_type, uint64_t> expected;
+      for( const account_object& a : db.get_index_type<account_index>().indices() )
+      {
+         const account_object& opinions = a.options.voting_account == GRAPHENE_PROXY_TO_SELF_ACCOUNT ? a
+                                          : a.options.voting_account(db);
+         uint64_t stake = a.statistics(db).total_core_in_orders.value
+                        + (a.cashback_vb.valid() ? (*a.cashback_vb)(db).balance.amount.value : 0)
+                        + db.get_balance( a.id, asset_id_type() ).amount.value;
+         for( vote_id_type id : opinions.options.votes )
+            expected[id] += stake;
+      }
+      for( const witness_object& w : all_witnesses )
+         BOOST_CHECK_EQUAL( w.total_votes, expected[w.vote_id] );
+   };
+
+   // the first maintenance counts every account
+   update_votes( alice_id, alice_private_key, { first_vote }, GRAPHENE_PROXY_TO_SELF_ACCOUNT );
+   update_votes( bob_id, bob_private_key, { first_vote, second_vote }, GRAPHENE_PROXY_TO_SELF_ACCOUNT );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   check_votes();
+   BOOST_CHECK_GE( first_witness(db).total_votes, 7000000u );
+
+   // then only the changed ones
+   transfer( bob_id, carol_id, asset( 1000000 ) );
+   update_votes( carol_id, carol_private_key, {}, alice_id );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   check_votes();
+   BOOST_CHECK_GE( first_witness(db).total_votes, 14000000u );
+
+   // changing the opinions of a proxy moves the stake of everyone following it
+   update_votes( alice_id, alice_private_key, { second_vote }, GRAPHENE_PROXY_TO_SELF_ACCOUNT );
+   create_sell_order( bob_id, asset( 500000 ), asset( 500000, create_user_issued_asset( "TALLY" ).id ) );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   check_votes();
+   BOOST_CHECK_GE( second_witness(db).total_votes, 14000000u );
+} FC_LOG_AND_RETHROW() }
+
 /**
  *  This test should verify that the asset_global_settle operation works as expected,
  *  make sure that global settling cannot be performed by anyone other than the
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/sync_scheduler.hpp>
+
+using namespace graphene::net;
+using namespace graphene::net::detail;
+
+namespace
+{
+   std::vector<block_message> make_sync_chain( uint32_t count )
+   {
+      std::vector<block_message> chain;
+      signed_block b;
+      for( uint32_t i = 0; i < count; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.timestamp = fc::time_point_sec( 3 * (i + 1) );
+         chain.push_back( block_message( b ) );
+      }
+      return chain;
+   }
+
+   /// pushes blocks to "the client" the way node_impl::process_backlog_of_sync_blocks does
+   std::vector<block_id_type> drain_sync_blocks( const std::unordered_set<peer_connection_ptr>& peers,
+                                                 sync_reorder_buffer& received_sync_items )
+   {
+      std::vector<block_id_type> processed;
+      for( auto next = find_next_sync_block( peers, received_sync_items );
+           next != received_sync_items.end();
+           next = find_next_sync_block( peers, received_sync_items ) )
+      {
+         block_id_type block_id = next->first;
+         received_sync_items.erase( next );
+         for( const peer_connection_ptr& peer : peers )
+            if( !peer->ids_of_items_to_get.empty() && peer->ids_of_items_to_get.front() == block_id )
+               peer->ids_of_items_to_get.pop_front();
+         processed.push_back( block_id );
+      }
+      return processed;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(sync_scheduler_tests)
+
+BOOST_AUTO_TEST_CASE( straggler_reassignment )
+{
+   try {
+      std::vector<block_message> chain = make_sync_chain( 3 );
+      fc::time_point now = fc::time_point::now();
+
+      peer_connection_ptr straggler = peer_connection::make_shared( nullptr );
+      straggler->sync_blocks_per_second = 10;
+      straggler->sync_window_size = 3;
+      straggler->sync_window_requested_time = now - fc::seconds(10);
+      for( const block_message& block : chain )
+         straggler->sync_items_requested_from_peer[item_id( block_message_type, block.block_id )] = straggler->sync_window_requested_time;
+
+      BOOST_CHECK( is_straggling_sync_peer( *straggler, now ) );
+      BOOST_CHECK( !is_straggling_sync_peer( *straggler, straggler->sync_window_requested_time + fc::seconds(1) ) );
+
+      // the fast peer is missing the last block, so that one has to go to the slow peer
+      peer_connection_ptr fast_peer = peer_connection::make_shared( nullptr );
+      fast_peer->sync_blocks_per_second = 50;
+      fast_peer->ids_of_items_to_get.push_back( chain[0].block_id );
+      fast_peer->ids_of_items_to_get.push_back( chain[1].block_id );
+      peer_connection_ptr slow_peer = peer_connection::make_shared( nullptr );
+      for( const block_message& block : chain )
+         slow_peer->ids_of_items_to_get.push_back( block.block_id );
+      std::vector<peer_connection_ptr> idle_peers = { fast_peer, slow_peer };
+
+      // the second block already arrived from somewhere else
+      sync_reorder_buffer received_sync_items;
+      received_sync_items[chain[1].block_id] = chain[1];
+
+      std::set<item_hash_t> reassigned_sync_requests;
+      std::set<item_hash_t> sync_items_to_request;
+      std::map<peer_connection_ptr, std::vector<item_hash_t> > requests;
+      BOOST_CHECK_EQUAL( reassign_straggling_sync_items( *straggler, idle_peers, 100, received_sync_items,
+                                                         reassigned_sync_requests, sync_items_to_request, requests ), 2u );
+      BOOST_REQUIRE_EQUAL( requests[fast_peer].size(), 1u );
+      BOOST_CHECK( requests[fast_peer][0] == chain[0].block_id );
+      BOOST_REQUIRE_EQUAL( requests[slow_peer].size(), 1u );
+      BOOST_CHECK( requests[slow_peer][0] == chain[2].block_id );
+      BOOST_CHECK_EQUAL( reassigned_sync_requests.size(), 2u );
+
+      // a block is only ever reassigned once
+      requests.clear();
+      BOOST_CHECK_EQUAL( reassign_straggling_sync_items( *straggler, idle_peers, 100, received_sync_items,
+                                                         reassigned_sync_requests, sync_items_to_request, requests ), 0u );
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( out_of_order_sync_blocks )
+{
+   try {
+      std::vector<block_message> chain = make_sync_chain( 4 );
+
+      peer_connection_ptr peer_a = peer_connection::make_shared( nullptr );
+      for( const block_message& block : chain )
+         peer_a->ids_of_items_to_get.push_back( block.block_id );
+      peer_connection_ptr peer_b = peer_connection::make_shared( nullptr );
+      peer_b->ids_of_items_to_get.push_back( chain[2].block_id );
+      peer_b->ids_of_items_to_get.push_back( chain[3].block_id );
+      std::unordered_set<peer_connection_ptr> peers = { peer_a, peer_b };
+
+      // later windows complete first; nothing can be pushed until the head of the chain arrives
+      sync_reorder_buffer received_sync_items;
+      received_sync_items[chain[3].block_id] = chain[3];
+      received_sync_items[chain[2].block_id] = chain[2];
+      BOOST_CHECK( drain_sync_blocks( peers, received_sync_items ).empty() );
+
+      received_sync_items[chain[0].block_id] = chain[0];
+      std::vector<block_id_type> processed = drain_sync_blocks( peers, received_sync_items );
+      BOOST_REQUIRE_EQUAL( processed.size(), 1u );
+      BOOST_CHECK( processed[0] == chain[0].block_id );
+      BOOST_CHECK_EQUAL( received_sync_items.size(), 2u );
+
+      received_sync_items[chain[1].block_id] = chain[1];
+      processed = drain_sync_blocks( peers, received_sync_items );
+      BOOST_REQUIRE_EQUAL( processed.size(), 3u );
+      for( uint32_t i = 0; i < 3; ++i )
+         BOOST_CHECK( processed[i] == chain[i + 1].block_id );
+      BOOST_CHECK( received_sync_items.empty() );
+      BOOST_CHECK( peer_a->ids_of_items_to_get.empty() );
+      BOOST_CHECK( peer_b->ids_of_items_to_get.empty() );
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE( duplicate_sync_block_arrival )
+{
+   try {
+      std::vector<block_message> chain = make_sync_chain( 3 );
+
+      peer_connection_ptr peer = peer_connection::make_shared( nullptr );
+      for( const block_message& block : chain )
+         peer->ids_of_items_to_get.push_back( block.block_id );
+      std::unordered_set<peer_connection_ptr> peers = { peer };
+
+      // the reassigned copy of the first block arrives and is handled
+      sync_reorder_buffer received_sync_items;
+      BOOST_CHECK( is_sync_block_still_needed( peers, chain[0].block_id ) );
+      received_sync_items[chain[0].block_id] = chain[0];
+      BOOST_CHECK_EQUAL( drain_sync_blocks( peers, received_sync_items ).size(), 1u );
+
+      // so the straggler's late copy is no longer needed and must not be buffered
+      BOOST_CHECK( !is_sync_block_still_needed( peers, chain[0].block_id ) );
+      BOOST_CHECK( is_sync_block_still_needed( peers, chain[2].block_id ) );
+
+      // anything stale that got into the buffer anyway is dropped, and the rest is kept
+      received_sync_items[chain[0].block_id] = chain[0];
+      received_sync_items[chain[2].block_id] = chain[2];
+      BOOST_CHECK_EQUAL( remove_unneeded_sync_blocks( peers, received_sync_items ), 1u );
+      BOOST_REQUIRE_EQUAL( received_sync_items.size(), 1u );
+      BOOST_CHECK( received_sync_items.begin()->first == chain[2].block_id );
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_SUITE_END()